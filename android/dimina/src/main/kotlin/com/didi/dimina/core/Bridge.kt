@@ -257,7 +257,7 @@ class Bridge(
         val target = msg.getString("target")
         if (target == "service") {
             //  转发到逻辑线程
-            options.jscore.postMessage(msg.toString())
+            options.jscore.postMessage(msg)
         } else if (target == "render") {
             // 转发到渲染线程
             options.webview.postMessage(msg.toString())
@@ -292,7 +292,7 @@ class Bridge(
         if (destroyed) {
             return
         }
-        options.jscore.postMessage(msg.toString())
+        options.jscore.postMessage(msg)
         if (msg.optString("type") == "resourceLoaded") {
             flushPendingAppShow()
             flushPageVisibility()
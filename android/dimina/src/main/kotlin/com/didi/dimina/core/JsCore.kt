@@ -34,6 +34,10 @@ class JsCore {
         jsEngine = QuickJSEngine()
         val initialized = jsEngine.initialize()
         LogUtils.d(tag, "QuickJS engine initialized: $initialized")
+        if (initialized) {
+            // invoke 消息和对象形式的 postMessage 走二进制格式，省掉两端的 JSON 序列化
+            jsEngine.setWireFormat(true)
+        }
         // Notify callback if provided
         callback?.invoke(initialized)
 
@@ -181,11 +185,22 @@ class JsCore {
             JSONObject().apply {
                 put("type", type)
                 put("body", body)
-            }.toString()
+            }
         )
     }
 
     fun postMessage(msg: String) {
+        postToRuntime { jsEngine.dispatchMessage(msg) }
+    }
+
+    /**
+     * 对象形式的消息，引擎开启二进制消息格式时不经过 JSON 文本
+     */
+    fun postMessage(msg: JSONObject) {
+        postToRuntime { jsEngine.dispatchMessage(msg) }
+    }
+
+    private fun postToRuntime(dispatch: () -> Unit) {
         if (!isInitialized()) {
             LogUtils.e(tag, "Cannot post message: Engine not initialized")
             return
@@ -193,7 +208,7 @@ class JsCore {
         val accepted = runtimeMessageQueue.post {
             // Immediate teardown may close the engine independently of this queued action.
             if (isInitialized()) {
-                jsEngine.evaluate(JavaScriptUtils.invokeWithJson("DiminaServiceBridge.onMessage", msg))
+                dispatch()
             }
         }
         if (!accepted) {
@@ -38,6 +38,7 @@ import com.didi.dimina.common.LogUtils
 import com.didi.dimina.common.Utils
 import com.didi.dimina.common.VersionUtils
 import com.didi.dimina.engine.qjs.JSValue
+import com.didi.dimina.engine.qjs.QuickJSEngine
 import com.didi.dimina.ui.container.DiminaActivity
 import kotlinx.coroutines.CoroutineScope
 import kotlinx.coroutines.Dispatchers
@@ -206,6 +207,9 @@ class MiniApp private constructor() {
                                     evaluate("globalThis.__diminaRegisteredApis = $apisJson")
                                 }
 
+                                QuickJSEngine.setCodeCacheDirectory(
+                                    File(context.cacheDir, "qjs_code_cache").absolutePath
+                                )
                                 evaluateFromFile(
                                     File(
                                         context.filesDir.absolutePath,
@@ -11,6 +11,11 @@
     *;
 }
 
+# 保留 WireFormat，native 通过 decodeObject 解码 invoke 消息
+-keep class com.didi.dimina.engine.qjs.WireFormat {
+    *;
+}
+
 # 保留所有与 JNI 相关的本地方法
 -keepclasseswithmembernames class * {
     native <methods>;
@@ -1,11 +1,15 @@
 package com.didi.dimina.engine.qjs
 
 import androidx.test.ext.junit.runners.AndroidJUnit4
+import androidx.test.platform.app.InstrumentationRegistry
 import org.junit.After
 import org.junit.Before
 import org.junit.Test
 import org.junit.Assert.*
+import org.json.JSONArray
+import org.json.JSONObject
 import org.junit.runner.RunWith
+import java.io.File
 import java.util.concurrent.CountDownLatch
 import java.util.concurrent.TimeUnit
 import java.util.concurrent.atomic.AtomicReference
@@ -900,4 +904,411 @@ class QuickJSEngineTest {
         val result = jsEngine.evaluate("rapidCount")
         assertEquals("Only 10 timers should execute", 10, result.numberValue.toInt())
     }
+
+    /**
+     * 测试 queueMicrotask、setImmediate 和 MessageChannel 的执行顺序
+     * 
+     * 验证内容:
+     * - 同一段脚本里依次排入 setImmediate、queueMicrotask 和端口消息
+     * - 取消其中一个 setImmediate
+     * 
+     * 预期结果: 同步代码 -> 微任务 -> immediate -> 端口消息，被取消的不执行
+     */
+    @Test
+    fun testSchedulingPrimitivesOrder() {
+        val initialized = jsEngine.initialize()
+        assertTrue("Engine should initialize successfully", initialized)
+        
+        jsEngine.evaluate("""
+            globalThis.order = [];
+            setImmediate((tag) => order.push(tag), "immediate");
+            queueMicrotask(() => order.push("microtask"));
+            const channel = new MessageChannel();
+            channel.port1.onmessage = (e) => order.push("message:" + e.data);
+            channel.port2.postMessage(1);
+            clearImmediate(setImmediate(() => order.push("cleared")));
+            order.push("sync");
+        """)
+        
+        Thread.sleep(100)
+        
+        val result = jsEngine.evaluate("order.join(',')")
+        assertEquals("sync,microtask,immediate,message:1", result.stringValue)
+    }
+
+    /**
+     * 测试定时器槽位复用
+     * 
+     * 验证内容:
+     * - 分 10 轮各创建并取消 100 个定时器
+     * - 取消后再次调用旧 id 的 clearTimeout
+     * 
+     * 预期结果: 同时存活 100 个只需两个 64 槽的分块，之后各轮复用；旧 id 不会误取消复用同一槽位的新定时器
+     */
+    @Test
+    fun testTimerSlabReuse() {
+        val initialized = jsEngine.initialize()
+        assertTrue("Engine should initialize successfully", initialized)
+        
+        jsEngine.evaluate("""
+            for (let round = 0; round < 10; round++) {
+                const ids = [];
+                for (let i = 0; i < 100; i++) {
+                    ids.push(setTimeout(() => {}, 1000));
+                }
+                ids.forEach(id => clearTimeout(id));
+            }
+            
+            globalThis.staleFired = false;
+            const stale = setTimeout(() => {}, 1000);
+            clearTimeout(stale);
+            setTimeout(() => { staleFired = true; }, 50);
+            clearTimeout(stale);
+        """)
+        
+        Thread.sleep(200)
+        
+        assertTrue("Stale id must not cancel a reused slot", jsEngine.evaluate("staleFired").booleanValue)
+        val stats = jsEngine.getEngineStats()
+        assertNotNull(stats)
+        assertTrue(stats!!.getLong("timersCreated") >= 1002)
+        assertEquals("100 live timers need two chunks, later rounds reuse them", 2, stats.getLong("timerChunkAllocations"))
+    }
+
+    /**
+     * 测试 publish 合并
+     * 
+     * 验证内容:
+     * - 开启合并后，同一轮里对两个页面各 publish 多次
+     * - 回调仍然逐条收到消息
+     * 
+     * 预期结果: 每个页面按发送顺序收到全部消息
+     */
+    @Test
+    fun testPublishBatching() {
+        val initialized = jsEngine.initialize()
+        assertTrue("Engine should initialize successfully", initialized)
+        jsEngine.setPublishBatching(true)
+
+        val latch = CountDownLatch(5)
+        val page1 = mutableListOf<Int>()
+        val page2 = mutableListOf<Int>()
+        jsEngine.setPublishCallback("1") { msg -> page1.add(msg.getInt("seq")); latch.countDown() }
+        jsEngine.setPublishCallback("2") { msg -> page2.add(msg.getInt("seq")); latch.countDown() }
+
+        jsEngine.evaluate("""
+            for (let i = 0; i < 3; i++) {
+                DiminaServiceBridge.publish("1", { seq: i });
+            }
+            DiminaServiceBridge.publish("2", { seq: 0 });
+            DiminaServiceBridge.publish("2", { seq: 1 });
+        """)
+
+        assertTrue("All publishes should be delivered", latch.await(2, TimeUnit.SECONDS))
+        assertEquals(listOf(0, 1, 2), page1)
+        assertEquals(listOf(0, 1), page2)
+    }
+
+    /**
+     * 测试二进制消息格式
+     * 
+     * 验证内容:
+     * - 开启后 invoke 消息经二进制编码交给 Kotlin，回调拿到的 JSONObject 与 JSON 一致
+     * - dispatchMessage(JSONObject) 经二进制编码交给 JS
+     * 
+     * 预期结果: 两个方向的字段、类型和嵌套结构都原样保留
+     */
+    @Test
+    fun testBinaryWireFormat() {
+        val initialized = jsEngine.initialize()
+        assertTrue("Engine should initialize successfully", initialized)
+        jsEngine.setWireFormat(true)
+
+        var invoked: JSONObject? = null
+        jsEngine.setInvokeCallback("b1") { msg -> invoked = msg; null }
+        jsEngine.evaluate("""
+            DiminaServiceBridge.invoke({
+                type: "test",
+                body: { bridgeId: "b1", n: -7, f: 1.5, s: "中文", skip: undefined, list: [{ k: 1 }, { k: 2 }, null], at: new Date(0) }
+            });
+        """)
+
+        val body = invoked?.getJSONObject("body")
+        assertNotNull("Invoke callback should receive the message", body)
+        assertEquals(-7, body!!.getInt("n"))
+        assertEquals(1.5, body.getDouble("f"), 0.0)
+        assertEquals("中文", body.getString("s"))
+        assertFalse("undefined values should be dropped", body.has("skip"))
+        val list = body.getJSONArray("list")
+        assertEquals(3, list.length())
+        assertEquals(2, list.getJSONObject(1).getInt("k"))
+        assertTrue(list.isNull(2))
+        assertEquals("Date should go through toJSON", "1970-01-01T00:00:00.000Z", body.getString("at"))
+
+        jsEngine.evaluate("DiminaServiceBridge.onMessage = function (m) { globalThis.received = m; return m.body.list.length; }")
+        val msg = JSONObject().put("type", "test").put("body", JSONObject()
+            .put("text", "é")
+            .put("list", JSONArray().put(1).put(2.5).put(JSONObject().put("deep", true))))
+        val result = jsEngine.dispatchMessage(msg)
+        assertEquals(3, result.numberValue.toInt())
+        val roundTrip = jsEngine.evaluate("JSON.stringify(received)")
+        assertEquals(msg.toString(), roundTrip.stringValue)
+    }
+
+    /**
+     * 测试后台挂起与恢复
+     * 
+     * 验证内容:
+     * - 挂起期间 setInterval 不再触发，消息任务照常执行
+     * - 恢复后定时器继续触发，统计里的 suspended 状态随之变化
+     * 
+     * 预期结果: 挂起期间计数不变，恢复后计数继续增长
+     */
+    @Test
+    fun testSuspendResumeFreezesTimers() {
+        val initialized = jsEngine.initialize()
+        assertTrue("Engine should initialize successfully", initialized)
+
+        jsEngine.evaluate("globalThis.ticks = 0; setInterval(() => { ticks++; }, 20);")
+        Thread.sleep(200)
+        assertTrue("Interval should run before suspending", jsEngine.evaluate("ticks").numberValue > 0)
+
+        jsEngine.suspendEngine()
+        val frozen = jsEngine.evaluate("ticks").numberValue
+        assertTrue(jsEngine.getEngineStats()!!.getBoolean("suspended"))
+        Thread.sleep(300)
+        assertEquals("Interval should not fire while suspended", frozen, jsEngine.evaluate("ticks").numberValue, 0.0)
+
+        jsEngine.resumeEngine()
+        Thread.sleep(200)
+        assertFalse(jsEngine.getEngineStats()!!.getBoolean("suspended"))
+        assertTrue("Interval should resume", jsEngine.evaluate("ticks").numberValue > frozen)
+    }
+
+    /**
+     * 测试 requestAnimationFrame
+     * 
+     * 验证内容:
+     * - 宿主推 vsync 时回调在下一个 vsync 执行，参数是 vsync 时间的毫秒数
+     * - cancelAnimationFrame 取消的回调不执行
+     * - 宿主停推 vsync 后由兜底定时器出帧
+     * 
+     * 预期结果: vsync 帧拿到宿主的时间戳，停推后 fallbackFrames 增加
+     */
+    @Test
+    fun testRequestAnimationFrame() {
+        val initialized = jsEngine.initialize()
+        assertTrue("Engine should initialize successfully", initialized)
+
+        // The first vsync only tells the engine the host is pushing
+        jsEngine.onVsync()
+        Thread.sleep(50)
+        jsEngine.evaluate("""
+            globalThis.frameTimes = [];
+            requestAnimationFrame(t => frameTimes.push(t));
+            cancelAnimationFrame(requestAnimationFrame(() => frameTimes.push(-1)));
+        """)
+        jsEngine.onVsync(12_345_000_000L)
+        Thread.sleep(50)
+        assertEquals("[12345]", jsEngine.evaluate("JSON.stringify(frameTimes)").stringValue)
+        assertEquals(0L, jsEngine.getEngineStats()!!.getLong("fallbackFrames"))
+
+        // No more vsync: the fallback timer takes over
+        Thread.sleep(150)
+        jsEngine.evaluate("requestAnimationFrame(t => frameTimes.push(t))")
+        Thread.sleep(150)
+        assertEquals(2, jsEngine.evaluate("frameTimes.length").numberValue.toInt())
+        assertTrue(jsEngine.getEngineStats()!!.getLong("fallbackFrames") >= 1)
+    }
+
+    /**
+     * 测试 invokeAsync 成功返回
+     * 
+     * 验证内容:
+     * - invokeAsync 立即返回 Promise，回调在后台线程执行时 JS 线程不被阻塞
+     * - 回调结果经事件循环 resolve Promise
+     * 
+     * 预期结果: 回调返回前 JS 仍可求值，之后 then 拿到回调返回的值
+     */
+    @Test
+    fun testInvokeAsyncResolves() {
+        val initialized = jsEngine.initialize()
+        assertTrue("Engine should initialize successfully", initialized)
+
+        val release = CountDownLatch(1)
+        val callbackThread = AtomicReference<String>()
+        jsEngine.setInvokeCallback("b1") { msg ->
+            callbackThread.set(Thread.currentThread().name)
+            release.await(5, TimeUnit.SECONDS)
+            JSValue.createString("done:" + msg.getJSONObject("body").getInt("n"))
+        }
+        jsEngine.evaluate("""
+            globalThis.settled = null;
+            DiminaServiceBridge.invokeAsync({ type: "test", body: { bridgeId: "b1", n: 7 } })
+                .then(v => { settled = "resolved:" + v; }, e => { settled = "rejected:" + e.message; });
+        """)
+
+        Thread.sleep(100)
+        assertEquals("JS thread should not wait for the callback", 2, jsEngine.evaluate("1 + 1").numberValue.toInt())
+        assertTrue(jsEngine.evaluate("settled === null").booleanValue)
+
+        release.countDown()
+        Thread.sleep(200)
+        assertEquals("resolved:done:7", jsEngine.evaluate("settled").stringValue)
+        assertEquals("JSInvokeAsync", callbackThread.get())
+    }
+
+    /**
+     * 测试 invokeAsync 失败返回
+     * 
+     * 验证内容:
+     * - 回调抛出异常时 Promise reject，错误信息为异常信息
+     * - 回调返回 ERROR 类型的 JSValue 时同样 reject
+     * 
+     * 预期结果: 两次调用都走 catch 分支，拿到对应的错误信息
+     */
+    @Test
+    fun testInvokeAsyncRejects() {
+        val initialized = jsEngine.initialize()
+        assertTrue("Engine should initialize successfully", initialized)
+
+        jsEngine.setInvokeCallback("throws") { throw IllegalStateException("host failed") }
+        jsEngine.setInvokeCallback("error") { JSValue.createError("bad result") }
+        jsEngine.evaluate("""
+            globalThis.errors = [];
+            for (const id of ["throws", "error"]) {
+                DiminaServiceBridge.invokeAsync({ type: "test", body: { bridgeId: id } })
+                    .then(() => errors.push(id + ":resolved"), e => errors.push(id + ":" + e.message));
+            }
+        """)
+
+        Thread.sleep(300)
+        val errors = jsEngine.evaluate("JSON.stringify(errors.sort())").stringValue
+        assertEquals("[\"error:bad result\",\"throws:host failed\"]", errors)
+    }
+
+    /**
+     * 测试 invokeAsync 挂起期间销毁引擎
+     * 
+     * 验证内容:
+     * - 回调尚未返回时销毁引擎，之后回调返回的结果被丢弃
+     * - 不崩溃，新引擎可正常工作
+     * 
+     * 预期结果: 回调正常结束，新建引擎求值正确
+     */
+    @Test
+    fun testInvokeAsyncEngineDestroyedWhilePending() {
+        val initialized = jsEngine.initialize()
+        assertTrue("Engine should initialize successfully", initialized)
+
+        val entered = CountDownLatch(1)
+        val release = CountDownLatch(1)
+        val finished = CountDownLatch(1)
+        jsEngine.setInvokeCallback("b1") {
+            entered.countDown()
+            release.await(5, TimeUnit.SECONDS)
+            finished.countDown()
+            JSValue.createString("late")
+        }
+        jsEngine.evaluate("""
+            DiminaServiceBridge.invokeAsync({ type: "test", body: { bridgeId: "b1" } })
+                .then(v => { globalThis.settled = v; });
+        """)
+        assertTrue("Callback should start", entered.await(2, TimeUnit.SECONDS))
+
+        jsEngine.destroy()
+        release.countDown()
+        assertTrue("Callback should finish after destroy", finished.await(2, TimeUnit.SECONDS))
+        Thread.sleep(200)
+
+        jsEngine = QuickJSEngine()
+        assertTrue("A new engine should initialize", jsEngine.initialize())
+        assertEquals(3, jsEngine.evaluate("1 + 2").numberValue.toInt())
+    }
+
+    /**
+     * 测试字节码缓存命中
+     * 
+     * 验证内容:
+     * - 首次 evaluateFromFile 编译并写入一个缓存文件
+     * - 第二次加载同一文件直接读取缓存，不重写缓存文件
+     * 
+     * 预期结果: 两次结果一致，缓存文件的修改时间保持不变
+     */
+    @Test
+    fun testCodeCacheHitOnSecondLoad() {
+        val initialized = jsEngine.initialize()
+        assertTrue("Engine should initialize successfully", initialized)
+
+        val root = createTempCodeCacheRoot()
+        val cacheDir = File(root, "cache").apply { mkdirs() }
+        val script = File(root, "bundle.js").apply { writeText("globalThis.loads = (globalThis.loads || 0) + 1; 40 + loads;") }
+        QuickJSEngine.setCodeCacheDirectory(cacheDir.absolutePath)
+        try {
+            assertEquals(41, jsEngine.evaluateFromFile(script.absolutePath).numberValue.toInt())
+            val entries = cacheDir.listFiles()!!
+            assertEquals("First load should write one cache entry", 1, entries.size)
+            val entry = entries[0]
+            assertTrue(entry.setLastModified(1_000_000L))
+
+            assertEquals(42, jsEngine.evaluateFromFile(script.absolutePath).numberValue.toInt())
+            assertEquals(1, cacheDir.listFiles()!!.size)
+            assertEquals("A cache hit should not rewrite the entry", 1_000_000L, entry.lastModified())
+        } finally {
+            QuickJSEngine.setCodeCacheDirectory("")
+            root.deleteRecursively()
+        }
+    }
+
+    /**
+     * 测试字节码缓存损坏或不匹配时回退
+     * 
+     * 验证内容:
+     * - 缓存文件被截断时回退到编译源码
+     * - 缓存文件换成另一个脚本的条目时回退到编译源码
+     * 
+     * 预期结果: 每次都执行当前源码，缓存文件被重写为有效条目
+     */
+    @Test
+    fun testCodeCacheFallsBackOnBadEntry() {
+        val initialized = jsEngine.initialize()
+        assertTrue("Engine should initialize successfully", initialized)
+
+        val root = createTempCodeCacheRoot()
+        val cacheDir = File(root, "cache").apply { mkdirs() }
+        val script = File(root, "a.js").apply { writeText("'a' + 1") }
+        val other = File(root, "b.js").apply { writeText("'b' + 2") }
+        QuickJSEngine.setCodeCacheDirectory(cacheDir.absolutePath)
+        try {
+            assertEquals("a1", jsEngine.evaluateFromFile(script.absolutePath).stringValue)
+            val entry = cacheDir.listFiles()!!.single()
+            val valid = entry.readBytes()
+
+            // Truncated entry
+            entry.writeBytes(valid.copyOf(valid.size / 2))
+            assertEquals("a1", jsEngine.evaluateFromFile(script.absolutePath).stringValue)
+            assertValidCacheEntry(entry, valid.size)
+
+            // Valid entry, but for another source
+            assertEquals("b2", jsEngine.evaluateFromFile(other.absolutePath).stringValue)
+            val otherEntry = cacheDir.listFiles()!!.single { it.name != entry.name }
+            otherEntry.copyTo(entry, overwrite = true)
+            assertEquals("a1", jsEngine.evaluateFromFile(script.absolutePath).stringValue)
+            assertValidCacheEntry(entry, valid.size)
+        } finally {
+            QuickJSEngine.setCodeCacheDirectory("")
+            root.deleteRecursively()
+        }
+    }
+
+    private fun assertValidCacheEntry(entry: File, expectedSize: Int) {
+        val bytes = entry.readBytes()
+        assertEquals("The entry should be rewritten in full", expectedSize, bytes.size)
+        assertEquals("DQJC", String(bytes, 0, 4, Charsets.US_ASCII))
+    }
+
+    private fun createTempCodeCacheRoot(): File {
+        val base = InstrumentationRegistry.getInstrumentation().targetContext.cacheDir
+        return File(base, "qjs-code-cache-test-" + System.nanoTime()).apply { mkdirs() }
+    }
 }
@@ -7,20 +7,49 @@
 #include <sstream>
 #include <unordered_map>
 #include <chrono>
+#include <climits>
 #include <mutex>
 #include <memory>
+#include <vector>
+#include <deque>
+#include <cerrno>
+#include <cinttypes>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <uv.h>
 #include "quickjs.h"
 #include "cutils.h"
 #include "libregexp.h"
 #include "libunicode.h"
+#include "wire_format.h"
 
 // Define log tag for Android logging
 #define LOG_TAG "QuickJSEngine(cpp)"
 
+// Passed in by CMake from cmake/DependencyVersions.cmake. Bytecode is only valid for the
+// QuickJS revision that produced it, so the tag is stored in every cache entry.
+#ifndef DIMINA_QUICKJS_GIT_TAG
+#define DIMINA_QUICKJS_GIT_TAG "unknown"
+#endif
+
 // Logging interval for the event loop (log progress every N iterations)
 static const int EVENT_LOOP_LOG_INTERVAL = 100;
 
+// Default microtask budget per drain: whichever of these is reached first
+static const uint32_t kDefaultMicrotaskMaxJobs = 1000;
+static const uint64_t kDefaultMicrotaskTimeUs = 8000;
+
+// Default publish batching flush thresholds, see nativeSetPublishBatching
+static const uint32_t kDefaultPublishBatchMaxBytes = 256 * 1024;
+static const uint64_t kDefaultPublishBatchDeadlineUs = 16000;
+
+// Fallback frame rate when the host does not push vsync, and how long after the last vsync
+// the host is considered to have stopped pushing. See requestFrame.
+static const uint64_t kFrameIntervalNs = 16666667;
+static const uint64_t kVsyncStaleMs = 100;
+
 // Global JavaVM pointer for JNI calls from any thread
 static JavaVM* gJavaVM = nullptr;
 
@@ -105,16 +134,286 @@ extern "C" JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* vm, void* reserved) {
 // Forward declaration
 struct EngineInstance;
 
-// Timer data structure for libuv
-struct TimerData {
-    JSContext* ctx;
-    int timerId;
-    JSValue callback;
-    int instanceId;
-    bool isInterval;
-    EngineInstance* instance;
+// One setTimeout/setInterval. Slots live in fixed-size chunks so the embedded uv_timer_t never
+// moves, and a slot's handle is initialised once and reused by every timer that lands in it:
+// creating or clearing a timer allocates nothing and never goes through uv_close.
+struct TimerSlot {
+    uv_timer_t handle;
+    JSValue callback = JS_UNDEFINED;
+    EngineInstance* instance = nullptr;
+    uint32_t index = 0;
+    // Bumped on release so ids handed out for earlier timers in this slot stop matching
+    uint32_t generation = 0;
+    uint32_t nextFree = 0;
+    bool handleOpen = false;
+    bool active = false;
+    bool isInterval = false;
     bool isExecuting = false;
-    bool isCleared = false;
+    uint64_t repeatMs = 0;
+    // While the engine is suspended the handle is stopped and this holds the time left
+    uint64_t suspendedDueIn = 0;
+};
+
+// Slab of timer slots with a free list, indexed directly by timer id. An id packs the slot
+// index plus one (low 24 bits, so 0 is never an id) with the slot generation (29 bits), which
+// keeps ids exact as JS numbers. JS thread only.
+class TimerTable {
+public:
+    static constexpr uint32_t kChunkSize = 64;
+    static constexpr uint32_t kIndexBits = 24;
+    static constexpr uint32_t kMaxSlots = (1u << kIndexBits) - 1;
+    static constexpr uint32_t kGenerationMask = (1u << 29) - 1;
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    // Pops a free slot, adding a chunk when the free list is empty. Returns nullptr when the
+    // table is full or out of memory; *grew tells the caller a chunk was allocated.
+    TimerSlot* acquire(bool* grew) {
+        *grew = false;
+        if (freeList == kNone) {
+            uint32_t base = (uint32_t)chunks.size() * kChunkSize;
+            if (base + kChunkSize > kMaxSlots) {
+                return nullptr;
+            }
+            std::unique_ptr<TimerSlot[]> chunk(new (std::nothrow) TimerSlot[kChunkSize]);
+            if (!chunk) {
+                return nullptr;
+            }
+            for (uint32_t i = kChunkSize; i-- > 0;) {
+                chunk[i].index = base + i;
+                chunk[i].nextFree = freeList;
+                freeList = base + i;
+            }
+            chunks.push_back(std::move(chunk));
+            *grew = true;
+        }
+        TimerSlot* slot = at(freeList);
+        freeList = slot->nextFree;
+        return slot;
+    }
+
+    // The live timer with this id, or nullptr for unknown, fired or cleared ids
+    TimerSlot* find(int64_t id) {
+        if (id <= 0) {
+            return nullptr;
+        }
+        uint32_t index = (uint32_t)(id & kMaxSlots) - 1;
+        uint32_t generation = (uint32_t)((uint64_t)id >> kIndexBits);
+        if (index >= chunks.size() * kChunkSize) {
+            return nullptr;
+        }
+        TimerSlot* slot = at(index);
+        return slot->active && slot->generation == generation ? slot : nullptr;
+    }
+
+    void release(TimerSlot* slot) {
+        slot->active = false;
+        slot->generation = (slot->generation + 1) & kGenerationMask;
+        slot->nextFree = freeList;
+        freeList = slot->index;
+    }
+
+    static int64_t idOf(const TimerSlot* slot) {
+        return ((int64_t)slot->generation << kIndexBits) | (slot->index + 1);
+    }
+
+    template <typename F>
+    void forEach(F&& f) {
+        for (auto& chunk : chunks) {
+            for (uint32_t i = 0; i < kChunkSize; i++) {
+                f(&chunk[i]);
+            }
+        }
+    }
+
+private:
+    TimerSlot* at(uint32_t index) {
+        return &chunks[index / kChunkSize][index % kChunkSize];
+    }
+
+    std::vector<std::unique_ptr<TimerSlot[]>> chunks;
+    uint32_t freeList = kNone;
+};
+
+// One setImmediate callback or one message posted to a MessagePort
+struct ImmediateEntry {
+    // The setImmediate callback, or the receiving port for a message
+    JSValue func = JS_UNDEFINED;
+    // Extra setImmediate arguments, or the message data
+    std::vector<JSValue> args;
+    bool isMessage = false;
+    bool cleared = false;
+};
+
+// FIFO run from the check phase of the uv loop. Ids grow in queue order, so entry k has id
+// headId + k and clearImmediate needs no lookup; cleared entries are skipped when popped.
+// JS thread only.
+struct ImmediateQueue {
+    std::deque<ImmediateEntry> entries;
+    uint64_t headId = 1;
+    // Entries not cleared
+    uint32_t live = 0;
+};
+
+// MessageChannel port. The two ports of a channel hold each other; the class gc_mark lets the
+// cycle be collected. Messages are not structured-cloned, the peer receives the same object.
+struct MessagePort {
+    JSValue peer = JS_UNDEFINED;
+    bool closed = false;
+};
+
+// ============================================================================
+// Engine Statistics
+// ============================================================================
+
+static uint64_t monotonicNanos() {
+    // Same clock as System.nanoTime(), so enqueue stamps from Kotlin are comparable
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Log-linear histogram in the spirit of HdrHistogram: one bucket per value below 16,
+// then 8 sub-buckets per power of two (<= 12.5% relative error), fixed memory.
+// Single writer (the JS thread); any thread may read without locking.
+class LatencyHistogram {
+public:
+    LatencyHistogram() {
+        for (auto& bucket : buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void record(uint64_t value) {
+        buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(value, std::memory_order_relaxed);
+        if (value > maxValue.load(std::memory_order_relaxed)) {
+            maxValue.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    uint64_t max() const { return maxValue.load(std::memory_order_relaxed); }
+
+    double mean() const {
+        uint64_t n = count();
+        return n == 0 ? 0 : (double)sum.load(std::memory_order_relaxed) / n;
+    }
+
+    // Upper bound of the bucket holding the p-th percentile, clamped to the observed max
+    uint64_t percentile(double p) const {
+        uint64_t counts[kBucketCount];
+        uint64_t n = 0;
+        for (int i = 0; i < kBucketCount; i++) {
+            counts[i] = buckets[i].load(std::memory_order_relaxed);
+            n += counts[i];
+        }
+        if (n == 0) {
+            return 0;
+        }
+        uint64_t rank = (uint64_t)(p / 100.0 * n + 0.5);
+        if (rank == 0) {
+            rank = 1;
+        }
+        uint64_t seen = 0;
+        for (int i = 0; i < kBucketCount; i++) {
+            seen += counts[i];
+            if (seen >= rank) {
+                uint64_t bound = upperBoundOf(i);
+                return bound < max() ? bound : max();
+            }
+        }
+        return max();
+    }
+
+private:
+    static constexpr int kLinearBuckets = 16;
+    static constexpr int kSubBucketBits = 3;
+    static constexpr int kMaxExponent = 40;
+    static constexpr int kBucketCount = kLinearBuckets + (kMaxExponent - 4) * (1 << kSubBucketBits);
+
+    static int bucketOf(uint64_t value) {
+        if (value < kLinearBuckets) {
+            return (int)value;
+        }
+        int exponent = 63 - __builtin_clzll(value);
+        if (exponent >= kMaxExponent) {
+            return kBucketCount - 1;
+        }
+        int sub = (int)((value >> (exponent - kSubBucketBits)) & ((1 << kSubBucketBits) - 1));
+        return kLinearBuckets + (exponent - 4) * (1 << kSubBucketBits) + sub;
+    }
+
+    static uint64_t upperBoundOf(int index) {
+        if (index < kLinearBuckets) {
+            return index;
+        }
+        int exponent = (index - kLinearBuckets) / (1 << kSubBucketBits) + 4;
+        uint64_t sub = (index - kLinearBuckets) % (1 << kSubBucketBits);
+        return (((1ULL << kSubBucketBits) + sub + 1) << (exponent - kSubBucketBits)) - 1;
+    }
+
+    std::atomic<uint64_t> buckets[kBucketCount];
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> maxValue{0};
+};
+
+// Per-instance counters, written on the JS thread and read directly by nativeGetEngineStats
+// from any thread, so polling never queues work onto the JS thread. Times are in microseconds.
+struct EngineStats {
+    std::atomic<uint64_t> tasksExecuted{0};
+    // Rate over the last complete one-second window; read it through tasksPerSecAt, because the
+    // window only rolls when a task runs and would otherwise report the last busy rate forever
+    std::atomic<uint64_t> tasksPerSec{0};
+    std::atomic<uint64_t> lastTaskNs{0};
+    std::atomic<uint64_t> loopIterations{0};
+    std::atomic<uint64_t> maxQueueDepth{0};
+    // Drains that hit the microtask budget and left jobs for the next loop turn
+    std::atomic<uint64_t> microtaskOverruns{0};
+    // Timers created vs. TimerTable chunks allocated for them; the ratio is allocations per timer
+    std::atomic<uint64_t> timersCreated{0};
+    std::atomic<uint64_t> timerChunkAllocations{0};
+    // Frames run, and how many of them came from the fallback timer instead of a host vsync
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> fallbackFrames{0};
+    LatencyHistogram queueWaitUs;
+    LatencyHistogram evalUs;
+    LatencyHistogram microtaskUs;
+    LatencyHistogram queueDepth;
+
+    // JS thread only
+    uint64_t windowStartNs = 0;
+    uint64_t windowTasks = 0;
+
+    void recordTaskStart(uint64_t enqueuedAtNs, uint64_t depth) {
+        uint64_t now = monotonicNanos();
+        queueWaitUs.record(now > enqueuedAtNs ? (now - enqueuedAtNs) / 1000 : 0);
+        queueDepth.record(depth);
+        if (depth > maxQueueDepth.load(std::memory_order_relaxed)) {
+            maxQueueDepth.store(depth, std::memory_order_relaxed);
+        }
+        tasksExecuted.fetch_add(1, std::memory_order_relaxed);
+        if (windowStartNs == 0) {
+            windowStartNs = now;
+        }
+        windowTasks++;
+        if (now - windowStartNs >= 1000000000ULL) {
+            tasksPerSec.store(windowTasks * 1000000000ULL / (now - windowStartNs), std::memory_order_relaxed);
+            windowStartNs = now;
+            windowTasks = 0;
+        }
+        lastTaskNs.store(now, std::memory_order_relaxed);
+    }
+
+    // Any thread: 0 once no task has started within the last second
+    uint64_t tasksPerSecAt(uint64_t nowNs) const {
+        uint64_t last = lastTaskNs.load(std::memory_order_relaxed);
+        if (last == 0 || nowNs - last >= 1000000000ULL) {
+            return 0;
+        }
+        return tasksPerSec.load(std::memory_order_relaxed);
+    }
 };
 
 // Structure to hold instance-specific data
@@ -123,39 +422,425 @@ struct EngineInstance {
     JSContext* ctx = nullptr;
     jobject engineObj = nullptr;
     uv_loop_t* loop = nullptr;
-    std::unordered_map<int, TimerData*> timerCallbacks;
-    std::unordered_map<int, uv_timer_t*> uvTimers;
-    std::atomic<int> nextTimerId{1};
+    TimerTable timers;
+    // setImmediate and MessagePort messages; immediateHandle only runs while the queue is non-empty
+    ImmediateQueue immediates;
+    uv_check_t immediateHandle;
+    bool immediateHandleOpen = false;
+    // Background mode, see nativeSuspend. Written on the JS thread, read by nativeGetEngineStats.
+    std::atomic<bool> suspended{false};
     std::atomic<bool> shouldStop{false};
+    // DiminaServiceBridge.onMessage and its receiver, captured by the accessor
+    // so nativeDispatchMessage can call it without compiling a script per message
+    JSValue messageBridge = JS_UNDEFINED;
+    JSValue messageHandler = JS_UNDEFINED;
+    EngineStats stats;
+    // Per-turn microtask budget, see runJavaScriptEventLoop. Written from any thread.
+    std::atomic<uint32_t> microtaskMaxJobs{kDefaultMicrotaskMaxJobs};
+    std::atomic<uint64_t> microtaskTimeUs{kDefaultMicrotaskTimeUs};
+    // DiminaServiceBridge.invokeAsync: promise resolvers waiting for the host, JS thread only
+    struct AsyncCall {
+        JSValue resolve;
+        JSValue reject;
+    };
+    std::unordered_map<uint32_t, AsyncCall> asyncCalls;
+    uint32_t nextAsyncCallId = 1;
+    // Host results (global refs to Kotlin JSValue) posted from any thread and settled on the
+    // JS thread when asyncInvokeHandle fires in the uv loop
+    uv_async_t asyncInvokeHandle;
+    bool asyncInvokeHandleOpen = false;
+    std::mutex asyncResultsMutex;
+    std::vector<std::pair<uint32_t, jobject>> asyncResults;
+    // Publish batching. Settings are written from any thread; batches are JS thread only,
+    // kept in first-publish order so flushing preserves the order between pages.
+    struct PublishBatch {
+        std::string id;
+        std::string data; // "[m1,m2,..." without the closing bracket
+        uint32_t count = 0;
+        uint64_t firstNs = 0;
+    };
+    std::atomic<bool> publishBatching{false};
+    std::atomic<uint32_t> publishBatchMaxBytes{kDefaultPublishBatchMaxBytes};
+    std::atomic<uint64_t> publishBatchDeadlineUs{kDefaultPublishBatchDeadlineUs};
+    std::vector<PublishBatch> publishBatches;
+    // invoke messages go to Kotlin in the binary wire format instead of JSON text, see
+    // wire_format.h. Written from any thread, read on the JS thread.
+    std::atomic<bool> binaryWire{false};
+    // requestAnimationFrame callbacks in registration order, JS thread only. A run callback or a
+    // cancelled one has func set to undefined.
+    struct FrameCallback {
+        uint32_t id;
+        JSValue func;
+    };
+    std::vector<FrameCallback> frameCallbacks;
+    uint32_t frameCallbacksLive = 0;
+    uint32_t nextFrameId = 0;
+    // Frame scheduling, see requestFrame. frameRequested and pendingVsyncNs are shared with
+    // nativeOnVsync on the host thread; the rest is JS thread only.
+    std::atomic<bool> frameRequested{false};
+    std::atomic<uint64_t> pendingVsyncNs{0};
+    uint64_t lastVsyncNs = 0;
+    uint64_t lastFrameNs = 0;
+    bool fallbackFrameDue = false;
+    uv_timer_t frameTimer;
+    bool frameTimerOpen = false;
+    // Hold publish batches until the next frame instead of the end of the loop turn, see
+    // nativeSetFrameAlignedPublish. Written from any thread, read on the JS thread.
+    std::atomic<bool> frameAlignedPublish{false};
 };
 
-// Map to store engine instances by ID
+// Map to store engine instances by ID. Owns registration: nativeInitialize/nativeDestroy and
+// callers that must keep an instance alive while reading it from another thread take the mutex.
 static std::unordered_map<int, EngineInstance*> gEngineInstances;
 static std::mutex gEngineInstancesMutex;
 
+// ============================================================================
+// Instance Registry
+// ============================================================================
+
+// Lock-free lookup index mirroring gEngineInstances, so JNI entry points never take the map
+// mutex. Fixed-size open-addressing table; each slot carries a seqlock version so a reader that
+// races an update simply retries. Updates happen only under gEngineInstancesMutex.
+static const uint32_t kInstanceSlotCount = 256;
+static const int kEmptyInstanceKey = INT_MIN;
+static const int kTombstoneInstanceKey = INT_MIN + 1;
+// Tombstones that cannot be cleared (live entries still follow them) before the table is compacted;
+// without this, a miss would eventually probe every slot
+static const uint32_t kMaxInstanceTombstones = kInstanceSlotCount / 4;
+
+struct InstanceSlot {
+    std::atomic<uint32_t> version{0};
+    std::atomic<int> key{kEmptyInstanceKey};
+    std::atomic<EngineInstance*> instance{nullptr};
+};
+
+static InstanceSlot gInstanceSlots[kInstanceSlotCount];
+// Guarded by gEngineInstancesMutex
+static uint32_t gInstanceTombstones = 0;
+// Odd while compactInstanceSlots moves entries. A reader can miss an entry that moves behind it,
+// so a miss is only trusted if no move happened in between
+static std::atomic<uint32_t> gInstanceMoves{0};
+
+// Writer side, caller holds gEngineInstancesMutex
+static void writeInstanceSlot(InstanceSlot& slot, int key, EngineInstance* instance) {
+    uint32_t version = slot.version.load(std::memory_order_relaxed);
+    slot.version.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.key.store(key, std::memory_order_relaxed);
+    slot.instance.store(instance, std::memory_order_relaxed);
+    slot.version.store(version + 2, std::memory_order_release);
+}
+
+// Caller holds gEngineInstancesMutex. A tombstone followed by an empty slot no longer sits in front of
+// any entry, so it and the tombstones chained before it become empty again. Nothing live follows them,
+// so a concurrent reader that now stops earlier misses nothing.
+static void clearTrailingInstanceTombstones(uint32_t index) {
+    if (gInstanceSlots[(index + 1) % kInstanceSlotCount].key.load(std::memory_order_relaxed) != kEmptyInstanceKey) {
+        return;
+    }
+    while (gInstanceSlots[index].key.load(std::memory_order_relaxed) == kTombstoneInstanceKey) {
+        writeInstanceSlot(gInstanceSlots[index], kEmptyInstanceKey, nullptr);
+        gInstanceTombstones--;
+        index = (index + kInstanceSlotCount - 1) % kInstanceSlotCount;
+    }
+}
+
+// Caller holds gEngineInstancesMutex. First moves every entry onto the first tombstone of its probe
+// sequence to shorten the chains; each move writes the new slot before tombstoning the old one, so a
+// concurrent reader always has a copy to find. Then every tombstone that no entry's probe chain crosses
+// becomes empty again: lookups only walk their own chain, so nobody needs those slots.
+static void compactInstanceSlots() {
+    gInstanceMoves.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (uint32_t i = 0; i < kInstanceSlotCount; i++) {
+        InstanceSlot& slot = gInstanceSlots[i];
+        int key = slot.key.load(std::memory_order_relaxed);
+        if (key == kEmptyInstanceKey || key == kTombstoneInstanceKey) {
+            continue;
+        }
+        for (uint32_t j = (uint32_t)key % kInstanceSlotCount; j != i; j = (j + 1) % kInstanceSlotCount) {
+            if (gInstanceSlots[j].key.load(std::memory_order_relaxed) == kTombstoneInstanceKey) {
+                writeInstanceSlot(gInstanceSlots[j], key, slot.instance.load(std::memory_order_relaxed));
+                writeInstanceSlot(slot, kTombstoneInstanceKey, nullptr);
+                break;
+            }
+        }
+    }
+    gInstanceMoves.fetch_add(1, std::memory_order_release);
+
+    bool onChain[kInstanceSlotCount] = {};
+    for (uint32_t i = 0; i < kInstanceSlotCount; i++) {
+        int key = gInstanceSlots[i].key.load(std::memory_order_relaxed);
+        if (key == kEmptyInstanceKey || key == kTombstoneInstanceKey) {
+            continue;
+        }
+        for (uint32_t j = (uint32_t)key % kInstanceSlotCount; j != i; j = (j + 1) % kInstanceSlotCount) {
+            onChain[j] = true;
+        }
+    }
+    for (uint32_t i = 0; i < kInstanceSlotCount; i++) {
+        if (!onChain[i] && gInstanceSlots[i].key.load(std::memory_order_relaxed) == kTombstoneInstanceKey) {
+            writeInstanceSlot(gInstanceSlots[i], kEmptyInstanceKey, nullptr);
+            gInstanceTombstones--;
+        }
+    }
+}
+
+// Caller holds gEngineInstancesMutex. Instance IDs are small and increasing, so the low bits
+// spread them evenly; tombstones left by removed instances are reused.
+static bool indexInstance(int instanceId, EngineInstance* instance) {
+    uint32_t start = (uint32_t)instanceId;
+    for (uint32_t i = 0; i < kInstanceSlotCount; i++) {
+        InstanceSlot& slot = gInstanceSlots[(start + i) % kInstanceSlotCount];
+        int key = slot.key.load(std::memory_order_relaxed);
+        if (key == kEmptyInstanceKey || key == kTombstoneInstanceKey) {
+            if (key == kTombstoneInstanceKey) {
+                gInstanceTombstones--;
+            }
+            writeInstanceSlot(slot, instanceId, instance);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Caller holds gEngineInstancesMutex
+static void unindexInstance(int instanceId) {
+    uint32_t start = (uint32_t)instanceId;
+    for (uint32_t i = 0; i < kInstanceSlotCount; i++) {
+        uint32_t index = (start + i) % kInstanceSlotCount;
+        InstanceSlot& slot = gInstanceSlots[index];
+        int key = slot.key.load(std::memory_order_relaxed);
+        if (key == kEmptyInstanceKey) {
+            return;
+        }
+        if (key == instanceId) {
+            writeInstanceSlot(slot, kTombstoneInstanceKey, nullptr);
+            gInstanceTombstones++;
+            clearTrailingInstanceTombstones(index);
+            if (gInstanceTombstones > kMaxInstanceTombstones) {
+                compactInstanceSlots();
+            }
+            return;
+        }
+    }
+}
+
 // ============================================================================
 // Helper Functions
 // ============================================================================
 
-// Helper function to get an engine instance by ID
-static EngineInstance* getEngineInstance(int instanceId) {
-    std::lock_guard<std::mutex> lock(gEngineInstancesMutex);
-    auto it = gEngineInstances.find(instanceId);
-    if (it != gEngineInstances.end()) {
-        return it->second;
+static EngineInstance* probeInstanceSlots(int instanceId) {
+    uint32_t start = (uint32_t)instanceId;
+    for (uint32_t i = 0; i < kInstanceSlotCount; i++) {
+        InstanceSlot& slot = gInstanceSlots[(start + i) % kInstanceSlotCount];
+        for (;;) {
+            uint32_t before = slot.version.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            int key = slot.key.load(std::memory_order_acquire);
+            EngineInstance* instance = slot.instance.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.version.load(std::memory_order_relaxed) != before) {
+                continue;
+            }
+            if (key == kEmptyInstanceKey) {
+                return nullptr;
+            }
+            if (key == instanceId) {
+                return instance;
+            }
+            break;
+        }
     }
     return nullptr;
 }
 
-// Helper function to find engine instance by context
+// Helper function to get an engine instance by ID, without locking. The instance is only freed
+// by nativeDestroy on the JS thread, so JS-thread callers can use the result freely; other threads
+// that need it to stay alive should hold gEngineInstancesMutex instead.
+// A hit is always valid; a miss is retried if compactInstanceSlots moved entries meanwhile.
+static EngineInstance* getEngineInstance(int instanceId) {
+    for (;;) {
+        uint32_t moves = gInstanceMoves.load(std::memory_order_acquire);
+        EngineInstance* instance = probeInstanceSlots(instanceId);
+        if (instance) {
+            return instance;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (!(moves & 1) && gInstanceMoves.load(std::memory_order_relaxed) == moves) {
+            return nullptr;
+        }
+    }
+}
+
+// Helper function to find engine instance by context: the context opaque points at the instance
+// (set in nativeInitialize, cleared in nativeDestroy), so bridge calls don't search at all
 static EngineInstance* findInstanceByContext(JSContext* ctx) {
-    std::lock_guard<std::mutex> lock(gEngineInstancesMutex);
-    for (const auto& pair : gEngineInstances) {
-        if (pair.second->ctx == ctx) {
-            return pair.second;
+    return static_cast<EngineInstance*>(JS_GetContextOpaque(ctx));
+}
+
+// ============================================================================
+// Bytecode Cache
+// ============================================================================
+
+// Directory for compiled service bundles. Empty disables the cache.
+static std::string gCodeCacheDir;
+static std::mutex gCodeCacheDirMutex;
+
+static const char kCodeCacheMagic[4] = {'D', 'Q', 'J', 'C'};
+static const uint32_t kCodeCacheFormatVersion = 1;
+static const size_t kCodeCacheTagSize = 40;
+
+// Each cache file is this header followed by payloadLength bytes of JS_WriteObject output.
+struct CodeCacheHeader {
+    char magic[4];
+    uint32_t formatVersion;
+    char quickjsTag[kCodeCacheTagSize];
+    uint64_t sourceHash;
+    uint64_t sourceLength;
+    uint64_t payloadLength;
+    uint64_t payloadHash;
+};
+
+// FNV-1a: dependency free and far cheaper than parsing the bundle it keys.
+static uint64_t fnv1a64(const void* data, size_t length, uint64_t hash = 0xcbf29ce484222325ULL) {
+    const auto* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < length; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static void fillQuickJSTag(char (&tag)[kCodeCacheTagSize]) {
+    memset(tag, 0, sizeof(tag));
+    strncpy(tag, DIMINA_QUICKJS_GIT_TAG, sizeof(tag));
+}
+
+static bool readFully(int fd, void* buf, size_t length) {
+    auto* p = static_cast<uint8_t*>(buf);
+    while (length > 0) {
+        ssize_t n = read(fd, p, length);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        length -= n;
+    }
+    return true;
+}
+
+static bool writeFully(int fd, const void* buf, size_t length) {
+    const auto* p = static_cast<const uint8_t*>(buf);
+    while (length > 0) {
+        ssize_t n = write(fd, p, length);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        length -= n;
+    }
+    return true;
+}
+
+// Reads and validates a cache entry. Any mismatch is treated as a miss.
+static bool loadCodeCache(const std::string& path, uint64_t sourceHash, size_t sourceLength,
+                          std::vector<uint8_t>& payload) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+    CodeCacheHeader header;
+    char tag[kCodeCacheTagSize];
+    fillQuickJSTag(tag);
+    bool ok = readFully(fd, &header, sizeof(header)) &&
+              memcmp(header.magic, kCodeCacheMagic, sizeof(kCodeCacheMagic)) == 0 &&
+              header.formatVersion == kCodeCacheFormatVersion &&
+              memcmp(header.quickjsTag, tag, kCodeCacheTagSize) == 0 &&
+              header.sourceHash == sourceHash && header.sourceLength == sourceLength &&
+              header.payloadLength > 0;
+    if (ok) {
+        payload.resize(header.payloadLength);
+        ok = readFully(fd, payload.data(), payload.size()) &&
+             fnv1a64(payload.data(), payload.size()) == header.payloadHash;
+    }
+    close(fd);
+    return ok;
+}
+
+// Writes through a temporary file and renames it, so a concurrent reader never sees a partial entry.
+static void storeCodeCache(const std::string& path, uint64_t sourceHash, size_t sourceLength,
+                           const uint8_t* payload, size_t payloadLength) {
+    CodeCacheHeader header;
+    memcpy(header.magic, kCodeCacheMagic, sizeof(kCodeCacheMagic));
+    header.formatVersion = kCodeCacheFormatVersion;
+    fillQuickJSTag(header.quickjsTag);
+    header.sourceHash = sourceHash;
+    header.sourceLength = sourceLength;
+    header.payloadLength = payloadLength;
+    header.payloadHash = fnv1a64(payload, payloadLength);
+
+    std::string tmpPath = path + "." + std::to_string(gettid()) + ".tmp";
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        __android_log_print(ANDROID_LOG_WARN, LOG_TAG, "Failed to create code cache %s: %s",
+                            tmpPath.c_str(), strerror(errno));
+        return;
+    }
+    bool ok = writeFully(fd, &header, sizeof(header)) && writeFully(fd, payload, payloadLength);
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        __android_log_print(ANDROID_LOG_WARN, LOG_TAG, "Failed to write code cache %s: %s",
+                            path.c_str(), strerror(errno));
+        unlink(tmpPath.c_str());
+    }
+}
+
+// Same contract as JS_Eval(JS_EVAL_TYPE_GLOBAL); source[length] must be '\0'.
+// A valid cache entry skips parse and compile entirely. A missing, stale or corrupt entry
+// falls back to compiling the source and refreshes the entry on disk.
+static JSValue evalWithCodeCache(JSContext* ctx, const char* source, size_t length, const char* filename) {
+    std::string dir;
+    {
+        std::lock_guard<std::mutex> lock(gCodeCacheDirMutex);
+        dir = gCodeCacheDir;
+    }
+    if (dir.empty()) {
+        return JS_Eval(ctx, source, length, filename, JS_EVAL_TYPE_GLOBAL);
+    }
+
+    // The filename is part of the key because it is baked into the bytecode for stack traces.
+    uint64_t sourceHash = fnv1a64(source, length);
+    char name[32];
+    snprintf(name, sizeof(name), "%016" PRIx64 ".qjsc", fnv1a64(filename, strlen(filename), sourceHash));
+    std::string path = dir + "/" + name;
+
+    std::vector<uint8_t> payload;
+    if (loadCodeCache(path, sourceHash, length, payload)) {
+        JSValue func = JS_ReadObject(ctx, payload.data(), payload.size(), JS_READ_OBJ_BYTECODE);
+        if (!JS_IsException(func)) {
+            __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, "Code cache hit for %s", filename);
+            // The script is running from here on; its exceptions are real and must not trigger a re-run.
+            return JS_EvalFunction(ctx, func);
         }
+        JS_FreeValue(ctx, JS_GetException(ctx));
     }
-    return nullptr;
+    unlink(path.c_str());
+
+    JSValue func = JS_Eval(ctx, source, length, filename, JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
+    if (JS_IsException(func)) {
+        return func;
+    }
+    size_t payloadLength = 0;
+    uint8_t* bytes = JS_WriteObject(ctx, &payloadLength, func, JS_WRITE_OBJ_BYTECODE);
+    if (bytes) {
+        storeCodeCache(path, sourceHash, length, bytes, payloadLength);
+        js_free(ctx, bytes);
+    } else {
+        // Caching is best effort; still run the script.
+        JS_FreeValue(ctx, JS_GetException(ctx));
+    }
+    return JS_EvalFunction(ctx, func);
 }
 
 // Helper function to perform JSON.stringify on a JSValue
@@ -323,27 +1008,34 @@ static JSValue throwJavaExceptionOrInternalError(JSContext* ctx, JNIEnv* env, co
     return JS_ThrowInternalError(ctx, "%s", message.c_str());
 }
 
-// Callback for uv_close
-static void uv_close_callback(uv_handle_t* handle);
+// Budgeted microtask drain, defined below
+static bool runJavaScriptEventLoop(JSContext *ctx, EngineInstance* instance = nullptr, bool* remaining = nullptr);
+
+// Frees the callback and returns the slot. The handle stays open for the next timer.
+static void releaseTimer(JSContext* ctx, TimerSlot* slot) {
+    uv_timer_stop(&slot->handle);
+    JS_FreeValue(ctx, slot->callback);
+    slot->callback = JS_UNDEFINED;
+    slot->instance->timers.release(slot);
+}
 
 // libuv timer callback
 static void uv_timer_callback(uv_timer_t* handle) {
-    TimerData* data = (TimerData*)handle->data;
-    if (!data || !data->ctx) {
+    TimerSlot* slot = (TimerSlot*)handle->data;
+    if (!slot || !slot->active || !slot->instance || !slot->instance->ctx) {
         __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "Invalid timer data in callback");
+        uv_timer_stop(handle);
         return;
     }
     
-    JSContext* ctx = data->ctx;
-    JSValue callback = data->callback;
-    int timerId = data->timerId;
-    bool isInterval = data->isInterval;
-    EngineInstance* instance = data->instance;
-    
-    __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, 
-        "Executing %s %d", isInterval ? "interval" : "timer", timerId);
+    EngineInstance* instance = slot->instance;
+    JSContext* ctx = instance->ctx;
+    JSValue callback = slot->callback;
+    bool isInterval = slot->isInterval;
     
-    data->isExecuting = true;
+    // clearTimeout from inside the callback only marks the slot inactive; the slot and the
+    // callback are released below, once the call has returned
+    slot->isExecuting = true;
 
     // Execute the callback
     JSValue result;
@@ -376,46 +1068,41 @@ static void uv_timer_callback(uv_timer_t* handle) {
     JS_FreeValue(ctx, result);
     
     // Process any pending Promise jobs after timer execution
-    JSContext *ctx1;
-    while (JS_ExecutePendingJob(JS_GetRuntime(ctx), &ctx1) > 0) {
-        // Continue processing jobs
-    }
+    runJavaScriptEventLoop(ctx, instance);
     
-    data->isExecuting = false;
+    slot->isExecuting = false;
 
     // For setTimeout, or an interval cleared from inside its callback, clean up once.
-    if ((!isInterval || data->isCleared) && instance) {
-        instance->timerCallbacks.erase(timerId);
-        instance->uvTimers.erase(timerId);
-        JS_FreeValue(ctx, data->callback);
-        handle->data = nullptr;
-        delete data;
-        if (!uv_is_closing((uv_handle_t*)handle)) {
-            uv_timer_stop(handle);
-            uv_close((uv_handle_t*)handle, uv_close_callback);
-        }
+    if (!isInterval || !slot->active) {
+        releaseTimer(ctx, slot);
     }
 }
 
-// Callback for uv_close
-static void uv_close_callback(uv_handle_t* handle) {
-    delete (uv_timer_t*)handle;
-}
-
-// Function to run the JavaScript event loop and process pending Promise jobs
-static bool runJavaScriptEventLoop(JSContext *ctx) {
+// Function to run the JavaScript event loop and process pending Promise jobs.
+// Runs at most the instance's microtask budget (jobs or time, whichever comes first) so a
+// self-rescheduling promise chain cannot starve timers and queued tasks; the rest is picked up
+// by nativeRunEventLoop on the next iteration of the JS thread loop.
+// Returns false if a job threw; sets *remaining when jobs were left over.
+static bool runJavaScriptEventLoop(JSContext *ctx, EngineInstance* instance, bool* remaining) {
     int count = 0;
     JSContext *ctx1;
     int err;
+    uint32_t maxJobs = instance ? instance->microtaskMaxJobs.load(std::memory_order_relaxed) : kDefaultMicrotaskMaxJobs;
+    auto timeBudget = std::chrono::microseconds(
+        instance ? instance->microtaskTimeUs.load(std::memory_order_relaxed) : kDefaultMicrotaskTimeUs);
+    if (remaining) {
+        *remaining = false;
+    }
     
-    // Get start time for logging purposes only
+    // Get start time for logging and the time budget
     auto startTime = std::chrono::steady_clock::now();
     
-    // Process pending jobs until none are left
+    // Process pending jobs until none are left or the budget runs out
     for(;;) {
         err = JS_ExecutePendingJob(JS_GetRuntime(ctx), &ctx1);
-        if (err <= 0) {
-            // No more pending jobs or error
+        bool overBudget = err > 0 && (++count >= (int)maxJobs || std::chrono::steady_clock::now() - startTime >= timeBudget);
+        if (err <= 0 || overBudget) {
+            // No more pending jobs, error, or out of budget
             if (err < 0) {
                 __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "Error executing pending job");
             }
@@ -423,15 +1110,27 @@ static bool runJavaScriptEventLoop(JSContext *ctx) {
             // Calculate total execution time for logging
             auto endTime = std::chrono::steady_clock::now();
             auto totalMs = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
+            if (instance && count > 0) {
+                instance->stats.microtaskUs.record(
+                    std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count());
+            }
+            if (overBudget && JS_IsJobPending(JS_GetRuntime(ctx))) {
+                if (instance) {
+                    instance->stats.microtaskOverruns.fetch_add(1, std::memory_order_relaxed);
+                }
+                if (remaining) {
+                    *remaining = true;
+                }
+                __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG,
+                    "Microtask budget exhausted after %d jobs, continuing next loop turn", count);
+            }
             
             __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, 
                 "Completed %d pending jobs in %.2f ms", count, (float)totalMs);
             
-            return err == 0; // true if no more jobs, false if error
+            return err >= 0; // false only if a job threw
         }
         
-        count++;
-        
         // Periodically log progress for debugging purposes
         if (count % EVENT_LOOP_LOG_INTERVAL == 0) {
             auto currentTime = std::chrono::steady_clock::now();
@@ -690,6 +1389,141 @@ static JSValue convertJavaJSValueToQuickJS(JNIEnv* env, JSContext* ctx, jobject
     return result;
 }
 
+// ============================================================================
+// Publish Batching
+// ============================================================================
+
+// Hand one batch to Kotlin as a JSON array. Publishing is fire-and-forget at this point, so a
+// failure is logged and the batch dropped rather than thrown into unrelated JS code.
+static void flushPublishBatch(JNIEnv* env, EngineInstance* instance, EngineInstance::PublishBatch& batch) {
+    batch.data.push_back(']');
+    jclass cls = env->GetObjectClass(instance->engineObj);
+    jmethodID method = cls ? env->GetMethodID(cls, "publishBatchFromJS", "(Ljava/lang/String;Ljava/lang/String;)V") : nullptr;
+    jstring jId = method ? env->NewStringUTF(batch.id.c_str()) : nullptr;
+    jstring jMsgs = jId ? env->NewStringUTF(batch.data.c_str()) : nullptr;
+    if (jMsgs) {
+        env->CallVoidMethod(instance->engineObj, method, jId, jMsgs);
+    }
+    if (env->ExceptionCheck() || !jMsgs) {
+        env->ExceptionClear();
+        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "Dropped publish batch of %u messages for %s",
+                            batch.count, batch.id.c_str());
+    }
+    if (jMsgs) env->DeleteLocalRef(jMsgs);
+    if (jId) env->DeleteLocalRef(jId);
+    if (cls) env->DeleteLocalRef(cls);
+}
+
+// Flush everything collected so far: at the end of every loop turn, and before invoke so the
+// host sees messages in the order JS sent them
+static void flushPublishBatches(JNIEnv* env, EngineInstance* instance) {
+    if (instance->publishBatches.empty() || !instance->engineObj) {
+        return;
+    }
+    std::vector<EngineInstance::PublishBatch> batches;
+    batches.swap(instance->publishBatches);
+    for (auto& batch : batches) {
+        flushPublishBatch(env, instance, batch);
+    }
+}
+
+// Queue one publish. Flushes that page early once it reaches the size threshold, and everything
+// once the oldest pending message has waited past the deadline.
+static void addPublishToBatch(JNIEnv* env, EngineInstance* instance, const char* id, const char* json) {
+    auto& batches = instance->publishBatches;
+    auto it = batches.begin();
+    while (it != batches.end() && it->id != id) {
+        ++it;
+    }
+    if (it == batches.end()) {
+        batches.emplace_back();
+        it = batches.end() - 1;
+        it->id = id;
+        it->data.push_back('[');
+        it->firstNs = monotonicNanos();
+    } else {
+        it->data.push_back(',');
+    }
+    it->data.append(json);
+    it->count++;
+
+    uint32_t maxBytes = instance->publishBatchMaxBytes.load(std::memory_order_relaxed);
+    if (maxBytes > 0 && it->data.size() >= maxBytes) {
+        EngineInstance::PublishBatch batch = std::move(*it);
+        batches.erase(it);
+        flushPublishBatch(env, instance, batch);
+    }
+    uint64_t deadlineUs = instance->publishBatchDeadlineUs.load(std::memory_order_relaxed);
+    if (deadlineUs > 0 && !batches.empty() &&
+        (monotonicNanos() - batches.front().firstNs) / 1000 >= deadlineUs) {
+        flushPublishBatches(env, instance);
+    }
+}
+
+// Build the org.json.JSONObject handed to invokeFromJS / invokeAsyncFromJS. With the binary
+// wire format the message skips JSON.stringify here and the JSON tokenizer in Kotlin;
+// WireFormat.decodeObject builds the same JSONObject from the encoded bytes.
+// Returns a local reference, or nullptr with the exception pending on ctx.
+static jobject newInvokeMessage(JNIEnv* env, JSContext* ctx, EngineInstance* instance, JSValueConst value) {
+    if (instance->binaryWire.load(std::memory_order_relaxed)) {
+        size_t length = 0;
+        uint8_t* data = wireEncodeJSValue(ctx, value, &length);
+        if (!data) {
+            return nullptr;
+        }
+        jbyteArray bytes = env->NewByteArray((jsize)length);
+        if (bytes) {
+            env->SetByteArrayRegion(bytes, 0, (jsize)length, reinterpret_cast<const jbyte*>(data));
+        }
+        free(data);
+        if (env->ExceptionCheck() || !bytes) {
+            throwJavaExceptionOrInternalError(ctx, env, "Failed to create invoke message bytes");
+            return nullptr;
+        }
+        jclass wireClass = env->FindClass("com/didi/dimina/engine/qjs/WireFormat");
+        jmethodID decodeMethod = wireClass && !env->ExceptionCheck()
+            ? env->GetStaticMethodID(wireClass, "decodeObject", "([B)Lorg/json/JSONObject;") : nullptr;
+        jobject message = decodeMethod && !env->ExceptionCheck()
+            ? env->CallStaticObjectMethod(wireClass, decodeMethod, bytes) : nullptr;
+        env->DeleteLocalRef(bytes);
+        if (wireClass) env->DeleteLocalRef(wireClass);
+        if (env->ExceptionCheck() || !message) {
+            if (message) env->DeleteLocalRef(message);
+            throwJavaExceptionOrInternalError(ctx, env, "Failed to decode invoke message");
+            return nullptr;
+        }
+        return message;
+    }
+
+    JSValueGuard jsonStr(ctx, jsonStringify(ctx, value));
+    if (jsonStr.isException()) {
+        return nullptr;
+    }
+    const char* jsonData = JS_ToCString(ctx, jsonStr.get());
+    if (!jsonData) {
+        return nullptr;
+    }
+    jstring jJsonData = env->NewStringUTF(jsonData);
+    JS_FreeCString(ctx, jsonData);
+    if (env->ExceptionCheck() || !jJsonData) {
+        throwJavaExceptionOrInternalError(ctx, env, "Failed to create invoke JSON string");
+        return nullptr;
+    }
+    jclass jsonObjectClass = env->FindClass("org/json/JSONObject");
+    jmethodID jsonObjectConstructor = jsonObjectClass && !env->ExceptionCheck()
+        ? env->GetMethodID(jsonObjectClass, "<init>", "(Ljava/lang/String;)V") : nullptr;
+    jobject message = jsonObjectConstructor && !env->ExceptionCheck()
+        ? env->NewObject(jsonObjectClass, jsonObjectConstructor, jJsonData) : nullptr;
+    env->DeleteLocalRef(jJsonData);
+    if (jsonObjectClass) env->DeleteLocalRef(jsonObjectClass);
+    if (env->ExceptionCheck() || !message) {
+        if (message) env->DeleteLocalRef(message);
+        throwJavaExceptionOrInternalError(ctx, env, "Failed to create invoke JSONObject");
+        return nullptr;
+    }
+    return message;
+}
+
 // QuickJSEngine methods
 
 // DiminaServiceBridge invoke method implementation
@@ -710,32 +1544,16 @@ static JSValue js_dimina_invoke(JSContext *ctx, JSValueConst this_val, int argc,
         return JS_ThrowInternalError(ctx, "Failed to get JNI environment");
     }
     JNIEnv* env = envGuard.get();
-
-    // Stringify the input object
-    JSValueGuard jsonStr(ctx, jsonStringify(ctx, argv[0]));
-    if (jsonStr.isException()) {
-        return JS_EXCEPTION;
-    }
-
-    // Get the JSON string
-    const char* jsonData = JS_ToCString(ctx, jsonStr.get());
-    if (!jsonData) {
-        return JS_EXCEPTION;
-    }
+    flushPublishBatches(env, instance);
 
     jclass cls = nullptr;
-    jclass jsonObjectClass = nullptr;
-    jstring jJsonData = nullptr;
     jobject jsonObject = nullptr;
     jobject resultObj = nullptr;
 
     auto cleanup = [&]() {
         if (resultObj) env->DeleteLocalRef(resultObj);
         if (jsonObject) env->DeleteLocalRef(jsonObject);
-        if (jJsonData) env->DeleteLocalRef(jJsonData);
-        if (jsonObjectClass) env->DeleteLocalRef(jsonObjectClass);
         if (cls) env->DeleteLocalRef(cls);
-        JS_FreeCString(ctx, jsonData);
     };
 
     // Call the Kotlin invokeFromJS method with JSValue? return type.
@@ -745,34 +1563,16 @@ static JSValue js_dimina_invoke(JSContext *ctx, JSValueConst this_val, int argc,
         return throwJavaExceptionOrInternalError(ctx, env, "Failed to get QuickJSEngine class");
     }
 
-    jsonObjectClass = env->FindClass("org/json/JSONObject");
-    if (env->ExceptionCheck() || !jsonObjectClass) {
-        cleanup();
-        return throwJavaExceptionOrInternalError(ctx, env, "Failed to find JSONObject class");
-    }
-
-    jmethodID jsonObjectConstructor = env->GetMethodID(jsonObjectClass, "<init>", "(Ljava/lang/String;)V");
-    if (env->ExceptionCheck() || !jsonObjectConstructor) {
-        cleanup();
-        return throwJavaExceptionOrInternalError(ctx, env, "Failed to find JSONObject constructor");
-    }
-
     jmethodID invokeMethod = env->GetMethodID(cls, "invokeFromJS", "(Lorg/json/JSONObject;)Lcom/didi/dimina/engine/qjs/JSValue;");
     if (env->ExceptionCheck() || !invokeMethod) {
         cleanup();
         return throwJavaExceptionOrInternalError(ctx, env, "Failed to find invokeFromJS method");
     }
 
-    jJsonData = env->NewStringUTF(jsonData);
-    if (env->ExceptionCheck() || !jJsonData) {
-        cleanup();
-        return throwJavaExceptionOrInternalError(ctx, env, "Failed to create invoke JSON string");
-    }
-
-    jsonObject = env->NewObject(jsonObjectClass, jsonObjectConstructor, jJsonData);
-    if (env->ExceptionCheck() || !jsonObject) {
+    jsonObject = newInvokeMessage(env, ctx, instance, argv[0]);
+    if (!jsonObject) {
         cleanup();
-        return throwJavaExceptionOrInternalError(ctx, env, "Failed to create invoke JSONObject");
+        return JS_EXCEPTION;
     }
 
     resultObj = env->CallObjectMethod(instance->engineObj, invokeMethod, jsonObject);
@@ -787,10 +1587,87 @@ static JSValue js_dimina_invoke(JSContext *ctx, JSValueConst this_val, int argc,
     return convertJavaJSValueToQuickJS(env, ctx, localResult);
 }
 
-// DiminaServiceBridge publish method implementation
-static JSValue js_dimina_publish(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
-    if (argc < 2 || !JS_IsString(argv[0]) || !JS_IsObject(argv[1])) {
-        return JS_ThrowTypeError(ctx, "Expected string and object arguments");
+// DiminaServiceBridge.invokeAsync: same message as invoke, but returns a Promise right away.
+// Kotlin runs the invoke callback off the JS thread and hands the result to
+// nativeResolveInvokeAsync, which wakes asyncInvokeHandle to settle the promise here.
+static JSValue js_dimina_invoke_async(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    if (argc < 1 || !JS_IsObject(argv[0])) {
+        return JS_ThrowTypeError(ctx, "Expected object argument");
+    }
+
+    EngineInstance* instance = findInstanceByContext(ctx);
+    if (!instance || !instance->engineObj) {
+        return JS_ThrowInternalError(ctx, "Engine instance not found or not initialized");
+    }
+
+    JNIEnvGuard envGuard;
+    if (!envGuard.isValid()) {
+        return JS_ThrowInternalError(ctx, "Failed to get JNI environment");
+    }
+    JNIEnv* env = envGuard.get();
+    flushPublishBatches(env, instance);
+
+    jclass cls = nullptr;
+    jobject jsonObject = nullptr;
+
+    auto cleanup = [&]() {
+        if (jsonObject) env->DeleteLocalRef(jsonObject);
+        if (cls) env->DeleteLocalRef(cls);
+    };
+
+    cls = env->GetObjectClass(instance->engineObj);
+    if (env->ExceptionCheck() || !cls) {
+        cleanup();
+        return throwJavaExceptionOrInternalError(ctx, env, "Failed to get QuickJSEngine class");
+    }
+
+    jmethodID invokeAsyncMethod = env->GetMethodID(cls, "invokeAsyncFromJS", "(ILorg/json/JSONObject;)V");
+    if (env->ExceptionCheck() || !invokeAsyncMethod) {
+        cleanup();
+        return throwJavaExceptionOrInternalError(ctx, env, "Failed to find invokeAsyncFromJS method");
+    }
+
+    jsonObject = newInvokeMessage(env, ctx, instance, argv[0]);
+    if (!jsonObject) {
+        cleanup();
+        return JS_EXCEPTION;
+    }
+
+    JSValue resolvingFuncs[2];
+    JSValue promise = JS_NewPromiseCapability(ctx, resolvingFuncs);
+    if (JS_IsException(promise)) {
+        cleanup();
+        return promise;
+    }
+    uint32_t callId = instance->nextAsyncCallId++;
+    if (instance->nextAsyncCallId == 0) {
+        instance->nextAsyncCallId = 1;
+    }
+    instance->asyncCalls[callId] = EngineInstance::AsyncCall{resolvingFuncs[0], resolvingFuncs[1]};
+
+    env->CallVoidMethod(instance->engineObj, invokeAsyncMethod, (jint)callId, jsonObject);
+    if (env->ExceptionCheck()) {
+        // Nothing was posted; reject now, the caller still gets its promise
+        JSValue error = throwJavaExceptionOrInternalError(ctx, env, "invokeAsyncFromJS threw an exception");
+        JS_FreeValue(ctx, error);
+        JSValue exception = JS_GetException(ctx);
+        auto it = instance->asyncCalls.find(callId);
+        JSValue ret = JS_Call(ctx, it->second.reject, JS_UNDEFINED, 1, &exception);
+        JS_FreeValue(ctx, ret);
+        JS_FreeValue(ctx, exception);
+        JS_FreeValue(ctx, it->second.resolve);
+        JS_FreeValue(ctx, it->second.reject);
+        instance->asyncCalls.erase(it);
+    }
+
+    cleanup();
+    return promise;
+}
+
+// DiminaServiceBridge publish method implementation
+static JSValue js_dimina_publish(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    if (argc < 2 || !JS_IsString(argv[0]) || !JS_IsObject(argv[1])) {
+        return JS_ThrowTypeError(ctx, "Expected string and object arguments");
     }
     
     // Find the engine instance for this context
@@ -821,6 +1698,13 @@ static JSValue js_dimina_publish(JSContext *ctx, JSValueConst this_val, int argc
         if (id) JS_FreeCString(ctx, id);
         return JS_EXCEPTION;
     }
+
+    if (instance->publishBatching.load(std::memory_order_relaxed)) {
+        addPublishToBatch(env, instance, id, jsonData);
+        JS_FreeCString(ctx, id);
+        JS_FreeCString(ctx, jsonData);
+        return JS_UNDEFINED;
+    }
     
     jclass cls = nullptr;
     jclass jsonObjectClass = nullptr;
@@ -899,8 +1783,8 @@ static JSValue js_clear_timer(JSContext *ctx, JSValueConst this_val, int argc, J
     }
     
     // Get the timer ID
-    int32_t timerId = 0;
-    JS_ToInt32(ctx, &timerId, argv[0]);
+    int64_t timerId = 0;
+    JS_ToInt64(ctx, &timerId, argv[0]);
     
     // Find the engine instance for this context
     EngineInstance* instance = findInstanceByContext(ctx);
@@ -908,35 +1792,17 @@ static JSValue js_clear_timer(JSContext *ctx, JSValueConst this_val, int argc, J
         return JS_ThrowInternalError(ctx, "Could not find engine instance for this context");
     }
     
-    // Find and stop the timer
-    auto timerIt = instance->uvTimers.find(timerId);
-    auto dataIt = instance->timerCallbacks.find(timerId);
-    if (dataIt != instance->timerCallbacks.end() && dataIt->second->isExecuting) {
-        dataIt->second->isCleared = true;
-        if (timerIt != instance->uvTimers.end()) {
-            uv_timer_stop(timerIt->second);
-        }
-        __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, "Marked running timer %d as cleared", timerId);
+    TimerSlot* slot = instance->timers.find(timerId);
+    if (!slot) {
         return JS_UNDEFINED;
     }
-
-    if (timerIt != instance->uvTimers.end()) {
-        uv_timer_t* timer = timerIt->second;
-        uv_timer_stop(timer);
-        uv_close((uv_handle_t*)timer, uv_close_callback);
-        instance->uvTimers.erase(timerIt);
-        
-        // Clean up timer data
-        if (dataIt != instance->timerCallbacks.end()) {
-            TimerData* data = dataIt->second;
-            JS_FreeValue(ctx, data->callback);
-            delete data;
-            instance->timerCallbacks.erase(dataIt);
-        }
-        
-        __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, "Cleared timer %d", timerId);
+    if (slot->isExecuting) {
+        // uv_timer_callback releases it once the callback returns
+        slot->active = false;
+        uv_timer_stop(&slot->handle);
+        return JS_UNDEFINED;
     }
-    
+    releaseTimer(ctx, slot);
     return JS_UNDEFINED;
 }
 
@@ -961,54 +1827,48 @@ static JSValue js_create_timer(JSContext *ctx, JSValueConst *argv, int argc, boo
         return JS_ThrowInternalError(ctx, "Could not find engine instance or event loop");
     }
     
-    // Generate a unique timer ID
-    int timerId = instance->nextTimerId++;
-    
-    // Create timer data
-    TimerData* data = new TimerData{
-        .ctx = ctx,
-        .timerId = timerId,
-        .callback = JS_DupValue(ctx, argv[0]),
-        .instanceId = 0,
-        .isInterval = isInterval,
-        .instance = instance
-    };
-    
-    // Create and initialize uv timer
-    uv_timer_t* timer = new uv_timer_t();
-    timer->data = data;
-    
-    int result = uv_timer_init(instance->loop, timer);
-    if (result != 0) {
-        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, 
-            "Failed to init uv_timer: %s", uv_strerror(result));
-        JS_FreeValue(ctx, data->callback);
-        delete data;
-        delete timer;
-        return JS_ThrowInternalError(ctx, "Failed to initialize timer");
+    bool grew = false;
+    TimerSlot* slot = instance->timers.acquire(&grew);
+    if (!slot) {
+        return JS_ThrowInternalError(ctx, "Too many timers");
+    }
+    if (grew) {
+        instance->stats.timerChunkAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!slot->handleOpen) {
+        int result = uv_timer_init(instance->loop, &slot->handle);
+        if (result != 0) {
+            __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, 
+                "Failed to init uv_timer: %s", uv_strerror(result));
+            instance->timers.release(slot);
+            return JS_ThrowInternalError(ctx, "Failed to initialize timer");
+        }
+        slot->handle.data = slot;
+        slot->handleOpen = true;
     }
+    slot->instance = instance;
+    slot->callback = JS_DupValue(ctx, argv[0]);
+    slot->isInterval = isInterval;
+    slot->active = true;
     
     // libuv treats repeat=0 as non-repeating, so clamp 0 ms intervals to 1 ms.
-    uint64_t repeat = isInterval ? static_cast<uint64_t>(delay == 0 ? 1 : delay) : 0;
-    result = uv_timer_start(timer, uv_timer_callback, static_cast<uint64_t>(delay), repeat);
+    slot->repeatMs = isInterval ? static_cast<uint64_t>(delay == 0 ? 1 : delay) : 0;
+    if (instance->suspended.load(std::memory_order_relaxed)) {
+        // Starts counting when the engine resumes
+        slot->suspendedDueIn = static_cast<uint64_t>(delay);
+        instance->stats.timersCreated.fetch_add(1, std::memory_order_relaxed);
+        return JS_NewInt64(ctx, TimerTable::idOf(slot));
+    }
+    int result = uv_timer_start(&slot->handle, uv_timer_callback, static_cast<uint64_t>(delay), slot->repeatMs);
     if (result != 0) {
         __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, 
             "Failed to start uv_timer: %s", uv_strerror(result));
-        JS_FreeValue(ctx, data->callback);
-        delete data;
-        uv_close((uv_handle_t*)timer, uv_close_callback);
+        releaseTimer(ctx, slot);
         return JS_ThrowInternalError(ctx, "Failed to start timer");
     }
+    instance->stats.timersCreated.fetch_add(1, std::memory_order_relaxed);
     
-    // Store timer references
-    instance->timerCallbacks[timerId] = data;
-    instance->uvTimers[timerId] = timer;
-    
-    __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, 
-        "Scheduled %s %d with delay %d ms using libuv", 
-        isInterval ? "interval" : "timer", timerId, delay);
-    
-    return JS_NewInt32(ctx, timerId);
+    return JS_NewInt64(ctx, TimerTable::idOf(slot));
 }
 
 // setTimeout wrapper
@@ -1119,6 +1979,534 @@ static void register_timer_functions(JSContext *ctx) {
     JS_FreeValue(ctx, global);
 }
 
+// ============================================================================
+// queueMicrotask, setImmediate and MessageChannel
+// ============================================================================
+
+static JSClassID gMessagePortClassId;
+// JS_NewClassID does an unlocked check-then-allocate on the global id; engines start on their own threads
+static std::once_flag gMessagePortClassOnce;
+
+static void freeImmediate(JSContext* ctx, ImmediateEntry& entry) {
+    JS_FreeValue(ctx, entry.func);
+    entry.func = JS_UNDEFINED;
+    for (JSValue& arg : entry.args) {
+        JS_FreeValue(ctx, arg);
+    }
+    entry.args.clear();
+}
+
+// Drop the queue once only cleared entries are left, and stop the check handle
+static void resetImmediatesIfEmpty(EngineInstance* instance) {
+    ImmediateQueue& queue = instance->immediates;
+    if (queue.live > 0) {
+        return;
+    }
+    queue.headId += queue.entries.size();
+    queue.entries.clear();
+    if (instance->immediateHandleOpen) {
+        uv_check_stop(&instance->immediateHandle);
+    }
+}
+
+static void immediate_check_callback(uv_check_t* handle);
+
+// Takes ownership of args. Returns the id of the new entry.
+static uint64_t pushImmediate(JSContext* ctx, EngineInstance* instance, JSValueConst func,
+                              std::vector<JSValue>&& args, bool isMessage) {
+    ImmediateQueue& queue = instance->immediates;
+    uint64_t id = queue.headId + queue.entries.size();
+    ImmediateEntry entry;
+    entry.func = JS_DupValue(ctx, func);
+    entry.args = std::move(args);
+    entry.isMessage = isMessage;
+    queue.entries.push_back(std::move(entry));
+    if (queue.live++ == 0 && instance->immediateHandleOpen && !instance->suspended.load(std::memory_order_relaxed)) {
+        uv_check_start(&instance->immediateHandle, immediate_check_callback);
+    }
+    return id;
+}
+
+static void logCallbackException(JSContext* ctx, const char* kind) {
+    JSValue exception = JS_GetException(ctx);
+    std::string errorMsg = getDetailedJSError(ctx, exception);
+    __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "Error in %s callback: %s", kind, errorMsg.c_str());
+    JS_FreeValue(ctx, exception);
+}
+
+// Messages to a closed port or one without onmessage are dropped
+static void deliverPortMessage(JSContext* ctx, JSValueConst target, JSValueConst data) {
+    MessagePort* port = (MessagePort*)JS_GetOpaque(target, gMessagePortClassId);
+    if (!port || port->closed) {
+        return;
+    }
+    JSValue handler = JS_GetPropertyStr(ctx, target, "onmessage");
+    if (!JS_IsFunction(ctx, handler)) {
+        if (JS_IsException(handler)) {
+            logCallbackException(ctx, "onmessage");
+        }
+        JS_FreeValue(ctx, handler);
+        return;
+    }
+    JSValue event = JS_NewObject(ctx);
+    JS_SetPropertyStr(ctx, event, "data", JS_DupValue(ctx, data));
+    JS_SetPropertyStr(ctx, event, "target", JS_DupValue(ctx, target));
+    JSValue result = JS_Call(ctx, handler, target, 1, &event);
+    if (JS_IsException(result)) {
+        logCallbackException(ctx, "onmessage");
+    }
+    JS_FreeValue(ctx, result);
+    JS_FreeValue(ctx, event);
+    JS_FreeValue(ctx, handler);
+}
+
+// Check phase: run what was queued before this turn. Entries queued by the callbacks wait
+// for the next turn, as in Node; nativeRunEventLoop reports them so the JS thread comes back
+// without waiting for a task.
+static void immediate_check_callback(uv_check_t* handle) {
+    EngineInstance* instance = (EngineInstance*)handle->data;
+    JSContext* ctx = instance->ctx;
+    ImmediateQueue& queue = instance->immediates;
+    if (!ctx) {
+        return;
+    }
+    uint64_t limitId = queue.headId + queue.entries.size();
+    while (!queue.entries.empty() && queue.headId < limitId) {
+        // Pop before running so callbacks can queue and clear freely
+        ImmediateEntry entry = std::move(queue.entries.front());
+        queue.entries.pop_front();
+        queue.headId++;
+        if (entry.cleared) {
+            continue;
+        }
+        queue.live--;
+        if (entry.isMessage) {
+            deliverPortMessage(ctx, entry.func, entry.args[0]);
+        } else {
+            JSValue result = JS_Call(ctx, entry.func, JS_UNDEFINED, (int)entry.args.size(), entry.args.data());
+            if (JS_IsException(result)) {
+                logCallbackException(ctx, "immediate");
+            }
+            JS_FreeValue(ctx, result);
+        }
+        freeImmediate(ctx, entry);
+        // Each entry is a macrotask: drain microtasks in between
+        runJavaScriptEventLoop(ctx, instance);
+    }
+    resetImmediatesIfEmpty(instance);
+}
+
+static JSValue js_microtask_job(JSContext *ctx, int argc, JSValueConst *argv) {
+    // An exception is reported by whoever runs JS_ExecutePendingJob
+    return JS_Call(ctx, argv[0], JS_UNDEFINED, 0, nullptr);
+}
+
+static JSValue js_queue_microtask(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    if (argc < 1 || !JS_IsFunction(ctx, argv[0])) {
+        return JS_ThrowTypeError(ctx, "queueMicrotask expects a function");
+    }
+    if (JS_EnqueueJob(ctx, js_microtask_job, 1, argv) < 0) {
+        return JS_EXCEPTION;
+    }
+    return JS_UNDEFINED;
+}
+
+static JSValue js_set_immediate(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    if (argc < 1 || !JS_IsFunction(ctx, argv[0])) {
+        return JS_ThrowTypeError(ctx, "setImmediate expects a function");
+    }
+    EngineInstance* instance = findInstanceByContext(ctx);
+    if (!instance || !instance->immediateHandleOpen) {
+        return JS_ThrowInternalError(ctx, "Could not find engine instance or event loop");
+    }
+    std::vector<JSValue> args;
+    args.reserve(argc - 1);
+    for (int i = 1; i < argc; i++) {
+        args.push_back(JS_DupValue(ctx, argv[i]));
+    }
+    return JS_NewInt64(ctx, (int64_t)pushImmediate(ctx, instance, argv[0], std::move(args), false));
+}
+
+static JSValue js_clear_immediate(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    if (argc < 1 || !JS_IsNumber(argv[0])) {
+        return JS_UNDEFINED;
+    }
+    int64_t id = 0;
+    JS_ToInt64(ctx, &id, argv[0]);
+    EngineInstance* instance = findInstanceByContext(ctx);
+    if (!instance) {
+        return JS_UNDEFINED;
+    }
+    ImmediateQueue& queue = instance->immediates;
+    if (id < 0 || (uint64_t)id < queue.headId || (uint64_t)id - queue.headId >= queue.entries.size()) {
+        return JS_UNDEFINED;
+    }
+    ImmediateEntry& entry = queue.entries[(size_t)((uint64_t)id - queue.headId)];
+    if (entry.cleared || entry.isMessage) {
+        return JS_UNDEFINED;
+    }
+    entry.cleared = true;
+    freeImmediate(ctx, entry);
+    queue.live--;
+    resetImmediatesIfEmpty(instance);
+    return JS_UNDEFINED;
+}
+
+static void js_message_port_finalizer(JSRuntime* rt, JSValue val) {
+    MessagePort* port = (MessagePort*)JS_GetOpaque(val, gMessagePortClassId);
+    if (port) {
+        JS_FreeValueRT(rt, port->peer);
+        delete port;
+    }
+}
+
+static void js_message_port_mark(JSRuntime* rt, JSValueConst val, JS_MarkFunc* mark_func) {
+    MessagePort* port = (MessagePort*)JS_GetOpaque(val, gMessagePortClassId);
+    if (port) {
+        JS_MarkValue(rt, port->peer, mark_func);
+    }
+}
+
+static JSValue newMessagePort(JSContext* ctx) {
+    JSValue obj = JS_NewObjectClass(ctx, gMessagePortClassId);
+    if (JS_IsException(obj)) {
+        return obj;
+    }
+    JS_SetOpaque(obj, new MessagePort());
+    return obj;
+}
+
+// Queued with setImmediate entries; delivered to the peer's onmessage in posting order
+static JSValue js_message_port_post(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    MessagePort* port = (MessagePort*)JS_GetOpaque(this_val, gMessagePortClassId);
+    if (!port) {
+        return JS_ThrowTypeError(ctx, "postMessage called on a non-MessagePort");
+    }
+    if (port->closed) {
+        return JS_UNDEFINED;
+    }
+    EngineInstance* instance = findInstanceByContext(ctx);
+    if (!instance || !instance->immediateHandleOpen) {
+        return JS_ThrowInternalError(ctx, "Could not find engine instance or event loop");
+    }
+    std::vector<JSValue> args;
+    args.push_back(argc > 0 ? JS_DupValue(ctx, argv[0]) : JS_UNDEFINED);
+    pushImmediate(ctx, instance, port->peer, std::move(args), true);
+    return JS_UNDEFINED;
+}
+
+// Closes both ends; messages already queued are dropped on delivery
+static JSValue js_message_port_close(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    MessagePort* port = (MessagePort*)JS_GetOpaque(this_val, gMessagePortClassId);
+    if (!port) {
+        return JS_ThrowTypeError(ctx, "close called on a non-MessagePort");
+    }
+    port->closed = true;
+    MessagePort* peer = (MessagePort*)JS_GetOpaque(port->peer, gMessagePortClassId);
+    if (peer) {
+        peer->closed = true;
+    }
+    return JS_UNDEFINED;
+}
+
+// Ports deliver as soon as onmessage is set; start() exists for compatibility
+static JSValue js_message_port_start(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    return JS_UNDEFINED;
+}
+
+static JSValue js_message_channel(JSContext *ctx, JSValueConst new_target, int argc, JSValueConst *argv) {
+    JSValue proto = JS_GetPropertyStr(ctx, new_target, "prototype");
+    if (JS_IsException(proto)) {
+        return proto;
+    }
+    JSValue channel = JS_NewObjectProto(ctx, proto);
+    JS_FreeValue(ctx, proto);
+    if (JS_IsException(channel)) {
+        return channel;
+    }
+    JSValue port1 = newMessagePort(ctx);
+    JSValue port2 = JS_IsException(port1) ? JS_EXCEPTION : newMessagePort(ctx);
+    if (JS_IsException(port2)) {
+        JS_FreeValue(ctx, port1);
+        JS_FreeValue(ctx, channel);
+        return JS_EXCEPTION;
+    }
+    ((MessagePort*)JS_GetOpaque(port1, gMessagePortClassId))->peer = JS_DupValue(ctx, port2);
+    ((MessagePort*)JS_GetOpaque(port2, gMessagePortClassId))->peer = JS_DupValue(ctx, port1);
+    JS_DefinePropertyValueStr(ctx, channel, "port1", port1, JS_PROP_ENUMERABLE | JS_PROP_CONFIGURABLE);
+    JS_DefinePropertyValueStr(ctx, channel, "port2", port2, JS_PROP_ENUMERABLE | JS_PROP_CONFIGURABLE);
+    return channel;
+}
+
+// Register queueMicrotask, setImmediate/clearImmediate and MessageChannel
+static void register_scheduler_functions(JSContext *ctx) {
+    // The class id is allocated once per process, the class is registered per runtime
+    JSRuntime* rt = JS_GetRuntime(ctx);
+    std::call_once(gMessagePortClassOnce, []() { JS_NewClassID(&gMessagePortClassId); });
+    if (!JS_IsRegisteredClass(rt, gMessagePortClassId)) {
+        JSClassDef portClass = {};
+        portClass.class_name = "MessagePort";
+        portClass.finalizer = js_message_port_finalizer;
+        portClass.gc_mark = js_message_port_mark;
+        JS_NewClass(rt, gMessagePortClassId, &portClass);
+    }
+    JSValue portProto = JS_NewObject(ctx);
+    JS_SetPropertyStr(ctx, portProto, "postMessage",
+                      JS_NewCFunction(ctx, js_message_port_post, "postMessage", 1));
+    JS_SetPropertyStr(ctx, portProto, "close",
+                      JS_NewCFunction(ctx, js_message_port_close, "close", 0));
+    JS_SetPropertyStr(ctx, portProto, "start",
+                      JS_NewCFunction(ctx, js_message_port_start, "start", 0));
+    JS_SetClassProto(ctx, gMessagePortClassId, portProto);
+
+    JSValue global = JS_GetGlobalObject(ctx);
+
+    JS_SetPropertyStr(ctx, global, "queueMicrotask",
+                      JS_NewCFunction(ctx, js_queue_microtask, "queueMicrotask", 1));
+    JS_SetPropertyStr(ctx, global, "setImmediate",
+                      JS_NewCFunction(ctx, js_set_immediate, "setImmediate", 1));
+    JS_SetPropertyStr(ctx, global, "clearImmediate",
+                      JS_NewCFunction(ctx, js_clear_immediate, "clearImmediate", 1));
+
+    JSValue channelCtor = JS_NewCFunction2(ctx, js_message_channel, "MessageChannel", 0, JS_CFUNC_constructor, 0);
+    JSValue channelProto = JS_NewObject(ctx);
+    JS_SetConstructor(ctx, channelCtor, channelProto);
+    JS_FreeValue(ctx, channelProto);
+    JS_SetPropertyStr(ctx, global, "MessageChannel", channelCtor);
+
+    JS_FreeValue(ctx, global);
+}
+
+// ============================================================================
+// Animation Frames
+// ============================================================================
+
+static void frame_timer_callback(uv_timer_t* handle) {
+    // The frame itself runs in nativeRunEventLoop, where a JNIEnv is at hand for the publish flush
+    ((EngineInstance*)handle->data)->fallbackFrameDue = true;
+}
+
+// Something waits for the next frame: rAF callbacks, or publishes held by frameAlignedPublish.
+// While the host pushes vsync the frame comes from nativeOnVsync and the timer only fires if
+// it stops; otherwise the timer paces frames at 60 Hz on the monotonic clock. JS thread only.
+static void requestFrame(EngineInstance* instance) {
+    instance->frameRequested.store(true, std::memory_order_relaxed);
+    if (instance->suspended.load(std::memory_order_relaxed) || !instance->frameTimerOpen ||
+        uv_is_active((uv_handle_t*)&instance->frameTimer)) {
+        return;
+    }
+    uint64_t now = monotonicNanos();
+    uint64_t timeoutMs;
+    if (instance->lastVsyncNs && (now - instance->lastVsyncNs) / 1000000 < kVsyncStaleMs) {
+        timeoutMs = kVsyncStaleMs - (now - instance->lastVsyncNs) / 1000000;
+    } else {
+        uint64_t sinceFrame = now - instance->lastFrameNs;
+        timeoutMs = sinceFrame >= kFrameIntervalNs ? 0 : (kFrameIntervalNs - sinceFrame + 999999) / 1000000;
+    }
+    uv_timer_start(&instance->frameTimer, frame_timer_callback, timeoutMs, 0);
+}
+
+// Run the callbacks registered before this frame, draining microtasks after each one as
+// browsers do, then hand over the publishes held for the frame. Callbacks registered during
+// the frame wait for the next one.
+static void runFrame(JNIEnv* env, EngineInstance* instance, uint64_t frameTimeNs, bool fallback) {
+    JSContext* ctx = instance->ctx;
+    instance->frameRequested.store(false, std::memory_order_relaxed);
+    instance->fallbackFrameDue = false;
+    if (instance->frameTimerOpen) {
+        uv_timer_stop(&instance->frameTimer);
+    }
+    instance->lastFrameNs = monotonicNanos();
+    instance->stats.frames.fetch_add(1, std::memory_order_relaxed);
+    if (fallback) {
+        instance->stats.fallbackFrames.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    auto& callbacks = instance->frameCallbacks;
+    size_t count = callbacks.size();
+    JSValue timestamp = JS_NewFloat64(ctx, (double)frameTimeNs / 1e6);
+    for (size_t i = 0; i < count; i++) {
+        // Index every time: a callback may grow the vector
+        JSValue func = callbacks[i].func;
+        if (JS_IsUndefined(func)) {
+            continue;
+        }
+        callbacks[i].func = JS_UNDEFINED;
+        instance->frameCallbacksLive--;
+        JSValue result = JS_Call(ctx, func, JS_UNDEFINED, 1, &timestamp);
+        if (JS_IsException(result)) {
+            logCallbackException(ctx, "animation frame");
+        }
+        JS_FreeValue(ctx, result);
+        JS_FreeValue(ctx, func);
+        runJavaScriptEventLoop(ctx, instance);
+    }
+    JS_FreeValue(ctx, timestamp);
+    if (instance->frameCallbacksLive == 0) {
+        callbacks.clear();
+    } else {
+        callbacks.erase(callbacks.begin(), callbacks.begin() + count);
+    }
+
+    if (instance->frameAlignedPublish.load(std::memory_order_relaxed)) {
+        flushPublishBatches(env, instance);
+    }
+    if (instance->frameCallbacksLive > 0) {
+        requestFrame(instance);
+    }
+}
+
+// Called once per loop turn. Returns true if a frame ran.
+static bool runPendingFrame(JNIEnv* env, EngineInstance* instance) {
+    uint64_t vsyncNs = instance->pendingVsyncNs.exchange(0, std::memory_order_relaxed);
+    if (vsyncNs) {
+        instance->lastVsyncNs = monotonicNanos();
+    }
+    if (instance->suspended.load(std::memory_order_relaxed) ||
+        !instance->frameRequested.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    if (vsyncNs) {
+        runFrame(env, instance, vsyncNs, false);
+    } else if (instance->fallbackFrameDue) {
+        runFrame(env, instance, monotonicNanos(), true);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static JSValue js_request_animation_frame(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    if (argc < 1 || !JS_IsFunction(ctx, argv[0])) {
+        return JS_ThrowTypeError(ctx, "requestAnimationFrame expects a function");
+    }
+    EngineInstance* instance = findInstanceByContext(ctx);
+    if (!instance || !instance->frameTimerOpen) {
+        return JS_ThrowInternalError(ctx, "Could not find engine instance or event loop");
+    }
+    // 0 is never a valid id, skip it on wrap-around
+    if (++instance->nextFrameId == 0) {
+        instance->nextFrameId = 1;
+    }
+    instance->frameCallbacks.push_back({instance->nextFrameId, JS_DupValue(ctx, argv[0])});
+    if (instance->frameCallbacksLive++ == 0) {
+        requestFrame(instance);
+    }
+    return JS_NewUint32(ctx, instance->nextFrameId);
+}
+
+// A frame holds only a handful of callbacks, so a linear search is enough
+static JSValue js_cancel_animation_frame(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    if (argc < 1 || !JS_IsNumber(argv[0])) {
+        return JS_UNDEFINED;
+    }
+    uint32_t id = 0;
+    JS_ToUint32(ctx, &id, argv[0]);
+    EngineInstance* instance = findInstanceByContext(ctx);
+    if (!instance || id == 0) {
+        return JS_UNDEFINED;
+    }
+    for (auto& callback : instance->frameCallbacks) {
+        if (callback.id == id) {
+            if (!JS_IsUndefined(callback.func)) {
+                JS_FreeValue(ctx, callback.func);
+                callback.func = JS_UNDEFINED;
+                instance->frameCallbacksLive--;
+            }
+            break;
+        }
+    }
+    return JS_UNDEFINED;
+}
+
+// Register requestAnimationFrame/cancelAnimationFrame
+static void register_animation_frame_functions(JSContext *ctx) {
+    JSValue global = JS_GetGlobalObject(ctx);
+    JS_SetPropertyStr(ctx, global, "requestAnimationFrame",
+                      JS_NewCFunction(ctx, js_request_animation_frame, "requestAnimationFrame", 1));
+    JS_SetPropertyStr(ctx, global, "cancelAnimationFrame",
+                      JS_NewCFunction(ctx, js_cancel_animation_frame, "cancelAnimationFrame", 1));
+    JS_FreeValue(ctx, global);
+}
+
+// Getter for DiminaServiceBridge.onMessage
+static JSValue js_dimina_get_on_message(JSContext *ctx, JSValueConst this_val) {
+    EngineInstance* instance = findInstanceByContext(ctx);
+    if (!instance) {
+        return JS_UNDEFINED;
+    }
+    return JS_DupValue(ctx, instance->messageHandler);
+}
+
+// Setter for DiminaServiceBridge.onMessage, caches the handler on the instance
+static JSValue js_dimina_set_on_message(JSContext *ctx, JSValueConst this_val, JSValueConst val) {
+    EngineInstance* instance = findInstanceByContext(ctx);
+    if (!instance) {
+        return JS_ThrowInternalError(ctx, "Engine instance not found");
+    }
+    JS_FreeValue(ctx, instance->messageHandler);
+    JS_FreeValue(ctx, instance->messageBridge);
+    instance->messageHandler = JS_DupValue(ctx, val);
+    instance->messageBridge = JS_DupValue(ctx, this_val);
+    return JS_UNDEFINED;
+}
+
+// asyncInvokeHandle callback, on the JS thread inside uv_run: settle every invokeAsync promise
+// whose host result has arrived, then drain the microtasks the settlements queued
+static void settle_async_invokes(uv_async_t* handle) {
+    auto* instance = (EngineInstance*)handle->data;
+    std::vector<std::pair<uint32_t, jobject>> results;
+    {
+        std::lock_guard<std::mutex> lock(instance->asyncResultsMutex);
+        results.swap(instance->asyncResults);
+    }
+    if (results.empty() || !instance->ctx) {
+        return;
+    }
+
+    JNIEnvGuard envGuard;
+    if (!envGuard.isValid()) {
+        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "Failed to get JNI environment for invokeAsync results");
+        return;
+    }
+    JNIEnv* env = envGuard.get();
+    JSContext* ctx = instance->ctx;
+
+    for (auto& entry : results) {
+        jobject localResult = entry.second ? env->NewLocalRef(entry.second) : nullptr;
+        if (entry.second) {
+            env->DeleteGlobalRef(entry.second);
+        }
+        auto it = instance->asyncCalls.find(entry.first);
+        if (it == instance->asyncCalls.end()) {
+            if (localResult) env->DeleteLocalRef(localResult);
+            continue;
+        }
+        EngineInstance::AsyncCall call = it->second;
+        instance->asyncCalls.erase(it);
+
+        // Same conversion as invoke; an ERROR result comes back as a pending exception
+        JSValue value = convertJavaJSValueToQuickJS(env, ctx, localResult);
+        bool rejected = JS_IsException(value);
+        if (rejected) {
+            value = JS_GetException(ctx);
+        }
+        JSValue ret = JS_Call(ctx, rejected ? call.reject : call.resolve, JS_UNDEFINED, 1, &value);
+        if (JS_IsException(ret)) {
+            JSValue exception = JS_GetException(ctx);
+            __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "Failed to settle invokeAsync: %s",
+                                getDetailedJSError(ctx, exception).c_str());
+            JS_FreeValue(ctx, exception);
+        }
+        JS_FreeValue(ctx, ret);
+        JS_FreeValue(ctx, value);
+        JS_FreeValue(ctx, call.resolve);
+        JS_FreeValue(ctx, call.reject);
+    }
+
+    runJavaScriptEventLoop(ctx, instance);
+}
+
 // Register DiminaServiceBridge global object and methods
 static void register_dimina_service_bridge(JSContext *ctx) {
     // Create the DiminaServiceBridge object
@@ -1128,8 +2516,20 @@ static void register_dimina_service_bridge(JSContext *ctx) {
     // Register methods
     JS_SetPropertyStr(ctx, diminaObj, "invoke", 
                       JS_NewCFunction(ctx, js_dimina_invoke, "invoke", 1));
+    JS_SetPropertyStr(ctx, diminaObj, "invokeAsync",
+                      JS_NewCFunction(ctx, js_dimina_invoke_async, "invokeAsync", 1));
     JS_SetPropertyStr(ctx, diminaObj, "publish", 
                       JS_NewCFunction(ctx, js_dimina_publish, "publish", 1));
+
+    // onMessage is an accessor so the service bundle's assignment lands on the instance
+    JSAtom onMessageAtom = JS_NewAtom(ctx, "onMessage");
+    JS_DefinePropertyGetSet(ctx, diminaObj, onMessageAtom,
+                            JS_NewCFunction2(ctx, (JSCFunction *)js_dimina_get_on_message,
+                                             "get onMessage", 0, JS_CFUNC_getter, 0),
+                            JS_NewCFunction2(ctx, (JSCFunction *)js_dimina_set_on_message,
+                                             "set onMessage", 1, JS_CFUNC_setter, 0),
+                            JS_PROP_CONFIGURABLE | JS_PROP_ENUMERABLE);
+    JS_FreeAtom(ctx, onMessageAtom);
     
     // Add DiminaServiceBridge to global object
     JS_SetPropertyStr(ctx, global, "DiminaServiceBridge", diminaObj);
@@ -1193,6 +2593,9 @@ Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeInitialize(
         return JNI_FALSE;
     }
     
+    // Bridge functions find their instance through the context opaque
+    JS_SetContextOpaque(instance->ctx, instance);
+    
     // Register DiminaServiceBridge global object
     register_dimina_service_bridge(instance->ctx);
     
@@ -1201,6 +2604,8 @@ Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeInitialize(
     
     // Register timer functions
     register_timer_functions(instance->ctx);
+    register_scheduler_functions(instance->ctx);
+    register_animation_frame_functions(instance->ctx);
     
     // Store pointers in Java object
     jclass cls = env->GetObjectClass(thiz);
@@ -1213,7 +2618,33 @@ Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeInitialize(
     env->SetLongField(thiz, loopField, (jlong)instance->loop);
     
     // Store instance in global map
+    if (!indexInstance(instanceId, instance)) {
+        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "Too many engine instances, cannot add %d", instanceId);
+        JS_FreeContext(instance->ctx);
+        JS_FreeRuntime(instance->runtime);
+        uv_loop_close(instance->loop);
+        delete instance->loop;
+        env->DeleteGlobalRef(instance->engineObj);
+        delete instance;
+        return JNI_FALSE;
+    }
     gEngineInstances[instanceId] = instance;
+
+    // Wakes the loop when an invokeAsync result is posted from another thread
+    instance->asyncInvokeHandle.data = instance;
+    if (uv_async_init(instance->loop, &instance->asyncInvokeHandle, settle_async_invokes) == 0) {
+        instance->asyncInvokeHandleOpen = true;
+    }
+    // Runs setImmediate callbacks and port messages; started only while any are queued
+    instance->immediateHandle.data = instance;
+    if (uv_check_init(instance->loop, &instance->immediateHandle) == 0) {
+        instance->immediateHandleOpen = true;
+    }
+    // Paces animation frames when the host does not push vsync
+    instance->frameTimer.data = instance;
+    if (uv_timer_init(instance->loop, &instance->frameTimer) == 0) {
+        instance->frameTimerOpen = true;
+    }
     
     __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, 
         "QuickJS instance %d initialized successfully with libuv event loop", instanceId);
@@ -1261,9 +2692,10 @@ Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeEvaluateFromFile(
         return createJSError(env, "File is empty");
     }
     
-    // Evaluate JavaScript
-    JSValueGuard val(ctx, JS_Eval(ctx, scriptContent.c_str(), scriptContent.length(), 
-                                   filePathStr, JS_EVAL_TYPE_GLOBAL));
+    // Evaluate JavaScript, reusing compiled bytecode when the bundle has not changed
+    uint64_t evalStart = monotonicNanos();
+    JSValueGuard val(ctx, evalWithCodeCache(ctx, scriptContent.c_str(), scriptContent.length(), filePathStr));
+    instance->stats.evalUs.record((monotonicNanos() - evalStart) / 1000);
     
     // Release file path string
     env->ReleaseStringUTFChars(filePath, filePathStr);
@@ -1283,7 +2715,7 @@ Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeEvaluateFromFile(
     // Run the event loop to process any pending Promise jobs
     __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, 
         "Running event loop to process pending Promise jobs from file for instance %d", instanceId);
-    bool allJobsProcessed = runJavaScriptEventLoop(ctx);
+    bool allJobsProcessed = runJavaScriptEventLoop(ctx, instance);
     if (!allJobsProcessed) {
         __android_log_print(ANDROID_LOG_WARN, LOG_TAG, 
             "Error processing async jobs from file for instance %d", instanceId);
@@ -1296,6 +2728,29 @@ Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeEvaluateFromFile(
     return createJSValueObject(env, ctx, val.get());
 }
 
+// Set the bytecode cache directory shared by all instances; an empty path disables it
+extern "C" JNIEXPORT void JNICALL
+Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeSetCodeCacheDir(
+        JNIEnv* env,
+        jclass clazz,
+        jstring dirPath) {
+
+    const char* dirStr = env->GetStringUTFChars(dirPath, nullptr);
+    if (!dirStr) {
+        return;
+    }
+    std::string dir = dirStr;
+    env->ReleaseStringUTFChars(dirPath, dirStr);
+
+    if (!dir.empty() && mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) {
+        __android_log_print(ANDROID_LOG_WARN, LOG_TAG, "Failed to create code cache dir %s: %s",
+                            dir.c_str(), strerror(errno));
+        return;
+    }
+    std::lock_guard<std::mutex> lock(gCodeCacheDirMutex);
+    gCodeCacheDir = dir;
+}
+
 // Evaluate JavaScript code and return JSValue
 extern "C" JNIEXPORT jobject JNICALL
 Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeEvaluate(
@@ -1319,7 +2774,9 @@ Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeEvaluate(
     }
     
     // Evaluate JavaScript
+    uint64_t evalStart = monotonicNanos();
     JSValueGuard val(ctx, JS_Eval(ctx, scriptStr, strlen(scriptStr), "<input>", JS_EVAL_TYPE_GLOBAL));
+    instance->stats.evalUs.record((monotonicNanos() - evalStart) / 1000);
     env->ReleaseStringUTFChars(script, scriptStr);
     
     // Check if there was an exception during evaluation
@@ -1337,7 +2794,7 @@ Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeEvaluate(
     // Run the event loop to process any pending Promise jobs
     __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, 
         "Running event loop to process pending Promise jobs for instance %d", instanceId);
-    bool allJobsProcessed = runJavaScriptEventLoop(ctx);
+    bool allJobsProcessed = runJavaScriptEventLoop(ctx, instance);
     if (!allJobsProcessed) {
         __android_log_print(ANDROID_LOG_WARN, LOG_TAG, 
             "Error processing async jobs for instance %d", instanceId);
@@ -1350,8 +2807,179 @@ Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeEvaluate(
     return createJSValueObject(env, ctx, val.get());
 }
 
-// Run the libuv event loop
+// Hand a parsed message to DiminaServiceBridge.onMessage, shared by the JSON and binary entry points
+static jobject dispatchParsedMessage(JNIEnv* env, EngineInstance* instance, JSValueGuard& message, jint instanceId) {
+    JSContext* ctx = instance->ctx;
+    if (message.isException()) {
+        jstring errorMsg = handleJSError(env, ctx);
+        const char* errorChars = errorMsg ? env->GetStringUTFChars(errorMsg, nullptr) : nullptr;
+        jobject errorResult = createJSError(env, errorChars);
+        if (errorChars) {
+            env->ReleaseStringUTFChars(errorMsg, errorChars);
+        }
+        env->DeleteLocalRef(errorMsg);
+        return errorResult;
+    }
+
+    // Hold our own references: the handler may reassign onMessage while running
+    JSValueGuard handler(ctx, JS_DupValue(ctx, instance->messageHandler));
+    JSValueGuard bridge(ctx, JS_DupValue(ctx, instance->messageBridge));
+    JSValue args[1] = {message.get()};
+    uint64_t evalStart = monotonicNanos();
+    JSValueGuard val(ctx, JS_Call(ctx, handler.get(), bridge.get(), 1, args));
+    instance->stats.evalUs.record((monotonicNanos() - evalStart) / 1000);
+
+    if (val.isException()) {
+        jstring errorMsg = handleJSError(env, ctx);
+        const char* errorChars = errorMsg ? env->GetStringUTFChars(errorMsg, nullptr) : nullptr;
+        jobject errorResult = createJSError(env, errorChars);
+        if (errorChars) {
+            env->ReleaseStringUTFChars(errorMsg, errorChars);
+        }
+        env->DeleteLocalRef(errorMsg);
+        return errorResult;
+    }
+
+    if (!runJavaScriptEventLoop(ctx, instance)) {
+        __android_log_print(ANDROID_LOG_WARN, LOG_TAG,
+            "Error processing async jobs for instance %d", instanceId);
+    }
+
+    return createJSValueObject(env, ctx, val.get());
+}
+
+// Dispatch a JSON message to DiminaServiceBridge.onMessage without eval
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeDispatchMessage(
+        JNIEnv* env,
+        jobject thiz,
+        jstring json,
+        jint instanceId) {
+
+    EngineInstance* instance = getEngineInstance(instanceId);
+    if (!instance || !instance->ctx) {
+        return createJSError(env, "QuickJS context is null or instance not found");
+    }
+
+    JSContext* ctx = instance->ctx;
+    if (!JS_IsFunction(ctx, instance->messageHandler)) {
+        return createJSError(env, "DiminaServiceBridge.onMessage is not a function");
+    }
+
+    const char* jsonStr = env->GetStringUTFChars(json, nullptr);
+    if (!jsonStr) {
+        return createJSError(env, "Failed to get message string");
+    }
+    JSValueGuard message(ctx, JS_ParseJSON(ctx, jsonStr, strlen(jsonStr), "<message>"));
+    env->ReleaseStringUTFChars(json, jsonStr);
+
+    return dispatchParsedMessage(env, instance, message, instanceId);
+}
+
+// Same as nativeDispatchMessage for a message in the binary wire format (WireFormat.encode)
+extern "C" JNIEXPORT jobject JNICALL
+Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeDispatchMessageBinary(
+        JNIEnv* env,
+        jobject thiz,
+        jbyteArray bytes,
+        jint instanceId) {
+
+    EngineInstance* instance = getEngineInstance(instanceId);
+    if (!instance || !instance->ctx) {
+        return createJSError(env, "QuickJS context is null or instance not found");
+    }
+
+    JSContext* ctx = instance->ctx;
+    if (!JS_IsFunction(ctx, instance->messageHandler)) {
+        return createJSError(env, "DiminaServiceBridge.onMessage is not a function");
+    }
+
+    jsize length = env->GetArrayLength(bytes);
+    jbyte* data = env->GetByteArrayElements(bytes, nullptr);
+    if (!data) {
+        return createJSError(env, "Failed to get message bytes");
+    }
+    JSValueGuard message(ctx, wireDecodeJSValue(ctx, reinterpret_cast<const uint8_t*>(data), (size_t)length));
+    env->ReleaseByteArrayElements(bytes, data, JNI_ABORT);
+
+    return dispatchParsedMessage(env, instance, message, instanceId);
+}
+
+// Called on the JS thread right before a queued task runs
 extern "C" JNIEXPORT void JNICALL
+Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeBeginTask(
+        JNIEnv* env,
+        jobject thiz,
+        jlong enqueuedAtNanos,
+        jint queueDepth,
+        jint instanceId) {
+
+    EngineInstance* instance = getEngineInstance(instanceId);
+    if (!instance) {
+        return;
+    }
+    instance->stats.recordTaskStart((uint64_t)enqueuedAtNanos, (uint64_t)queueDepth);
+}
+
+static void appendHistogramJson(std::string& out, const char* name, const LatencyHistogram& histogram) {
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "\"%s\":{\"count\":%" PRIu64 ",\"mean\":%.2f,\"p50\":%" PRIu64 ",\"p90\":%" PRIu64
+             ",\"p99\":%" PRIu64 ",\"max\":%" PRIu64 "}",
+             name, histogram.count(), histogram.mean(), histogram.percentile(50), histogram.percentile(90),
+             histogram.percentile(99), histogram.max());
+    out += buf;
+}
+
+// Snapshot of an instance's statistics as JSON; safe to call from any thread.
+// Reads the counters in place under the instance map lock, which also keeps nativeDestroy from freeing them.
+extern "C" JNIEXPORT jstring JNICALL
+Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeGetEngineStats(
+        JNIEnv* env,
+        jobject thiz,
+        jint instanceId) {
+
+    std::string json;
+    {
+        std::lock_guard<std::mutex> lock(gEngineInstancesMutex);
+        auto it = gEngineInstances.find(instanceId);
+        if (it == gEngineInstances.end()) {
+            return nullptr;
+        }
+        const EngineStats& stats = it->second->stats;
+        char buf[512];
+        snprintf(buf, sizeof(buf),
+                 "{\"tasksExecuted\":%" PRIu64 ",\"tasksPerSec\":%" PRIu64 ",\"loopIterations\":%" PRIu64
+                 ",\"maxQueueDepth\":%" PRIu64 ",\"microtaskOverruns\":%" PRIu64
+                 ",\"timersCreated\":%" PRIu64 ",\"timerChunkAllocations\":%" PRIu64
+                 ",\"frames\":%" PRIu64 ",\"fallbackFrames\":%" PRIu64 ",\"suspended\":%s,",
+                 stats.tasksExecuted.load(std::memory_order_relaxed),
+                 stats.tasksPerSecAt(monotonicNanos()),
+                 stats.loopIterations.load(std::memory_order_relaxed),
+                 stats.maxQueueDepth.load(std::memory_order_relaxed),
+                 stats.microtaskOverruns.load(std::memory_order_relaxed),
+                 stats.timersCreated.load(std::memory_order_relaxed),
+                 stats.timerChunkAllocations.load(std::memory_order_relaxed),
+                 stats.frames.load(std::memory_order_relaxed),
+                 stats.fallbackFrames.load(std::memory_order_relaxed),
+                 it->second->suspended.load(std::memory_order_relaxed) ? "true" : "false");
+        json = buf;
+        appendHistogramJson(json, "queueWaitUs", stats.queueWaitUs);
+        json += ",";
+        appendHistogramJson(json, "evalUs", stats.evalUs);
+        json += ",";
+        appendHistogramJson(json, "microtaskUs", stats.microtaskUs);
+        json += ",";
+        appendHistogramJson(json, "queueDepthSamples", stats.queueDepth);
+        json += "}";
+    }
+    return env->NewStringUTF(json.c_str());
+}
+
+// Run the libuv event loop. Returns true if microtasks are still pending after this turn's
+// budget or immediates are queued, so the caller should come back immediately instead of
+// waiting for the next task.
+extern "C" JNIEXPORT jboolean JNICALL
 Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeRunEventLoop(
         JNIEnv* env,
         jobject thiz,
@@ -1362,18 +2990,164 @@ Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeRunEventLoop(
     if (!instance || !instance->loop) {
         __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, 
             "Failed to run event loop: Instance %d not found or loop is null", instanceId);
-        return;
+        return JNI_FALSE;
     }
 
+    instance->stats.loopIterations.fetch_add(1, std::memory_order_relaxed);
+
     // Run the event loop in non-blocking mode with a timeout
     // This allows the loop to process events without blocking indefinitely
     uv_run(instance->loop, UV_RUN_NOWAIT);
     
-    // Also process any pending JavaScript jobs
-    JSContext *ctx1;
-    while (JS_ExecutePendingJob(instance->runtime, &ctx1) > 0) {
-        // Continue processing jobs
+    // Also process any pending JavaScript jobs, within the microtask budget
+    bool remaining = false;
+    runJavaScriptEventLoop(instance->ctx, instance, &remaining);
+    // Animation frame, if a vsync arrived or the fallback timer fired since the last turn
+    if (runPendingFrame(env, instance)) {
+        runJavaScriptEventLoop(instance->ctx, instance, &remaining);
+    }
+    // End of the turn: hand this turn's publishes to Kotlin, one call per page. With
+    // frameAlignedPublish they wait for the next frame instead; a suspended engine has no
+    // frames, so it keeps flushing per turn.
+    if (instance->frameAlignedPublish.load(std::memory_order_relaxed) &&
+        !instance->suspended.load(std::memory_order_relaxed)) {
+        if (!instance->publishBatches.empty()) {
+            requestFrame(instance);
+        }
+    } else {
+        flushPublishBatches(env, instance);
+    }
+    // Immediates queued during this turn run in the next one, without waiting for a task
+    bool immediatesPending = instance->immediates.live > 0 && !instance->suspended.load(std::memory_order_relaxed);
+    return remaining || immediatesPending ? JNI_TRUE : JNI_FALSE;
+}
+
+// Hand an invokeAsync result back to the engine; safe to call from any thread.
+// The result is settled on the JS thread the next time its uv loop runs.
+extern "C" JNIEXPORT void JNICALL
+Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeResolveInvokeAsync(
+        JNIEnv* env,
+        jobject thiz,
+        jint callId,
+        jobject result,
+        jint instanceId) {
+
+    // Hold the map lock so nativeDestroy can't close the handle underneath
+    std::lock_guard<std::mutex> lock(gEngineInstancesMutex);
+    auto it = gEngineInstances.find(instanceId);
+    if (it == gEngineInstances.end() || !it->second->asyncInvokeHandleOpen) {
+        return;
+    }
+    EngineInstance* instance = it->second;
+    {
+        std::lock_guard<std::mutex> resultsLock(instance->asyncResultsMutex);
+        instance->asyncResults.emplace_back((uint32_t)callId, result ? env->NewGlobalRef(result) : nullptr);
+    }
+    uv_async_send(&instance->asyncInvokeHandle);
+}
+
+// Configure the per-turn microtask budget; zero keeps the current value
+extern "C" JNIEXPORT void JNICALL
+Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeSetMicrotaskBudget(
+        JNIEnv* env,
+        jobject thiz,
+        jint maxJobs,
+        jlong maxTimeUs,
+        jint instanceId) {
+
+    // Any thread; hold the map lock so nativeDestroy can't free the instance underneath
+    std::lock_guard<std::mutex> lock(gEngineInstancesMutex);
+    auto it = gEngineInstances.find(instanceId);
+    if (it == gEngineInstances.end()) {
+        return;
+    }
+    EngineInstance* instance = it->second;
+    if (maxJobs > 0) {
+        instance->microtaskMaxJobs.store((uint32_t)maxJobs, std::memory_order_relaxed);
+    }
+    if (maxTimeUs > 0) {
+        instance->microtaskTimeUs.store((uint64_t)maxTimeUs, std::memory_order_relaxed);
+    }
+}
+
+// Configure publish batching; zero thresholds disable that trigger
+extern "C" JNIEXPORT void JNICALL
+Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeSetPublishBatching(
+        JNIEnv* env,
+        jobject thiz,
+        jboolean enabled,
+        jint maxBytes,
+        jlong deadlineUs,
+        jint instanceId) {
+
+    // Any thread; hold the map lock so nativeDestroy can't free the instance underneath.
+    // Batches already collected are flushed at the end of the current turn either way.
+    std::lock_guard<std::mutex> lock(gEngineInstancesMutex);
+    auto it = gEngineInstances.find(instanceId);
+    if (it == gEngineInstances.end()) {
+        return;
+    }
+    EngineInstance* instance = it->second;
+    instance->publishBatchMaxBytes.store(maxBytes > 0 ? (uint32_t)maxBytes : 0, std::memory_order_relaxed);
+    instance->publishBatchDeadlineUs.store(deadlineUs > 0 ? (uint64_t)deadlineUs : 0, std::memory_order_relaxed);
+    instance->publishBatching.store(enabled == JNI_TRUE, std::memory_order_relaxed);
+}
+
+// Hold publish batches until the next animation frame, so the host gets at most one flush per
+// page per frame. Only has an effect with publish batching on; its size and deadline
+// thresholds still flush early.
+extern "C" JNIEXPORT void JNICALL
+Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeSetFrameAlignedPublish(
+        JNIEnv* env,
+        jobject thiz,
+        jboolean enabled,
+        jint instanceId) {
+
+    std::lock_guard<std::mutex> lock(gEngineInstancesMutex);
+    auto it = gEngineInstances.find(instanceId);
+    if (it == gEngineInstances.end()) {
+        return;
+    }
+    it->second->frameAlignedPublish.store(enabled == JNI_TRUE, std::memory_order_relaxed);
+}
+
+// Host vsync, from any thread (typically a Choreographer frame callback). frameTimeNs is on
+// the System.nanoTime() clock; 0 means now. Consecutive vsyncs the JS thread has not caught up
+// with collapse into the latest. Returns true if the engine is waiting for a frame, so the
+// caller knows to wake the JS thread.
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeOnVsync(
+        JNIEnv* env,
+        jobject thiz,
+        jlong frameTimeNs,
+        jint instanceId) {
+
+    std::lock_guard<std::mutex> lock(gEngineInstancesMutex);
+    auto it = gEngineInstances.find(instanceId);
+    if (it == gEngineInstances.end()) {
+        return JNI_FALSE;
     }
+    EngineInstance* instance = it->second;
+    instance->pendingVsyncNs.store(frameTimeNs > 0 ? (uint64_t)frameTimeNs : monotonicNanos(),
+                                   std::memory_order_relaxed);
+    return instance->frameRequested.load(std::memory_order_relaxed) &&
+           !instance->suspended.load(std::memory_order_relaxed) ? JNI_TRUE : JNI_FALSE;
+}
+
+// Choose the encoding of invoke messages sent to Kotlin: binary wire format or JSON text
+extern "C" JNIEXPORT void JNICALL
+Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeSetWireFormat(
+        JNIEnv* env,
+        jobject thiz,
+        jboolean binary,
+        jint instanceId) {
+
+    std::lock_guard<std::mutex> lock(gEngineInstancesMutex);
+    auto it = gEngineInstances.find(instanceId);
+    if (it == gEngineInstances.end()) {
+        return;
+    }
+    it->second->binaryWire.store(binary == JNI_TRUE, std::memory_order_relaxed);
 }
 
 // Stop the libuv event loop
@@ -1398,6 +3172,72 @@ Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeStopEventLoop(
     uv_stop(instance->loop);
 }
 
+// Background mode for a hidden mini-program; call on the JS thread. Every timer, intervals
+// included, is stopped with its remaining time recorded, and immediates stop running, so with
+// no tasks the JS thread can block on its queue. Pending publishes are flushed, then a full GC
+// runs and idle buffers are released. Tasks still run; timers created meanwhile start counting
+// on resume.
+extern "C" JNIEXPORT void JNICALL
+Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeSuspend(
+        JNIEnv* env,
+        jobject thiz,
+        jint instanceId) {
+
+    EngineInstance* instance = getEngineInstance(instanceId);
+    if (!instance || !instance->loop || instance->suspended.load(std::memory_order_relaxed)) {
+        return;
+    }
+    instance->suspended.store(true, std::memory_order_relaxed);
+    instance->timers.forEach([](TimerSlot* slot) {
+        if (slot->active && slot->handleOpen) {
+            slot->suspendedDueIn = uv_timer_get_due_in(&slot->handle);
+            uv_timer_stop(&slot->handle);
+        }
+    });
+    if (instance->immediateHandleOpen) {
+        uv_check_stop(&instance->immediateHandle);
+    }
+    // Pending rAF callbacks stay queued and run in the first frame after resuming
+    if (instance->frameTimerOpen) {
+        uv_timer_stop(&instance->frameTimer);
+    }
+    flushPublishBatches(env, instance);
+    JS_RunGC(instance->runtime);
+    instance->publishBatches.shrink_to_fit();
+    instance->immediates.entries.shrink_to_fit();
+    __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, "Instance %d suspended", instanceId);
+}
+
+// Leave background mode; call on the JS thread. Timers restart with the time they had left
+// when suspended, so the time spent in background is not counted and missed interval ticks
+// are not replayed.
+extern "C" JNIEXPORT void JNICALL
+Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeResume(
+        JNIEnv* env,
+        jobject thiz,
+        jint instanceId) {
+
+    EngineInstance* instance = getEngineInstance(instanceId);
+    if (!instance || !instance->loop || !instance->suspended.load(std::memory_order_relaxed)) {
+        return;
+    }
+    instance->suspended.store(false, std::memory_order_relaxed);
+    // Timers stopped by nativeSuspend measure from the current loop time
+    uv_update_time(instance->loop);
+    instance->timers.forEach([](TimerSlot* slot) {
+        if (slot->active && slot->handleOpen && !uv_is_active((uv_handle_t*)&slot->handle)) {
+            uv_timer_start(&slot->handle, uv_timer_callback, slot->suspendedDueIn, slot->repeatMs);
+        }
+    });
+    if (instance->immediateHandleOpen && instance->immediates.live > 0) {
+        uv_check_start(&instance->immediateHandle, immediate_check_callback);
+    }
+    if (instance->frameRequested.load(std::memory_order_relaxed)) {
+        requestFrame(instance);
+    }
+    __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, "Instance %d resumed", instanceId);
+}
+
 // Destroy QuickJS runtime, context, and libuv event loop
 extern "C" JNIEXPORT void JNICALL
 Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeDestroy(
@@ -1417,6 +3257,10 @@ Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeDestroy(
         instance = it->second;
         // Remove from map immediately to prevent double-free issues
         gEngineInstances.erase(it);
+        unindexInstance(instanceId);
+    }
+    if (instance->ctx) {
+        JS_SetContextOpaque(instance->ctx, nullptr);
     }
     
     // Stop the event loop
@@ -1434,22 +3278,64 @@ Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeDestroy(
     env->SetLongField(thiz, runtimeField, 0L);
     env->SetLongField(thiz, loopField, 0L);
     
-    // Clean up all active timers
-    for (auto& pair : instance->uvTimers) {
-        uv_timer_stop(pair.second);
-        uv_close((uv_handle_t*)pair.second, uv_close_callback);
+    // Stop taking invokeAsync results; nativeResolveInvokeAsync can no longer find the instance
+    if (instance->asyncInvokeHandleOpen) {
+        uv_close((uv_handle_t*)&instance->asyncInvokeHandle, nullptr);
+        instance->asyncInvokeHandleOpen = false;
     }
-    instance->uvTimers.clear();
+    {
+        std::lock_guard<std::mutex> lock(instance->asyncResultsMutex);
+        for (auto& entry : instance->asyncResults) {
+            if (entry.second) env->DeleteGlobalRef(entry.second);
+        }
+        instance->asyncResults.clear();
+    }
+    // Pages are going away with the engine; unflushed publishes are dropped
+    instance->publishBatches.clear();
     
-    // Clean up timer data and callbacks
+    // Drop queued immediates and port messages
+    if (instance->ctx) {
+        for (ImmediateEntry& entry : instance->immediates.entries) {
+            if (!entry.cleared) {
+                freeImmediate(instance->ctx, entry);
+            }
+        }
+    }
+    instance->immediates.entries.clear();
+    instance->immediates.live = 0;
+    if (instance->immediateHandleOpen) {
+        uv_close((uv_handle_t*)&instance->immediateHandle, nullptr);
+        instance->immediateHandleOpen = false;
+    }
+
+    // Drop pending animation frame callbacks
     if (instance->ctx) {
-        for (auto& pair : instance->timerCallbacks) {
-            TimerData* data = pair.second;
-            JS_FreeValue(instance->ctx, data->callback);
-            delete data;
+        for (auto& callback : instance->frameCallbacks) {
+            JS_FreeValue(instance->ctx, callback.func);
         }
     }
-    instance->timerCallbacks.clear();
+    instance->frameCallbacks.clear();
+    instance->frameCallbacksLive = 0;
+    instance->frameRequested.store(false, std::memory_order_relaxed);
+    if (instance->frameTimerOpen) {
+        uv_close((uv_handle_t*)&instance->frameTimer, nullptr);
+        instance->frameTimerOpen = false;
+    }
+    
+    // Release pending timers and close every slot's handle; the chunks outlive the
+    // close callbacks because they are freed with the instance
+    instance->timers.forEach([instance](TimerSlot* slot) {
+        if (slot->active && instance->ctx) {
+            JS_FreeValue(instance->ctx, slot->callback);
+        }
+        slot->callback = JS_UNDEFINED;
+        slot->active = false;
+        if (slot->handleOpen) {
+            uv_timer_stop(&slot->handle);
+            uv_close((uv_handle_t*)&slot->handle, nullptr);
+            slot->handleOpen = false;
+        }
+    });
     
     // Close the event loop and wait for all handles to close
     if (instance->loop) {
@@ -1474,6 +3360,19 @@ Java_com_didi_dimina_engine_qjs_QuickJSEngine_nativeDestroy(
         instance->loop = nullptr;
     }
     
+    // Drop the cached onMessage handler and unsettled invokeAsync resolvers before the context goes away
+    if (instance->ctx) {
+        JS_FreeValue(instance->ctx, instance->messageHandler);
+        JS_FreeValue(instance->ctx, instance->messageBridge);
+        instance->messageHandler = JS_UNDEFINED;
+        instance->messageBridge = JS_UNDEFINED;
+        for (auto& pair : instance->asyncCalls) {
+            JS_FreeValue(instance->ctx, pair.second.resolve);
+            JS_FreeValue(instance->ctx, pair.second.reject);
+        }
+        instance->asyncCalls.clear();
+    }
+
     // Free context and runtime in the correct order
     if (instance->ctx && instance->runtime) {
         // Run garbage collection before freeing the context
@@ -0,0 +1,654 @@
+#include "wire_format.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+enum : uint8_t {
+    kTagUndefined = 0x00,
+    kTagNull = 0x01,
+    kTagFalse = 0x02,
+    kTagTrue = 0x03,
+    kTagInt = 0x04,
+    kTagDouble = 0x05,
+    kTagString = 0x06,
+    kTagArray = 0x07,
+    kTagObject = 0x08,
+    kTagArrayBuffer = 0x09,
+    kTagTypedArray = 0x0A,
+};
+
+// Deeper nesting is treated as a cycle; also keeps recursion off the end of the thread stack
+constexpr int kMaxDepth = 128;
+// Object counts are reserved as 5 bytes and patched afterwards; a varint padded with
+// continuation bits decodes the same as the short form
+constexpr size_t kCountSlot = 5;
+
+class Writer {
+public:
+    ~Writer() {
+        std::free(data);
+    }
+
+    bool failed = false;
+
+    void byte(uint8_t value) {
+        if (reserve(1)) {
+            data[length++] = static_cast<char>(value);
+        }
+    }
+
+    void varint(uint64_t value) {
+        while (value >= 0x80) {
+            byte(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+        byte(static_cast<uint8_t>(value));
+    }
+
+    void bytes(const void* src, size_t n) {
+        if (n > 0 && reserve(n)) {
+            std::memcpy(data + length, src, n);
+            length += n;
+        }
+    }
+
+    void f64(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        for (int i = 0; i < 8; i++) {
+            byte(static_cast<uint8_t>(bits >> (i * 8)));
+        }
+    }
+
+    void str(const char* s, size_t n) {
+        varint(n);
+        bytes(s, n);
+    }
+
+    size_t beginCount() {
+        size_t at = length;
+        if (reserve(kCountSlot)) {
+            length += kCountSlot;
+        }
+        return at;
+    }
+
+    void endCount(size_t at, uint32_t count) {
+        if (failed) {
+            return;
+        }
+        for (size_t i = 0; i < kCountSlot; i++) {
+            uint8_t b = static_cast<uint8_t>(count & 0x7F);
+            count >>= 7;
+            data[at + i] = static_cast<char>(i + 1 < kCountSlot ? (b | 0x80) : b);
+        }
+    }
+
+    char* release(size_t* outLength) {
+        if (failed) {
+            return nullptr;
+        }
+        char* result = data;
+        *outLength = length;
+        data = nullptr;
+        length = capacity = 0;
+        return result;
+    }
+
+private:
+    bool reserve(size_t n) {
+        if (failed) {
+            return false;
+        }
+        if (length + n > capacity) {
+            size_t next = capacity ? capacity * 2 : 256;
+            while (next < length + n) {
+                next *= 2;
+            }
+            char* grown = static_cast<char *>(std::realloc(data, next));
+            if (!grown) {
+                failed = true;
+                return false;
+            }
+            data = grown;
+            capacity = next;
+        }
+        return true;
+    }
+
+    char* data = nullptr;
+    size_t length = 0;
+    size_t capacity = 0;
+};
+
+class Reader {
+public:
+    Reader(const uint8_t* data, size_t length) : p(data), end(data + length) {}
+
+    bool failed = false;
+
+    uint8_t byte() {
+        if (p >= end) {
+            failed = true;
+            return 0;
+        }
+        return* p++;
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t b = byte();
+            value |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) {
+                return value;
+            }
+        }
+        failed = true;
+        return 0;
+    }
+
+    const uint8_t* bytes(uint64_t n) {
+        if (n > static_cast<uint64_t>(end - p)) {
+            failed = true;
+            return nullptr;
+        }
+        const uint8_t* at = p;
+        p += n;
+        return at;
+    }
+
+    double f64() {
+        const uint8_t* b = bytes(8);
+        uint64_t bits = 0;
+        for (int i = 0; b && i < 8; i++) {
+            bits |= static_cast<uint64_t>(b[i]) << (i * 8);
+        }
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // Every element takes at least one byte, so a count above the remaining bytes is corrupt;
+// reject it before allocating for it
+    uint64_t count() {
+        uint64_t n = varint();
+        if (n > static_cast<uint64_t>(end - p)) {
+            failed = true;
+            return 0;
+        }
+        return n;
+    }
+
+    bool atEnd() const {
+        return p == end;
+    }
+
+private:
+    const uint8_t* p;
+    const uint8_t* end;
+};
+
+int64_t zigzagDecode(uint64_t n) {
+    return static_cast<int64_t>(n >> 1) ^ -static_cast<int64_t>(n & 1);
+}
+
+uint64_t zigzagEncode(int32_t n) {
+    return (static_cast<uint32_t>(n) << 1) ^ static_cast<uint32_t>(n >> 31);
+}
+
+void writeNumber(Writer& w, double d) {
+    if (d >= INT32_MIN && d <= INT32_MAX && std::floor(d) == d && !(d == 0 && std::signbit(d))) {
+        w.byte(kTagInt);
+        w.varint(zigzagEncode(static_cast<int32_t>(d)));
+    } else {
+        w.byte(kTagDouble);
+        w.f64(d);
+    }
+}
+
+// Typed array kinds on the wire, numbered like napi_typedarray_type on HarmonyOS
+enum : uint8_t {
+    kKindInt8 = 0,
+    kKindUint8 = 1,
+    kKindUint8Clamped = 2,
+    kKindInt16 = 3,
+    kKindUint16 = 4,
+    kKindInt32 = 5,
+    kKindUint32 = 6,
+    kKindFloat32 = 7,
+    kKindFloat64 = 8,
+    kKindBigInt64 = 9,
+    kKindBigUint64 = 10,
+};
+
+int typedArrayKind(int jsType) {
+    switch (jsType) {
+        case JS_TYPED_ARRAY_INT8: return kKindInt8;
+        case JS_TYPED_ARRAY_UINT8: return kKindUint8;
+        case JS_TYPED_ARRAY_UINT8C: return kKindUint8Clamped;
+        case JS_TYPED_ARRAY_INT16: return kKindInt16;
+        case JS_TYPED_ARRAY_UINT16: return kKindUint16;
+        case JS_TYPED_ARRAY_INT32: return kKindInt32;
+        case JS_TYPED_ARRAY_UINT32: return kKindUint32;
+        case JS_TYPED_ARRAY_FLOAT32: return kKindFloat32;
+        case JS_TYPED_ARRAY_FLOAT64: return kKindFloat64;
+        case JS_TYPED_ARRAY_BIG_INT64: return kKindBigInt64;
+        case JS_TYPED_ARRAY_BIG_UINT64: return kKindBigUint64;
+        default: return -1; // no wire kind (Float16), encoded as a plain object
+    }
+}
+
+int jsTypedArrayType(uint8_t kind) {
+    switch (kind) {
+        case kKindInt8: return JS_TYPED_ARRAY_INT8;
+        case kKindUint8: return JS_TYPED_ARRAY_UINT8;
+        case kKindUint8Clamped: return JS_TYPED_ARRAY_UINT8C;
+        case kKindInt16: return JS_TYPED_ARRAY_INT16;
+        case kKindUint16: return JS_TYPED_ARRAY_UINT16;
+        case kKindInt32: return JS_TYPED_ARRAY_INT32;
+        case kKindUint32: return JS_TYPED_ARRAY_UINT32;
+        case kKindFloat32: return JS_TYPED_ARRAY_FLOAT32;
+        case kKindFloat64: return JS_TYPED_ARRAY_FLOAT64;
+        case kKindBigInt64: return JS_TYPED_ARRAY_BIG_INT64;
+        case kKindBigUint64: return JS_TYPED_ARRAY_BIG_UINT64;
+        default: return -1;
+    }
+}
+
+int elementSize(uint8_t kind) {
+    static const int sizes[] = {1, 1, 1, 2, 2, 4, 4, 4, 8, 8, 8};
+    return kind < sizeof(sizes) / sizeof(sizes[0]) ? sizes[kind] : 0;
+}
+
+class JSEncoder {
+public:
+    JSEncoder(JSContext* ctx) : ctx(ctx) {
+        JSValue global = JS_GetGlobalObject(ctx);
+        arrayBufferCtor = JS_GetPropertyStr(ctx, global, "ArrayBuffer");
+        JS_FreeValue(ctx, global);
+    }
+
+    ~JSEncoder() {
+        JS_FreeValue(ctx, arrayBufferCtor);
+        for (auto& entry : keys) {
+            JS_FreeAtom(ctx, entry.first);
+        }
+    }
+
+    // On false the exception is pending on ctx
+    bool encode(JSValueConst value, int depth) {
+        switch (JS_VALUE_GET_TAG(value)) {
+            case JS_TAG_UNDEFINED:
+                w.byte(kTagUndefined);
+                return true;
+            case JS_TAG_NULL:
+                w.byte(kTagNull);
+                return true;
+            case JS_TAG_BOOL:
+                w.byte(JS_VALUE_GET_BOOL(value) ? kTagTrue : kTagFalse);
+                return true;
+            case JS_TAG_INT:
+                w.byte(kTagInt);
+                w.varint(zigzagEncode(JS_VALUE_GET_INT(value)));
+                return true;
+            case JS_TAG_FLOAT64: {
+                double d = JS_VALUE_GET_FLOAT64(value);
+                // NaN / Infinity become null, as in JSON
+                if (std::isfinite(d)) {
+                    writeNumber(w, d);
+                } else {
+                    w.byte(kTagNull);
+                }
+                return true;
+            }
+            case JS_TAG_STRING: {
+                size_t len = 0;
+                const char* s = JS_ToCStringLen(ctx, &len, value);
+                if (!s) {
+                    return false;
+                }
+                w.byte(kTagString);
+                w.str(s, len);
+                JS_FreeCString(ctx, s);
+                return true;
+            }
+            case JS_TAG_OBJECT:
+                return encodeObject(value, depth);
+            default:
+                // Symbol, BigInt: not representable in JSON either
+                w.byte(kTagUndefined);
+                return true;
+        }
+    }
+
+    char* release(size_t* length) {
+        if (w.failed) {
+            JS_ThrowOutOfMemory(ctx);
+        }
+        return w.release(length);
+    }
+
+    Writer w;
+
+private:
+    bool encodeObject(JSValueConst value, int depth) {
+        if (depth >= kMaxDepth) {
+            JS_ThrowRangeError(ctx, "wire format: object nested too deeply or circular");
+            return false;
+        }
+        if (JS_IsFunction(ctx, value)) {
+            w.byte(kTagUndefined);
+            return true;
+        }
+        if (JS_IsArray(ctx, value) == 1) {
+            uint32_t count = 0;
+            JSValue lengthValue = JS_GetPropertyStr(ctx, value, "length");
+            int failed = JS_ToUint32(ctx, &count, lengthValue);
+            JS_FreeValue(ctx, lengthValue);
+            if (failed) {
+                return false;
+            }
+            w.byte(kTagArray);
+            w.varint(count);
+            for (uint32_t i = 0; i < count; i++) {
+                JSValue element = JS_GetPropertyUint32(ctx, value, i);
+                if (JS_IsException(element)) {
+                    return false;
+                }
+                // undefined / functions inside arrays become null, as in JSON
+                bool ok;
+                if (JS_IsUndefined(element) || JS_IsFunction(ctx, element)) {
+                    w.byte(kTagNull);
+                    ok = true;
+                } else {
+                    ok = encode(element, depth + 1);
+                }
+                JS_FreeValue(ctx, element);
+                if (!ok) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        int kind = typedArrayKind(JS_GetTypedArrayType(value));
+        if (kind >= 0) {
+            size_t offset = 0, byteLength = 0, bytesPerElement = 0;
+            JSValue buffer = JS_GetTypedArrayBuffer(ctx, value, &offset, &byteLength, &bytesPerElement);
+            if (JS_IsException(buffer)) {
+                return false;
+            }
+            size_t size = 0;
+            uint8_t* data = JS_GetArrayBuffer(ctx, &size, buffer);
+            JS_FreeValue(ctx, buffer);
+            if (!data) {
+                return false;
+            }
+            w.byte(kTagTypedArray);
+            w.byte(static_cast<uint8_t>(kind));
+            w.varint(byteLength);
+            w.bytes(data + offset, byteLength);
+            return true;
+        }
+        if (JS_IsInstanceOf(ctx, value, arrayBufferCtor) == 1) {
+            size_t size = 0;
+            uint8_t* data = JS_GetArrayBuffer(ctx, &size, value);
+            if (!data && size > 0) {
+                return false;
+            }
+            discardPendingError();
+            w.byte(kTagArrayBuffer);
+            w.varint(size);
+            w.bytes(data, size);
+            return true;
+        }
+
+        // Honor toJSON like JSON.stringify does; without it a Date would encode as {}
+        JSValue toJSON = JS_GetPropertyStr(ctx, value, "toJSON");
+        if (JS_IsException(toJSON)) {
+            return false;
+        }
+        if (JS_IsFunction(ctx, toJSON)) {
+            JSValue key = JS_NewString(ctx, "");
+            JSValue replaced = JS_Call(ctx, toJSON, value, 1, &key);
+            JS_FreeValue(ctx, key);
+            JS_FreeValue(ctx, toJSON);
+            if (JS_IsException(replaced)) {
+                return false;
+            }
+            bool ok = encode(replaced, depth + 1);
+            JS_FreeValue(ctx, replaced);
+            return ok;
+        }
+        JS_FreeValue(ctx, toJSON);
+
+        JSPropertyEnum* props = nullptr;
+        uint32_t len = 0;
+        if (JS_GetOwnPropertyNames(ctx, &props, &len, value, JS_GPN_STRING_MASK | JS_GPN_ENUM_ONLY) != 0) {
+            return false;
+        }
+        w.byte(kTagObject);
+        size_t countAt = w.beginCount();
+        uint32_t written = 0;
+        bool ok = true;
+        uint32_t i = 0;
+        for (; i < len && ok; i++) {
+            JSValue prop = JS_GetProperty(ctx, value, props[i].atom);
+            if (JS_IsException(prop)) {
+                ok = false;
+            } else if (!JS_IsUndefined(prop) && !JS_IsFunction(ctx, prop) &&
+                       JS_VALUE_GET_TAG(prop) != JS_TAG_SYMBOL) {
+                // Keys holding undefined / functions / symbols are skipped, as in JSON
+                ok = writeKey(props[i].atom) && encode(prop, depth + 1);
+                written++;
+            }
+            JS_FreeValue(ctx, prop);
+            JS_FreeAtom(ctx, props[i].atom);
+        }
+        for (; i < len; i++) {
+            JS_FreeAtom(ctx, props[i].atom);
+        }
+        js_free(ctx, props);
+        w.endCount(countAt, written);
+        return ok;
+    }
+
+    bool writeKey(JSAtom atom) {
+        auto it = keys.find(atom);
+        if (it != keys.end()) {
+            w.varint(it->second);
+            return true;
+        }
+        size_t len = 0;
+        JSValue name = JS_AtomToString(ctx, atom);
+        const char* s = JS_ToCStringLen(ctx, &len, name);
+        JS_FreeValue(ctx, name);
+        if (!s) {
+            return false;
+        }
+        w.varint(0);
+        w.str(s, len);
+        JS_FreeCString(ctx, s);
+        keys.emplace(JS_DupAtom(ctx, atom), static_cast<uint32_t>(keys.size() + 1));
+        return true;
+    }
+
+    // A zero-length ArrayBuffer may report a null pointer; that is not an error
+    void discardPendingError() {
+        if (JS_HasException(ctx)) {
+            JS_FreeValue(ctx, JS_GetException(ctx));
+        }
+    }
+
+    JSContext* ctx;
+    JSValue arrayBufferCtor;
+    std::unordered_map<JSAtom, uint32_t> keys;
+};
+
+class JSDecoder {
+public:
+    JSDecoder(JSContext* ctx, const uint8_t* data, size_t length) : r(data, length), ctx(ctx) {}
+
+    ~JSDecoder() {
+        for (JSAtom atom : keys) {
+            JS_FreeAtom(ctx, atom);
+        }
+    }
+
+    JSValue decode(int depth) {
+        if (depth >= kMaxDepth) {
+            return corrupt();
+        }
+        uint8_t tag = r.byte();
+        if (r.failed) {
+            return corrupt();
+        }
+        switch (tag) {
+            case kTagUndefined: return JS_UNDEFINED;
+            case kTagNull: return JS_NULL;
+            case kTagFalse: return JS_FALSE;
+            case kTagTrue: return JS_TRUE;
+            case kTagInt: {
+                int64_t n = zigzagDecode(r.varint());
+                return r.failed ? corrupt() : JS_NewInt32(ctx, static_cast<int32_t>(n));
+            }
+            case kTagDouble: {
+                double d = r.f64();
+                return r.failed ? corrupt() : JS_NewFloat64(ctx, d);
+            }
+            case kTagString: {
+                uint64_t n = r.varint();
+                const uint8_t* s = r.bytes(n);
+                return r.failed ? corrupt() : JS_NewStringLen(ctx, reinterpret_cast<const char *>(s), n);
+            }
+            case kTagArray: {
+                uint64_t count = r.count();
+                if (r.failed) {
+                    return corrupt();
+                }
+                JSValue array = JS_NewArray(ctx);
+                for (uint64_t i = 0; i < count && !JS_IsException(array); i++) {
+                    JSValue element = decode(depth + 1);
+                    if (JS_IsException(element) ||
+                        JS_DefinePropertyValueUint32(ctx, array, static_cast<uint32_t>(i), element, JS_PROP_C_W_E) < 0) {
+                        JS_FreeValue(ctx, array);
+                        array = JS_EXCEPTION;
+                    }
+                }
+                return array;
+            }
+            case kTagObject: {
+                uint64_t count = r.count();
+                if (r.failed) {
+                    return corrupt();
+                }
+                JSValue object = JS_NewObject(ctx);
+                for (uint64_t i = 0; i < count && !JS_IsException(object); i++) {
+                    JSAtom key = readKey();
+                    JSValue prop = key == JS_ATOM_NULL ? JS_EXCEPTION : decode(depth + 1);
+                    if (JS_IsException(prop) || JS_DefinePropertyValue(ctx, object, key, prop, JS_PROP_C_W_E) < 0) {
+                        JS_FreeValue(ctx, object);
+                        object = JS_EXCEPTION;
+                    }
+                }
+                return object;
+            }
+            case kTagArrayBuffer: {
+                uint64_t n = r.varint();
+                const uint8_t* data = r.bytes(n);
+                return r.failed ? corrupt() : JS_NewArrayBufferCopy(ctx, data, n);
+            }
+            case kTagTypedArray: {
+                uint8_t kind = r.byte();
+                uint64_t n = r.varint();
+                const uint8_t* data = r.bytes(n);
+                int type = jsTypedArrayType(kind);
+                if (r.failed || type < 0 || n % elementSize(kind) != 0) {
+                    return corrupt();
+                }
+                JSValue buffer = JS_NewArrayBufferCopy(ctx, data, n);
+                if (JS_IsException(buffer)) {
+                    return buffer;
+                }
+                JSValue array = JS_NewTypedArray(ctx, 1, &buffer, static_cast<JSTypedArrayEnum>(type));
+                JS_FreeValue(ctx, buffer);
+                return array;
+            }
+            default:
+                return corrupt();
+        }
+    }
+
+    Reader r;
+
+private:
+    JSAtom readKey() {
+        uint64_t index = r.varint();
+        if (r.failed) {
+            corrupt();
+            return JS_ATOM_NULL;
+        }
+        if (index > 0) {
+            if (index > keys.size()) {
+                corrupt();
+                return JS_ATOM_NULL;
+            }
+            return keys[index - 1];
+        }
+        uint64_t n = r.varint();
+        const uint8_t* s = r.bytes(n);
+        if (r.failed) {
+            corrupt();
+            return JS_ATOM_NULL;
+        }
+        JSAtom atom = JS_NewAtomLen(ctx, reinterpret_cast<const char *>(s), n);
+        if (atom != JS_ATOM_NULL) {
+            keys.push_back(atom);
+        }
+        return atom;
+    }
+
+    JSValue corrupt() {
+        if (!JS_HasException(ctx)) {
+            JS_ThrowSyntaxError(ctx, "wire format: malformed message");
+        }
+        return JS_EXCEPTION;
+    }
+
+    JSContext* ctx;
+    // JS_DefinePropertyValue does not take the atom; dictionary atoms are freed on destruction
+    std::vector<JSAtom> keys;
+};
+
+bool readHeader(Reader& r) {
+    return r.byte() == kWireMagic && r.byte() == kWireVersion && !r.failed;
+}
+
+} // namespace
+
+uint8_t* wireEncodeJSValue(JSContext* ctx, JSValueConst value, size_t* length) {
+    JSEncoder encoder(ctx);
+    encoder.w.byte(kWireMagic);
+    encoder.w.byte(kWireVersion);
+    if (!encoder.encode(value, 0)) {
+        return nullptr;
+    }
+    return reinterpret_cast<uint8_t*>(encoder.release(length));
+}
+
+JSValue wireDecodeJSValue(JSContext* ctx, const uint8_t* data, size_t length) {
+    JSDecoder decoder(ctx, data, length);
+    if (!readHeader(decoder.r)) {
+        return JS_ThrowSyntaxError(ctx, "wire format: unsupported header");
+    }
+    JSValue value = decoder.decode(0);
+    if (!JS_IsException(value) && !decoder.r.atEnd()) {
+        JS_FreeValue(ctx, value);
+        return JS_ThrowSyntaxError(ctx, "wire format: trailing bytes");
+    }
+    return value;
+}
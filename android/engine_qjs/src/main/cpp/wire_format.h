@@ -0,0 +1,42 @@
+#ifndef DIMINA_ANDROID_WIRE_FORMAT_H
+#define DIMINA_ANDROID_WIRE_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include "quickjs.h"
+
+// Binary encoding for bridge messages, saving a JSON stringify/parse on each side.
+// The same format is used by the HarmonyOS engine and by WireFormat.kt.
+//
+//   message := 0xD1 version(1) value
+//   value   := tag payload
+//   0x00 undefined   0x01 null   0x02 false   0x03 true
+//   0x04 int         zigzag varint, only for integers in int32 range
+//   0x05 double      8 bytes little-endian
+//   0x06 string      varint byte length + UTF-8
+//   0x07 array       varint count + values
+//   0x08 object      varint count + (key value) pairs
+//        key := varint n; n == 0 is followed by varint byte length + UTF-8 and defines the next
+//               key in order of appearance, n > 0 refers to the n-th key already defined
+//   0x09 ArrayBuffer varint byte length + raw bytes
+//   0x0A TypedArray  kind byte + varint byte length + raw bytes, kinds:
+//                    0 Int8 1 Uint8 2 Uint8Clamped 3 Int16 4 Uint16 5 Int32 6 Uint32
+//                    7 Float32 8 Float64 9 BigInt64 10 BigUint64
+//
+// JSON text never starts with 0xD1, so receivers tell the two formats apart by the first byte.
+// Like JSON.stringify, functions and symbols are skipped (null inside arrays) and cycles are
+// rejected through the nesting depth limit.
+
+static const uint8_t kWireMagic = 0xD1;
+static const uint8_t kWireVersion = 1;
+
+inline bool wireIsBinary(const void* data, size_t length) {
+    return length >= 2 && static_cast<const uint8_t*>(data)[0] == kWireMagic;
+}
+
+// Both run on the JS thread. On failure the exception is left pending on ctx.
+// The encoded buffer is malloc'ed and owned by the caller.
+uint8_t* wireEncodeJSValue(JSContext* ctx, JSValueConst value, size_t* length);
+JSValue wireDecodeJSValue(JSContext* ctx, const uint8_t* data, size_t length);
+
+#endif // DIMINA_ANDROID_WIRE_FORMAT_H
@@ -3,9 +3,11 @@ package com.didi.dimina.engine.qjs
 import android.os.Handler
 import android.os.Looper
 import android.util.Log
+import org.json.JSONArray
 import org.json.JSONObject
 import java.util.concurrent.ConcurrentHashMap
 import java.util.concurrent.CountDownLatch
+import java.util.concurrent.Executors
 import java.util.concurrent.LinkedBlockingQueue
 import java.util.concurrent.TimeUnit
 import java.util.concurrent.atomic.AtomicInteger
@@ -39,6 +41,18 @@ class QuickJSEngine {
      */
     private var isRunning = false
 
+    /**
+     * Whether bridge messages use the binary wire format, see [setWireFormat]
+     */
+    @Volatile
+    private var binaryWire = false
+
+    /**
+     * Whether the engine is in background mode, see [suspendEngine]. Only written on the JS thread.
+     */
+    @Volatile
+    private var suspended = false
+
     /**
      * Handler for main thread callbacks
      */
@@ -73,17 +87,36 @@ class QuickJSEngine {
         // Map to store all active engine instances by ID
         private val engineInstances = ConcurrentHashMap<Int, QuickJSEngine>()
 
+        // Runs invoke callbacks for DiminaServiceBridge.invokeAsync off the JS threads
+        private val invokeAsyncExecutor = Executors.newCachedThreadPool { runnable ->
+            Thread(runnable, "JSInvokeAsync").apply { isDaemon = true }
+        }
+
         // Get an engine instance by ID
         @JvmStatic
         fun getInstanceById(id: Int): QuickJSEngine? {
             return engineInstances[id]
         }
+
+        /**
+         * Set the directory used to cache compiled bytecode for files loaded with evaluateFromFile.
+         * Entries are keyed by content hash and QuickJS version; pass an empty path to disable caching.
+         */
+        @JvmStatic
+        fun setCodeCacheDirectory(path: String) {
+            nativeSetCodeCacheDir(path)
+        }
+
+        @JvmStatic
+        private external fun nativeSetCodeCacheDir(path: String)
     }
 
     /**
      * Task class for JavaScript operations
      */
     private abstract class JSTask<T> {
+        // Same clock as the native side (CLOCK_MONOTONIC), used for queue wait statistics
+        val enqueuedAtNanos = System.nanoTime()
         val result = AtomicReference<T?>(null)
         val latch = CountDownLatch(1)
         var error: String? = null
@@ -106,6 +139,14 @@ class QuickJSEngine {
         }
     }
 
+    /**
+     * Queued only to wake the JS thread so a posted invokeAsync result is settled without
+     * waiting for the poll timeout; executing it does nothing
+     */
+    private val wakeUpTask = object : JSTask<Unit>() {
+        override fun execute(engine: QuickJSEngine) {}
+    }
+
     /**
      * Initialize and create a new QuickJS runtime and context
      * @return true if initialization was successful, false otherwise
@@ -135,12 +176,20 @@ class QuickJSEngine {
             Log.d(tag, "QuickJS engine with libuv initialized on dedicated thread (instance ID: $instanceId)")
 
             // Process tasks and run event loop
+            var microtasksPending = false
             while (isRunning) {
                 try {
-                    // Process JavaScript tasks from the queue
-                    val task = taskQueue.poll(10, TimeUnit.MILLISECONDS)
-                    if (task != null) {
+                    // Process JavaScript tasks from the queue. Don't wait if the last loop turn
+                    // ran out of microtask budget and left jobs behind, or queued immediates.
+                    // While suspended no timer can fire, so park until a task arrives.
+                    val task = when {
+                        microtasksPending -> taskQueue.poll()
+                        suspended -> taskQueue.take()
+                        else -> taskQueue.poll(10, TimeUnit.MILLISECONDS)
+                    }
+                    if (task != null && task !== wakeUpTask) {
                         try {
+                            nativeBeginTask(task.enqueuedAtNanos, taskQueue.size + 1)
                             task.execute(this)
                         } catch (e: Exception) {
                             Log.e(tag, "Error executing JS task (instance ID: $instanceId)", e)
@@ -150,7 +199,7 @@ class QuickJSEngine {
                     
                     // Run the libuv event loop to process timers and I/O
                     // This is non-blocking and will return immediately if no events
-                    nativeRunEventLoop(instanceId)
+                    microtasksPending = nativeRunEventLoop(instanceId)
                     
                 } catch (e: InterruptedException) {
                     Log.d(tag, "JavaScript thread interrupted (instance ID: $instanceId)")
@@ -203,6 +252,70 @@ class QuickJSEngine {
         return task.await() ?: JSValue.createError("Evaluation timed out")
     }
 
+    /**
+     * Deliver a JSON message to DiminaServiceBridge.onMessage.
+     * The message is parsed with JSON.parse semantics and passed to the handler directly,
+     * instead of being wrapped into a script that has to be compiled for every message.
+     * @param json The message as a JSON string
+     * @return The handler's return value
+     */
+    fun dispatchMessage(json: String): JSValue {
+        if (!isRunning) {
+            return JSValue.createError("Engine not initialized")
+        }
+
+        val task = object : JSTask<JSValue>() {
+            override fun execute(engine: QuickJSEngine) {
+                try {
+                    val result = engine.nativeDispatchMessage(json)
+                    complete(result)
+                } catch (e: Exception) {
+                    Log.e(tag, "Error dispatching message", e)
+                    complete(JSValue.createError("Error: ${e.message}"))
+                }
+            }
+        }
+
+        taskQueue.offer(task)
+        return task.await() ?: JSValue.createError("Dispatch timed out")
+    }
+
+    /**
+     * Dispatch a message object to DiminaServiceBridge.onMessage. Once [setWireFormat] has turned
+     * on the binary format it is encoded with [WireFormat] instead of going through JSON text.
+     * @param msg The message
+     * @return The handler's return value
+     */
+    fun dispatchMessage(msg: JSONObject): JSValue {
+        if (!binaryWire) {
+            return dispatchMessage(msg.toString())
+        }
+        if (!isRunning) {
+            return JSValue.createError("Engine not initialized")
+        }
+
+        val bytes = try {
+            WireFormat.encode(msg)
+        } catch (e: IllegalArgumentException) {
+            Log.e(tag, "Error encoding message", e)
+            return JSValue.createError("Error: ${e.message}")
+        }
+        val task = object : JSTask<JSValue>() {
+            override fun execute(engine: QuickJSEngine) {
+                try {
+                    val result = engine.nativeDispatchMessageBinary(bytes)
+                    complete(result)
+                } catch (e: Exception) {
+                    Log.e(tag, "Error dispatching message", e)
+                    complete(JSValue.createError("Error: ${e.message}"))
+                }
+            }
+        }
+
+        taskQueue.offer(task)
+        return task.await() ?: JSValue.createError("Dispatch timed out")
+    }
+
     /**
      * Evaluate JavaScript code from a file path and return the result
      * @param filePath The path to the JavaScript file to evaluate
@@ -301,8 +414,9 @@ class QuickJSEngine {
         // Signal the thread to stop
         isRunning = false
 
-        // Clear the task queue
+        // Clear the task queue, and wake the thread in case it is parked while suspended
         taskQueue.clear()
+        taskQueue.offer(wakeUpTask)
 
         // Wait for the thread to finish
         jsThread?.join(1000)
@@ -322,6 +436,106 @@ class QuickJSEngine {
         Log.d(tag, "QuickJS engine destroyed (instance ID: $instanceId)")
     }
 
+    /**
+     * Put the engine in background mode while its mini-program is hidden. All timers, intervals
+     * included, stop with their remaining time kept, immediates stop running and the JS thread
+     * blocks until a task arrives instead of polling. Pending publishes are flushed and a full GC
+     * runs. Tasks such as [dispatchMessage] still execute. Safe to call from any thread.
+     */
+    fun suspendEngine() {
+        taskQueue.offer(object : JSTask<Unit>() {
+            override fun execute(engine: QuickJSEngine) {
+                nativeSuspend()
+                suspended = true
+                complete(Unit)
+            }
+        })
+    }
+
+    /**
+     * Leave background mode. Timers continue with the time they had left when suspended, so
+     * the hidden period doesn't count and missed interval ticks are not replayed.
+     * Safe to call from any thread.
+     */
+    fun resumeEngine() {
+        taskQueue.offer(object : JSTask<Unit>() {
+            override fun execute(engine: QuickJSEngine) {
+                suspended = false
+                nativeResume()
+                complete(Unit)
+            }
+        })
+    }
+
+    /**
+     * Task pipeline statistics: queue wait, eval time and microtask drain time histograms
+     * (microseconds), queue depth and throughput. Reads native counters directly, so it can be
+     * polled from any thread without queuing work onto the JS thread.
+     * @return The statistics, or null if the engine is not running
+     */
+    fun getEngineStats(): JSONObject? {
+        val json = nativeGetEngineStats() ?: return null
+        return JSONObject(json)
+    }
+
+    /**
+     * Limit how much Promise work runs in one drain, so a long promise chain can't starve timers
+     * and queued tasks. Leftover jobs continue on the next event loop turn.
+     * @param maxJobs Maximum jobs per drain, 0 keeps the current value (default 1000)
+     * @param maxTimeMs Maximum time per drain in milliseconds, 0 keeps the current value (default 8)
+     */
+    fun setMicrotaskBudget(maxJobs: Int, maxTimeMs: Long) {
+        nativeSetMicrotaskBudget(maxJobs, maxTimeMs * 1000)
+    }
+
+    /**
+     * Coalesce publishes made during one event loop turn into one main-thread post per page.
+     * A page's batch is handed over early once it reaches [maxBytes], and all batches once the
+     * oldest pending message has waited [deadlineMs]. Callbacks still see one message per call.
+     * @param enabled Whether to batch publishes (default false)
+     * @param maxBytes Size threshold per page in bytes, 0 disables it (default 256 KB)
+     * @param deadlineMs Maximum wait in milliseconds, 0 disables it (default 16)
+     */
+    fun setPublishBatching(enabled: Boolean, maxBytes: Int = 256 * 1024, deadlineMs: Long = 16) {
+        nativeSetPublishBatching(enabled, maxBytes, deadlineMs * 1000)
+    }
+
+    /**
+     * With publish batching on, hold the batches until the next animation frame and hand them
+     * over right after the requestAnimationFrame callbacks, so each page gets at most one
+     * publish call per frame. The size and deadline thresholds of [setPublishBatching] still
+     * flush early. While suspended batches are flushed every loop turn as usual.
+     * @param enabled Whether to align publish flushes to frames (default false)
+     */
+    fun setFrameAlignedPublish(enabled: Boolean) {
+        nativeSetFrameAlignedPublish(enabled)
+    }
+
+    /**
+     * Drive requestAnimationFrame from the display: call on every vsync, typically from a
+     * Choreographer.FrameCallback. Vsyncs the JS thread hasn't caught up with collapse into
+     * the latest one. Without vsync for 100 ms the engine paces frames itself at 60 Hz.
+     * Safe to call from any thread.
+     * @param frameTimeNanos Frame time on the System.nanoTime() clock, 0 for now; callbacks
+     * receive it in milliseconds
+     */
+    fun onVsync(frameTimeNanos: Long = 0) {
+        if (nativeOnVsync(frameTimeNanos)) {
+            taskQueue.offer(wakeUpTask)
+        }
+    }
+
+    /**
+     * Exchange bridge messages in the binary [WireFormat] instead of JSON text: invoke messages
+     * from JS, and messages passed to [dispatchMessage] as a JSONObject. Callbacks still receive
+     * JSONObjects either way.
+     * @param binary Whether to use the binary format (default false)
+     */
+    fun setWireFormat(binary: Boolean) {
+        binaryWire = binary
+        nativeSetWireFormat(binary)
+    }
+
     /**
      * Check if the engine is initialized
      * @return true if the engine is initialized, false otherwise
@@ -336,7 +550,19 @@ class QuickJSEngine {
     private external fun nativeInitialize(instanceId: Int): Boolean
     private external fun nativeEvaluate(script: String, instanceId: Int = this.instanceId): JSValue
     private external fun nativeEvaluateFromFile(filePath: String, instanceId: Int = this.instanceId): JSValue
-    private external fun nativeRunEventLoop(instanceId: Int = this.instanceId)
+    private external fun nativeDispatchMessage(json: String, instanceId: Int = this.instanceId): JSValue
+    private external fun nativeDispatchMessageBinary(bytes: ByteArray, instanceId: Int = this.instanceId): JSValue
+    private external fun nativeBeginTask(enqueuedAtNanos: Long, queueDepth: Int, instanceId: Int = this.instanceId)
+    private external fun nativeGetEngineStats(instanceId: Int = this.instanceId): String?
+    private external fun nativeRunEventLoop(instanceId: Int = this.instanceId): Boolean
+    private external fun nativeResolveInvokeAsync(callId: Int, result: JSValue?, instanceId: Int = this.instanceId)
+    private external fun nativeSetMicrotaskBudget(maxJobs: Int, maxTimeUs: Long, instanceId: Int = this.instanceId)
+    private external fun nativeSetPublishBatching(enabled: Boolean, maxBytes: Int, deadlineUs: Long, instanceId: Int = this.instanceId)
+    private external fun nativeSetWireFormat(binary: Boolean, instanceId: Int = this.instanceId)
+    private external fun nativeSetFrameAlignedPublish(enabled: Boolean, instanceId: Int = this.instanceId)
+    private external fun nativeOnVsync(frameTimeNanos: Long, instanceId: Int = this.instanceId): Boolean
+    private external fun nativeSuspend(instanceId: Int = this.instanceId)
+    private external fun nativeResume(instanceId: Int = this.instanceId)
     private external fun nativeStopEventLoop(instanceId: Int = this.instanceId)
     private external fun nativeDestroy(instanceId: Int)
 
@@ -378,6 +604,25 @@ class QuickJSEngine {
         return invokeCallbacks[id]?.invoke(msg)
     }
 
+    /**
+     * Called from DiminaServiceBridge.invokeAsync on the JS thread. The invoke callback runs on a
+     * background thread so the JS thread keeps working; its result settles the promise in the
+     * engine's event loop. A thrown exception rejects it.
+     */
+    @Suppress("unused")
+    fun invokeAsyncFromJS(callId: Int, msg: JSONObject) {
+        invokeAsyncExecutor.execute {
+            val result = try {
+                invokeFromJS(msg)
+            } catch (e: Exception) {
+                Log.e(tag, "invokeAsync callback failed (instance ID: $instanceId)", e)
+                JSValue.createError(e.message ?: "invokeAsync failed")
+            }
+            nativeResolveInvokeAsync(callId, result)
+            taskQueue.offer(wakeUpTask)
+        }
+    }
+
     @Suppress("unused")
     fun publishFromJS(id: String, msg: JSONObject) {
         Log.d(tag, "Received publish from JavaScript: id=$id, message=$msg")
@@ -386,6 +631,21 @@ class QuickJSEngine {
         }
     }
 
+    /**
+     * Called with the publishes batched for one page, as a JSON array in the order JS sent them.
+     */
+    @Suppress("unused")
+    fun publishBatchFromJS(id: String, msgs: String) {
+        val batch = JSONArray(msgs)
+        Log.d(tag, "Received publish batch from JavaScript: id=$id, count=${batch.length()}")
+        mainHandler.post {
+            val callback = publishCallbacks[id] ?: return@post
+            for (i in 0 until batch.length()) {
+                callback.invoke(batch.getJSONObject(i))
+            }
+        }
+    }
+
     // Note: Timer and interval scheduling is now handled entirely by libuv in native code
     // The scheduleTimer, clearTimer, scheduleInterval, and clearInterval methods are no longer needed
     // as setTimeout/setInterval in JavaScript directly use libuv timers
@@ -0,0 +1,260 @@
+package com.didi.dimina.engine.qjs
+
+import org.json.JSONArray
+import org.json.JSONObject
+import java.io.ByteArrayOutputStream
+
+/**
+ * Binary wire format for bridge messages, the Kotlin side of wire_format.h.
+ * Values map to org.json types: JSONObject, JSONArray, String, Boolean, Int, Double and
+ * JSONObject.NULL. ArrayBuffers and typed arrays are decoded to their raw bytes as ByteArray,
+ * and a ByteArray is encoded as an ArrayBuffer.
+ */
+object WireFormat {
+    private const val MAGIC = 0xD1
+    private const val VERSION = 1
+
+    private const val TAG_UNDEFINED = 0x00
+    private const val TAG_NULL = 0x01
+    private const val TAG_FALSE = 0x02
+    private const val TAG_TRUE = 0x03
+    private const val TAG_INT = 0x04
+    private const val TAG_DOUBLE = 0x05
+    private const val TAG_STRING = 0x06
+    private const val TAG_ARRAY = 0x07
+    private const val TAG_OBJECT = 0x08
+    private const val TAG_ARRAY_BUFFER = 0x09
+    private const val TAG_TYPED_ARRAY = 0x0A
+
+    private const val MAX_DEPTH = 128
+
+    fun isBinary(bytes: ByteArray): Boolean {
+        return bytes.size >= 2 && (bytes[0].toInt() and 0xFF) == MAGIC
+    }
+
+    /**
+     * Encode a message for QuickJSEngine.dispatchMessage.
+     * @throws IllegalArgumentException for values JSON can't carry either, or nesting deeper than 128
+     */
+    fun encode(value: Any?): ByteArray {
+        val writer = Writer()
+        writer.out.write(MAGIC)
+        writer.out.write(VERSION)
+        writer.write(value, 0)
+        return writer.out.toByteArray()
+    }
+
+    /**
+     * Decode a message encoded by the engine.
+     * @throws IllegalArgumentException if the bytes are not a well-formed message
+     */
+    fun decode(bytes: ByteArray): Any? {
+        val reader = Reader(bytes)
+        require(reader.byte() == MAGIC && reader.byte() == VERSION) { "wire format: unsupported header" }
+        val value = reader.read(0)
+        require(reader.atEnd()) { "wire format: trailing bytes" }
+        return value
+    }
+
+    /**
+     * Called from native code for invoke messages, which are always objects.
+     */
+    @JvmStatic
+    fun decodeObject(bytes: ByteArray): JSONObject {
+        return decode(bytes) as? JSONObject ?: throw IllegalArgumentException("wire format: not an object")
+    }
+
+    private class Writer {
+        val out = ByteArrayOutputStream(256)
+        private val keys = HashMap<String, Int>()
+
+        fun write(value: Any?, depth: Int) {
+            require(depth < MAX_DEPTH) { "wire format: object nested too deeply or circular" }
+            when (value) {
+                null, JSONObject.NULL -> out.write(TAG_NULL)
+                is Boolean -> out.write(if (value) TAG_TRUE else TAG_FALSE)
+                is Int, is Short, is Byte -> int((value as Number).toInt())
+                is Long -> if (value in Int.MIN_VALUE..Int.MAX_VALUE) int(value.toInt()) else number(value.toDouble())
+                is Number -> number(value.toDouble())
+                is String -> string(value)
+                is ByteArray -> {
+                    out.write(TAG_ARRAY_BUFFER)
+                    varint(value.size.toLong())
+                    out.write(value)
+                }
+                is JSONArray -> {
+                    out.write(TAG_ARRAY)
+                    varint(value.length().toLong())
+                    for (i in 0 until value.length()) {
+                        write(value.opt(i), depth + 1)
+                    }
+                }
+                is JSONObject -> {
+                    out.write(TAG_OBJECT)
+                    varint(value.length().toLong())
+                    for (key in value.keys()) {
+                        writeKey(key)
+                        write(value.opt(key), depth + 1)
+                    }
+                }
+                is Map<*, *> -> write(JSONObject(value), depth)
+                is Collection<*> -> write(JSONArray(value), depth)
+                else -> string(value.toString())
+            }
+        }
+
+        private fun int(n: Int) {
+            out.write(TAG_INT)
+            varint(((n shl 1) xor (n shr 31)).toLong() and 0xFFFFFFFFL)
+        }
+
+        private fun number(d: Double) {
+            if (d.isNaN() || d.isInfinite()) {
+                out.write(TAG_NULL)
+                return
+            }
+            if (d >= Int.MIN_VALUE && d <= Int.MAX_VALUE && d == Math.floor(d) &&
+                !(d == 0.0 && 1.0 / d < 0)) {
+                int(d.toInt())
+                return
+            }
+            out.write(TAG_DOUBLE)
+            val bits = java.lang.Double.doubleToRawLongBits(d)
+            for (i in 0 until 8) {
+                out.write((bits ushr (i * 8)).toInt() and 0xFF)
+            }
+        }
+
+        private fun string(s: String) {
+            out.write(TAG_STRING)
+            utf8(s)
+        }
+
+        private fun writeKey(key: String) {
+            val index = keys[key]
+            if (index != null) {
+                varint(index.toLong())
+                return
+            }
+            varint(0)
+            utf8(key)
+            keys[key] = keys.size + 1
+        }
+
+        private fun utf8(s: String) {
+            val bytes = s.toByteArray(Charsets.UTF_8)
+            varint(bytes.size.toLong())
+            out.write(bytes)
+        }
+
+        private fun varint(value: Long) {
+            var v = value
+            while (v >= 0x80) {
+                out.write(((v and 0x7F) or 0x80).toInt())
+                v = v ushr 7
+            }
+            out.write(v.toInt())
+        }
+    }
+
+    private class Reader(private val bytes: ByteArray) {
+        private var pos = 0
+        private val keys = ArrayList<String>()
+
+        fun atEnd(): Boolean = pos == bytes.size
+
+        fun byte(): Int {
+            require(pos < bytes.size) { "wire format: truncated message" }
+            return bytes[pos++].toInt() and 0xFF
+        }
+
+        fun read(depth: Int): Any? {
+            require(depth < MAX_DEPTH) { "wire format: nested too deeply" }
+            return when (val tag = byte()) {
+                TAG_UNDEFINED, TAG_NULL -> JSONObject.NULL
+                TAG_FALSE -> false
+                TAG_TRUE -> true
+                TAG_INT -> {
+                    val n = varint()
+                    ((n ushr 1) xor -(n and 1)).toInt()
+                }
+                TAG_DOUBLE -> {
+                    var bits = 0L
+                    for (i in 0 until 8) {
+                        bits = bits or (byte().toLong() shl (i * 8))
+                    }
+                    java.lang.Double.longBitsToDouble(bits)
+                }
+                TAG_STRING -> utf8()
+                TAG_ARRAY -> {
+                    val count = count()
+                    val array = JSONArray()
+                    for (i in 0 until count) {
+                        array.put(read(depth + 1))
+                    }
+                    array
+                }
+                TAG_OBJECT -> {
+                    val count = count()
+                    val obj = JSONObject()
+                    for (i in 0 until count) {
+                        val key = readKey()
+                        obj.put(key, read(depth + 1))
+                    }
+                    obj
+                }
+                TAG_ARRAY_BUFFER -> raw(varint())
+                TAG_TYPED_ARRAY -> {
+                    require(byte() <= 10) { "wire format: unknown typed array kind" }
+                    raw(varint())
+                }
+                else -> throw IllegalArgumentException("wire format: unknown tag $tag")
+            }
+        }
+
+        private fun readKey(): String {
+            val index = varint()
+            if (index > 0) {
+                require(index <= keys.size) { "wire format: bad key reference" }
+                return keys[(index - 1).toInt()]
+            }
+            return utf8().also { keys.add(it) }
+        }
+
+        private fun utf8(): String {
+            val n = length(varint())
+            val s = String(bytes, pos, n, Charsets.UTF_8)
+            pos += n
+            return s
+        }
+
+        private fun raw(size: Long): ByteArray {
+            val n = length(size)
+            val data = bytes.copyOfRange(pos, pos + n)
+            pos += n
+            return data
+        }
+
+        // Every element takes at least one byte, so a count above the remaining bytes is corrupt
+        private fun count(): Int = length(varint())
+
+        private fun length(n: Long): Int {
+            require(n >= 0 && n <= bytes.size - pos) { "wire format: truncated message" }
+            return n.toInt()
+        }
+
+        private fun varint(): Long {
+            var value = 0L
+            var shift = 0
+            while (shift < 64) {
+                val b = byte()
+                value = value or ((b and 0x7F).toLong() shl shift)
+                if ((b and 0x80) == 0) {
+                    return value
+                }
+                shift += 7
+            }
+            throw IllegalArgumentException("wire format: bad varint")
+        }
+    }
+}
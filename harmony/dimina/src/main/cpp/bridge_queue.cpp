@@ -0,0 +1,232 @@
+//
+// Created on 2026/10/16.
+//
+
+#include "bridge_queue.h"
+#include "log.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <uv.h>
+
+void BridgeQueue::configure(uint32_t invokeLimit, uint32_t publishLimit, uint32_t logLimit) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats[static_cast<int>(BridgeMessageKind::Invoke)].limit.store(invokeLimit, std::memory_order_relaxed);
+        stats[static_cast<int>(BridgeMessageKind::Publish)].limit.store(publishLimit, std::memory_order_relaxed);
+        stats[static_cast<int>(BridgeMessageKind::Log)].limit.store(logLimit, std::memory_order_relaxed);
+        closed = false;
+    }
+    // 上限可能调大了，等着的 invoke 重新看一眼
+    roomAvailable.notify_all();
+}
+
+void BridgeQueue::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+    }
+    roomAvailable.notify_all();
+}
+
+void BridgeQueue::resetStats() {
+    for (BridgeQueueCounters &counter : stats) {
+        counter.maxInFlight.store(counter.inFlight.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        counter.stalls.store(0, std::memory_order_relaxed);
+        counter.stallUs.store(0, std::memory_order_relaxed);
+        counter.overLimit.store(0, std::memory_order_relaxed);
+        counter.dropped.store(0, std::memory_order_relaxed);
+        counter.coalesced.store(0, std::memory_order_relaxed);
+    }
+}
+
+BridgeMessageKind BridgeQueue::kindOf(int type) {
+    switch (type) {
+        case 1: return BridgeMessageKind::Invoke;
+        case 3: return BridgeMessageKind::Log;
+        default: return BridgeMessageKind::Publish;
+    }
+}
+
+bool BridgeQueue::hasRoom(BridgeMessageKind kind) const {
+    const BridgeQueueCounters &counter = stats[static_cast<int>(kind)];
+    uint32_t limit = counter.limit.load(std::memory_order_relaxed);
+    return limit == 0 || counter.inFlight.load(std::memory_order_relaxed) < limit;
+}
+
+void BridgeQueue::taken(BridgeMessageKind kind) {
+    BridgeQueueCounters &counter = stats[static_cast<int>(kind)];
+    uint64_t inFlight = counter.inFlight.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (inFlight > counter.maxInFlight.load(std::memory_order_relaxed)) {
+        counter.maxInFlight.store(inFlight, std::memory_order_relaxed);
+    }
+}
+
+const char *BridgeQueue::post(napi_threadsafe_function tsfn, std::unique_ptr<OnMessageData> &message) {
+    BridgeMessageKind kind = kindOf(message->type);
+    BridgeQueueCounters &counter = stats[static_cast<int>(kind)];
+    std::unique_lock<std::mutex> lock(mutex);
+    switch (kind) {
+        case BridgeMessageKind::Invoke:
+            if (!closed && !hasRoom(kind) && !mayBlock.load(std::memory_order_relaxed)) {
+                counter.overLimit.fetch_add(1, std::memory_order_relaxed);
+            } else if (!closed && !hasRoom(kind)) {
+                uint64_t startNs = uv_hrtime();
+                counter.stalls.fetch_add(1, std::memory_order_relaxed);
+                roomAvailable.wait(lock, [this, kind] { return closed || hasRoom(kind); });
+                counter.stallUs.fetch_add((uv_hrtime() - startNs) / 1000, std::memory_order_relaxed);
+            }
+            if (closed) {
+                return "bridge is shutting down";
+            }
+            break;
+        case BridgeMessageKind::Publish: {
+            // 这个页面已经有攒着的，后来的必须排在它后面，有没有名额都并进去
+            auto it = std::find_if(pendingPublishes.begin(), pendingPublishes.end(),
+                                   [&](const PendingPublish &p) { return p.webViewId == message->webViewId; });
+            if (it == pendingPublishes.end() && hasRoom(kind)) {
+                break;
+            }
+            if (it == pendingPublishes.end()) {
+                pendingPublishes.push_back(
+                    PendingPublish{message->webViewId, message->appIndex, nullptr, 0, 0, 0});
+                it = pendingPublishes.end() - 1;
+            }
+            if (!coalesce(*it, *message)) {
+                if (it->count == 0) {
+                    pendingPublishes.erase(it);
+                }
+                return "failed to coalesce publish";
+            }
+            counter.coalesced.fetch_add(message->count, std::memory_order_relaxed);
+            message.reset();
+            return nullptr;
+        }
+        case BridgeMessageKind::Log:
+            if (!hasRoom(kind)) {
+                counter.dropped.fetch_add(1, std::memory_order_relaxed);
+                if (queuedLogs.empty()) {
+                    // 积压的都已经在处理了，挤不掉别的，丢这一条
+                    message.reset();
+                    return nullptr;
+                }
+                // 外壳还在 threadsafe function 的队列里，先把内容释放掉，名额让给新的
+                OnMessageData *oldest = queuedLogs.front();
+                queuedLogs.pop_front();
+                oldest->dropped = true;
+                oldest->payload.reset();
+                counter.inFlight.fetch_sub(1, std::memory_order_relaxed);
+            }
+            break;
+    }
+    return enqueue(tsfn, message);
+}
+
+// 持锁调用。napi_call_threadsafe_function 在锁里做，和 done 里投攒着的 publish 互斥，同一页面的顺序才有保证
+const char *BridgeQueue::enqueue(napi_threadsafe_function tsfn, std::unique_ptr<OnMessageData> &message) {
+    if (napi_acquire_threadsafe_function(tsfn) != napi_ok) {
+        // acquire 都没成功就不要再往下调用了，句柄可能已经在关闭。
+        return "bridge is shutting down";
+    }
+    BridgeMessageKind kind = kindOf(message->type);
+    message->queue = shared_from_this();
+    // 上限由这边控制，threadsafe function 本身不限长度，非阻塞调用不会因为队列满失败
+    if (napi_call_threadsafe_function(tsfn, message.get(), napi_tsfn_nonblocking) != napi_ok) {
+        // 非 napi_ok 表示没入队，所有权还在调用方
+        message->queue.reset();
+        return "failed to post message to the container";
+    }
+    taken(kind);
+    if (kind == BridgeMessageKind::Log) {
+        queuedLogs.push_back(message.get());
+    }
+    message.release();
+    return nullptr;
+}
+
+bool BridgeQueue::coalesce(PendingPublish &pending, const OnMessageData &message) {
+    // type 4 本身是 "[a,b]"，去掉外层的方括号再拼
+    const char *element = message.payload.get();
+    size_t length = message.length;
+    if (message.type == 4 && length >= 2) {
+        element++;
+        length -= 2;
+    }
+    // 第一条：'[' + 内容 + ']' + '\0'；之后：末尾的 ']' 换成 ',' + 内容 + ']' + '\0'
+    size_t needed = pending.length + length + (pending.count == 0 ? 3 : 2);
+    if (needed > pending.capacity) {
+        size_t capacity = pending.capacity * 2 > needed ? pending.capacity * 2 : needed;
+        char *data = static_cast<char *>(std::realloc(pending.data.get(), capacity));
+        if (!data) {
+            return false;
+        }
+        pending.data.release();
+        pending.data.reset(data);
+        pending.capacity = capacity;
+    }
+    char *tail = pending.data.get() + pending.length;
+    if (pending.count == 0) {
+        *tail++ = '[';
+    } else {
+        tail[-1] = ',';
+    }
+    std::memcpy(tail, element, length);
+    tail += length;
+    *tail++ = ']';
+    *tail = '\0';
+    pending.length = tail - pending.data.get();
+    pending.count += message.count;
+    return true;
+}
+
+bool BridgeQueue::begin(OnMessageData *message) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (message->dropped) {
+        return false;
+    }
+    if (message->type == 3) {
+        auto it = std::find(queuedLogs.begin(), queuedLogs.end(), message);
+        if (it != queuedLogs.end()) {
+            queuedLogs.erase(it);
+        }
+    }
+    return true;
+}
+
+void BridgeQueue::done(int type, napi_threadsafe_function tsfn) {
+    BridgeMessageKind kind = kindOf(type);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats[static_cast<int>(kind)].inFlight.fetch_sub(1, std::memory_order_relaxed);
+        if (kind == BridgeMessageKind::Publish) {
+            postPending(tsfn);
+        }
+    }
+    if (kind == BridgeMessageKind::Invoke) {
+        roomAvailable.notify_all();
+    }
+}
+
+// 持锁调用，在 ArkTS 线程上
+void BridgeQueue::postPending(napi_threadsafe_function tsfn) {
+    BridgeQueueCounters &counter = stats[static_cast<int>(BridgeMessageKind::Publish)];
+    while (!pendingPublishes.empty() && hasRoom(BridgeMessageKind::Publish)) {
+        PendingPublish pending = std::move(pendingPublishes.front());
+        pendingPublishes.erase(pendingPublishes.begin());
+        const char *error = "bridge is not available";
+        if (tsfn) {
+            std::unique_ptr<OnMessageData> message(new OnMessageData());
+            message->type = 4;
+            message->webViewId = pending.webViewId;
+            message->appIndex = pending.appIndex;
+            message->payload = std::move(pending.data);
+            message->length = pending.length;
+            message->count = pending.count;
+            error = enqueue(tsfn, message);
+        }
+        if (error) {
+            OHError("coalesced publish dropped %{public}u messages: %{public}s", pending.count, error);
+            counter.dropped.fetch_add(pending.count, std::memory_order_relaxed);
+        }
+    }
+}
@@ -0,0 +1,136 @@
+//
+// Created on 2026/10/16.
+//
+// Node APIs are not fully supported. To solve the compilation error of the interface cannot be found,
+// please include "napi/native_api.h".
+
+#ifndef DIMINA_HARMONYOS_BRIDGE_QUEUE_H
+#define DIMINA_HARMONYOS_BRIDGE_QUEUE_H
+
+#include "js_thread.h"
+#include "napi/native_api.h"
+#include "quickjs.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class BridgeQueue;
+
+// JS 线程交给 ArkTS 的一条消息，经 threadsafe function 送到 onMessageCb
+struct OnMessageData {
+    napi_async_work asyncWork = nullptr;
+    napi_ref callbackRef = nullptr;
+    // 1 = invoke, 2 = publish , 3 = 日志打印, 4 = 合并后的 publish（JSON 数组）,
+    // 5 = dispatchJsTaskPath 执行完，native 自己兑现 deferred，不经过 ArkTS 回调也不走 BridgeQueue
+    int type = 1;
+    int webViewId = 0;
+    int appIndex = 0; // 添加 appIndex 字段
+    // 非 0 表示 invokeAsync：JS 线程没在等，结果通过任务队列投回，不走 promise
+    uint32_t asyncCallId = 0;
+    std::promise<JSValue> promise;
+    // JSValueToStringLen 产出的那份缓冲区，一路移交不再拷贝；publish/日志直接作为外部 ArrayBuffer 交给 ArkTS
+    OwnedCStr payload;
+    size_t length = 0;
+    // invoke 的 payload 是二进制编码，在 ArkTS 线程直接解成对象
+    bool binary = false;
+    // type 4 里合并了几条 publish
+    uint32_t count = 1;
+    // 经 BridgeQueue 投递的消息持有它，引擎销毁或者回到预热池之后照样能还名额
+    std::shared_ptr<BridgeQueue> queue;
+    // 日志被后来的挤掉了：payload 已经释放，onMessageCb 直接丢弃。受 BridgeQueue 的锁保护
+    bool dropped = false;
+    // type 5
+    napi_deferred deferred = nullptr;
+    PathLoadResult pathLoad;
+};
+
+enum class BridgeMessageKind : int {
+    Invoke = 0,
+    Publish = 1,
+    Log = 2,
+};
+constexpr int kBridgeMessageKindCount = 3;
+
+// 每种消息的计数，任意线程直接读
+struct BridgeQueueCounters {
+    std::atomic<uint32_t> limit{0};
+    // 已投递、ArkTS 还没处理完的条数
+    std::atomic<uint64_t> inFlight{0};
+    std::atomic<uint64_t> maxInFlight{0};
+    // invoke：队列满了 JS 线程等待的次数和总时长
+    std::atomic<uint64_t> stalls{0};
+    std::atomic<uint64_t> stallUs{0};
+    // invoke：不能阻塞的线程上满了照样投递、超出上限的次数
+    std::atomic<uint64_t> overLimit{0};
+    // log：被挤掉的条数
+    std::atomic<uint64_t> dropped{0};
+    // publish：没有单独投递、合并进同一页面前一批的条数
+    std::atomic<uint64_t> coalesced{0};
+};
+
+// threadsafe function 本身不限长度（max_queue_size 为 0），ArkTS 主线程跟不上时 JS 线程的
+// publish / 日志会无限堆积。这里按消息种类限制还没处理完的条数，满了按各自的策略处理：
+// - invoke：阻塞，JS 线程等到有名额（同步 invoke 本来就要等结果，这里只会挡住成批的 invokeAsync）；
+//   共享线程上的引擎不阻塞，超出上限照样投递，只计数；
+// - publish：同一个 webViewId 的合并成一批 "[m1,m2,...]"，有名额时整批投递，页面内顺序不变；
+// - log：丢掉最老的还没送到的那条。
+// limit 为 0 表示不限。名额在 onMessageCb 处理完时归还，所以限制的是 ArkTS 侧的积压。
+// 满载时不同种类之间的先后不再保证（publish 可能被后面的 invoke 超过），同一页面的 publish 保持顺序。
+class BridgeQueue : public std::enable_shared_from_this<BridgeQueue> {
+public:
+    // 任意线程调用；引擎从预热池领走时也会调，顺带解除 close
+    void configure(uint32_t invokeLimit, uint32_t publishLimit, uint32_t logLimit);
+    // 引擎销毁：唤醒等名额的 JS 线程，之后的 invoke 直接失败
+    void close();
+    void resetStats();
+    // 共享线程（sharedWorker）上的引擎设为 false：JS 线程同时跑着别的引擎，invoke 满了不等，超出上限照样投递
+    void setBlocking(bool blocking) {
+        mayBlock.store(blocking, std::memory_order_relaxed);
+    };
+
+    // 按种类的策略投递，任意线程调用。成功返回 nullptr，message 的所有权交出去（可能合并进了攒着的 publish）；
+    // 失败返回错误描述，message 还在调用方手里
+    const char *post(napi_threadsafe_function tsfn, std::unique_ptr<OnMessageData> &message);
+    // onMessageCb 开始处理时调用。返回 false 表示这条日志已被挤掉，直接释放即可，不用再调 done
+    bool begin(OnMessageData *message);
+    // onMessageCb 处理完调用，归还名额；publish 有攒着的就接着投。tsfn 为空表示引擎已注销，攒着的丢掉
+    void done(int type, napi_threadsafe_function tsfn);
+
+    const BridgeQueueCounters &counters(BridgeMessageKind kind) const {
+        return stats[static_cast<int>(kind)];
+    };
+
+private:
+    struct PendingPublish {
+        int webViewId;
+        int appIndex;
+        OwnedCStr data; // "[m1,m2,...]"
+        size_t length;
+        size_t capacity;
+        uint32_t count;
+    };
+
+    static BridgeMessageKind kindOf(int type);
+    bool hasRoom(BridgeMessageKind kind) const;
+    void taken(BridgeMessageKind kind);
+    const char *enqueue(napi_threadsafe_function tsfn, std::unique_ptr<OnMessageData> &message);
+    bool coalesce(PendingPublish &pending, const OnMessageData &message);
+    void postPending(napi_threadsafe_function tsfn);
+
+    std::mutex mutex;
+    std::condition_variable roomAvailable;
+    bool closed = false;
+    std::atomic<bool> mayBlock{true};
+    BridgeQueueCounters stats[kBridgeMessageKindCount];
+    // 按第一次被挡住的顺序排，有名额时先投最老的
+    std::vector<PendingPublish> pendingPublishes;
+    // 已投递、onMessageCb 还没拿到的日志，最老的在队头
+    std::deque<OnMessageData *> queuedLogs;
+};
+
+#endif // DIMINA_HARMONYOS_BRIDGE_QUEUE_H
@@ -0,0 +1,199 @@
+//
+// Created on 2026/10/16.
+//
+
+#include "code_cache.h"
+#include "log.h"
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+// CMake 从 cmake/DependencyVersions.cmake 传进来。升级 QuickJS 后字节码格式可能变化，
+// 旧缓存必须整体作废，所以版本号写进每个缓存文件头里校验。
+#ifndef DIMINA_QUICKJS_GIT_TAG
+#define DIMINA_QUICKJS_GIT_TAG "unknown"
+#endif
+
+namespace {
+
+constexpr char kMagic[4] = {'D', 'Q', 'J', 'C'};
+constexpr uint32_t kFormatVersion = 1;
+constexpr size_t kTagSize = 40;
+
+// 文件头后面紧跟 payloadLength 字节的 JS_WriteObject 输出。
+struct CacheHeader {
+    char magic[4];
+    uint32_t formatVersion;
+    char quickjsTag[kTagSize];
+    uint64_t sourceHash;
+    uint64_t sourceLength;
+    uint64_t payloadLength;
+    uint64_t payloadHash;
+};
+
+std::mutex gCacheDirMutex;
+std::string gCacheDir;
+
+std::string getCacheDir() {
+    std::lock_guard<std::mutex> lock(gCacheDirMutex);
+    return gCacheDir;
+}
+
+// FNV-1a：不引额外依赖，对几 MB 的 bundle 来说比一次解析便宜得多。
+uint64_t fnv1a64(const void *data, size_t length, uint64_t hash = 0xcbf29ce484222325ULL) {
+    const auto *p = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < length; i++) {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+void fillTag(char (&tag)[kTagSize]) {
+    memset(tag, 0, sizeof(tag));
+    strncpy(tag, DIMINA_QUICKJS_GIT_TAG, sizeof(tag));
+}
+
+// 文件名也参与 key：字节码里带着 filename，错误堆栈要指向真实路径。
+std::string cachePathFor(const std::string &dir, uint64_t sourceHash, const char *filename) {
+    uint64_t key = fnv1a64(filename, strlen(filename), sourceHash);
+    char name[32];
+    snprintf(name, sizeof(name), "%016" PRIx64 ".qjsc", key);
+    return dir + "/" + name;
+}
+
+bool readAll(int fd, void *buf, size_t length) {
+    auto *p = static_cast<uint8_t *>(buf);
+    while (length > 0) {
+        ssize_t n = read(fd, p, length);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        length -= n;
+    }
+    return true;
+}
+
+bool writeAll(int fd, const void *buf, size_t length) {
+    const auto *p = static_cast<const uint8_t *>(buf);
+    while (length > 0) {
+        ssize_t n = write(fd, p, length);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        length -= n;
+    }
+    return true;
+}
+
+// 读出并校验缓存，任何一项对不上都当作没命中。
+bool loadPayload(const std::string &path, uint64_t sourceHash, size_t sourceLength, std::vector<uint8_t> &payload) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    CacheHeader header;
+    char tag[kTagSize];
+    fillTag(tag);
+    bool ok = readAll(fd, &header, sizeof(header)) && memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 &&
+              header.formatVersion == kFormatVersion && memcmp(header.quickjsTag, tag, kTagSize) == 0 &&
+              header.sourceHash == sourceHash && header.sourceLength == sourceLength && header.payloadLength > 0;
+    if (ok) {
+        payload.resize(header.payloadLength);
+        ok = readAll(fd, payload.data(), payload.size()) &&
+             fnv1a64(payload.data(), payload.size()) == header.payloadHash;
+    }
+    close(fd);
+    return ok;
+}
+
+// 先写临时文件再 rename，多个引擎同时编译同一个 bundle 也不会读到写了一半的文件。
+void storePayload(const std::string &path, uint64_t sourceHash, size_t sourceLength, const uint8_t *payload,
+                  size_t payloadLength) {
+    CacheHeader header;
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.formatVersion = kFormatVersion;
+    fillTag(header.quickjsTag);
+    header.sourceHash = sourceHash;
+    header.sourceLength = sourceLength;
+    header.payloadLength = payloadLength;
+    header.payloadHash = fnv1a64(payload, payloadLength);
+
+    char suffix[48];
+    snprintf(suffix, sizeof(suffix), ".%d.%p.tmp", getpid(), (void *)&header);
+    std::string tmpPath = path + suffix;
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd == -1) {
+        OHWarn("code cache open %{public}s failed: %{public}d", tmpPath.c_str(), errno);
+        return;
+    }
+    bool ok = writeAll(fd, &header, sizeof(header)) && writeAll(fd, payload, payloadLength);
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        OHWarn("code cache write %{public}s failed: %{public}d", path.c_str(), errno);
+        unlink(tmpPath.c_str());
+    }
+}
+
+} // namespace
+
+void setCodeCacheDir(const std::string &dir) {
+    if (!dir.empty() && mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) {
+        OHWarn("code cache mkdir %{public}s failed: %{public}d", dir.c_str(), errno);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(gCacheDirMutex);
+    gCacheDir = dir;
+}
+
+JSValue evalWithCodeCache(JSContext *ctx, const char *source, size_t length, const char *filename) {
+    std::string dir = getCacheDir();
+    if (dir.empty()) {
+        return JS_Eval(ctx, source, length, filename, JS_EVAL_TYPE_GLOBAL);
+    }
+
+    uint64_t sourceHash = fnv1a64(source, length);
+    std::string path = cachePathFor(dir, sourceHash, filename);
+
+    std::vector<uint8_t> payload;
+    if (loadPayload(path, sourceHash, length, payload)) {
+        JSValue func = JS_ReadObject(ctx, payload.data(), payload.size(), JS_READ_OBJ_BYTECODE);
+        if (!JS_IsException(func)) {
+            OHLog("code cache hit %{public}s", filename);
+            // 从这里开始脚本已经在执行，出错就是脚本自己的异常，不能再回退重跑一遍。
+            return JS_EvalFunction(ctx, func);
+        }
+        // 校验都过了还读不出来，说明缓存和当前 runtime 不兼容，删掉重新编译。
+        JS_FreeValue(ctx, JS_GetException(ctx));
+    }
+    unlink(path.c_str());
+
+    JSValue func = JS_Eval(ctx, source, length, filename, JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
+    if (JS_IsException(func)) {
+        return func;
+    }
+    size_t payloadLength = 0;
+    uint8_t *bytes = JS_WriteObject(ctx, &payloadLength, func, JS_WRITE_OBJ_BYTECODE);
+    if (bytes) {
+        storePayload(path, sourceHash, length, bytes, payloadLength);
+        js_free(ctx, bytes);
+    } else {
+        // 写缓存是锦上添花，序列化失败也照常执行脚本。
+        JS_FreeValue(ctx, JS_GetException(ctx));
+    }
+    return JS_EvalFunction(ctx, func);
+}
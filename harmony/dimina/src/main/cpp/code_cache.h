@@ -0,0 +1,23 @@
+//
+// Created on 2026/10/16.
+//
+// Node APIs are not fully supported. To solve the compilation error of the interface cannot be found,
+// please include "napi/native_api.h".
+
+#ifndef DIMINA_HARMONYOS_CODE_CACHE_H
+#define DIMINA_HARMONYOS_CODE_CACHE_H
+
+#include "quickjs.h"
+#include <cstddef>
+#include <string>
+
+// 字节码缓存目录，空串表示关闭缓存。所有引擎共用一个目录，可以在任意线程设置。
+void setCodeCacheDir(const std::string &dir);
+
+// 和 JS_Eval(JS_EVAL_TYPE_GLOBAL) 同一个约定：返回脚本的执行结果，出错时返回 JS_EXCEPTION 并把异常挂在 ctx 上。
+// 缓存命中时跳过解析和编译，直接 JS_ReadObject + JS_EvalFunction；缓存缺失、过期或损坏时
+// 回退到源码编译，并把新的字节码写回磁盘。
+// 和 JS_Eval 一样，source[length] 必须是 '\0'。
+JSValue evalWithCodeCache(JSContext *ctx, const char *source, size_t length, const char *filename);
+
+#endif // DIMINA_HARMONYOS_CODE_CACHE_H
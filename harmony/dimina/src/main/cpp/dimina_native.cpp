@@ -2,6 +2,7 @@
 
 #include "napi/native_api.h"
 #include "js_thread.h"
+#include "utils.h"
 #include "brotli/decode.h"
 
 #include <cstring>
@@ -66,14 +67,72 @@ static napi_value BrotliDecompress(napi_env env, napi_callback_info info) {
     return arrayBuffer;
 }
 
+// 仅供测试：在一个临时的 Runtime 里执行脚本，结果经 ConvertJSValueToNapiValue 交给 ArkTS。
+// 生产路径只有 napi -> QuickJS 方向，反方向只能这样测。脚本或转换抛异常时抛 Error，message 不变
+static napi_value EvalJsValueForTest(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1] = {nullptr};
+    if (napi_ok != napi_get_cb_info(env, info, &argc, args, nullptr, nullptr) || argc < 1) {
+        napi_throw_error(env, "-1000", "arguments invalid");
+        return nullptr;
+    }
+    size_t length = 0;
+    if (napi_ok != napi_get_value_string_utf8(env, args[0], nullptr, 0, &length)) {
+        napi_throw_error(env, "-1000", "arguments invalid");
+        return nullptr;
+    }
+    string script(length, '\0');
+    napi_get_value_string_utf8(env, args[0], &script[0], length + 1, &length);
+
+    JSRuntime *rt = JS_NewRuntime();
+    JSContext *ctx = rt ? JS_NewContext(rt) : nullptr;
+    if (!ctx) {
+        if (rt) {
+            JS_FreeRuntime(rt);
+        }
+        napi_throw_error(env, "-1002", "create context fail");
+        return nullptr;
+    }
+
+    napi_value result = nullptr;
+    JSValue value = JS_Eval(ctx, script.c_str(), script.size(), "<test>", JS_EVAL_TYPE_GLOBAL);
+    if (!JS_IsException(value)) {
+        result = ConvertJSValueToNapiValue(env, ctx, value);
+    }
+    if (JS_HasException(ctx)) {
+        JSValue exception = JS_GetException(ctx);
+        const char *message = JS_ToCString(ctx, exception);
+        napi_throw_error(env, nullptr, message ? message : "convert fail");
+        JS_FreeCString(ctx, message);
+        JS_FreeValue(ctx, exception);
+        result = nullptr;
+    } else if (!result) {
+        // 函数、Symbol 之类转不了的值
+        napi_get_undefined(env, &result);
+    }
+    JS_FreeValue(ctx, value);
+    JS_FreeContext(ctx);
+    JS_FreeRuntime(rt);
+    return result;
+}
+
 EXTERN_C_START static napi_value Init(napi_env env, napi_value exports) {
     napi_property_descriptor desc[] = {
         {"StartJsEngine", nullptr, StartJsEngine, nullptr, nullptr, nullptr, napi_default, nullptr},
         {"dispatchJsTask", nullptr, dispatchJsTask, nullptr, nullptr, nullptr, napi_default, nullptr},
         {"dispatchJsTaskAb", nullptr, dispatchJsTaskAb, nullptr, nullptr, nullptr, napi_default, nullptr},
         {"dispatchJsTaskPath", nullptr, dispatchJsTaskPath, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"dispatchJsMessage", nullptr, dispatchJsMessage, nullptr, nullptr, nullptr, napi_default, nullptr},
         {"destroyJsEngine", nullptr, destroyJsEngine, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"setCodeCacheDir", nullptr, SetCodeCacheDir, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"configureJsEnginePool", nullptr, ConfigureJsEnginePool, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"configureJsWorkerPool", nullptr, ConfigureJsWorkerPool, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"getEngineStats", nullptr, GetEngineStats, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"suspendEngine", nullptr, SuspendEngine, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"resumeEngine", nullptr, ResumeEngine, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"onVsync", nullptr, OnVsync, nullptr, nullptr, nullptr, napi_default, nullptr},
         {"brotliDecompress", nullptr, BrotliDecompress, nullptr, nullptr, nullptr, napi_default, nullptr},
+        {"evalJsValueForTest", nullptr, EvalJsValueForTest, nullptr, nullptr, nullptr, napi_default, nullptr},
     };
     napi_define_properties(env, exports, sizeof(desc) / sizeof(desc[0]), desc);
 
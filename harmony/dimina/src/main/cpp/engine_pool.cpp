@@ -0,0 +1,105 @@
+//
+// Created on 2026/10/16.
+//
+
+#include "engine_pool.h"
+#include "log.h"
+#include "utils.h"
+#include <cerrno>
+#include <deque>
+#include <mutex>
+
+namespace {
+
+std::mutex gPoolMutex;
+std::deque<JSEngine *> gPool;
+size_t gPoolSize = 0;
+std::string gPreloadPath;
+bool gRecycle = false;
+std::function<void(JSContext *ctx)> gRegisterFunc;
+
+// 桥接相关的选项（publish 合并、消息编码）领走时可以改，不参与比较
+bool sameOptions(const JSSchedulerOptions &a, const JSSchedulerOptions &b) {
+    return a.maxTasks == b.maxTasks && a.maxTimeUs == b.maxTimeUs && a.eventDriven == b.eventDriven &&
+           a.sharedWorker == b.sharedWorker && a.normalAgingUs == b.normalAgingUs &&
+           a.backgroundAgingUs == b.backgroundAgingUs && a.longTaskUs == b.longTaskUs &&
+           a.taskHardLimitUs == b.taskHardLimitUs && a.maxMicrotasks == b.maxMicrotasks &&
+           a.microtaskTimeUs == b.microtaskTimeUs;
+}
+
+// 预加载脚本排在 Runtime 初始化之后执行，也在引擎自己的线程上。调用时持有 gPoolMutex。
+void addLocked(JSEngine *engine) {
+    if (!gPreloadPath.empty()) {
+        std::string script;
+        if (readFile(gPreloadPath, script)) {
+            engine->setPreloadedPath(gPreloadPath);
+            engine->executeJavaScriptFile(gPreloadPath, std::move(script));
+        } else {
+            OHWarn("engine pool preload %{public}s failed: %{public}d", gPreloadPath.c_str(), errno);
+        }
+    }
+    gPool.push_back(engine);
+    OHLog("engine pool add %{public}p, size: %{public}zu", (void *)engine, gPool.size());
+}
+
+// JSEngine 的构造只是 pthread_create，Runtime/Context 的初始化在新线程里做，调用方不会被卡住。
+void refillLocked() {
+    while (gPool.size() < gPoolSize) {
+        addLocked(new JSEngine(-1, gRegisterFunc));
+    }
+}
+
+} // namespace
+
+void configureEnginePool(size_t size, const std::string &preloadPath, bool recycle,
+                         std::function<void(JSContext *ctx)> registerFunc) {
+    std::lock_guard<std::mutex> lock(gPoolMutex);
+    gRegisterFunc = registerFunc;
+    gRecycle = recycle;
+    // 预加载路径变了，池里预热好的引擎作废
+    bool stale = preloadPath != gPreloadPath;
+    gPoolSize = size;
+    gPreloadPath = preloadPath;
+    while (!gPool.empty() && (stale || gPool.size() > gPoolSize)) {
+        JSEngine *engine = gPool.back();
+        gPool.pop_back();
+        engine->destroyEngine();
+    }
+    refillLocked();
+}
+
+JSEngine *claimPooledEngine(const JSSchedulerOptions &options) {
+    std::lock_guard<std::mutex> lock(gPoolMutex);
+    auto found = gPool.end();
+    for (auto it = gPool.begin(); it != gPool.end(); ++it) {
+        if (!sameOptions((*it)->getSchedulerOptions(), options)) {
+            continue;
+        }
+        // 还在初始化的也能用，只是省得少一些，先找已经就绪的
+        if (found == gPool.end() || (*it)->isReady()) {
+            found = it;
+        }
+        if ((*it)->isReady()) {
+            break;
+        }
+    }
+    if (found == gPool.end()) {
+        return nullptr;
+    }
+    JSEngine *engine = *found;
+    gPool.erase(found);
+    engine->applyBridgeOptions(options);
+    if (!gRecycle) {
+        refillLocked();
+    }
+    return engine;
+}
+
+bool recycleToEnginePool(JSEngine *engine) {
+    std::lock_guard<std::mutex> lock(gPoolMutex);
+    if (!gRecycle || gPool.size() >= gPoolSize) {
+        return false;
+    }
+    addLocked(engine);
+    return true;
+}
@@ -0,0 +1,33 @@
+//
+// Created on 2026/10/16.
+//
+// Node APIs are not fully supported. To solve the compilation error of the interface cannot be found,
+// please include "napi/native_api.h".
+
+#ifndef DIMINA_HARMONYOS_ENGINE_POOL_H
+#define DIMINA_HARMONYOS_ENGINE_POOL_H
+
+#include "js_engine.h"
+#include <functional>
+#include <string>
+
+// 预热引擎池。池里的引擎已经起好线程、建好 Runtime/Context、注册完桥接和事件循环，
+// StartJsEngine 领一个绑定 appIndex 即可执行第一个任务，冷启动的开销挪到了上一次启动之后。
+// 所有 worker 共用一个池，可以在任意线程调用。
+
+// 设置池大小并补足。size 为 0 时清空池。preloadPath 非空时，新进池的引擎会预先执行这个脚本
+// （比如基础库 service.js），之后对同一路径的第一次 dispatchJsTaskPath 会被跳过。
+// 预加载的脚本执行时还没有绑定 appIndex，invoke/publish/console 发不出去，只适合纯初始化的代码。
+// recycle 为 true 时，销毁的引擎释放完 Runtime 后保留线程和事件循环，重建 Runtime 放回池里，
+// 池由回收的引擎补充，领走时不再新建；为 false 时领走一个就在后台新建一个。
+void configureEnginePool(size_t size, const std::string &preloadPath, bool recycle,
+                         std::function<void(JSContext *ctx)> registerFunc);
+
+// 取一个调度参数与 options 相同的引擎，优先取已经初始化完成的，并在后台补一个新的。
+// 池是空的或者参数对不上时返回 nullptr，由调用方自己冷启动。
+JSEngine *claimPooledEngine(const JSSchedulerOptions &options);
+
+// 引擎线程释放完 Runtime 后调用。开启了回收且池没满时收下，返回 true。
+bool recycleToEnginePool(JSEngine *engine);
+
+#endif // DIMINA_HARMONYOS_ENGINE_POOL_H
@@ -0,0 +1,223 @@
+//
+// Created on 2026/10/16.
+//
+
+#include "engine_registry.h"
+#include "js_core.h"
+#include "js_engine.h"
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <mutex>
+
+namespace {
+
+// 同时存活的小程序不会很多，256 个槽位足够，负载低探测也短
+constexpr uint32_t kSlotCount = 256;
+constexpr uint32_t kSlotMask = kSlotCount - 1;
+// 从没用过的槽位，查找探到这里就可以停
+constexpr int kEmptyKey = INT_MIN;
+// 注销留下的墓碑，查找要跳过继续探测，注册时可以复用
+constexpr int kTombstoneKey = INT_MIN + 1;
+// 清不掉的墓碑（后面还连着有效条目）超过这么多就整理一次，不然查不到的 appIndex 要探测整张表
+constexpr uint32_t kMaxTombstones = kSlotCount / 4;
+
+// 所有字段都是原子变量，读写并发也没有数据竞争；一致性靠 version：写之前变奇数，写完变偶数。
+struct Slot {
+    std::atomic<uint32_t> version{0};
+    std::atomic<int> key{kEmptyKey};
+    std::atomic<JSEngine *> engine{nullptr};
+    std::atomic<napi_threadsafe_function> tsfn{nullptr};
+};
+
+Slot gSlots[kSlotCount];
+std::mutex gWriteMutex;
+// 只在持有 gWriteMutex 时读写
+uint32_t gTombstones = 0;
+// compact 挪条目期间是奇数。挪动中的条目可能被查找前后两次都错过，所以查不到时要确认期间没有挪过
+std::atomic<uint32_t> gMoves{0};
+
+uint32_t slotOf(int appIndex) {
+    // appIndex 是递增的小整数，直接取低位就分布得很均匀
+    return static_cast<uint32_t>(appIndex) & kSlotMask;
+}
+
+struct Entry {
+    JSEngine *engine = nullptr;
+    napi_threadsafe_function tsfn = nullptr;
+};
+
+bool probe(int appIndex, Entry &entry) {
+    uint32_t start = slotOf(appIndex);
+    for (uint32_t i = 0; i < kSlotCount; i++) {
+        Slot &slot = gSlots[(start + i) & kSlotMask];
+        for (;;) {
+            uint32_t before = slot.version.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue;
+            }
+            int key = slot.key.load(std::memory_order_acquire);
+            JSEngine *engine = slot.engine.load(std::memory_order_acquire);
+            napi_threadsafe_function tsfn = slot.tsfn.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.version.load(std::memory_order_relaxed) != before) {
+                continue;
+            }
+            if (key == kEmptyKey) {
+                return false;
+            }
+            if (key == appIndex) {
+                entry.engine = engine;
+                entry.tsfn = tsfn;
+                return true;
+            }
+            break;
+        }
+    }
+    return false;
+}
+
+// 找到的一定是对的；没找到的话，期间 compact 挪过条目就重查
+bool lookup(int appIndex, Entry &entry) {
+    for (;;) {
+        uint32_t moves = gMoves.load(std::memory_order_acquire);
+        if (probe(appIndex, entry)) {
+            return true;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (!(moves & 1) && gMoves.load(std::memory_order_relaxed) == moves) {
+            return false;
+        }
+    }
+}
+
+// 只在持有 gWriteMutex 时调用
+void writeSlot(Slot &slot, int key, JSEngine *engine, napi_threadsafe_function tsfn) {
+    uint32_t version = slot.version.load(std::memory_order_relaxed);
+    slot.version.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.key.store(key, std::memory_order_relaxed);
+    slot.engine.store(engine, std::memory_order_relaxed);
+    slot.tsfn.store(tsfn, std::memory_order_relaxed);
+    slot.version.store(version + 2, std::memory_order_release);
+}
+
+// 只在持有 gWriteMutex 时调用。后面紧跟空槽的墓碑不会再挡着谁，连同往前连着的墓碑一起变回空槽。
+// 变回空槽的墓碑后面没有有效条目，正在探测的查找提前停下也不会漏
+void clearTrailingTombstones(uint32_t index) {
+    if (gSlots[(index + 1) & kSlotMask].key.load(std::memory_order_relaxed) != kEmptyKey) {
+        return;
+    }
+    while (gSlots[index].key.load(std::memory_order_relaxed) == kTombstoneKey) {
+        writeSlot(gSlots[index], kEmptyKey, nullptr, nullptr);
+        gTombstones--;
+        index = (index - 1) & kSlotMask;
+    }
+}
+
+// 只在持有 gWriteMutex 时调用。先把每个条目挪到探测序列里最靠前的墓碑上，缩短探测链；
+// 先写新位置、再把旧位置改成墓碑，并发的查找任何时候都至少能找到一份。
+// 然后不在任何条目探测链上的墓碑都变回空槽：查找只会走到自己那条链的末尾，这些槽位谁也用不着
+void compact() {
+    gMoves.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (uint32_t i = 0; i < kSlotCount; i++) {
+        Slot &slot = gSlots[i];
+        int key = slot.key.load(std::memory_order_relaxed);
+        if (key == kEmptyKey || key == kTombstoneKey) {
+            continue;
+        }
+        for (uint32_t j = slotOf(key); j != i; j = (j + 1) & kSlotMask) {
+            if (gSlots[j].key.load(std::memory_order_relaxed) == kTombstoneKey) {
+                writeSlot(gSlots[j], key, slot.engine.load(std::memory_order_relaxed),
+                          slot.tsfn.load(std::memory_order_relaxed));
+                writeSlot(slot, kTombstoneKey, nullptr, nullptr);
+                break;
+            }
+        }
+    }
+    gMoves.fetch_add(1, std::memory_order_release);
+
+    bool onChain[kSlotCount] = {};
+    for (uint32_t i = 0; i < kSlotCount; i++) {
+        int key = gSlots[i].key.load(std::memory_order_relaxed);
+        if (key == kEmptyKey || key == kTombstoneKey) {
+            continue;
+        }
+        for (uint32_t j = slotOf(key); j != i; j = (j + 1) & kSlotMask) {
+            onChain[j] = true;
+        }
+    }
+    for (uint32_t i = 0; i < kSlotCount; i++) {
+        if (!onChain[i] && gSlots[i].key.load(std::memory_order_relaxed) == kTombstoneKey) {
+            writeSlot(gSlots[i], kEmptyKey, nullptr, nullptr);
+            gTombstones--;
+        }
+    }
+}
+
+} // namespace
+
+bool registerEngine(int appIndex, JSEngine *engine, napi_threadsafe_function tsfn) {
+    if (appIndex == kEmptyKey || appIndex == kTombstoneKey) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(gWriteMutex);
+    Entry existing;
+    if (lookup(appIndex, existing)) {
+        return false;
+    }
+    uint32_t start = slotOf(appIndex);
+    for (uint32_t i = 0; i < kSlotCount; i++) {
+        Slot &slot = gSlots[(start + i) & kSlotMask];
+        int key = slot.key.load(std::memory_order_relaxed);
+        if (key == kEmptyKey || key == kTombstoneKey) {
+            if (key == kTombstoneKey) {
+                gTombstones--;
+            }
+            writeSlot(slot, appIndex, engine, tsfn);
+            return true;
+        }
+    }
+    return false;
+}
+
+napi_threadsafe_function unregisterEngine(int appIndex) {
+    std::lock_guard<std::mutex> lock(gWriteMutex);
+    uint32_t start = slotOf(appIndex);
+    for (uint32_t i = 0; i < kSlotCount; i++) {
+        uint32_t index = (start + i) & kSlotMask;
+        Slot &slot = gSlots[index];
+        int key = slot.key.load(std::memory_order_relaxed);
+        if (key == kEmptyKey) {
+            break;
+        }
+        if (key == appIndex) {
+            napi_threadsafe_function tsfn = slot.tsfn.load(std::memory_order_relaxed);
+            writeSlot(slot, kTombstoneKey, nullptr, nullptr);
+            gTombstones++;
+            clearTrailingTombstones(index);
+            if (gTombstones > kMaxTombstones) {
+                compact();
+            }
+            return tsfn;
+        }
+    }
+    return nullptr;
+}
+
+JSEngine *findEngine(int appIndex) {
+    Entry entry;
+    return lookup(appIndex, entry) ? entry.engine : nullptr;
+}
+
+napi_threadsafe_function findTsfn(int appIndex) {
+    Entry entry;
+    return lookup(appIndex, entry) ? entry.tsfn : nullptr;
+}
+
+JSEngine *engineFromContext(JSContext *ctx) {
+    JSCore *core = static_cast<JSCore *>(JS_GetContextOpaque(ctx));
+    JSEngine *engine = core ? core->owner : nullptr;
+    return engine && engine->getAppIndex() >= 0 ? engine : nullptr;
+}
@@ -0,0 +1,33 @@
+//
+// Created on 2026/10/16.
+//
+// Node APIs are not fully supported. To solve the compilation error of the interface cannot be found,
+// please include "napi/native_api.h".
+
+#ifndef DIMINA_HARMONYOS_ENGINE_REGISTRY_H
+#define DIMINA_HARMONYOS_ENGINE_REGISTRY_H
+
+#include "napi/native_api.h"
+#include "quickjs.h"
+
+class JSEngine;
+
+// appIndex -> (JSEngine, 线程安全函数) 的注册表。
+// 查找不加锁：固定大小的开放寻址表，每个槽位带一个版本号（seqlock），读到一半被改就重读。
+// 注册和注销很少发生，由一把锁串行化。NAPI 入口和 JS 线程的桥接函数都可以并发查。
+// 注销后 JSEngine 要等引擎线程退出、回收线程 join 之后才释放，查找方拿到的指针只在当次调用里用，
+// 这段时间足够充当宽限期。
+
+// 表满或者 appIndex 已存在时返回 false
+bool registerEngine(int appIndex, JSEngine *engine, napi_threadsafe_function tsfn);
+// 返回注销前登记的线程安全函数，由调用方释放；没有登记过返回 nullptr
+napi_threadsafe_function unregisterEngine(int appIndex);
+
+JSEngine *findEngine(int appIndex);
+napi_threadsafe_function findTsfn(int appIndex);
+
+// 桥接函数的热路径：ctx 的 opaque 是 JSCore，JSCore 反指所属的 JSEngine，不查表。
+// 预热池里还没绑定 appIndex 的引擎返回 nullptr，和查不到一样处理。
+JSEngine *engineFromContext(JSContext *ctx);
+
+#endif // DIMINA_HARMONYOS_ENGINE_REGISTRY_H
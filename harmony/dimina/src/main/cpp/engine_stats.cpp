@@ -0,0 +1,144 @@
+//
+// Created on 2026/10/16.
+//
+
+#include "engine_stats.h"
+
+namespace {
+
+constexpr uint64_t kNsPerSec = 1000000000ULL;
+
+void storeMax(std::atomic<uint64_t> &target, uint64_t value) {
+    // 只有一个写者，不用 CAS
+    if (value > target.load(std::memory_order_relaxed)) {
+        target.store(value, std::memory_order_relaxed);
+    }
+}
+
+} // namespace
+
+LatencyHistogram::LatencyHistogram() {
+    for (auto &bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+int LatencyHistogram::bucketOf(uint64_t value) {
+    if (value < kLinearBuckets) {
+        return static_cast<int>(value);
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    if (exponent >= kMaxExponent) {
+        return kBucketCount - 1;
+    }
+    int sub = static_cast<int>((value >> (exponent - kSubBucketBits)) & ((1 << kSubBucketBits) - 1));
+    return kLinearBuckets + (exponent - 4) * (1 << kSubBucketBits) + sub;
+}
+
+uint64_t LatencyHistogram::upperBoundOf(int index) {
+    if (index < kLinearBuckets) {
+        return index;
+    }
+    int exponent = (index - kLinearBuckets) / (1 << kSubBucketBits) + 4;
+    uint64_t sub = (index - kLinearBuckets) % (1 << kSubBucketBits);
+    return (((1ULL << kSubBucketBits) + sub + 1) << (exponent - kSubBucketBits)) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value) {
+    buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+    storeMax(maxValue, value);
+}
+
+void LatencyHistogram::reset() {
+    for (auto &bucket : buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    total.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    maxValue.store(0, std::memory_order_relaxed);
+}
+
+double LatencyHistogram::mean() const {
+    uint64_t n = count();
+    return n == 0 ? 0 : static_cast<double>(sum.load(std::memory_order_relaxed)) / n;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    // 读的时候写者还在加，以各桶加起来的数为准，不用 total
+    uint64_t counts[kBucketCount];
+    uint64_t n = 0;
+    for (int i = 0; i < kBucketCount; i++) {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        n += counts[i];
+    }
+    if (n == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(p / 100.0 * n + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < kBucketCount; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            uint64_t bound = upperBoundOf(i);
+            // 桶上界可能比实际见过的最大值还大
+            uint64_t observed = max();
+            return bound < observed ? bound : observed;
+        }
+    }
+    return max();
+}
+
+void JSEngineStats::recordDequeue(uint64_t waitUs, uint64_t depth) {
+    queueWaitUs.record(waitUs);
+    depthSamples.record(depth);
+    storeMax(maxQueueDepth, depth);
+}
+
+void JSEngineStats::recordTaskDone(uint64_t nowNs) {
+    tasksExecuted.fetch_add(1, std::memory_order_relaxed);
+    if (windowStartNs == 0) {
+        windowStartNs = nowNs;
+    }
+    windowTasks++;
+    uint64_t elapsed = nowNs - windowStartNs;
+    if (elapsed >= kNsPerSec) {
+        tasksPerSec.store(windowTasks * kNsPerSec / elapsed, std::memory_order_relaxed);
+        windowStartNs = nowNs;
+        windowTasks = 0;
+    }
+    lastTaskNs.store(nowNs, std::memory_order_relaxed);
+}
+
+uint64_t JSEngineStats::tasksPerSecAt(uint64_t nowNs) const {
+    uint64_t last = lastTaskNs.load(std::memory_order_relaxed);
+    if (last == 0 || nowNs - last >= kNsPerSec) {
+        return 0;
+    }
+    return tasksPerSec.load(std::memory_order_relaxed);
+}
+
+void JSEngineStats::reset() {
+    loopIterations.store(0, std::memory_order_relaxed);
+    wakeups.store(0, std::memory_order_relaxed);
+    tasksExecuted.store(0, std::memory_order_relaxed);
+    maxQueueDepth.store(0, std::memory_order_relaxed);
+    agedTasks.store(0, std::memory_order_relaxed);
+    longTasks.store(0, std::memory_order_relaxed);
+    abortedTasks.store(0, std::memory_order_relaxed);
+    microtaskOverruns.store(0, std::memory_order_relaxed);
+    frames.store(0, std::memory_order_relaxed);
+    fallbackFrames.store(0, std::memory_order_relaxed);
+    tasksPerSec.store(0, std::memory_order_relaxed);
+    lastTaskNs.store(0, std::memory_order_relaxed);
+    queueWaitUs.reset();
+    evalUs.reset();
+    microtaskUs.reset();
+    depthSamples.reset();
+    windowStartNs = 0;
+    windowTasks = 0;
+}
@@ -0,0 +1,99 @@
+//
+// Created on 2026/10/16.
+//
+// Node APIs are not fully supported. To solve the compilation error of the interface cannot be found,
+// please include "napi/native_api.h".
+
+#ifndef DIMINA_HARMONYOS_ENGINE_STATS_H
+#define DIMINA_HARMONYOS_ENGINE_STATS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// 对数线性分桶的直方图（HDR Histogram 的简化版）：16 以下每个值一个桶，往上每个 2 的幂区间等分 8 个子桶，
+// 相对误差不超过 12.5%，内存固定，记录一次只是几次 relaxed 原子加。
+// 只有一个写者（JS 线程），任意线程都能直接读，读到的是近似一致的快照。
+class LatencyHistogram {
+public:
+    LatencyHistogram();
+
+    void record(uint64_t value);
+    void reset();
+
+    uint64_t count() const {
+        return total.load(std::memory_order_relaxed);
+    };
+    uint64_t max() const {
+        return maxValue.load(std::memory_order_relaxed);
+    };
+    double mean() const;
+    // 返回所在桶的上界，p 取 0 ~ 100
+    uint64_t percentile(double p) const;
+
+private:
+    static constexpr int kLinearBuckets = 16;
+    static constexpr int kSubBucketBits = 3;
+    // 最高到 2^40，按微秒算十几天，再大的都记进最后一个桶
+    static constexpr int kMaxExponent = 40;
+    static constexpr int kBucketCount = kLinearBuckets + (kMaxExponent - 4) * (1 << kSubBucketBits);
+
+    static int bucketOf(uint64_t value);
+    static uint64_t upperBoundOf(int index);
+
+    std::atomic<uint64_t> buckets[kBucketCount];
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> maxValue{0};
+};
+
+// 每个引擎一块统计内存，跟着 JSCore 分配，JS 线程写、任意线程直接读。
+// 查询不用给 JS 线程发任务，也不用加锁，轮询多频繁都不会影响 JS 线程。
+// 时间都是微秒。
+struct alignas(64) JSEngineStats {
+    // 调度计数：loopIterations / tasksExecuted 就是每个任务摊到的循环轮数
+    std::atomic<uint64_t> loopIterations{0};
+    std::atomic<uint64_t> wakeups{0};
+    std::atomic<uint64_t> tasksExecuted{0};
+
+    // 当前排队的任务数，生产者入队时加、JS 线程出队时减，单独占一条缓存行
+    alignas(64) std::atomic<uint64_t> queueDepth{0};
+    std::atomic<uint64_t> maxQueueDepth{0};
+    // 按优先级分开的排队数，下标是 JSTaskPriority
+    std::atomic<uint64_t> laneDepth[3]{};
+    // 因为老化提前执行的低优先级任务数
+    std::atomic<uint64_t> agedTasks{0};
+    // 超过 longTaskUs 的任务数，以及其中被 taskHardLimitUs 中断的
+    std::atomic<uint64_t> longTasks{0};
+    std::atomic<uint64_t> abortedTasks{0};
+    // 微任务预算用完、剩下的留到下一轮的次数
+    std::atomic<uint64_t> microtaskOverruns{0};
+    // 跑过的帧数（requestAnimationFrame / 按帧 flush publish），以及其中宿主没推 vsync、由兜底定时器驱动的
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> fallbackFrames{0};
+    // 最近一个完整的一秒窗口里执行的任务数，读的时候用 tasksPerSecAt：窗口只在任务执行完时滚动，
+    // 空闲下来之后这个值不会再更新
+    std::atomic<uint64_t> tasksPerSec{0};
+    // 最后一条任务执行完的时刻（uv_hrtime），0 表示还没有
+    std::atomic<uint64_t> lastTaskNs{0};
+
+    LatencyHistogram queueWaitUs;  // 入队到出队
+    LatencyHistogram evalUs;       // JS_Eval / onMessage 调用本身
+    LatencyHistogram microtaskUs;  // 每次清空微任务队列，没有微任务的不记
+    LatencyHistogram depthSamples; // 每次出队时看到的排队数
+
+    // 以下只在 JS 线程上用
+    // depth 是取出这条任务之前的排队数，包括它自己
+    void recordDequeue(uint64_t waitUs, uint64_t depth);
+    void recordTaskDone(uint64_t nowNs);
+    // 任意线程调用。最近一秒没有任务执行完就是 0
+    uint64_t tasksPerSecAt(uint64_t nowNs) const;
+    // 新建 Runtime 时清零，复用的引擎不带上一个小程序的数据。queueDepth 是实时值，不清。
+    void reset();
+
+private:
+    uint64_t windowStartNs = 0;
+    uint64_t windowTasks = 0;
+};
+
+#endif // DIMINA_HARMONYOS_ENGINE_STATS_H
@@ -7,18 +7,45 @@
 #include <thread>
 #include "log.h"
 #include "utils.h"
+#include "js_thread.h"
+#include <cerrno>
+#include "code_cache.h"
+#include "wire_format.h"
 #include "types/qjs_extension/settimeout.h"
+#include "types/qjs_extension/scheduler.h"
+#include "types/qjs_extension/animationframe.h"
+
+// 兜底出帧按 60Hz；宿主超过 kVsyncStaleMs 没推 vsync 就认为停推了，改由兜底定时器出帧
+constexpr uint64_t kFrameIntervalNs = 16666667;
+constexpr uint64_t kVsyncStaleMs = 100;
 
 // 构造函数
 JSCore::JSCore() : rt(nullptr), ctx(nullptr), js_loop(nullptr), starting(false), running(false), closing(false) {
     // 初始化其他成员变量
 }
 
+JSCore::JSCore(const JSSchedulerOptions &options) : JSCore() {
+    schedOptions = options;
+    if (schedOptions.maxTasks == 0) {
+        schedOptions.maxTasks = 1;
+    }
+    if (schedOptions.maxMicrotasks == 0) {
+        schedOptions.maxMicrotasks = 1;
+    }
+    publishBatcher.configure(schedOptions.publishBatching, schedOptions.publishBatchMaxBytes,
+                             schedOptions.publishBatchDeadlineUs);
+    binaryWire = schedOptions.binaryWire;
+    frameAlignedPublish = schedOptions.frameAlignedPublish;
+    bridgeQueue->configure(schedOptions.invokeQueueLimit, schedOptions.publishQueueLimit, schedOptions.logQueueLimit);
+}
+
 // 析构函数
 JSCore::~JSCore() {
     OHWarn("core JSCore::~JSCore()");
-    // 清理资源，释放内存
+    // 正常情况下 startEngine 退出前已经全部释放，这里只兜底线程没能跑完的情况
     if (ctx) {
+        releaseMessageHandler();
+        releaseAsyncCalls();
         JS_FreeContext(ctx);
         ctx = nullptr;
     }
@@ -31,19 +58,12 @@ JSCore::~JSCore() {
         free(js_loop);
         js_loop = nullptr;
     }
-    // 关闭 uv 句柄
-    uv_close((uv_handle_t *)&eval_handle, nullptr);
-    uv_close((uv_handle_t *)&destroy_handle, nullptr);
-    uv_close((uv_handle_t *)&idle_handle, nullptr);
-    uv_close((uv_handle_t *)&prepare_handle, nullptr);
-    uv_close((uv_handle_t *)&check_handle, nullptr);
     // 清空任务队列
-    std::queue<std::string> empty;
-    std::swap(jsTaskQueue, empty);
+    clearTasks();
 }
 
 // 实现成员函数
-bool JSCore::executeJavaScript(const std::string &code) {
+bool JSCore::executeJavaScript(const JSTask &task) {
     if (firstTaskMark) {
         firstTaskMark = false;
         auto now = std::chrono::system_clock::now();
@@ -53,9 +73,29 @@ bool JSCore::executeJavaScript(const std::string &code) {
 
     // 执行 JavaScript 代码
 //     OHWarn("before JS_Eval:  %{public}s", code.c_str());
-//     OHWarn("before JS_Eval, jsTaskQueue size: %{public}zu", jsTaskQueue.size());
-    JSValue result = JS_Eval(ctx, code.c_str(), code.size(), "", JS_EVAL_TYPE_GLOBAL);
-    OHWarn("after JS_Eval, jsTaskQueue size: %{public}zu", jsTaskQueue.size());
+//     OHWarn("before JS_Eval, jsTaskQueue size: %{public}zu", pendingTaskCount());
+    if (task.type == JSTaskType::Message) {
+        return dispatchMessage(task.code);
+    }
+    if (task.type == JSTaskType::InvokeResult) {
+        return settleAsyncCall(task);
+    }
+    if (task.type == JSTaskType::Path) {
+        return executePath(task);
+    }
+    if (task.type == JSTaskType::Suspend) {
+        suspend();
+        return true;
+    }
+    if (task.type == JSTaskType::Resume) {
+        resume();
+        return true;
+    }
+    JSValue result = task.type == JSTaskType::File
+                         ? evalWithCodeCache(ctx, task.code.c_str(), task.code.size(), task.path.c_str())
+                         : JS_Eval(ctx, task.code.c_str(), task.code.size(), "", JS_EVAL_TYPE_GLOBAL);
+    OHWarn("after JS_Eval, jsTaskQueue size: %{public}llu",
+           (unsigned long long)stats.queueDepth.load(std::memory_order_relaxed));
     if (JS_IsException(result)) {
         exceptionLogFunc(ctx);
         JS_FreeValue(ctx, result);
@@ -65,48 +105,392 @@ bool JSCore::executeJavaScript(const std::string &code) {
     return true;
 }
 
-void JSCore::processPendingJobs() {
+bool JSCore::dispatchMessage(const std::string &payload) {
+    if (!JS_IsFunction(ctx, messageHandler)) {
+        OHError("dispatchMessage: DiminaServiceBridge.onMessage is not set");
+        return false;
+    }
+    JSValue message = WireIsBinary(payload.data(), payload.size())
+                          ? WireDecodeJSValue(ctx, reinterpret_cast<const uint8_t *>(payload.data()), payload.size())
+                          : JS_ParseJSON(ctx, payload.c_str(), payload.size(), "<onMessage>");
+    if (JS_IsException(message)) {
+        exceptionLogFunc(ctx);
+        return false;
+    }
+    // onMessage 执行过程中可能给自己重新赋值，先持有一份引用，防止函数在调用中途被释放。
+    JSValue handler = JS_DupValue(ctx, messageHandler);
+    JSValue bridge = JS_DupValue(ctx, messageBridge);
+    JSValue result = JS_Call(ctx, handler, bridge, 1, &message);
+    JS_FreeValue(ctx, bridge);
+    JS_FreeValue(ctx, handler);
+    JS_FreeValue(ctx, message);
+    if (JS_IsException(result)) {
+        exceptionLogFunc(ctx);
+        return false;
+    }
+    JS_FreeValue(ctx, result);
+    return true;
+}
+
+JSValue JSCore::getMessageHandler() {
+    return JS_DupValue(ctx, messageHandler);
+}
+
+void JSCore::setMessageHandler(JSValueConst bridge, JSValueConst handler) {
+    releaseMessageHandler();
+    messageBridge = JS_DupValue(ctx, bridge);
+    messageHandler = JS_DupValue(ctx, handler);
+}
+
+void JSCore::releaseMessageHandler() {
+    JS_FreeValue(ctx, messageHandler);
+    JS_FreeValue(ctx, messageBridge);
+    messageHandler = JS_UNDEFINED;
+    messageBridge = JS_UNDEFINED;
+}
+
+uint32_t JSCore::addAsyncCall(JSValue resolve, JSValue reject) {
+    uint32_t callId = nextAsyncCallId++;
+    if (nextAsyncCallId == 0) {
+        nextAsyncCallId = 1;
+    }
+    asyncCalls[callId] = AsyncCall{resolve, reject};
+    return callId;
+}
+
+bool JSCore::settleAsyncCall(const JSTask &task) {
+    auto it = asyncCalls.find(task.callId);
+    if (it == asyncCalls.end()) {
+        OHWarn("invokeAsync result for unknown call %{public}u", task.callId);
+        return false;
+    }
+    AsyncCall call = it->second;
+    asyncCalls.erase(it);
+
+    bool rejected = task.rejected;
+    JSValue value = JS_UNDEFINED;
+    if (rejected) {
+        value = JS_NewError(ctx);
+        JS_SetPropertyStr(ctx, value, "message", JS_NewStringLen(ctx, task.code.c_str(), task.code.size()));
+    } else if (!task.code.empty()) {
+        value = JS_ParseJSON(ctx, task.code.c_str(), task.code.size(), "<invokeAsync>");
+        if (JS_IsException(value)) {
+            value = JS_GetException(ctx);
+            rejected = true;
+        }
+    }
+    JSValue result = JS_Call(ctx, rejected ? call.reject : call.resolve, JS_UNDEFINED, 1, &value);
+    JS_FreeValue(ctx, value);
+    JS_FreeValue(ctx, call.resolve);
+    JS_FreeValue(ctx, call.reject);
+    if (JS_IsException(result)) {
+        exceptionLogFunc(ctx);
+        return false;
+    }
+    JS_FreeValue(ctx, result);
+    return true;
+}
+
+void JSCore::releaseAsyncCalls() {
+    for (auto &pair : asyncCalls) {
+        JS_FreeValue(ctx, pair.second.resolve);
+        JS_FreeValue(ctx, pair.second.reject);
+    }
+    asyncCalls.clear();
+}
+
+// dispatchJsTaskPath 的文件在这里读，ArkTS 主线程只负责入队。几 MB 的 bundle 读起来也只占 JS 线程
+bool JSCore::executePath(const JSTask &task) {
+    PathLoadResult result;
+    uint64_t start = uv_hrtime();
+    result.queueUs = (start - task.enqueueNs) / 1000;
+    std::string script;
+    bool ok = readFile(task.path, script);
+    uint64_t loaded = uv_hrtime();
+    result.loadUs = (loaded - start) / 1000;
+    if (!ok) {
+        int error = errno;
+        OHError("load %{public}s failed: %{public}d", task.path.c_str(), error);
+        result.error = "Unable to read file " + task.path + ": " + std::to_string(error);
+    } else {
+        result.bytes = script.size();
+        JSValue value = evalWithCodeCache(ctx, script.c_str(), script.size(), task.path.c_str());
+        if (JS_IsException(value)) {
+            ok = false;
+            // 错误信息带回给 ArkTS，异常放回去照常打日志
+            JSValue exception = JS_GetException(ctx);
+            const char *message = JS_ToCString(ctx, exception);
+            result.error = message ? message : "script threw an exception";
+            JS_FreeCString(ctx, message);
+            JS_Throw(ctx, exception);
+            exceptionLogFunc(ctx);
+        } else {
+            JS_FreeValue(ctx, value);
+        }
+        result.evalUs = (uv_hrtime() - loaded) / 1000;
+    }
+    if (task.deferred) {
+        postPathLoaded(ctx, task.deferred, std::move(result));
+    }
+    return ok;
+}
+
+// 切到后台：定时器冻结、immediate 停掉，没有任务时事件循环只剩 eval/destroy 两个 async 句柄，
+// 线程一直睡在 epoll 上。攒着的 publish 先交出去，再做一次完整 GC，把定时器堆和 immediate 队列缩回去。
+// 任务照常执行：后台收到的消息（onHide 之类）还要处理，期间新建的定时器等 resume 之后才开始计时。
+void JSCore::suspend() {
+    if (suspended) {
+        return;
+    }
+    suspended = true;
+    suspendTimers(ctx);
+    uv_check_stop(&immediate_handle);
+    // rAF 回调留着，resume 之后的第一帧执行
+    uv_timer_stop(&frame_timer);
+    publishBatcher.flush(ctx);
+    JS_RunGC(rt);
+    schedulerTrim(ctx);
+    OHLog("core suspended");
+}
+
+void JSCore::resume() {
+    if (!suspended) {
+        return;
+    }
+    suspended = false;
+    resumeTimers(ctx);
+    if (hasPendingImmediates(ctx)) {
+        js_core_arm_immediates(ctx, 1);
+    }
+    if (frameRequested) {
+        requestFrame();
+    }
+    OHLog("core resumed");
+}
+
+static const char *taskKindName(JSTaskType type) {
+    switch (type) {
+        case JSTaskType::File:
+        case JSTaskType::Path:
+            return "file";
+        case JSTaskType::Message:
+            return "message";
+        case JSTaskType::InvokeResult:
+            return "invokeResult";
+        case JSTaskType::Suspend:
+        case JSTaskType::Resume:
+            return "lifecycle";
+        default:
+            return "script";
+    }
+}
+
+// 最多保留的长任务条数，多了丢最早的
+constexpr size_t kMaxLongTaskEvents = 32;
+
+bool JSCore::beginWatch(const char *kind) {
+    if (watchKind) {
+        return false;
+    }
+    watchKind = kind;
+    watchStartNs = uv_hrtime();
+    watchCaptured = false;
+    watchAborted = false;
+    watchStack.clear();
+    return true;
+}
+
+void JSCore::endWatch() {
+    uint64_t durationUs = (uv_hrtime() - watchStartNs) / 1000;
+    if (durationUs >= schedOptions.longTaskUs) {
+        JSLongTaskEvent event;
+        event.kind = watchKind;
+        auto now = std::chrono::system_clock::now();
+        event.startTimeMs =
+            std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() - durationUs / 1000;
+        event.durationUs = durationUs;
+        event.stack = std::move(watchStack);
+        event.aborted = watchAborted;
+        stats.longTasks.fetch_add(1, std::memory_order_relaxed);
+        if (watchAborted) {
+            stats.abortedTasks.fetch_add(1, std::memory_order_relaxed);
+        }
+        OHWarn("long task %{public}s %{public}llums aborted: %{public}d\n%{public}s", event.kind.c_str(),
+               (unsigned long long)(durationUs / 1000), event.aborted ? 1 : 0, event.stack.c_str());
+        std::lock_guard<std::mutex> lock(longTaskMutex);
+        if (longTasks.size() >= kMaxLongTaskEvents) {
+            longTasks.pop_front();
+        }
+        longTasks.push_back(std::move(event));
+    }
+    watchKind = nullptr;
+}
+
+std::vector<JSLongTaskEvent> JSCore::getLongTasks() {
+    std::lock_guard<std::mutex> lock(longTaskMutex);
+    return std::vector<JSLongTaskEvent>(longTasks.begin(), longTasks.end());
+}
+
+int JSCore::interrupt_handler(JSRuntime *rt, void *opaque) {
+    return static_cast<JSCore *>(opaque)->onInterrupt();
+}
+
+// 大约每执行一万条字节码回调一次，没在监控或者还没超时的话只多一次取时间
+int JSCore::onInterrupt() {
+    if (!watchKind || inInterrupt) {
+        return 0;
+    }
+    uint64_t elapsedUs = (uv_hrtime() - watchStartNs) / 1000;
+    if (elapsedUs < schedOptions.longTaskUs) {
+        return 0;
+    }
+    if (!watchCaptured) {
+        watchCaptured = true;
+        captureWatchStack();
+        OHWarn("long task %{public}s still running after %{public}llums\n%{public}s", watchKind,
+               (unsigned long long)(elapsedUs / 1000), watchStack.c_str());
+    }
+    if (schedOptions.taskHardLimitUs > 0 && elapsedUs >= schedOptions.taskHardLimitUs) {
+        // 返回非 0 后 QuickJS 抛出不可捕获的 InternalError("interrupted")，一路退回到任务入口
+        watchAborted = true;
+        OHError("long task %{public}s aborted after %{public}llums", watchKind, (unsigned long long)(elapsedUs / 1000));
+        return 1;
+    }
+    return 0;
+}
+
+// 在中断回调里调用 JS 函数拿栈：栈上还是超时任务的调用链，只多一层 <watchdog>
+void JSCore::captureWatchStack() {
+    if (!JS_IsFunction(ctx, stackProbe)) {
+        return;
+    }
+    inInterrupt = true;
+    JSValue stack = JS_Call(ctx, stackProbe, JS_UNDEFINED, 0, nullptr);
+    inInterrupt = false;
+    if (JS_IsException(stack)) {
+        JS_FreeValue(ctx, JS_GetException(ctx));
+        return;
+    }
+    const char *str = JS_ToCString(ctx, stack);
+    if (str) {
+        watchStack = str;
+        JS_FreeCString(ctx, str);
+    }
+    JS_FreeValue(ctx, stack);
+}
+
+// 一次最多跑 maxMicrotasks 个微任务、占用 microtaskTimeUs，自己不断续命的 Promise 链不会饿死定时器和新消息。
+// 预算用完还有剩余时给自己发一次通知，poll 不阻塞，下一轮 prepare 接着跑。返回是否还有剩余。
+bool JSCore::processPendingJobs() {
     JSContext *ctx1;
     int err;
 
+    if (!ctx) {
+        return false;
+    }
+
+    // 每轮循环都会进来，没有微任务时直接返回，也不计入统计
+    if (!JS_IsJobPending(rt)) {
+        return false;
+    }
     OHLog("executePendingJobLoop executing");
 //    OHLog("ctx地址: %{public}p", (void*)ctx);
 
-    while ((err = JS_ExecutePendingJob(JS_GetRuntime(ctx), &ctx1)) > 0) {
+    uint64_t start = uv_hrtime();
+    uint64_t deadline = start + schedOptions.microtaskTimeUs * 1000;
+    bool watching = beginWatch("microtask");
+    bool remaining = false;
+    uint32_t count = 0;
+    while ((err = JS_ExecutePendingJob(rt, &ctx1)) != 0) {
 //        OHLog("ctx1地址: %{public}p", (void*)ctx1);
         if (err < 0) {
+            // 出异常的那个微任务已经出队了，记下来接着跑后面的
             exceptionLogFunc(ctx1);
+        }
+        if (++count >= schedOptions.maxMicrotasks || uv_hrtime() >= deadline) {
+            remaining = JS_IsJobPending(rt);
             break;
         }
     }
+    if (watching) {
+        endWatch();
+    }
+    stats.microtaskUs.record((uv_hrtime() - start) / 1000);
+    if (remaining) {
+        stats.microtaskOverruns.fetch_add(1, std::memory_order_relaxed);
+        // 销毁流程里不再续跑，剩下的由 freeRuntime 里的 drainPendingJobs 跑完
+        if (running) {
+            uv_async_send(&eval_handle);
+        }
+    }
+    return remaining;
+}
+
+void JSCore::drainPendingJobs() {
+    JSContext *ctx1;
+    int err;
+    while ((err = JS_ExecutePendingJob(rt, &ctx1)) != 0) {
+        if (err < 0) {
+            exceptionLogFunc(ctx1);
+        }
+    }
 }
 
 // 线程函数
-void *JSCore::startEngine(int index, std::function<void(JSContext *ctx)> registerFunc) {
+void *JSCore::startEngine(int index, std::function<void(JSContext *ctx)> registerFunc,
+                          std::function<bool()> recycleFunc) {
     auto now = std::chrono::system_clock::now();
     auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
     PFLog("[launch-container][%{public}lld]JS引擎启动-Runtime/事件循环初始化开始", timestamp);
 
     thread::id this_id = this_thread::get_id();
     OHWarn("startEngine thread::id %{public}d index %{public}d", this_id, index);
-    OHWarn("startEngine, jsTaskQueue size: %{public}zu", jsTaskQueue.size());
+    OHWarn("startEngine, jsTaskQueue size: %{public}zu", pendingTaskCount());
     OHWarn("startEngine, core_closing: %{public}d", closing ? 1 : 0);
 
-    starting = true;
+    // 事件循环和几个常驻句柄跟着线程走，回收复用时保留，只重建 Runtime/Context
+    initHandles(uv_loop_new());
 
-    rt = JS_NewRuntime();
-    JS_SetMaxStackSize(rt, 128 * 1024 * 1024);
-    ctx = JS_NewContext(rt);
+    for (;;) {
+        createRuntime(registerFunc);
 
-    registerFunc(ctx);
+        now = std::chrono::system_clock::now();
+        timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+        PFLog("[launch-container][%{public}lld]JS引擎启动-Runtime/事件循环初始化完成", timestamp);
 
-    consoleInit(ctx);
-    timeoutInit(ctx);
-    setLogger(debugLogFunc, exceptionLogFunc);
+        starting = false;
+        running = true;
+        // running 置位之前入队的任务没有发过通知，这里补一次
+        if (schedOptions.eventDriven) {
+            uv_async_send(&eval_handle);
+        }
+        if (destroyRequested) {
+            uv_async_send(&destroy_handle);
+        }
+        // destroy_cb_impl 里 uv_stop 之后返回
+        uv_run(js_loop, UV_RUN_DEFAULT);
+
+        freeRuntime();
 
-    js_loop = uv_loop_new();
-    JS_SetContextOpaque(ctx, this);  // 存储 this 指针，而不是 js_loop
+        // 回收方决定要不要复用这个线程，要复用的话它负责重置外部状态。
+        // recycleFunc 一返回引擎就已经在池里、可能马上被取走并请求销毁，所以内部状态要在交出去之前重置
+        closing = false;
+        destroyRequested = false;
+        firstTaskMark = true;
+        if (!recycleFunc || !recycleFunc()) {
+            closing = true;
+            break;
+        }
+        OHWarn("core recycled, thread %{public}d", this_id);
+    }
 
+    closeLoop();
+    OHLog("jsThreadFunc end");
+    return nullptr;
+}
+
+void JSCore::initHandles(uv_loop_t *loop) {
+    js_loop = loop;
     uv_async_init(js_loop, &eval_handle, js_task_cb);
     eval_handle.data = this;
     uv_async_init(js_loop, &destroy_handle, destroy_cb);
@@ -116,21 +500,205 @@ void *JSCore::startEngine(int index, std::function<void(JSContext *ctx)> registe
     uv_prepare_start(&prepare_handle, prepare_cb);
     uv_check_init(js_loop, &check_handle);
     check_handle.data = this;
-    uv_check_start(&check_handle, check_cb);
     uv_idle_init(js_loop, &idle_handle);
     idle_handle.data = this;
-    uv_idle_start(&idle_handle, idle_cb);
+    uv_timer_init(js_loop, &timer_handle);
+    timer_handle.data = this;
+    uv_check_init(js_loop, &immediate_handle);
+    immediate_handle.data = this;
+    uv_async_init(js_loop, &frame_handle, frame_cb);
+    frame_handle.data = this;
+    uv_timer_init(js_loop, &frame_timer);
+    frame_timer.data = this;
+}
+
+// 共享模式下事件循环不归自己，只关掉自己的句柄，全部关闭后回调 done
+void JSCore::closeHandles(std::function<void()> done) {
+    handlesClosed = std::move(done);
+    openHandles = 9;
+    uv_close((uv_handle_t *)&eval_handle, handle_closed_cb);
+    uv_close((uv_handle_t *)&destroy_handle, handle_closed_cb);
+    uv_close((uv_handle_t *)&prepare_handle, handle_closed_cb);
+    uv_close((uv_handle_t *)&check_handle, handle_closed_cb);
+    uv_close((uv_handle_t *)&idle_handle, handle_closed_cb);
+    uv_close((uv_handle_t *)&timer_handle, handle_closed_cb);
+    uv_close((uv_handle_t *)&immediate_handle, handle_closed_cb);
+    uv_close((uv_handle_t *)&frame_handle, handle_closed_cb);
+    uv_close((uv_handle_t *)&frame_timer, handle_closed_cb);
+}
+
+void JSCore::handle_closed_cb(uv_handle_t *handle) {
+    JSCore *core = static_cast<JSCore *>(handle->data);
+    if (--core->openHandles == 0) {
+        core->js_loop = nullptr;
+        // 回调里可能把 core 交出去释放，必须是最后一步
+        std::function<void()> done = std::move(core->handlesClosed);
+        done();
+    }
+}
+
+void JSCore::notifyTask() {
+    notifiers.fetch_add(1);
+    if (running) {
+        uv_async_send(&eval_handle);
+    }
+    notifiers.fetch_sub(1);
+}
+
+void JSCore::onVsync(uint64_t frameTimeNs) {
+    pendingVsyncNs.store(frameTimeNs ? frameTimeNs : uv_hrtime(), std::memory_order_relaxed);
+    notifiers.fetch_add(1);
+    if (running) {
+        uv_async_send(&frame_handle);
+    }
+    notifiers.fetch_sub(1);
+}
+
+void JSCore::notifyDestroy() {
+    destroyRequested = true;
+    notifiers.fetch_add(1);
+    if (running) {
+        uv_async_send(&destroy_handle);
+    }
+    notifiers.fetch_sub(1);
+}
+
+// running 已经置 false：之后进来的生产者都不会再碰句柄，等已经在 uv_async_send 里的退出
+void JSCore::quiesceNotifiers() {
+    while (notifiers.load() != 0) {
+        std::this_thread::yield();
+    }
+}
 
-    now = std::chrono::system_clock::now();
-    timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
-    PFLog("[launch-container][%{public}lld]JS引擎启动-Runtime/事件循环初始化完成", timestamp);
+void JSCore::attach(uv_loop_t *loop, const std::function<void(JSContext *ctx)> &registerFunc) {
+    hosted = true;
+    // 多个引擎共用一个线程，idle 空转会拖累同一线程上的其他引擎
+    schedOptions.eventDriven = true;
+    // 同样的原因，invoke 积压满了也不能在这个线程上等
+    bridgeQueue->setBlocking(false);
+    initHandles(loop);
+    createRuntime(registerFunc);
 
     starting = false;
     running = true;
-    uv_run(js_loop, UV_RUN_DEFAULT);
+    uv_async_send(&eval_handle);
+    if (destroyRequested) {
+        uv_async_send(&destroy_handle);
+    }
+}
 
-    OHLog("jsThreadFunc end");
-    return nullptr;
+bool JSCore::isIdle() {
+    return running && !hasPendingTasks() && !JS_IsJobPending(rt) && !hasActiveTimers(ctx) &&
+           !hasPendingImmediates(ctx) && !frameRequested;
+}
+
+void JSCore::detachForMigration(std::function<void()> done) {
+    running = false;
+    quiesceNotifiers();
+    // 空闲时没有待触发的定时器，定时器句柄跟着 closeHandles 关掉，reattach 时在新循环上重建
+    closeHandles(std::move(done));
+}
+
+void JSCore::reattach(uv_loop_t *loop) {
+    initHandles(loop);
+    // QuickJS 按创建 Runtime 的线程记录栈顶做栈溢出检查，换了线程要更新
+    JS_UpdateStackTop(rt);
+    running = true;
+    // 迁移期间到的任务和销毁请求没有发过通知，这里补上
+    uv_async_send(&eval_handle);
+    if (destroyRequested) {
+        uv_async_send(&destroy_handle);
+    }
+}
+
+void JSCore::createRuntime(const std::function<void(JSContext *ctx)> &registerFunc) {
+    starting = true;
+    stats.reset();
+    bridgeQueue->resetStats();
+    suspended = false;
+    pendingVsyncNs = 0;
+    lastVsyncNs = 0;
+    lastFrameNs = 0;
+    frameRequested = false;
+
+    rt = JS_NewRuntime();
+    JS_SetMaxStackSize(rt, 128 * 1024 * 1024);
+    ctx = JS_NewContext(rt);
+
+    JS_SetContextOpaque(ctx, this);  // 存储 this 指针，而不是 js_loop；timeoutInit 要用
+
+    registerFunc(ctx);
+
+    consoleInit(ctx);
+    timeoutInit(ctx);
+    schedulerInit(ctx);
+    animationFrameInit(ctx);
+    setLogger(debugLogFunc, exceptionLogFunc);
+
+    static const char kStackProbe[] = "(function () { return new Error().stack; })";
+    stackProbe = JS_Eval(ctx, kStackProbe, sizeof(kStackProbe) - 1, "<watchdog>", JS_EVAL_TYPE_GLOBAL);
+    JS_SetInterruptHandler(rt, interrupt_handler, this);
+
+    if (!schedOptions.eventDriven) {
+        uv_check_start(&check_handle, check_cb);
+        uv_idle_start(&idle_handle, idle_cb);
+    }
+}
+
+// Runtime 里所有对象都得先放掉，JS_FreeRuntime 才不会在 gc_obj_list 非空的断言上挂掉：
+// 挂起的微任务、定时器持有的回调和参数、onMessage 的缓存引用、队列里没执行的任务。
+void JSCore::freeRuntime() {
+    uv_check_stop(&check_handle);
+    uv_idle_stop(&idle_handle);
+
+    // 微任务里可能还会注册定时器，先跑完再清定时器。closing 已经置位，invoke/publish 会直接返回。
+    // 这里不受每轮预算限制，必须跑空：留在 job_list 上的微任务会持有对象，Runtime 就释放不掉了
+    drainPendingJobs();
+    // 定时器状态不在 JS 堆上，回调和参数的引用在这里同步放掉，句柄留给 closeHandles
+    timeoutFree(ctx);
+    schedulerFree(ctx);
+    animationFrameFree(ctx);
+    frameRequested = false;
+    uv_timer_stop(&frame_timer);
+
+    releaseMessageHandler();
+    releaseAsyncCalls();
+    // 页面都要关了，没 flush 的 publish 直接丢掉
+    publishBatcher.clear();
+    clearTasks();
+    JS_SetInterruptHandler(rt, nullptr, nullptr);
+    JS_FreeValue(ctx, stackProbe);
+    stackProbe = JS_UNDEFINED;
+    // 上面释放回调时可能又 resolve 了 Promise
+    drainPendingJobs();
+
+    JS_FreeContext(ctx);
+    ctx = nullptr;
+    JS_RunGC(rt);
+
+    JSMemoryUsage usage;
+    JS_ComputeMemoryUsage(rt, &usage);
+    if (usage.obj_count != 0 || usage.shape_count != 0 || usage.js_func_count != 0) {
+        // 还有对象活着说明有引用没还，此时 JS_FreeRuntime 会断言失败，宁可泄漏这个 Runtime 也不能让进程崩掉
+        OHError("core runtime leak, objects: %{public}lld shapes: %{public}lld functions: %{public}lld",
+                (long long)usage.obj_count, (long long)usage.shape_count, (long long)usage.js_func_count);
+    } else {
+        JS_FreeRuntime(rt);
+    }
+    rt = nullptr;
+}
+
+void JSCore::closeLoop() {
+    uv_walk(js_loop, [](uv_handle_t *handle, void *arg) {
+        if (!uv_is_closing(handle)) {
+            uv_close(handle, nullptr);
+        }
+    }, nullptr);
+    // 没有活动句柄之后 uv_run 返回，所有 close 回调都已执行
+    uv_run(js_loop, UV_RUN_DEFAULT);
+    uv_loop_close(js_loop);
+    free(js_loop);
+    js_loop = nullptr;
 }
 
 // 静态回调函数实现，作为桥接
@@ -159,90 +727,409 @@ void JSCore::check_cb(uv_check_t *handle) {
     core->check_cb_impl(handle);
 }
 
-// 实例回调方法实现
-void JSCore::destroy_cb_impl(uv_async_t *handle) {
-    thread::id this_id = this_thread::get_id();
-    OHWarn("core destroy begin %{public}d", this_id);
-
-    running = false;
-    closing = true;
-    clearAllTimers(ctx);
+void JSCore::timer_cb(uv_timer_t *handle) {
+    JSCore *core = static_cast<JSCore *>(handle->data);
+    if (core->ctx) {
+        runTimers(core->ctx);
+    }
+}
 
-    if (js_loop) {
-        uv_stop(js_loop);
+void JSCore::immediate_cb(uv_check_t *handle) {
+    JSCore *core = static_cast<JSCore *>(handle->data);
+    if (core->ctx) {
+        runImmediates(core->ctx);
+    }
+}
 
-        if (!uv_is_closing((uv_handle_t *)&idle_handle)) {
-            uv_close((uv_handle_t *)&idle_handle, NULL);
-        }
-        if (!uv_is_closing((uv_handle_t *)&prepare_handle)) {
-            uv_close((uv_handle_t *)&prepare_handle, NULL);
-        }
-        if (!uv_is_closing((uv_handle_t *)&check_handle)) {
-            uv_close((uv_handle_t *)&check_handle, NULL);
-        }
+void JSCore::frame_cb(uv_async_t *handle) {
+    JSCore *core = static_cast<JSCore *>(handle->data);
+    uint64_t frameTimeNs = core->pendingVsyncNs.exchange(0, std::memory_order_relaxed);
+    if (!frameTimeNs || !core->ctx) {
+        return;
+    }
+    core->lastVsyncNs = uv_hrtime();
+    // 宿主一直在推，没人要帧时只记一下时间
+    if (core->frameRequested && !core->suspended) {
+        core->runFrame(frameTimeNs, false);
+    }
+}
 
-        // 等待事件循环彻底停止
-        uv_run(js_loop, UV_RUN_NOWAIT);
-        // 释放事件循环
-        uv_loop_close(js_loop);
-        free(js_loop);
-        js_loop = nullptr;
+void JSCore::frame_timer_cb(uv_timer_t *handle) {
+    JSCore *core = static_cast<JSCore *>(handle->data);
+    if (core->ctx) {
+        core->runFrame(uv_hrtime(), true);
     }
+}
 
-    if (ctx) {
-        JS_FreeContext(ctx);
-        ctx = nullptr;
+void JSCore::requestFrame() {
+    frameRequested = true;
+    if (suspended || !js_loop || uv_is_active((uv_handle_t *)&frame_timer)) {
+        return;
     }
+    uint64_t now = uv_hrtime();
+    uint64_t timeoutMs;
+    if (lastVsyncNs && (now - lastVsyncNs) / 1000000 < kVsyncStaleMs) {
+        // 等 vsync；这个定时器只在宿主停推时才会到期
+        timeoutMs = kVsyncStaleMs - (now - lastVsyncNs) / 1000000;
+    } else {
+        uint64_t sinceFrame = now - lastFrameNs;
+        timeoutMs = sinceFrame >= kFrameIntervalNs ? 0 : (kFrameIntervalNs - sinceFrame + 999999) / 1000000;
+    }
+    uv_timer_start(&frame_timer, frame_timer_cb, timeoutMs, 0);
+}
 
-    // 检查 JS 运行时是否存在，然后销毁
-    // fixme 如果直接调用 JS_FreeRuntime 会导致 assert(list_empty(&rt->gc_obj_list)); 报错所以注释了。
-    // fixme 当前 pthread_exit 已经可以确保整个线程退出了，精细化管理 qtr 可以暂时不做
-    //    if (rt) {
-    //        JS_FreeRuntime(rt);
-    //        rt = nullptr;
-    //    }
+// 一帧：先跑 rAF 回调（回调之间跑微任务），按帧 flush 时再把这一帧攒下的 publish 一起交给 ArkTS
+void JSCore::runFrame(uint64_t frameTimeNs, bool fallback) {
+    frameRequested = false;
+    uv_timer_stop(&frame_timer);
+    lastFrameNs = uv_hrtime();
+    stats.frames.fetch_add(1, std::memory_order_relaxed);
+    if (fallback) {
+        stats.fallbackFrames.fetch_add(1, std::memory_order_relaxed);
+    }
+    runAnimationFrames(ctx, static_cast<double>(frameTimeNs) / 1e6);
+    if (frameAlignedPublish) {
+        publishBatcher.flush(ctx);
+    }
+    // 回调里登记的下一帧再跑
+    if (hasPendingAnimationFrames(ctx)) {
+        requestFrame();
+    }
+}
 
-    std::queue<std::string> emptyQueue;
-    jsTaskQueue.swap(emptyQueue);
+// 实例回调方法实现
+// 独立线程模式这里只停事件循环，真正的释放回到 startEngine 里 uv_run 返回之后做：uv_run 不可重入，
+// 不能在回调里再跑循环等句柄关闭。
+void JSCore::destroy_cb_impl(uv_async_t *handle) {
+    thread::id this_id = this_thread::get_id();
+    OHWarn("core destroy %{public}d", this_id);
 
-    OHWarn("core destroy end %{public}d", this_id);
-    pthread_exit(NULL);
+    running = false;
+    closing = true;
+    // running 清掉之后不会再有新的 uv_async_send，等正在发的那几个做完，之后才能关句柄、释放 JSCore
+    quiesceNotifiers();
+    if (!hosted) {
+        uv_stop(js_loop);
+        return;
+    }
+    // 共享模式：就地释放 Runtime，再关掉自己的句柄，事件循环留给 worker 上的其他引擎
+    freeRuntime();
+    closeHandles([this]() { onHostDetached(this); });
 }
 
 void JSCore::prepare_cb_impl(uv_prepare_t *handle) {
+    // prepare 每轮循环恰好执行一次，用它数循环轮数
+    stats.loopIterations.fetch_add(1, std::memory_order_relaxed);
     processPendingJobs();
+    // 这一轮的任务、定时器、微任务都跑完了，线程睡下去之前把攒着的 publish 交出去；
+    // 按帧 flush 时留给下一帧，后台不出帧，照常按轮交
+    if (frameAlignedPublish && !suspended) {
+        if (!publishBatcher.empty()) {
+            requestFrame();
+        }
+    } else {
+        publishBatcher.flush(ctx);
+    }
 
-    if (jsTaskQueue.empty()) {
+    // 还有 immediate 时 idle 保持活跃，poll 不阻塞，check 阶段马上接着跑；挂起期间 immediate 不算
+    if (!hasPendingTasks() && (suspended || !hasPendingImmediates(ctx))) {
         uv_idle_stop(&idle_handle);
     }
 }
 
+void JSCore::keepPolling() {
+    if (!uv_is_active((uv_handle_t *)&idle_handle)) {
+        uv_idle_start(&idle_handle, idle_cb);
+    }
+}
+
 void JSCore::idle_cb_impl(uv_idle_t *handle) {
     // 可以留空，或执行低优先级任务
 }
 
 void JSCore::js_task_cb_impl(uv_async_t *handle) {
-    if (!uv_is_active((uv_handle_t *)&idle_handle)) {
-        uv_idle_start(&idle_handle, idle_cb);
+    stats.wakeups.fetch_add(1, std::memory_order_relaxed);
+    if (!schedOptions.eventDriven) {
+        if (!uv_is_active((uv_handle_t *)&idle_handle)) {
+            uv_idle_start(&idle_handle, idle_cb);
+        }
+        return;
+    }
+    // 预算用完还有剩余任务时给自己再发一次通知：下一轮先跑到期的定时器和 I/O，再回来接着执行，
+    // 而且 poll 只在这一轮不阻塞，队列空了之后照常睡在 epoll 上。
+    // 生产者总是先入队再 uv_async_send，所以这里看到队列为空之后新来的任务一定会再触发一次回调。
+    if (drainTasks()) {
+        uv_async_send(&eval_handle);
     }
 }
 
 void JSCore::check_cb_impl(uv_check_t *handle) {
-    std::string script;
-    {
-        std::lock_guard<std::mutex> lock(queueMutex);
-        if (!jsTaskQueue.empty()) {
-            script = jsTaskQueue.front();
-            jsTaskQueue.pop();
-        } else {
-            return;
+    // 预算用完还有剩余任务时 idle 保持活跃，uv_run 不会阻塞在 poll 上，下一轮接着执行。
+    drainTasks();
+}
+
+// 一轮循环里连续执行队列中的任务，直到队列空了或者预算用完。返回是否还有剩余任务。
+// 任务之间跑一次微任务，保证每条消息触发的 Promise 回调在下一条消息之前完成，和逐条执行时的时序一致；
+// 微任务超出预算时这一轮就不再取新任务。
+bool JSCore::drainTasks() {
+    // 销毁流程里还会跑一轮循环，那时候已经不再执行任务
+    if (!running) {
+        return false;
+    }
+    uint64_t deadline = uv_hrtime() + schedOptions.maxTimeUs * 1000;
+    for (uint32_t count = 0; count < schedOptions.maxTasks; count++) {
+        JSTask task;
+        uint64_t depth = stats.queueDepth.load(std::memory_order_relaxed);
+        if (!popTask(task)) {
+            return false;
+        }
+        uint64_t start = uv_hrtime();
+        stats.recordDequeue((start - task.enqueueNs) / 1000, depth);
+        bool watching = beginWatch(taskKindName(task.type));
+        executeJavaScript(task);
+        if (watching) {
+            endWatch();
+        }
+        uint64_t evalEnd = uv_hrtime();
+        stats.evalUs.record((evalEnd - start) / 1000);
+        // 微任务预算用完时先停下，剩下的微任务在下一轮 prepare 里跑完，再接着执行后面的任务
+        bool jobsRemaining = processPendingJobs();
+
+        uint64_t now = uv_hrtime();
+        stats.recordTaskDone(now);
+        uint64_t executed = stats.tasksExecuted.load(std::memory_order_relaxed);
+        if (executed % 1000 == 0) {
+            OHLog("scheduler tasks: %{public}llu loops: %{public}llu wakeups: %{public}llu "
+                  "wait p99: %{public}lluus eval p99: %{public}lluus",
+                  (unsigned long long)executed,
+                  (unsigned long long)stats.loopIterations.load(std::memory_order_relaxed),
+                  (unsigned long long)stats.wakeups.load(std::memory_order_relaxed),
+                  (unsigned long long)stats.queueWaitUs.percentile(99),
+                  (unsigned long long)stats.evalUs.percentile(99));
+        }
+        if (jobsRemaining || now >= deadline) {
+            break;
+        }
+    }
+    return hasPendingTasks();
+}
+
+JSSchedulerStats JSCore::getSchedulerStats() {
+    JSSchedulerStats result;
+    result.loopIterations = stats.loopIterations.load(std::memory_order_relaxed);
+    result.wakeups = stats.wakeups.load(std::memory_order_relaxed);
+    result.tasksExecuted = stats.tasksExecuted.load(std::memory_order_relaxed);
+    return result;
+}
+
+void JSCore::pushTask(JSTask &&task) {
+    task.enqueueNs = uv_hrtime();
+    int priority = static_cast<int>(task.priority);
+    TaskLane &lane = lanes[priority];
+    // 先计数再入队，消费者出队时减，不会减到负数
+    stats.queueDepth.fetch_add(1, std::memory_order_relaxed);
+    stats.laneDepth[priority].fetch_add(1, std::memory_order_relaxed);
+    if (!lane.overflowing.load(std::memory_order_acquire) && lane.ring.tryPush(task)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(lane.queueMutex);
+    if (lane.overflowQueue.empty()) {
+        OHWarn("task ring %{public}d full, spill to overflow queue", priority);
+    }
+    lane.overflowing.store(true, std::memory_order_release);
+    lane.overflowQueue.push(std::move(task));
+}
+
+// 先看各 lane 队头：有等过了老化时间的 Normal / Background 任务就取其中等得最久的，
+// 否则取优先级最高的非空 lane。
+bool JSCore::popTask(JSTask &task) {
+    uint64_t now = uv_hrtime();
+    const uint64_t agingNs[kTaskPriorityCount] = {
+        UINT64_MAX, schedOptions.normalAgingUs * 1000, schedOptions.backgroundAgingUs * 1000};
+    int highest = -1;
+    int aged = -1;
+    uint64_t agedEnqueueNs = UINT64_MAX;
+    for (int priority = 0; priority < kTaskPriorityCount; priority++) {
+        uint64_t enqueueNs;
+        if (!laneHead(priority, enqueueNs)) {
+            continue;
         }
+        if (highest == -1) {
+            highest = priority;
+        }
+        if (now - enqueueNs >= agingNs[priority] && enqueueNs < agedEnqueueNs) {
+            aged = priority;
+            agedEnqueueNs = enqueueNs;
+        }
+    }
+    if (highest == -1) {
+        return false;
+    }
+    if (aged != -1 && aged != highest) {
+        stats.agedTasks.fetch_add(1, std::memory_order_relaxed);
+        return popLane(aged, task);
+    }
+    return popLane(highest, task);
+}
+
+bool JSCore::laneHead(int priority, uint64_t &enqueueNs) {
+    TaskLane &lane = lanes[priority];
+    // 环里的任务都早于 overflowQueue 里的，先看环
+    if (JSTask *head = lane.ring.front()) {
+        enqueueNs = head->enqueueNs;
+        return true;
+    }
+    if (!lane.overflowing.load(std::memory_order_acquire)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(lane.queueMutex);
+    if (lane.overflowQueue.empty()) {
+        return false;
+    }
+    enqueueNs = lane.overflowQueue.front().enqueueNs;
+    return true;
+}
+
+bool JSCore::popLane(int priority, JSTask &task) {
+    TaskLane &lane = lanes[priority];
+    bool popped = lane.ring.tryPop(task);
+    if (!popped && lane.overflowing.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(lane.queueMutex);
+        if (!lane.overflowQueue.empty()) {
+            task = std::move(lane.overflowQueue.front());
+            lane.overflowQueue.pop();
+            popped = true;
+        }
+        if (lane.overflowQueue.empty()) {
+            lane.overflowing.store(false, std::memory_order_release);
+        }
+    }
+    if (popped) {
+        stats.queueDepth.fetch_sub(1, std::memory_order_relaxed);
+        stats.laneDepth[priority].fetch_sub(1, std::memory_order_relaxed);
+    }
+    return popped;
+}
+
+bool JSCore::hasPendingTasks() {
+    for (TaskLane &lane : lanes) {
+        if (!lane.ring.empty() || lane.overflowing.load(std::memory_order_acquire)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t JSCore::pendingTaskCount() {
+    size_t count = 0;
+    for (TaskLane &lane : lanes) {
+        count += lane.ring.size();
+        std::lock_guard<std::mutex> lock(lane.queueMutex);
+        count += lane.overflowQueue.size();
+    }
+    return count;
+}
+
+void JSCore::clearTasks() {
+    JSTask task;
+    while (popTask(task)) {
     }
-    executeJavaScript(script);
 }
 
 // C 兼容的接口函数实现
 extern "C" {
+    void js_core_process_pending_jobs(JSContext* ctx) {
+        JSCore* core = static_cast<JSCore*>(JS_GetContextOpaque(ctx));
+        if (core) {
+            core->processPendingJobs();
+        }
+    }
+
+    int js_core_begin_task(JSContext* ctx, const char* kind) {
+        JSCore* core = static_cast<JSCore*>(JS_GetContextOpaque(ctx));
+        return core && core->beginWatch(kind) ? 1 : 0;
+    }
+
+    void js_core_end_task(JSContext* ctx) {
+        JSCore* core = static_cast<JSCore*>(JS_GetContextOpaque(ctx));
+        if (core) {
+            core->endWatch();
+        }
+    }
+
+    void js_core_arm_timer(JSContext* ctx, uint64_t timeoutMs) {
+        JSCore* core = static_cast<JSCore*>(JS_GetContextOpaque(ctx));
+        if (!core || !core->js_loop) {
+            return;
+        }
+        if (timeoutMs == UINT64_MAX) {
+            uv_timer_stop(&core->timer_handle);
+        } else {
+            uv_timer_start(&core->timer_handle, JSCore::timer_cb, timeoutMs, 0);
+        }
+    }
+
+    void js_core_arm_immediates(JSContext* ctx, int pending) {
+        JSCore* core = static_cast<JSCore*>(JS_GetContextOpaque(ctx));
+        if (!core || !core->js_loop) {
+            return;
+        }
+        // 挂起期间只排队，resume 时再启动
+        if (!pending || core->suspended) {
+            uv_check_stop(&core->immediate_handle);
+            return;
+        }
+        uv_check_start(&core->immediate_handle, JSCore::immediate_cb);
+        core->keepPolling();
+    }
+
+    void js_core_request_frame(JSContext* ctx) {
+        JSCore* core = static_cast<JSCore*>(JS_GetContextOpaque(ctx));
+        if (core) {
+            core->requestFrame();
+        }
+    }
+
+    void* js_core_get_frames(JSContext* ctx) {
+        JSCore* core = static_cast<JSCore*>(JS_GetContextOpaque(ctx));
+        return core ? core->frames : nullptr;
+    }
+
+    void js_core_set_frames(JSContext* ctx, void* frames) {
+        JSCore* core = static_cast<JSCore*>(JS_GetContextOpaque(ctx));
+        if (core) {
+            core->frames = frames;
+        }
+    }
+
+    void* js_core_get_immediates(JSContext* ctx) {
+        JSCore* core = static_cast<JSCore*>(JS_GetContextOpaque(ctx));
+        return core ? core->immediates : nullptr;
+    }
+
+    void js_core_set_immediates(JSContext* ctx, void* immediates) {
+        JSCore* core = static_cast<JSCore*>(JS_GetContextOpaque(ctx));
+        if (core) {
+            core->immediates = immediates;
+        }
+    }
+
+    void js_core_report_exception(JSContext* ctx) {
+        exceptionLogFunc(ctx);
+    }
+
+    void* js_core_get_timers(JSContext* ctx) {
+        JSCore* core = static_cast<JSCore*>(JS_GetContextOpaque(ctx));
+        return core ? core->timers : nullptr;
+    }
+
+    void js_core_set_timers(JSContext* ctx, void* timers) {
+        JSCore* core = static_cast<JSCore*>(JS_GetContextOpaque(ctx));
+        if (core) {
+            core->timers = timers;
+        }
+    }
+
     uv_loop_t* js_core_get_loop_from_ctx(JSContext* ctx) {
         JSCore* core = static_cast<JSCore*>(JS_GetContextOpaque(ctx));
         if (core) {
@@ -9,28 +9,184 @@
 
 #include "quickjs.h"
 #include "napi/native_api.h"
+#include "bridge_queue.h"
+#include "engine_stats.h"
+#include "publish_batch.h"
+#include "task_queue.h"
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <mutex>
 #include <queue>
 #include <string>
+#include <unordered_map>
 #include <uv.h>
+#include <vector>
 
 // 为 C 文件提供的 API
 #ifdef __cplusplus
 extern "C" {
 #endif
     uv_loop_t* js_core_get_loop_from_ctx(JSContext* ctx);
+    // 按 JSCore 的微任务预算执行挂起的 Promise 任务
+    void js_core_process_pending_jobs(JSContext* ctx);
+    // 定时器回调等 C 代码里的执行段也纳入长任务监控。begin 返回 0 表示外层已经在监控，不用 end。
+    int js_core_begin_task(JSContext* ctx, const char* kind);
+    void js_core_end_task(JSContext* ctx);
+    // settimeout.c 的定时器共用 JSCore 的一个 uv_timer_t：timeoutMs 毫秒后回调 runTimers，UINT64_MAX 表示停掉
+    void js_core_arm_timer(JSContext* ctx, uint64_t timeoutMs);
+    // settimeout.c 的定时器状态，JSCore 只负责存放
+    void* js_core_get_timers(JSContext* ctx);
+    void js_core_set_timers(JSContext* ctx, void* timers);
+    // scheduler.c 的 setImmediate / 端口消息共用 JSCore 的一个 uv_check_t：pending 非 0 时在 check 阶段
+    // 回调 runImmediates，同时让 poll 不阻塞
+    void js_core_arm_immediates(JSContext* ctx, int pending);
+    void* js_core_get_immediates(JSContext* ctx);
+    void js_core_set_immediates(JSContext* ctx, void* immediates);
+    // 回调抛出的异常交给 exceptionLogFunc
+    void js_core_report_exception(JSContext* ctx);
+    // animationframe.c 有回调登记时调用，等下一帧（宿主的 vsync，或者兜底定时器）回调 runAnimationFrames
+    void js_core_request_frame(JSContext* ctx);
+    void* js_core_get_frames(JSContext* ctx);
+    void js_core_set_frames(JSContext* ctx, void* frames);
 #ifdef __cplusplus
 }
 #endif
 
+enum class JSTaskType {
+    Script,  // dispatchJsTask / dispatchJsTaskAb 的脚本
+    File,    // 预热池预先读好的 bundle，执行时走字节码缓存
+    Path,    // dispatchJsTaskPath 的路径，在 JS 线程读文件再按 File 执行，ArkTS 主线程不碰文件
+    Message, // dispatchJsMessage 的 JSON，直接交给 DiminaServiceBridge.onMessage
+    InvokeResult, // invokeAsync 的宿主返回值，兑现 callId 对应的 Promise
+    Suspend, // suspendEngine：切到后台，冻结定时器和 immediate，GC 后收缩缓冲区
+    Resume,  // resumeEngine：恢复定时器，到期时间按挂起时长顺延
+};
+
+// 任务优先级，数值越小越先执行。每个优先级一条独立的队列（lane），同一条 lane 内保持 FIFO。
+// 低优先级任务排队超过 JSSchedulerOptions 里的老化时间后提到最前面，不会被一直饿着。
+enum class JSTaskPriority : uint8_t {
+    UserBlocking = 0, // 点击、输入等用户交互事件
+    Normal = 1,       // 生命周期、API 回调，以及没有指定优先级的任务
+    Background = 2,   // 批量数据、预加载等不着急的工作
+};
+constexpr int kTaskPriorityCount = 3;
+
+// 队列里的一条任务。File 类型的 path 用来做缓存 key，也作为文件名，错误堆栈能指回具体的 bundle。
+// 只能移动不能拷贝：napi 层读出来的那一份 code 一路移到 JS_Eval，中间不再复制。
+struct JSTask {
+    JSTaskType type = JSTaskType::Script;
+    std::string code;
+    std::string path;
+    JSTaskPriority priority = JSTaskPriority::Normal;
+    // 入队时刻（uv_hrtime），出队时算排队等待时间，也用来判断老化
+    uint64_t enqueueNs = 0;
+    // InvokeResult 用：code 是返回值的 JSON（空串为 undefined），rejected 时是错误信息
+    uint32_t callId = 0;
+    bool rejected = false;
+    // Path 用：执行完通过 postPathLoaded 兑现。引擎在执行前销毁的话任务被丢掉，Promise 由 destroyJsEngine reject
+    napi_deferred deferred = nullptr;
+
+    JSTask() = default;
+    JSTask(JSTaskType type, std::string code, std::string path = std::string())
+        : type(type), code(std::move(code)), path(std::move(path)) {}
+    JSTask(JSTask &&) = default;
+    JSTask &operator=(JSTask &&) = default;
+    JSTask(const JSTask &) = delete;
+    JSTask &operator=(const JSTask &) = delete;
+};
+
+// 一次最多连续执行多少任务、占用多长时间，先到哪个算哪个。
+// 剩下的留到下一轮循环，中间让定时器和 I/O 有机会执行。maxTasks 为 1 就是逐条执行的老行为。
+// eventDriven 为 true 时在 eval_handle 的回调里直接执行任务，没有任务就阻塞在 epoll 上；
+// 为 false 时沿用 idle + check 的老调度，有任务期间 poll 超时为 0，线程一直空转。
+struct JSSchedulerOptions {
+    uint32_t maxTasks = 64;
+    uint64_t maxTimeUs = 8000;
+    bool eventDriven = true;
+    // 不单独起线程，挂到共享的 JSWorker 上（M:N），此时总是 eventDriven
+    bool sharedWorker = false;
+    // Normal / Background 任务排队超过这么久就优先于更高优先级的任务执行
+    uint64_t normalAgingUs = 50000;
+    uint64_t backgroundAgingUs = 200000;
+    // 单个任务执行超过 longTaskUs 记一条长任务；超过 taskHardLimitUs 直接中断，0 表示不中断
+    uint64_t longTaskUs = 50000;
+    uint64_t taskHardLimitUs = 0;
+    // 一次连续执行微任务的预算，个数和时间先到哪个算哪个，剩下的留到下一轮循环
+    uint32_t maxMicrotasks = 1000;
+    uint64_t microtaskTimeUs = 8000;
+    // publish 按 webViewId 合并，每轮循环结束时一起交给 ArkTS。单个 webViewId 攒够 maxBytes
+    // 或者最早一条等了 deadlineUs 就提前 flush，0 表示不按这个条件
+    bool publishBatching = false;
+    uint32_t publishBatchMaxBytes = 256 * 1024;
+    uint64_t publishBatchDeadlineUs = 16000;
+    // invoke / invokeAsync 发给 ArkTS 的消息用二进制编码（见 wire_format.h），ArkTS 收到的是解好的对象。
+    // 反方向不需要协商：dispatchJsMessage 按首字节区分 JSON 和二进制
+    bool binaryWire = false;
+    // 发给 ArkTS 还没处理完的消息按种类限条数，满了 invoke 阻塞、publish 按页面合并、日志丢最老的（见 bridge_queue.h）。
+    // 0 表示不限
+    uint32_t invokeQueueLimit = 64;
+    uint32_t publishQueueLimit = 64;
+    uint32_t logQueueLimit = 128;
+    // 攒着的 publish 不在每轮循环结束时交出去，而是等下一帧、跑完 requestAnimationFrame 回调之后一起交，
+    // 每帧最多一次。只在 publishBatching 开启时有效，maxBytes / deadline 照常提前 flush；挂起期间按轮 flush
+    bool frameAlignedPublish = false;
+};
+
+// 一条长任务记录
+struct JSLongTaskEvent {
+    std::string kind;        // script / file / message / timer / immediate / frame / microtask
+    int64_t startTimeMs = 0; // 开始时间，毫秒时间戳，方便和日志对上
+    uint64_t durationUs = 0;
+    // 超时那一刻的 Error().stack。一直卡在 native 调用里、没回到解释器的任务拿不到，为空
+    std::string stack;
+    bool aborted = false;    // 超过 taskHardLimitUs 被中断
+};
+
+// 调度计数的快照，来自 JSEngineStats。loopIterations / tasksExecuted 就是每个任务摊到的循环轮数。
+class JSEngine;
+
+struct JSSchedulerStats {
+    uint64_t loopIterations = 0;
+    uint64_t wakeups = 0;
+    uint64_t tasksExecuted = 0;
+};
+
 class JSCore {
 public:
     JSCore();
+    explicit JSCore(const JSSchedulerOptions &options);
     ~JSCore();
     
-    bool executeJavaScript(const std::string &code);
-    void processPendingJobs();
-    void *startEngine(int index, std::function<void(JSContext *ctx)> registerFunc);
+    bool executeJavaScript(const JSTask &task);
+    bool dispatchMessage(const std::string &payload);
+    // 按微任务预算执行，返回是否还有剩余
+    bool processPendingJobs();
+
+    // invokeAsync：登记 Promise 的 resolve/reject（接管引用），返回 callId。
+    // 宿主处理完把结果作为 InvokeResult 任务投回来，settleAsyncCall 在 JS 线程兑现。
+    uint32_t addAsyncCall(JSValue resolve, JSValue reject);
+    bool settleAsyncCall(const JSTask &task);
+
+    // DiminaServiceBridge.onMessage 是 native 访问器，赋值时在这里留一份引用，
+    // 派发消息不用每次解析 "DiminaServiceBridge.onMessage(...)" 脚本，也不用查属性。
+    JSValue getMessageHandler();
+    void setMessageHandler(JSValueConst bridge, JSValueConst handler);
+    // 引擎线程的主函数。每个 Runtime 的生命周期是：创建 -> 跑事件循环直到 destroy -> 完整释放。
+    // 释放后调用 recycleFunc，返回 true 就在同一个线程和事件循环上重建 Runtime，否则关闭循环、线程返回。
+    void *startEngine(int index, std::function<void(JSContext *ctx)> registerFunc,
+                      std::function<bool()> recycleFunc = nullptr);
+    JSSchedulerStats getSchedulerStats();
+    // 任意线程直接读，不经过 JS 线程
+    const JSEngineStats &getEngineStats() {
+        return stats;
+    };
+    // 最近的长任务，任意线程可读
+    std::vector<JSLongTaskEvent> getLongTasks();
+
+    // 长任务监控，只在 JS 线程调用。同一时刻只监控最外层的一段，嵌套的 begin 返回 false，也不用 end。
+    bool beginWatch(const char *kind);
+    void endWatch();
     
     void destroy_cb_impl(uv_async_t *handle);
     void prepare_cb_impl(uv_prepare_t *handle);
@@ -43,21 +199,79 @@ public:
     static void idle_cb(uv_idle_t *handle);
     static void js_task_cb(uv_async_t *handle);
     static void check_cb(uv_check_t *handle);
+    static void timer_cb(uv_timer_t *handle);
+    static void immediate_cb(uv_check_t *handle);
+    static void frame_cb(uv_async_t *handle);
+    static void frame_timer_cb(uv_timer_t *handle);
+    // 有 immediate 排队时调用：启动 idle 让 poll 不阻塞，prepare 里看没有剩余工作了再停
+    void keepPolling();
+    // 宿主推来的 vsync，任意线程调用。frameTimeNs 和 uv_hrtime 是同一个单调时钟；
+    // JS 线程来不及处理时连续几帧合并成最新的一帧
+    void onVsync(uint64_t frameTimeNs);
+    // JS 线程调用：有 rAF 回调或者按帧 flush 的 publish 在等下一帧。宿主最近推过 vsync 就等 vsync，
+    // 同时设一个兜底定时器，宿主停推（页面不可见、没接 vsync）时按 60Hz 的单调时钟出帧
+    void requestFrame();
     
     bool starting;
-    bool running;
+    // 引擎线程写、任意线程读，和 destroyRequested 一起保证销毁通知不会丢
+    std::atomic<bool> running;
+    // 线程还没起来时请求销毁，由 startEngine 初始化完成后自己补发 destroy_handle
+    std::atomic<bool> destroyRequested{false};
     bool closing;
+    // JS 线程写，任意线程读。挂起期间任务照常执行，定时器和 immediate 不触发
+    std::atomic<bool> suspended{false};
 
     JSContext* getContext() {
         return ctx;
     };
 
-    std::mutex queueMutex;
-    std::queue<std::string> jsTaskQueue;
+    // 只在 JS 线程使用（configure 除外），桥接函数的 publish 往这里攒
+    PublishBatcher publishBatcher;
+    // 任意线程写，JS 线程的桥接函数读
+    std::atomic<bool> binaryWire{false};
+    // 任意线程写，JS 线程读，见 JSSchedulerOptions::frameAlignedPublish
+    std::atomic<bool> frameAlignedPublish{false};
+    // onMessageCb 里的消息持有它的引用，引擎销毁之后还能归还名额
+    std::shared_ptr<BridgeQueue> bridgeQueue = std::make_shared<BridgeQueue>();
+
+    // 所属的 JSEngine，创建后不变。桥接函数从 ctx 的 opaque 直接拿到它，不用查表
+    JSEngine *owner = nullptr;
+
+    // 任意线程入队；环形队列满了才退到 overflowQueue
+    void pushTask(JSTask &&task);
+    // 生产者唤醒 JS 线程、请求销毁都走这两个函数，和迁移时关闭句柄做握手
+    void notifyTask();
+    void notifyDestroy();
+
+    // 共享线程模式（M:N）：由 JSWorker 在自己的线程上调用，Runtime 挂到 worker 的事件循环上。
+    // 销毁完成（Runtime 已释放、句柄都已关闭）后在 worker 线程上回调 onHostDetached。
+    void attach(uv_loop_t *loop, const std::function<void(JSContext *ctx)> &registerFunc);
+    std::function<void(JSCore *core)> onHostDetached;
+
+    // 迁移，都在当前宿主 worker 线程上调用。只有 isIdle 时才能迁：没有排队任务、没有微任务、
+    // 没有在跑的定时器。句柄全部关闭后回调 done，之后在目标 worker 线程上 reattach。
+    bool isIdle();
+    // 挂在共享 JSWorker 上：线程不归自己，不能在上面阻塞等 ArkTS
+    bool isHosted() const {
+        return hosted;
+    };
+    void detachForMigration(std::function<void()> done);
+    void reattach(uv_loop_t *loop);
+
     uv_async_t eval_handle;
     uv_async_t destroy_handle;
     
     uv_loop_t *js_loop;
+    // 所有 JS 定时器共用这一个句柄，总是设在最早到期的那个上，由 settimeout.c 的 runTimers 执行
+    uv_timer_t timer_handle;
+    void *timers = nullptr;
+    // setImmediate 和 MessagePort 的消息在 check 阶段由 scheduler.c 的 runImmediates 执行，有排队时才启动
+    uv_check_t immediate_handle;
+    void *immediates = nullptr;
+    // onVsync 唤醒 JS 线程；frame_timer 是宿主没推 vsync 时的兜底。回调由 animationframe.c 的 runAnimationFrames 执行
+    uv_async_t frame_handle;
+    uv_timer_t frame_timer;
+    void *frames = nullptr;
 
 private:
     JSRuntime *rt;
@@ -67,7 +281,88 @@ private:
     uv_prepare_t prepare_handle;
     uv_check_t check_handle;
 
+    // 以下只在 JS 线程调用
+    void initHandles(uv_loop_t *loop);
+    void closeHandles(std::function<void()> done);
+    static void handle_closed_cb(uv_handle_t *handle);
+    void quiesceNotifiers();
+    void createRuntime(const std::function<void(JSContext *ctx)> &registerFunc);
+    void freeRuntime();
+    // 销毁时用：不看预算，把微任务跑空
+    void drainPendingJobs();
+    void closeLoop();
+    bool popTask(JSTask &task);
+    bool hasPendingTasks();
+    bool drainTasks();
+    size_t pendingTaskCount();
+    void clearTasks();
+    bool executePath(const JSTask &task);
+    void suspend();
+    void resume();
+    void runFrame(uint64_t frameTimeNs, bool fallback);
+
+    // 宿主推来、JS 线程还没处理的最新一帧，0 表示没有
+    std::atomic<uint64_t> pendingVsyncNs{0};
+    // 以下只在 JS 线程访问，uv_hrtime
+    uint64_t lastVsyncNs = 0;
+    uint64_t lastFrameNs = 0;
+    bool frameRequested = false;
+
+    // 每个优先级一条 lane。平时只走无锁的 ring，突发消息把它塞满时退到加锁的 overflowQueue，
+    // overflowing 期间新任务也都进 overflowQueue，直到消费者把它取空，这样同一个生产者的任务不会乱序。
+    struct TaskLane {
+        TaskLane(size_t capacity) : ring(capacity) {}
+        MpscRingQueue<JSTask> ring;
+        std::mutex queueMutex;
+        std::queue<JSTask> overflowQueue;
+        std::atomic<bool> overflowing{false};
+    };
+    // 用户交互一般是零星的，lane 小一些
+    TaskLane lanes[kTaskPriorityCount]{{256}, {1024}, {1024}};
+    // lane 队头的入队时刻，空的返回 false
+    bool laneHead(int priority, uint64_t &enqueueNs);
+    bool popLane(int priority, JSTask &task);
+
     bool firstTaskMark = true;
+    JSSchedulerOptions schedOptions;
+
+    // 共享线程模式下没有自己的线程和事件循环
+    bool hosted = false;
+    int openHandles = 0;
+    std::function<void()> handlesClosed;
+    // 正在 uv_async_send 的生产者个数
+    std::atomic<int> notifiers{0};
+
+    JSEngineStats stats;
+
+    JSValue messageBridge = JS_UNDEFINED;
+    JSValue messageHandler = JS_UNDEFINED;
+    void releaseMessageHandler();
+
+    // 等待宿主返回的 invokeAsync，只在 JS 线程访问。Runtime 释放前全部丢弃，Promise 永远不会兑现
+    struct AsyncCall {
+        JSValue resolve;
+        JSValue reject;
+    };
+    std::unordered_map<uint32_t, AsyncCall> asyncCalls;
+    uint32_t nextAsyncCallId = 1;
+    void releaseAsyncCalls();
+
+    // QuickJS 执行一段字节码就回调一次，在这里检查当前任务有没有超时
+    static int interrupt_handler(JSRuntime *rt, void *opaque);
+    int onInterrupt();
+    void captureWatchStack();
+    const char *watchKind = nullptr;
+    uint64_t watchStartNs = 0;
+    bool watchCaptured = false;
+    bool watchAborted = false;
+    bool inInterrupt = false;
+    std::string watchStack;
+    // () => new Error().stack，创建 Runtime 时编译一次，超时时调用它拿调用栈
+    JSValue stackProbe = JS_UNDEFINED;
+
+    std::mutex longTaskMutex;
+    std::deque<JSLongTaskEvent> longTasks;
 };
 
 #endif //DIMINA_HARMONYOS_JS_CORE_H
@@ -10,57 +10,166 @@
 #include "log.h"
 #include "utils.h"
 #include "types/qjs_extension/settimeout.h"
+#include "engine_pool.h"
+#include <condition_variable>
+#include <deque>
 
-JSEngine::JSEngine(int idx, std::function<void(JSContext *ctx)> func) : index(idx), core(nullptr), registerFunc(func) {
+namespace {
+
+// 回收线程：join 已经退出的引擎线程，然后释放 JSEngine/JSCore。
+// 不能在 destroyJsEngine 里直接 join，JS 线程可能正阻塞在 invoke 上等 worker 线程回调，会死锁。
+std::mutex gRetiredMutex;
+std::condition_variable gRetiredCond;
+std::deque<JSEngine *> gRetiredEngines;
+bool gReaperStarted = false;
+
+void reaperLoop() {
+    for (;;) {
+        JSEngine *engine;
+        {
+            std::unique_lock<std::mutex> lock(gRetiredMutex);
+            gRetiredCond.wait(lock, [] { return !gRetiredEngines.empty(); });
+            engine = gRetiredEngines.front();
+            gRetiredEngines.pop_front();
+        }
+        engine->join();
+        OHWarn("engine reaped %{public}p", (void *)engine);
+        delete engine;
+    }
+}
+
+} // namespace
+
+void retireEngine(JSEngine *engine) {
+    std::lock_guard<std::mutex> lock(gRetiredMutex);
+    if (!gReaperStarted) {
+        gReaperStarted = true;
+        std::thread(reaperLoop).detach();
+    }
+    gRetiredEngines.push_back(engine);
+    gRetiredCond.notify_one();
+}
+
+JSEngine::JSEngine(int idx, std::function<void(JSContext *ctx)> func, const JSSchedulerOptions &options)
+    : index(idx), core(nullptr), registerFunc(func), schedOptions(options) {
     if (!core) {
-        OHWarn("engine JSEngine() idx: %{public}d", idx);
-        core = new JSCore();
+        OHWarn("engine JSEngine() idx: %{public}d maxTasks: %{public}u maxTimeUs: %{public}llu eventDriven: %{public}d",
+               idx, options.maxTasks, (unsigned long long)options.maxTimeUs, options.eventDriven ? 1 : 0);
+        core = new JSCore(options);
+        core->owner = this;
+
+        if (options.sharedWorker) {
+            // 共享线程上的引擎不进预热池回收，销毁完直接交给回收线程释放
+            hostWorker = acquireWorker();
+            hostWorker->host(core, registerFunc, [this]() { retireEngine(this); });
+            return;
+        }
 
         pthread_attr_t attr;
         pthread_attr_init(&attr);
         pthread_attr_setstacksize(&attr, 1024 * 1024 * 128);
 
-        pthread_t tid;
-
+        // 线程不再 detach：退出前把引擎交给回收线程，由它 join 之后再 delete
         pthread_create(
             &tid, &attr,
             [](void *arg) -> void * {
                 auto *engine = static_cast<JSEngine *>(arg);
-                engine->core->startEngine(engine->index, engine->registerFunc);
+                engine->core->startEngine(engine->index, engine->registerFunc,
+                                          [engine]() { return engine->recycle(); });
+                retireEngine(engine);
 
                 return nullptr;
             },
             this);
 
-        pthread_detach(tid);
         pthread_attr_destroy(&attr);
     }
 }
 
 // 实现成员函数
-bool JSEngine::executeJavaScript(const std::string &script) {
-    {
-        std::lock_guard<std::mutex> lock(core->queueMutex);
-        core->jsTaskQueue.push(script);
-    }
+bool JSEngine::executeJavaScript(std::string script, JSTaskPriority priority) {
+    return enqueue(JSTask(JSTaskType::Script, std::move(script)), priority);
+}
 
-    if (core->running) {
-        uv_async_send(&(core->eval_handle));
-    }
+bool JSEngine::executeJavaScriptFile(std::string path, std::string script, JSTaskPriority priority) {
+    return enqueue(JSTask(JSTaskType::File, std::move(script), std::move(path)), priority);
+}
+
+bool JSEngine::executeJavaScriptPath(std::string path, napi_deferred deferred, JSTaskPriority priority) {
+    JSTask task(JSTaskType::Path, std::string(), std::move(path));
+    task.deferred = deferred;
+    return enqueue(std::move(task), priority);
+}
+
+bool JSEngine::dispatchMessage(std::string payload, JSTaskPriority priority) {
+    return enqueue(JSTask(JSTaskType::Message, std::move(payload)), priority);
+}
+
+bool JSEngine::deliverInvokeResult(uint32_t callId, bool rejected, std::string json) {
+    JSTask task(JSTaskType::InvokeResult, std::move(json));
+    task.callId = callId;
+    task.rejected = rejected;
+    return enqueue(std::move(task), JSTaskPriority::Normal);
+}
+
+bool JSEngine::suspend() {
+    return enqueue(JSTask(JSTaskType::Suspend, std::string()), JSTaskPriority::Normal);
+}
+
+bool JSEngine::resume() {
+    return enqueue(JSTask(JSTaskType::Resume, std::string()), JSTaskPriority::Normal);
+}
+
+bool JSEngine::enqueue(JSTask &&task, JSTaskPriority priority) {
+    task.priority = priority;
+    core->pushTask(std::move(task));
+    core->notifyTask();
     return true;
 }
 
 
+void JSEngine::setPreloadedPath(const std::string &path) {
+    std::lock_guard<std::mutex> lock(preloadMutex);
+    preloadedPath = path;
+}
+
+bool JSEngine::consumePreloadedPath(const std::string &path) {
+    std::lock_guard<std::mutex> lock(preloadMutex);
+    if (preloadedPath.empty() || preloadedPath != path) {
+        return false;
+    }
+    preloadedPath.clear();
+    return true;
+}
+
 // 停止引擎
 void JSEngine::destroyEngine() {
     closing = true;
     if (core) {
-        OHWarn("engine uv_async_send destroy_handle");
-        uv_async_send(&core->destroy_handle);
+        // destroy_handle 在引擎线程初始化完才可用，还没起来（或者正在迁移）的话由引擎线程就绪后补发
+        OHWarn("engine notify destroy");
+        core->notifyDestroy();
+        // 等名额的 invoke 不会再等到 ArkTS 处理，叫醒让它失败返回
+        core->bridgeQueue->close();
     }
 }
 
 
+void JSEngine::join() {
+    if (hostWorker) {
+        return;
+    }
+    pthread_join(tid, nullptr);
+}
+
+// JS 线程上调用，Runtime 已经完整释放。交给预热池就继续用这个线程，池不要就让线程退出。
+bool JSEngine::recycle() {
+    index = -1;
+    closing = false;
+    setPreloadedPath("");
+    return recycleToEnginePool(this);
+}
+
 // 析构函数
 JSEngine::~JSEngine() {
     if (core) {
@@ -8,18 +8,58 @@
 #define DIMINA_HARMONYOS_JS_ENGINE_H
 
 #include "js_core.h"
+#include "js_worker.h"
 #include "quickjs.h"
 #include "napi/native_api.h"
+#include <pthread.h>
 #include <string>
 
 class JSEngine {
 public:
     JSEngine();
-    JSEngine(int idx, std::function<void(JSContext *ctx)> registerFunc);
+    JSEngine(int idx, std::function<void(JSContext *ctx)> registerFunc, const JSSchedulerOptions &options = JSSchedulerOptions());
     ~JSEngine();
 
-    bool executeJavaScript(const std::string &code);
+    // 参数按值传入并移进任务队列，调用方用 std::move 交出缓冲区就不会再有拷贝。
+    bool executeJavaScript(std::string code, JSTaskPriority priority = JSTaskPriority::Normal);
+    // 文件在 JS 线程上读。deferred 非空时执行完在 ArkTS 线程兑现，结果见 PathLoadResult
+    bool executeJavaScriptPath(std::string path, napi_deferred deferred,
+                               JSTaskPriority priority = JSTaskPriority::Normal);
+    // path 只用来做缓存 key 和错误堆栈里的文件名，内容已经由调用方读好。
+    bool executeJavaScriptFile(std::string path, std::string code,
+                               JSTaskPriority priority = JSTaskPriority::Normal);
+    // payload 是 JSON 文本，在 JS 线程解析后直接调用 DiminaServiceBridge.onMessage。
+    bool dispatchMessage(std::string payload, JSTaskPriority priority = JSTaskPriority::Normal);
+    // invokeAsync 的宿主结果，任意线程调用，排进任务队列由 JS 线程兑现 Promise。
+    // rejected 为 false 时 json 是返回值的 JSON（空串为 undefined），为 true 时是错误信息。
+    bool deliverInvokeResult(uint32_t callId, bool rejected, std::string json);
+    // 切到后台 / 回到前台，任意线程调用。排进 Normal 队列，和 onHide/onShow 等消息保持先后顺序，在 JS 线程上生效
+    bool suspend();
+    bool resume();
+    bool isSuspended() {
+        return core->suspended;
+    };
+    // 宿主的 vsync，任意线程调用，见 JSCore::onVsync
+    void onVsync(uint64_t frameTimeNs) {
+        core->onVsync(frameTimeNs);
+    };
+    // 只发出销毁请求，立即返回。Runtime 在引擎线程上完整释放，之后线程要么被预热池回收复用，
+    // 要么退出并由回收线程 join、delete，调用方不再持有这个指针。
     void destroyEngine();
+    bool recycle();
+    void join();
+    JSSchedulerStats getSchedulerStats() {
+        return core->getSchedulerStats();
+    };
+    const JSEngineStats &getEngineStats() {
+        return core->getEngineStats();
+    };
+    std::vector<JSLongTaskEvent> getLongTasks() {
+        return core->getLongTasks();
+    };
+    const BridgeQueue &getBridgeQueue() {
+        return *core->bridgeQueue;
+    };
     
     std::function<void(JSContext *ctx)> registerFunc;
     
@@ -28,18 +68,67 @@ public:
     };
     
     int getAppIndex() {
-        return index;
+        return index.load(std::memory_order_acquire);
+    };
+
+    // 预热池里的引擎以 -1 启动，StartJsEngine 领走时再绑定 appIndex
+    void bindAppIndex(int appIndex) {
+        index.store(appIndex, std::memory_order_release);
+    };
+
+    // 线程已起来，Runtime/Context/事件循环都初始化完了
+    bool isReady() {
+        return core->running;
+    };
+
+    const JSSchedulerOptions &getSchedulerOptions() {
+        return schedOptions;
+    };
+
+    // 预热池领走时按调用方的参数重新配置桥接相关的选项（publish 合并和按帧 flush、消息编码、队列上限），任意线程调用
+    void applyBridgeOptions(const JSSchedulerOptions &options) {
+        schedOptions.publishBatching = options.publishBatching;
+        schedOptions.publishBatchMaxBytes = options.publishBatchMaxBytes;
+        schedOptions.publishBatchDeadlineUs = options.publishBatchDeadlineUs;
+        schedOptions.binaryWire = options.binaryWire;
+        schedOptions.invokeQueueLimit = options.invokeQueueLimit;
+        schedOptions.publishQueueLimit = options.publishQueueLimit;
+        schedOptions.logQueueLimit = options.logQueueLimit;
+        schedOptions.frameAlignedPublish = options.frameAlignedPublish;
+        core->publishBatcher.configure(options.publishBatching, options.publishBatchMaxBytes,
+                                       options.publishBatchDeadlineUs);
+        core->binaryWire = options.binaryWire;
+        core->frameAlignedPublish = options.frameAlignedPublish;
+        core->bridgeQueue->configure(options.invokeQueueLimit, options.publishQueueLimit, options.logQueueLimit);
     };
+
+    // 预热时已经执行过的脚本。之后第一次 dispatchJsTaskPath 同一路径直接跳过，返回 true。
+    void setPreloadedPath(const std::string &path);
+    bool consumePreloadedPath(const std::string &path);
     
-    bool closing = false;
+    // ArkTS 线程写，JS 线程的桥接函数读
+    std::atomic<bool> closing{false};
     
     bool isCoreClosing() {
         return core->closing;
     };
     
 private:
-    int index;
+    bool enqueue(JSTask &&task, JSTaskPriority priority);
+
+    // 预热池领走时由 ArkTS 线程改写，JS 线程的桥接函数并发读
+    std::atomic<int> index;
     JSCore *core = nullptr;
+    pthread_t tid;
+    // sharedWorker 时挂在这个共享线程上，不单独起线程
+    JSWorker *hostWorker = nullptr;
+    JSSchedulerOptions schedOptions;
+
+    std::mutex preloadMutex;
+    std::string preloadedPath;
 };
 
+// 引擎线程退出前调用，把自己交给回收线程
+void retireEngine(JSEngine *engine);
+
 #endif // DIMINA_HARMONYOS_JS_ENGINE_H
@@ -4,35 +4,26 @@
 #include "napi/native_api.h"
 #include <future>
 #include "utils.h"
+#include "code_cache.h"
+#include "engine_pool.h"
+#include "engine_registry.h"
+#include "js_worker.h"
 #include "types/qjs_extension/settimeout.h"
-#include <sys/mman.h> // 包含 mmap, munmap 等函数
-#include <unistd.h>   // 包含 close 函数
-#include <map>
+#include "wire_format.h"
+#include "bridge_queue.h"
 #include <memory>
+#include <unordered_map>
 
-// 使用 map 存储多个 JSEngine 实例
-std::map<int, JSEngine *> engineMap;
-// 使用 map 存储每个引擎实例对应的线程安全函数
-std::map<int, napi_threadsafe_function> tsfnMap;
 // 引擎是否处于调试模式
 bool isDebugMode = false;
 
-// 获取指定 appIndex 的 JSEngine 实例
+// 引擎和线程安全函数都登记在 engine_registry 里，这两个只是转一下，查找不加锁
 JSEngine *getEngine(int appIndex) {
-    auto it = engineMap.find(appIndex);
-    if (it != engineMap.end()) {
-        return it->second;
-    }
-    return nullptr;
+    return findEngine(appIndex);
 }
 
-// 获取指定 appIndex 的线程安全函数
 napi_threadsafe_function getTsfn(int appIndex) {
-    auto it = tsfnMap.find(appIndex);
-    if (it != tsfnMap.end()) {
-        return it->second;
-    }
-    return nullptr;
+    return findTsfn(appIndex);
 }
 
 
@@ -57,47 +48,178 @@ void discardPendingException(JSContext *ctx) {
 void initBridges(JSContext *ctx);
 void registerInvoke(JSContext *ctx);
 void registerPublish(JSContext *ctx);
+void registerOnMessage(JSContext *ctx);
+void registerFunc(JSContext *ctx);
+
+// invokeAsync 的结果在 ArkTS 线程上转成 JSON 文本（不能在这里碰引擎的 JSContext），
+// 再排进引擎的任务队列，由 JS 线程兑现 Promise。引擎已经销毁就丢掉。
+static void deliverInvokeValue(napi_env env, int appIndex, uint32_t callId, napi_value value, bool rejected) {
+    std::string text;
+    napi_valuetype type = napi_undefined;
+    napi_typeof(env, value, &type);
+    napi_value str = nullptr;
+    if (rejected) {
+        napi_value message = nullptr;
+        bool isError = false;
+        if (napi_is_error(env, value, &isError) == napi_ok && isError) {
+            napi_get_named_property(env, value, "message", &message);
+        }
+        napi_coerce_to_string(env, message ? message : value, &str);
+    } else if (type != napi_undefined) {
+        napi_value global, json, stringify;
+        napi_get_global(env, &global);
+        napi_get_named_property(env, global, "JSON", &json);
+        napi_get_named_property(env, json, "stringify", &stringify);
+        if (napi_call_function(env, json, stringify, 1, &value, &str) != napi_ok) {
+            napi_value err;
+            napi_get_and_clear_last_exception(env, &err);
+            rejected = true;
+            napi_create_string_utf8(env, "invokeAsync: result is not serializable", NAPI_AUTO_LENGTH, &str);
+        }
+    }
+    napi_valuetype strType = napi_undefined;
+    if (str && napi_typeof(env, str, &strType) == napi_ok && strType == napi_string) {
+        size_t length = 0;
+        napi_get_value_string_utf8(env, str, nullptr, 0, &length);
+        text.resize(length);
+        napi_get_value_string_utf8(env, str, &text[0], length + 1, &length);
+    }
 
-struct OnMessageData {
-    napi_async_work asyncWork = nullptr;
-    napi_ref callbackRef = nullptr;
-    int type = 1; // 1 = invoke, 2 = publish , 3 = 日志打印
-    int webViewId = 0;
-    int appIndex = 0; // 添加 appIndex 字段
-    std::promise<JSValue> promise;
-    std::string str;
+    JSEngine *engine = getEngine(appIndex);
+    if (!engine || engine->closing) {
+        OHLog("invokeAsync result dropped, engine gone for appIndex: %{public}d", appIndex);
+        return;
+    }
+    engine->deliverInvokeResult(callId, rejected, std::move(text));
+}
+
+// 宿主返回 Promise 时挂在它的 then 上，兑现后再投回引擎。fulfilled / rejected 只会有一个被调用，由它释放。
+struct AsyncInvokeTarget {
+    int appIndex;
+    uint32_t callId;
 };
 
+static napi_value onHostSettled(napi_env env, napi_callback_info info, bool rejected) {
+    size_t argc = 1;
+    napi_value value = nullptr;
+    void *data = nullptr;
+    napi_get_cb_info(env, info, &argc, &value, nullptr, &data);
+    auto *target = static_cast<AsyncInvokeTarget *>(data);
+    if (argc < 1) {
+        napi_get_undefined(env, &value);
+    }
+    deliverInvokeValue(env, target->appIndex, target->callId, value, rejected);
+    delete target;
+    return nullptr;
+}
+
+static napi_value onHostFulfilled(napi_env env, napi_callback_info info) {
+    return onHostSettled(env, info, false);
+}
+
+static napi_value onHostRejected(napi_env env, napi_callback_info info) {
+    return onHostSettled(env, info, true);
+}
+
+static void settleInvokeAsync(napi_env env, int appIndex, uint32_t callId, napi_value result) {
+    if (!result) {
+        napi_value message;
+        napi_create_string_utf8(env, "invokeAsync: container handler failed", NAPI_AUTO_LENGTH, &message);
+        deliverInvokeValue(env, appIndex, callId, message, true);
+        return;
+    }
+    bool isPromise = false;
+    if (napi_is_promise(env, result, &isPromise) != napi_ok || !isPromise) {
+        deliverInvokeValue(env, appIndex, callId, result, false);
+        return;
+    }
+    auto *target = new AsyncInvokeTarget{appIndex, callId};
+    napi_value then, callbacks[2];
+    napi_get_named_property(env, result, "then", &then);
+    napi_create_function(env, "onFulfilled", NAPI_AUTO_LENGTH, onHostFulfilled, target, &callbacks[0]);
+    napi_create_function(env, "onRejected", NAPI_AUTO_LENGTH, onHostRejected, target, &callbacks[1]);
+    napi_value chained;
+    if (napi_call_function(env, result, then, 2, callbacks, &chained) != napi_ok) {
+        napi_value err;
+        napi_get_and_clear_last_exception(env, &err);
+        delete target;
+        napi_value message;
+        napi_create_string_utf8(env, "invokeAsync: failed to await container result", NAPI_AUTO_LENGTH, &message);
+        deliverInvokeValue(env, appIndex, callId, message, true);
+    }
+}
+
+static void deliverMessage(napi_env env, napi_value js_cb, OnMessageData *asyncContext);
+static void settlePathLoaded(napi_env env, OnMessageData *asyncContext);
+
 // 定义一个回调函数 onMessageCb，参数包括环境env，回调函数js_cb，上下文context，数据data
 static void onMessageCb(napi_env env, napi_value js_cb, void *context, void *data) {
+    auto *asyncContext = static_cast<OnMessageData *>(data);
+    if (asyncContext->type == 5) {
+        settlePathLoaded(env, asyncContext);
+        delete asyncContext;
+        return;
+    }
+    // deliverMessage 里 delete 之前先取出来，处理完再归还名额
+    std::shared_ptr<BridgeQueue> queue = std::move(asyncContext->queue);
+    int type = asyncContext->type;
+    int appIndex = asyncContext->appIndex;
+    if (queue && !queue->begin(asyncContext)) {
+        delete asyncContext;
+        return;
+    }
+    deliverMessage(env, js_cb, asyncContext);
+    if (queue) {
+        queue->done(type, getTsfn(appIndex));
+    }
+}
+
+static void deliverMessage(napi_env env, napi_value js_cb, OnMessageData *asyncContext) {
     //    OHLog("onMessageCb begin isMainThread: %{public}d", isMainThread());
 
     napi_handle_scope scope;
     napi_open_handle_scope(env, &scope);
 
-    auto *asyncContext = static_cast<OnMessageData *>(data);
-    const char *str = asyncContext->str.c_str();
+    const char *str = asyncContext->payload.get();
+    size_t length = asyncContext->length;
     int appIndex = asyncContext->appIndex; // 添加 appIndex 到 OnMessageData 结构
 
     napi_status status;
     napi_value s;
     napi_value arrayBuffer;
 
-    if (asyncContext->type == 1) {
-        status = napi_create_string_utf8(env, str, NAPI_AUTO_LENGTH, &s);
+    napi_value decoded = nullptr;
+    if (asyncContext->type == 1 && asyncContext->binary) {
+        decoded = WireDecodeNapiValue(env, reinterpret_cast<const uint8_t *>(str), length);
+        status = napi_create_string_utf8(env, "", 0, &s);
+        status = napi_get_undefined(env, &arrayBuffer);
+    } else if (asyncContext->type == 1) {
+        status = napi_create_string_utf8(env, str, length, &s);
         status = napi_get_undefined(env, &arrayBuffer);
     } else {
         status = napi_get_undefined(env, &s);
-        void *dataPtr;
-        status = napi_create_arraybuffer(env, strlen(str), &dataPtr, &arrayBuffer);
-        memcpy(dataPtr, str, strlen(str));
+        // 缓冲区本身交给 ArkTS，ArrayBuffer 被回收时由 finalizer 释放。几百 KB 的 setData 不再整块拷贝
+        status = napi_create_external_arraybuffer(
+            env, asyncContext->payload.get(), length,
+            [](napi_env env, void *finalizeData, void *hint) { std::free(finalizeData); }, nullptr, &arrayBuffer);
+        if (status == napi_ok) {
+            asyncContext->payload.release();
+        } else {
+            void *dataPtr;
+            status = napi_create_arraybuffer(env, length, &dataPtr, &arrayBuffer);
+            memcpy(dataPtr, str, length);
+        }
     }
 
     napi_value type, webViewId;
     napi_create_int32(env, asyncContext->type, &type);
     napi_create_int32(env, asyncContext->webViewId, &webViewId);
 
-    napi_value args[4] = {type, webViewId, s, arrayBuffer};
+    if (!decoded) {
+        napi_get_undefined(env, &decoded);
+    }
+
+    napi_value args[5] = {type, webViewId, s, arrayBuffer, decoded};
 
     napi_value undefined;
     napi_value result;
@@ -105,9 +227,14 @@ static void onMessageCb(napi_env env, napi_value js_cb, void *context, void *dat
 
     //    OHLog("napi_call_function before type: %{public}d webViewId: %{public}d", asyncContext->type,
     //    asyncContext->webViewId); OHLog("napi_call_function before len: %{public}zu", strlen(str));
-    OHLog("napi_call_function before str: %{public}s", str);
+    if (asyncContext->type == 1 && !asyncContext->binary) {
+        OHLog("napi_call_function before str: %{public}s", str);
+    } else {
+        // 缓冲区可能已经交出去了，而且 publish 的内容动辄几百 KB，只记长度
+        OHLog("napi_call_function before type: %{public}d len: %{public}zu", asyncContext->type, length);
+    }
 
-    status = napi_call_function(env, undefined, js_cb, 4, args, &result);
+    status = napi_call_function(env, undefined, js_cb, 5, args, &result);
 
     //     OHLog("napi_call_function after");
 
@@ -145,6 +272,13 @@ static void onMessageCb(napi_env env, napi_value js_cb, void *context, void *dat
         OHError("JavaScript Exception Stack Trace: %{public}s", stack_buffer);
     }
 
+    if (asyncContext->asyncCallId != 0) {
+        settleInvokeAsync(env, appIndex, asyncContext->asyncCallId, status == napi_ok ? result : nullptr);
+        delete asyncContext;
+        napi_close_handle_scope(env, scope);
+        return;
+    }
+
     JSValue jsValueResult = JS_EXCEPTION;
     if (status != napi_ok) {
         OHError("onMessage napi_call_function error: print value:");
@@ -170,18 +304,164 @@ static void onMessageCb(napi_env env, napi_value js_cb, void *context, void *dat
 }
 
 
+static void setNamedUint64(napi_env env, napi_value object, const char *name, uint64_t value);
+
+// 还没兑现的 dispatchJsTaskPath Promise 和所属的 appIndex，只在 ArkTS 线程上读写。
+// 引擎销毁时队列里没执行的 Path 任务直接丢掉，完成通知也可能因为 tsfn 已注销发不出来，
+// 这些 Promise 由 destroyJsEngine 统一 reject；之后才到的完成通知查不到就忽略，不会重复兑现
+static std::unordered_map<napi_deferred, int> gPendingPaths;
+
+static void rejectPath(napi_env env, napi_deferred deferred, const char *reason) {
+    napi_value message;
+    napi_value error;
+    napi_create_string_utf8(env, reason, NAPI_AUTO_LENGTH, &message);
+    napi_create_error(env, nullptr, message, &error);
+    napi_reject_deferred(env, deferred, error);
+}
+
+static void rejectPendingPaths(napi_env env, int appIndex) {
+    for (auto it = gPendingPaths.begin(); it != gPendingPaths.end();) {
+        if (it->second == appIndex) {
+            rejectPath(env, it->first, "engine destroyed before the script was loaded");
+            it = gPendingPaths.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+static void settlePathLoaded(napi_env env, OnMessageData *asyncContext) {
+    if (gPendingPaths.erase(asyncContext->deferred) == 0) {
+        // 引擎销毁时已经 reject 过了
+        return;
+    }
+    napi_handle_scope scope;
+    napi_open_handle_scope(env, &scope);
+    const PathLoadResult &load = asyncContext->pathLoad;
+    if (load.error.empty()) {
+        napi_value result;
+        napi_create_object(env, &result);
+        napi_value preloaded;
+        napi_get_boolean(env, false, &preloaded);
+        napi_set_named_property(env, result, "preloaded", preloaded);
+        setNamedUint64(env, result, "queueUs", load.queueUs);
+        setNamedUint64(env, result, "loadUs", load.loadUs);
+        setNamedUint64(env, result, "evalUs", load.evalUs);
+        setNamedUint64(env, result, "bytes", load.bytes);
+        napi_resolve_deferred(env, asyncContext->deferred, result);
+    } else {
+        napi_value message;
+        napi_value error;
+        napi_create_string_utf8(env, load.error.c_str(), load.error.size(), &message);
+        napi_create_error(env, nullptr, message, &error);
+        // 失败的时候耗时一样有用，挂在 Error 上
+        setNamedUint64(env, error, "loadUs", load.loadUs);
+        setNamedUint64(env, error, "evalUs", load.evalUs);
+        napi_reject_deferred(env, asyncContext->deferred, error);
+    }
+    napi_close_handle_scope(env, scope);
+}
+
+void postPathLoaded(JSContext *ctx, napi_deferred deferred, PathLoadResult result) {
+    JSEngine *engine = engineFromContext(ctx);
+    napi_threadsafe_function tsfn = engine ? getTsfn(engine->getAppIndex()) : nullptr;
+    if (!tsfn) {
+        // 引擎已经在销毁，Promise 由 destroyJsEngine reject
+        OHError("dispatchJsTaskPath result dropped: bridge is not available");
+        return;
+    }
+    try {
+        std::unique_ptr<OnMessageData> asyncContext(new OnMessageData());
+        asyncContext->type = 5;
+        asyncContext->appIndex = engine->getAppIndex();
+        asyncContext->deferred = deferred;
+        asyncContext->pathLoad = std::move(result);
+        // 完成通知每个文件只有一条，不占 BridgeQueue 的名额
+        if (napi_acquire_threadsafe_function(tsfn) != napi_ok ||
+            napi_call_threadsafe_function(tsfn, asyncContext.get(), napi_tsfn_nonblocking) != napi_ok) {
+            OHError("dispatchJsTaskPath result dropped: failed to post message to the container");
+            return;
+        }
+        asyncContext.release();
+    } catch (const std::exception &e) {
+        OHError("dispatchJsTaskPath result error: %{public}s", e.what());
+    }
+}
+
+// 经引擎的 BridgeQueue 投递给 ArkTS，满了按消息种类的策略处理。成功返回 nullptr，message 的所有权交出去；
+// 失败返回错误描述，message 还在调用方手里
+static const char *postToContainer(JSContext *ctx, JSEngine *engine, std::unique_ptr<OnMessageData> &message) {
+    napi_threadsafe_function tsfn = getTsfn(engine->getAppIndex());
+    JSCore *core = static_cast<JSCore *>(JS_GetContextOpaque(ctx));
+    if (!tsfn || !core) {
+        OHError("Threadsafe function not found for appIndex: %{public}d", engine->getAppIndex());
+        return "bridge is not available";
+    }
+    const char *error = core->bridgeQueue->post(tsfn, message);
+    if (error) {
+        OHError("post message to the container error: %{public}s", error);
+    }
+    return error;
+}
+
+// publish 的投递：payload 整块移交给 onMessageCb。成功返回 nullptr，失败返回错误描述，payload 由这边收掉
+static const char *postPublish(JSContext *ctx, JSEngine *engine, int webViewId, OwnedCStr payload, size_t length,
+                               uint32_t count) {
+    std::unique_ptr<OnMessageData> asyncContext(new OnMessageData());
+    asyncContext->payload = std::move(payload);
+    asyncContext->length = length;
+    asyncContext->appIndex = engine->getAppIndex(); // 设置 appIndex
+    asyncContext->type = count > 1 ? 4 : 2;
+    asyncContext->webViewId = webViewId;
+    asyncContext->count = count;
+    return postToContainer(ctx, engine, asyncContext);
+}
+
+void postPublishBatch(JSContext *ctx, int webViewId, OwnedCStr payload, size_t length, uint32_t count) {
+    JSEngine *engine = engineFromContext(ctx);
+    if (!engine || engine->closing) {
+        return;
+    }
+    try {
+        const char *error = postPublish(ctx, engine, webViewId, std::move(payload), length, count);
+        if (error) {
+            OHError("publish batch dropped %{public}u messages: %{public}s", count, error);
+        }
+    } catch (const std::exception &e) {
+        OHError("[dimina][service] publish batch error: %{public}s", e.what());
+    }
+}
+
+// invoke / invokeAsync 的消息。协商了二进制并且传的是对象就直接编码，ArkTS 那边省掉 JSON.parse；
+// 传的已经是字符串（JS 侧自己序列化过）照旧按 JSON 文本交出去
+static char *serializeInvokeMessage(JSContext *ctx, JSValueConst value, size_t *length, bool *binary) {
+    JSCore *core = static_cast<JSCore *>(JS_GetContextOpaque(ctx));
+    *binary = core && core->binaryWire.load(std::memory_order_relaxed) && JS_IsObject(value);
+    return *binary ? WireEncodeJSValue(ctx, value, length) : JSValueToStringLen(ctx, value, length);
+}
+
+// invoke / 日志走的是另一条投递路径，先把攒着的 publish 交出去，宿主看到的顺序和 JS 调用顺序一致
+static void flushPublishes(JSContext *ctx) {
+    JSCore *core = static_cast<JSCore *>(JS_GetContextOpaque(ctx));
+    if (core) {
+        core->publishBatcher.flush(ctx);
+    }
+}
+
 static JSValue invoke(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
     OHLog("invoke begin isMainThread: %{public}d", isMainThread());
 
-    // 获取当前引擎实例的 appIndex
-    JSEngine *currentEngine = nullptr;
-    for (const auto &pair : engineMap) {
-        if (pair.second->getContext() == ctx) {
-            currentEngine = pair.second;
-            break;
-        }
+    // 共享 JSWorker 上等 ArkTS 的结果会卡住同一线程上的所有引擎，ArkTS 那边又可能在等其中某个引擎，
+    // 会死锁。这种引擎不支持同步 invoke，直接抛错，调用方改用 invokeAsync
+    JSCore *hostCore = static_cast<JSCore *>(JS_GetContextOpaque(ctx));
+    if (hostCore && hostCore->isHosted()) {
+        return JS_ThrowTypeError(ctx, "DiminaServiceBridge.invoke is synchronous and not available on a "
+                                      "sharedWorker engine, use invokeAsync");
     }
 
+    // 获取当前引擎实例的 appIndex
+    JSEngine *currentEngine = engineFromContext(ctx);
+
     if (!currentEngine) {
         OHError("No engine found for context %{public}p", (void *)ctx);
         return JS_UNDEFINED;
@@ -195,10 +475,13 @@ static JSValue invoke(JSContext *ctx, JSValueConst this_val, int argc, JSValueCo
     // 整段放进 try：内存不足时 new / std::string 赋值都会抛，而这里是 QuickJS 的 C 回调
     // 边界，C++ 异常越过去会直接终止进程。要转成 JS 侧能接住的异常。
     try {
+        flushPublishes(ctx);
         // JSValueToString 只读传入值、不接管它，所以这里不需要先加一次引用——加了也没人还，
         // 那个对象就再也释放不掉。argv 的引用由调用方持有，整个调用期间都有效。
         // 它返回的是 strdup 出来的缓冲区，交给作用域对象保证任何出口都会还。
-        OwnedCStr str(JSValueToString(ctx, argv[0]));
+        size_t length = 0;
+        bool binary = false;
+        OwnedCStr str(serializeInvokeMessage(ctx, argv[0], &length, &binary));
         if (!str) {
             // 转不出字符串就没有可投递的内容。这里不挡住的话，下面拿 NULL 去构造
             // std::string 是未定义行为。
@@ -208,16 +491,11 @@ static JSValue invoke(JSContext *ctx, JSValueConst this_val, int argc, JSValueCo
         // packet 在成功投递之前都归这边所有，用 unique_ptr 持有，任何提前返回或抛异常
         // 都不会漏；投递成功后再 release，把所有权交给 onMessageCb。
         std::unique_ptr<OnMessageData> asyncContext(new OnMessageData());
-        asyncContext->str = str.get();
+        asyncContext->payload = std::move(str);
+        asyncContext->length = length;
         asyncContext->appIndex = currentEngine->getAppIndex(); // 设置 appIndex
         asyncContext->type = 1;
-        const bool blocking = true;
-
-        napi_threadsafe_function tsfn = getTsfn(currentEngine->getAppIndex());
-        if (!tsfn) {
-            OHError("Threadsafe function not found for appIndex: %{public}d", currentEngine->getAppIndex());
-            return throwNativeError(ctx, "invoke: bridge is not available");
-        }
+        asyncContext->binary = binary;
 
         // future 必须在投递之前取。投递之后 ArkTS 线程随时可能跑完 onMessageCb，
         // 那里 set_value 完就 delete asyncContext，promise 析构会把共享状态的引用
@@ -225,21 +503,12 @@ static JSValue invoke(JSContext *ctx, JSValueConst this_val, int argc, JSValueCo
         // 后面 future.get() 收尾时解引用它必然崩。
         std::future<JSValue> future = asyncContext->promise.get_future();
 
-        if (napi_acquire_threadsafe_function(tsfn) != napi_ok) {
-            // acquire 都没成功就不要再往下调用了，句柄可能已经在关闭。
-            OHError("napi_acquire_threadsafe_function error");
-            return throwNativeError(ctx, "invoke: bridge is shutting down");
+        // 只有投递成功才代表 packet 已入队、所有权移交给 onMessageCb；失败时 unique_ptr 会把它收掉。
+        // ArkTS 积压的 invoke 到了上限，会在这里等到有名额
+        const char *error = postToContainer(ctx, currentEngine, asyncContext);
+        if (error) {
+            return throwNativeError(ctx, (std::string("invoke: ") + error).c_str());
         }
-        napi_threadsafe_function_call_mode call_mode = blocking ? napi_tsfn_blocking : napi_tsfn_nonblocking;
-
-        napi_status status = napi_call_threadsafe_function(tsfn, asyncContext.get(), call_mode);
-        if (status != napi_ok) {
-            // 只有返回 napi_ok 才代表 packet 已入队、所有权移交给 onMessageCb；
-            // 其余返回码（队列满、正在关闭）都没入队，unique_ptr 会把它收掉。
-            OHError("napi_call_threadsafe_function error");
-            return throwNativeError(ctx, "invoke: failed to post message to the container");
-        }
-        asyncContext.release();
 
         JSValue value = future.get();
         if (JS_IsException(value)) {
@@ -254,16 +523,66 @@ static JSValue invoke(JSContext *ctx, JSValueConst this_val, int argc, JSValueCo
     }
 }
 
+// 和 invoke 同一个消息格式，宿主那边也是同一个回调，但立即返回 Promise，不阻塞 JS 线程。
+// 宿主的返回值（或者它返回的 Promise 的结果）转成 JSON 投回任务队列，在 JS 线程上兑现。
+static JSValue invokeAsync(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    JSEngine *currentEngine = engineFromContext(ctx);
+    JSCore *core = static_cast<JSCore *>(JS_GetContextOpaque(ctx));
+    if (!currentEngine || !core || currentEngine->closing) {
+        OHLog("invokeAsync engine_closing or not found");
+        return JS_ThrowInternalError(ctx, "invokeAsync: engine is not available");
+    }
+    if (argc < 1) {
+        return JS_ThrowTypeError(ctx, "invokeAsync expects one argument");
+    }
+
+    try {
+        flushPublishes(ctx);
+        size_t length = 0;
+        bool binary = false;
+        OwnedCStr str(serializeInvokeMessage(ctx, argv[0], &length, &binary));
+        if (!str) {
+            OHError("invokeAsync JSValueToString failed");
+            return throwNativeError(ctx, "invokeAsync: failed to serialize message");
+        }
+        if (!getTsfn(currentEngine->getAppIndex())) {
+            return throwNativeError(ctx, "invokeAsync: bridge is not available");
+        }
+
+        JSValue resolvingFuncs[2];
+        JSValue promise = JS_NewPromiseCapability(ctx, resolvingFuncs);
+        if (JS_IsException(promise)) {
+            return promise;
+        }
+        uint32_t callId = core->addAsyncCall(resolvingFuncs[0], resolvingFuncs[1]);
+
+        std::unique_ptr<OnMessageData> asyncContext(new OnMessageData());
+        asyncContext->payload = std::move(str);
+        asyncContext->length = length;
+        asyncContext->appIndex = currentEngine->getAppIndex();
+        asyncContext->type = 1;
+        asyncContext->binary = binary;
+        asyncContext->asyncCallId = callId;
+
+        const char *error = postToContainer(ctx, currentEngine, asyncContext);
+        if (error) {
+            // 没投出去就地 reject，Promise 照样返回给调用方
+            JSTask failed(JSTaskType::InvokeResult, std::string("invokeAsync: ") + error);
+            failed.callId = callId;
+            failed.rejected = true;
+            core->settleAsyncCall(failed);
+        }
+        return promise;
+    } catch (const std::exception &e) {
+        OHError("[dimina][service] invokeAsync error: %{public}s", e.what());
+        return throwNativeError(ctx, e.what());
+    }
+}
+
 JSValue sendLogToContainer(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
     OHLog("sendLogToContainer begin isMainThread: %{public}d", isMainThread());
     // 获取当前引擎实例的 appIndex
-    JSEngine *currentEngine = nullptr;
-    for (const auto &pair : engineMap) {
-        if (pair.second->getContext() == ctx) {
-            currentEngine = pair.second;
-            break;
-        }
-    }
+    JSEngine *currentEngine = engineFromContext(ctx);
     if (!currentEngine || currentEngine->closing) {
         OHLog("sendLogToContainer engine_closing or not found");
         return JS_UNDEFINED;
@@ -282,35 +601,23 @@ JSValue sendLogToContainer(JSContext *ctx, JSValueConst this_val, int argc, JSVa
     }
     // 打日志是尽力而为的，内存不足之类的 C++ 异常也不该让它冒到调用方去。
     try {
+        flushPublishes(ctx);
         // 同 invoke：JSValueToString 不接管所有权，多加的那次引用没人还。
-        OwnedCStr logMessage(JSValueToString(ctx, argv[1]));
+        size_t length = 0;
+        OwnedCStr logMessage(JSValueToStringLen(ctx, argv[1], &length));
         if (!logMessage) {
             OHError("sendLogToContainer JSValueToString failed");
             discardPendingException(ctx);
             return JS_UNDEFINED;
         }
         std::unique_ptr<OnMessageData> asyncContext(new OnMessageData());
-        asyncContext->str = logMessage.get();
+        asyncContext->payload = std::move(logMessage);
+        asyncContext->length = length;
         asyncContext->appIndex = currentEngine->getAppIndex(); // 设置 appIndex
         asyncContext->type = 3;
         asyncContext->webViewId = level;
-        napi_threadsafe_function tsfn = getTsfn(currentEngine->getAppIndex());
-        if (!tsfn) {
-            OHError("Threadsafe function not found for appIndex: %{public}d", currentEngine->getAppIndex());
-            return JS_UNDEFINED;
-        }
-        if (napi_acquire_threadsafe_function(tsfn) != napi_ok) {
-            OHError("napi_acquire_threadsafe_function error");
-            return JS_UNDEFINED;
-        }
-        napi_threadsafe_function_call_mode call_mode = napi_tsfn_nonblocking;
-        napi_status status = napi_call_threadsafe_function(tsfn, asyncContext.get(), call_mode);
-        if (status != napi_ok) {
-            // 同 invoke：非 napi_ok 表示没入队，所有权还在这边，unique_ptr 会收掉。
-            OHError("napi_call_threadsafe_function error");
-            return JS_UNDEFINED;
-        }
-        asyncContext.release();
+        // 同 invoke：没投出去所有权还在这边，unique_ptr 会收掉。积压太多时最老的日志会被挤掉
+        postToContainer(ctx, currentEngine, asyncContext);
     } catch (const std::exception &e) {
         OHError("sendLogToContainer error: %{public}s", e.what());
         discardPendingException(ctx);
@@ -322,13 +629,7 @@ static JSValue publish(JSContext *ctx, JSValueConst this_val, int argc, JSValueC
     OHLog("publish begin isMainThread: %{public}d", isMainThread());
 
     // 获取当前引擎实例的 appIndex
-    JSEngine *currentEngine = nullptr;
-    for (const auto &pair : engineMap) {
-        if (pair.second->getContext() == ctx) {
-            currentEngine = pair.second;
-            break;
-        }
-    }
+    JSEngine *currentEngine = engineFromContext(ctx);
 
     if (!currentEngine || currentEngine->closing) {
         OHLog("publish engine_closing or not found");
@@ -347,39 +648,22 @@ static JSValue publish(JSContext *ctx, JSValueConst this_val, int argc, JSValueC
     // 同 invoke：整段放进 try，别让 C++ 异常越过 QuickJS 的 C 回调边界。
     try {
         // JSValueToString 不接管所有权，多加的那次引用没人还；返回的缓冲区交给作用域对象。
-        OwnedCStr str(JSValueToString(ctx, argv[1]));
+        size_t length = 0;
+        OwnedCStr str(JSValueToStringLen(ctx, argv[1], &length));
         if (!str) {
             OHError("publish JSValueToString failed");
             return throwNativeError(ctx, "publish: failed to serialize message");
         }
 
-        std::unique_ptr<OnMessageData> asyncContext(new OnMessageData());
-        asyncContext->str = str.get();
-        asyncContext->appIndex = currentEngine->getAppIndex(); // 设置 appIndex
-        asyncContext->type = 2;
-        asyncContext->webViewId = webViewId;
-        const bool blocking = false;
-
-        napi_threadsafe_function tsfn = getTsfn(currentEngine->getAppIndex());
-        if (!tsfn) {
-            OHError("Threadsafe function not found for appIndex: %{public}d", currentEngine->getAppIndex());
-            return throwNativeError(ctx, "publish: bridge is not available");
-        }
-
-        if (napi_acquire_threadsafe_function(tsfn) != napi_ok) {
-            // acquire 都没成功就不要再往下调用了，句柄可能已经在关闭。
-            OHError("napi_acquire_threadsafe_function error");
-            return throwNativeError(ctx, "publish: bridge is shutting down");
+        // 开了合并就先攒着，投递失败只能记日志，不再抛给调用方
+        JSCore *core = static_cast<JSCore *>(JS_GetContextOpaque(ctx));
+        if (core && core->publishBatcher.add(ctx, webViewId, str, length)) {
+            return JS_UNDEFINED;
         }
-        napi_threadsafe_function_call_mode call_mode = blocking ? napi_tsfn_blocking : napi_tsfn_nonblocking;
-
-        napi_status status = napi_call_threadsafe_function(tsfn, asyncContext.get(), call_mode);
-        if (status != napi_ok) {
-            // 同 invoke：非 napi_ok 表示没入队，所有权还在这边，unique_ptr 会收掉。
-            OHError("napi_call_threadsafe_function error");
-            return throwNativeError(ctx, "publish: failed to post message to the container");
+        const char *error = postPublish(ctx, currentEngine, webViewId, std::move(str), length, 1);
+        if (error) {
+            return throwNativeError(ctx, (std::string("publish: ") + error).c_str());
         }
-        asyncContext.release();
     } catch (const std::exception &e) {
         OHError("[dimina][service] publish error: %{public}s", e.what());
         return throwNativeError(ctx, e.what());
@@ -389,9 +673,21 @@ static JSValue publish(JSContext *ctx, JSValueConst this_val, int argc, JSValueC
 }
 
 
+// dispatchJsTask* 可选的最后一个参数：0 用户交互，1 普通（默认），2 后台
+static JSTaskPriority parseTaskPriority(napi_env env, size_t argc, napi_value *args, size_t index) {
+    uint32_t priority = static_cast<uint32_t>(JSTaskPriority::Normal);
+    if (argc > index) {
+        napi_get_value_uint32(env, args[index], &priority);
+    }
+    if (priority >= kTaskPriorityCount) {
+        priority = static_cast<uint32_t>(JSTaskPriority::Background);
+    }
+    return static_cast<JSTaskPriority>(priority);
+}
+
 napi_value dispatchJsTask(napi_env env, napi_callback_info info) {
-    size_t requireArgc = 2; // 修改为需要两个参数：appIndex 和 script
-    napi_value args[2] = {nullptr};
+    size_t requireArgc = 3; // appIndex、script，以及可选的优先级
+    napi_value args[3] = {nullptr};
 
     if (napi_ok != napi_get_cb_info(env, info, &requireArgc, args, nullptr, nullptr)) {
         napi_throw_error(env, "-1000", "arguments invalid");
@@ -421,22 +717,22 @@ napi_value dispatchJsTask(napi_env env, napi_callback_info info) {
         return nullptr;
     }
 
-    // 使用 unique_ptr 自动管理内存
-    length = length + 1;
-    unique_ptr<char[]> buffer(new char[length]);
-    if (napi_ok != napi_get_value_string_utf8(env, args[1], buffer.get(), length, &length)) {
+    // 直接读进 std::string，之后整块移进任务队列，不再拷贝
+    std::string script(length, '\0');
+    if (napi_ok != napi_get_value_string_utf8(env, args[1], &script[0], length + 1, &length)) {
         napi_throw_error(env, "-1005", "napi_get_value_string_utf8 error");
         return nullptr;
     }
+    script.resize(length);
 
-    engine->executeJavaScript(buffer.get());
+    engine->executeJavaScript(std::move(script), parseTaskPriority(env, requireArgc, args, 2));
 
     return nullptr;
 }
 
 napi_value dispatchJsTaskAb(napi_env env, napi_callback_info info) {
-    size_t requireArgc = 2; // 修改为需要两个参数：appIndex 和 ArrayBuffer
-    napi_value args[2] = {nullptr};
+    size_t requireArgc = 3; // appIndex、ArrayBuffer，以及可选的优先级
+    napi_value args[3] = {nullptr};
 
     if (napi_ok != napi_get_cb_info(env, info, &requireArgc, args, nullptr, nullptr)) {
         napi_throw_error(env, "-1000", "arguments invalid");
@@ -468,18 +764,17 @@ napi_value dispatchJsTaskAb(napi_env env, napi_callback_info info) {
         return nullptr;
     }
 
-    std::unique_ptr<char[]> buffer(new char[length + 1]);
-    memcpy(buffer.get(), data, length);
-    buffer[length] = '\0'; // 确保字符串以 null 结尾
-    engine->executeJavaScript(buffer.get());
+    // std::string 自带结尾的 '\0'，这是唯一一次拷贝
+    engine->executeJavaScript(std::string(static_cast<const char *>(data), length),
+                              parseTaskPriority(env, requireArgc, args, 2));
 
     return nullptr;
 }
 
 
 napi_value dispatchJsTaskPath(napi_env env, napi_callback_info info) {
-    size_t requireArgc = 2; // 修改为需要两个参数：appIndex 和文件路径
-    napi_value args[2] = {nullptr};
+    size_t requireArgc = 3; // appIndex、文件路径，以及可选的优先级
+    napi_value args[3] = {nullptr};
 
     if (napi_ok != napi_get_cb_info(env, info, &requireArgc, args, nullptr, nullptr)) {
         napi_throw_error(env, "-1000", "arguments invalid");
@@ -496,7 +791,12 @@ napi_value dispatchJsTaskPath(napi_env env, napi_callback_info info) {
     JSEngine *engine = getEngine(appIndex);
     if (!engine || engine->closing) {
         OHLog("dispatchJsTaskPath engine_closing or not found for appIndex: %{public}d", appIndex);
-        return nullptr;
+        // 调用方一律拿到 Promise，引擎不在了就直接 reject
+        napi_deferred deferred;
+        napi_value promise;
+        napi_create_promise(env, &deferred, &promise);
+        rejectPath(env, deferred, "engine is not available");
+        return promise;
     }
 
     // 获取文件路径
@@ -517,48 +817,295 @@ napi_value dispatchJsTaskPath(napi_env env, napi_callback_info info) {
         return nullptr;
     }
 
-    // 打开文件
-    int fd = open(filePath.get(), O_RDONLY);
-    if (fd == -1) {
-        napi_throw_error(env, "-1006", "Unable to open file");
+    // 文件交给 JS 线程去读，这里只入队，返回的 Promise 在执行完之后兑现
+    napi_deferred deferred = nullptr;
+    napi_value promise = nullptr;
+    if (napi_ok != napi_create_promise(env, &deferred, &promise)) {
+        napi_throw_error(env, "-1006", "napi_create_promise error");
+        return nullptr;
+    }
+
+    // 预热引擎已经执行过这个脚本
+    if (engine->consumePreloadedPath(filePath.get())) {
+        OHLog("dispatchJsTaskPath skip preloaded %{public}s", filePath.get());
+        napi_value result;
+        napi_create_object(env, &result);
+        napi_value preloaded;
+        napi_get_boolean(env, true, &preloaded);
+        napi_set_named_property(env, result, "preloaded", preloaded);
+        napi_resolve_deferred(env, deferred, result);
+        return promise;
+    }
+
+    gPendingPaths.emplace(deferred, appIndex);
+    if (!engine->executeJavaScriptPath(filePath.get(), deferred, parseTaskPriority(env, requireArgc, args, 2))) {
+        gPendingPaths.erase(deferred);
+        rejectPath(env, deferred, "engine is not available");
+    }
+    return promise;
+}
+
+napi_value dispatchJsMessage(napi_env env, napi_callback_info info) {
+    size_t requireArgc = 3;
+    napi_value args[3] = {nullptr};
+
+    if (napi_ok != napi_get_cb_info(env, info, &requireArgc, args, nullptr, nullptr)) {
+        napi_throw_error(env, "-1000", "arguments invalid");
+        return nullptr;
+    }
+
+    int appIndex;
+    if (napi_ok != napi_get_value_int32(env, args[0], &appIndex)) {
+        napi_throw_error(env, "-1001", "Invalid appIndex");
+        return nullptr;
+    }
+
+    JSEngine *engine = getEngine(appIndex);
+    if (!engine || engine->closing) {
+        OHLog("dispatchJsMessage engine_closing or not found for appIndex: %{public}d", appIndex);
+        return nullptr;
+    }
+
+    bool isArrayBuffer = false;
+    napi_is_arraybuffer(env, args[1], &isArrayBuffer);
+    napi_valuetype payloadType = napi_undefined;
+    napi_typeof(env, args[1], &payloadType);
+
+    std::string payload;
+    if (!isArrayBuffer && payloadType == napi_object) {
+        // 直接传对象：在这里编成二进制，JS 线程解码，两边都不用过 JSON 文本
+        size_t length = 0;
+        OwnedCStr encoded(WireEncodeNapiValue(env, args[1], &length));
+        if (!encoded) {
+            napi_throw_error(env, "-1006", "failed to encode message");
+            return nullptr;
+        }
+        payload.assign(encoded.get(), length);
+    } else if (isArrayBuffer) {
+        void *data = nullptr;
+        size_t length = 0;
+        if (napi_ok != napi_get_arraybuffer_info(env, args[1], &data, &length)) {
+            napi_throw_error(env, "-1003", "napi_get_arraybuffer_info error");
+            return nullptr;
+        }
+        payload.assign(static_cast<const char *>(data), length);
+    } else {
+        size_t length = 0;
+        if (napi_ok != napi_get_value_string_utf8(env, args[1], nullptr, 0, &length)) {
+            napi_throw_error(env, "-1003", "napi_get_value_string_utf8 error");
+            return nullptr;
+        }
+        payload.resize(length);
+        if (napi_ok != napi_get_value_string_utf8(env, args[1], &payload[0], length + 1, &length)) {
+            napi_throw_error(env, "-1005", "napi_get_value_string_utf8 error");
+            return nullptr;
+        }
+    }
+    if (payload.empty()) {
+        napi_throw_error(env, "-1004", "the param length invalid");
         return nullptr;
     }
 
-    // 获取文件大小
-    struct stat sb;
-    if (fstat(fd, &sb) == -1) {
-        close(fd);
-        napi_throw_error(env, "-1007", "Error getting file size");
+    engine->dispatchMessage(std::move(payload), parseTaskPriority(env, requireArgc, args, 2));
+
+    return nullptr;
+}
+
+// 设置预热引擎池：configureJsEnginePool(size, preloadPath?, recycle?)
+napi_value ConfigureJsEnginePool(napi_env env, napi_callback_info info) {
+    size_t argc = 3;
+    napi_value args[3] = {nullptr};
+    if (napi_ok != napi_get_cb_info(env, info, &argc, args, nullptr, nullptr) || argc < 1) {
+        napi_throw_error(env, "-1000", "arguments invalid");
         return nullptr;
     }
-    size_t fileSize = sb.st_size;
-    if (fileSize == 0) {
-        close(fd);
-        napi_throw_error(env, "-1008", "File is empty");
+
+    uint32_t size = 0;
+    if (napi_ok != napi_get_value_uint32(env, args[0], &size)) {
+        napi_throw_error(env, "-1001", "Invalid pool size");
         return nullptr;
     }
 
-    // 使用 mmap 将文件映射到内存
-    char *data = static_cast<char *>(mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0));
-    if (data == MAP_FAILED) {
-        close(fd);
-        napi_throw_error(env, "-1009", "Error mapping file to memory");
+    std::string preloadPath;
+    napi_valuetype type = napi_undefined;
+    if (argc > 1 && napi_typeof(env, args[1], &type) == napi_ok && type == napi_string) {
+        size_t length = 0;
+        napi_get_value_string_utf8(env, args[1], nullptr, 0, &length);
+        preloadPath.resize(length);
+        if (napi_ok != napi_get_value_string_utf8(env, args[1], &preloadPath[0], length + 1, &length)) {
+            napi_throw_error(env, "-1005", "napi_get_value_string_utf8 error");
+            return nullptr;
+        }
+    }
+
+    bool recycle = false;
+    if (argc > 2 && napi_typeof(env, args[2], &type) == napi_ok && type == napi_boolean) {
+        napi_get_value_bool(env, args[2], &recycle);
+    }
+
+    configureEnginePool(size, preloadPath, recycle, registerFunc);
+    return nullptr;
+}
+
+static void setNamedUint64(napi_env env, napi_value object, const char *name, uint64_t value) {
+    napi_value v;
+    napi_create_double(env, static_cast<double>(value), &v);
+    napi_set_named_property(env, object, name, v);
+}
+
+static napi_value histogramToObject(napi_env env, const LatencyHistogram &histogram) {
+    napi_value object;
+    napi_create_object(env, &object);
+    setNamedUint64(env, object, "count", histogram.count());
+    napi_value mean;
+    napi_create_double(env, histogram.mean(), &mean);
+    napi_set_named_property(env, object, "mean", mean);
+    setNamedUint64(env, object, "p50", histogram.percentile(50));
+    setNamedUint64(env, object, "p90", histogram.percentile(90));
+    setNamedUint64(env, object, "p99", histogram.percentile(99));
+    setNamedUint64(env, object, "max", histogram.max());
+    return object;
+}
+
+static napi_value bridgeQueueToObject(napi_env env, const BridgeQueueCounters &counters) {
+    napi_value object;
+    napi_create_object(env, &object);
+    setNamedUint64(env, object, "limit", counters.limit.load(std::memory_order_relaxed));
+    setNamedUint64(env, object, "inFlight", counters.inFlight.load(std::memory_order_relaxed));
+    setNamedUint64(env, object, "maxInFlight", counters.maxInFlight.load(std::memory_order_relaxed));
+    setNamedUint64(env, object, "stalls", counters.stalls.load(std::memory_order_relaxed));
+    setNamedUint64(env, object, "stallUs", counters.stallUs.load(std::memory_order_relaxed));
+    setNamedUint64(env, object, "overLimit", counters.overLimit.load(std::memory_order_relaxed));
+    setNamedUint64(env, object, "dropped", counters.dropped.load(std::memory_order_relaxed));
+    setNamedUint64(env, object, "coalesced", counters.coalesced.load(std::memory_order_relaxed));
+    return object;
+}
+
+// 引擎统计：getEngineStats(appIndex)，引擎不存在返回 undefined。
+// 直接读引擎的统计内存，不经过 JS 线程，可以随意轮询。时间单位都是微秒。
+napi_value GetEngineStats(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1] = {nullptr};
+    int appIndex = 0;
+    if (napi_ok != napi_get_cb_info(env, info, &argc, args, nullptr, nullptr) || argc < 1 ||
+        napi_ok != napi_get_value_int32(env, args[0], &appIndex)) {
+        napi_throw_error(env, "-1000", "arguments invalid");
         return nullptr;
     }
 
-    close(fd);
+    JSEngine *engine = getEngine(appIndex);
+    if (!engine) {
+        napi_value undefined;
+        napi_get_undefined(env, &undefined);
+        return undefined;
+    }
 
-    std::unique_ptr<char[]> buffer(new char[fileSize + 1]);
-    memcpy(buffer.get(), data, fileSize);
-    buffer[fileSize] = '\0'; // 确保字符串以 null 结尾
+    const JSEngineStats &stats = engine->getEngineStats();
+    napi_value result;
+    napi_create_object(env, &result);
+    setNamedUint64(env, result, "tasksExecuted", stats.tasksExecuted.load(std::memory_order_relaxed));
+    setNamedUint64(env, result, "tasksPerSec", stats.tasksPerSecAt(uv_hrtime()));
+    setNamedUint64(env, result, "loopIterations", stats.loopIterations.load(std::memory_order_relaxed));
+    setNamedUint64(env, result, "wakeups", stats.wakeups.load(std::memory_order_relaxed));
+    setNamedUint64(env, result, "queueDepth", stats.queueDepth.load(std::memory_order_relaxed));
+    setNamedUint64(env, result, "maxQueueDepth", stats.maxQueueDepth.load(std::memory_order_relaxed));
+    napi_value laneDepth;
+    napi_create_array_with_length(env, kTaskPriorityCount, &laneDepth);
+    for (int i = 0; i < kTaskPriorityCount; i++) {
+        napi_value depth;
+        napi_create_double(env, static_cast<double>(stats.laneDepth[i].load(std::memory_order_relaxed)), &depth);
+        napi_set_element(env, laneDepth, i, depth);
+    }
+    napi_set_named_property(env, result, "laneDepth", laneDepth);
+    setNamedUint64(env, result, "agedTasks", stats.agedTasks.load(std::memory_order_relaxed));
+    napi_set_named_property(env, result, "queueWaitUs", histogramToObject(env, stats.queueWaitUs));
+    napi_set_named_property(env, result, "evalUs", histogramToObject(env, stats.evalUs));
+    napi_set_named_property(env, result, "microtaskUs", histogramToObject(env, stats.microtaskUs));
+    napi_set_named_property(env, result, "queueDepthSamples", histogramToObject(env, stats.depthSamples));
+
+    setNamedUint64(env, result, "longTaskCount", stats.longTasks.load(std::memory_order_relaxed));
+    setNamedUint64(env, result, "abortedTasks", stats.abortedTasks.load(std::memory_order_relaxed));
+    setNamedUint64(env, result, "microtaskOverruns", stats.microtaskOverruns.load(std::memory_order_relaxed));
+    setNamedUint64(env, result, "frames", stats.frames.load(std::memory_order_relaxed));
+    setNamedUint64(env, result, "fallbackFrames", stats.fallbackFrames.load(std::memory_order_relaxed));
+    std::vector<JSLongTaskEvent> events = engine->getLongTasks();
+    napi_value longTasks;
+    napi_create_array_with_length(env, events.size(), &longTasks);
+    for (size_t i = 0; i < events.size(); i++) {
+        const JSLongTaskEvent &event = events[i];
+        napi_value item;
+        napi_create_object(env, &item);
+        napi_value v;
+        napi_create_string_utf8(env, event.kind.c_str(), event.kind.size(), &v);
+        napi_set_named_property(env, item, "kind", v);
+        napi_create_double(env, static_cast<double>(event.startTimeMs), &v);
+        napi_set_named_property(env, item, "startTime", v);
+        setNamedUint64(env, item, "durationUs", event.durationUs);
+        napi_create_string_utf8(env, event.stack.c_str(), event.stack.size(), &v);
+        napi_set_named_property(env, item, "stack", v);
+        napi_get_boolean(env, event.aborted, &v);
+        napi_set_named_property(env, item, "aborted", v);
+        napi_set_element(env, longTasks, i, item);
+    }
+    napi_set_named_property(env, result, "longTasks", longTasks);
+
+    const BridgeQueue &bridgeQueue = engine->getBridgeQueue();
+    napi_value bridgeQueues;
+    napi_create_object(env, &bridgeQueues);
+    napi_set_named_property(env, bridgeQueues, "invoke",
+                            bridgeQueueToObject(env, bridgeQueue.counters(BridgeMessageKind::Invoke)));
+    napi_set_named_property(env, bridgeQueues, "publish",
+                            bridgeQueueToObject(env, bridgeQueue.counters(BridgeMessageKind::Publish)));
+    napi_set_named_property(env, bridgeQueues, "log",
+                            bridgeQueueToObject(env, bridgeQueue.counters(BridgeMessageKind::Log)));
+    napi_set_named_property(env, result, "bridgeQueues", bridgeQueues);
+
+    napi_value suspended;
+    napi_get_boolean(env, engine->isSuspended(), &suspended);
+    napi_set_named_property(env, result, "suspended", suspended);
+    return result;
+}
 
-    // 解除映射
-    if (munmap(data, fileSize) == -1) {
-        napi_throw_error(env, "-1010", "Error unmapping file");
+// 设置共享 JS 线程数：configureJsWorkerPool(threads)，只增不减。
+// StartJsEngine 传 sharedWorker: true 的引擎挂到这些线程上，不再每个引擎一个线程。
+napi_value ConfigureJsWorkerPool(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1] = {nullptr};
+    if (napi_ok != napi_get_cb_info(env, info, &argc, args, nullptr, nullptr) || argc < 1) {
+        napi_throw_error(env, "-1000", "arguments invalid");
         return nullptr;
     }
 
-    engine->executeJavaScript(buffer.get());
+    uint32_t threads = 0;
+    if (napi_ok != napi_get_value_uint32(env, args[0], &threads) || threads == 0) {
+        napi_throw_error(env, "-1001", "Invalid thread count");
+        return nullptr;
+    }
+
+    configureWorkerPool(threads);
+    return nullptr;
+}
+
+// 设置字节码缓存目录，传空串关闭缓存。dispatchJsTaskPath 加载的脚本会按内容哈希缓存编译结果。
+napi_value SetCodeCacheDir(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value args[1] = {nullptr};
+    if (napi_ok != napi_get_cb_info(env, info, &argc, args, nullptr, nullptr) || argc < 1) {
+        napi_throw_error(env, "-1000", "arguments invalid");
+        return nullptr;
+    }
+
+    size_t length = 0;
+    if (napi_ok != napi_get_value_string_utf8(env, args[0], nullptr, 0, &length)) {
+        napi_throw_error(env, "-1003", "napi_get_value_string_utf8 error");
+        return nullptr;
+    }
+    std::string dir(length, '\0');
+    if (napi_ok != napi_get_value_string_utf8(env, args[0], &dir[0], length + 1, &length)) {
+        napi_throw_error(env, "-1005", "napi_get_value_string_utf8 error");
+        return nullptr;
+    }
+    setCodeCacheDir(dir);
 
     return nullptr;
 }
@@ -567,14 +1114,112 @@ void registerFunc(JSContext *ctx) {
     initBridges(ctx);
     registerInvoke(ctx);
     registerPublish(ctx);
+    registerOnMessage(ctx);
+}
+
+// 读取 StartJsEngine 第四个参数 { drainMaxTasks, drainTimeBudgetMs, eventDriven }，缺省或非法的字段保持默认值。
+static JSSchedulerOptions parseSchedulerOptions(napi_env env, napi_value options) {
+    JSSchedulerOptions result;
+    napi_valuetype type = napi_undefined;
+    if (options == nullptr || napi_typeof(env, options, &type) != napi_ok || type != napi_object) {
+        return result;
+    }
+
+    napi_value value;
+    uint32_t maxTasks = 0;
+    if (napi_get_named_property(env, options, "drainMaxTasks", &value) == napi_ok &&
+        napi_get_value_uint32(env, value, &maxTasks) == napi_ok && maxTasks > 0) {
+        result.maxTasks = maxTasks;
+    }
+    double timeBudgetMs = 0;
+    if (napi_get_named_property(env, options, "drainTimeBudgetMs", &value) == napi_ok &&
+        napi_get_value_double(env, value, &timeBudgetMs) == napi_ok && timeBudgetMs > 0) {
+        result.maxTimeUs = static_cast<uint64_t>(timeBudgetMs * 1000);
+    }
+    bool eventDriven = true;
+    if (napi_get_named_property(env, options, "eventDriven", &value) == napi_ok &&
+        napi_get_value_bool(env, value, &eventDriven) == napi_ok) {
+        result.eventDriven = eventDriven;
+    }
+    bool sharedWorker = false;
+    if (napi_get_named_property(env, options, "sharedWorker", &value) == napi_ok &&
+        napi_get_value_bool(env, value, &sharedWorker) == napi_ok) {
+        result.sharedWorker = sharedWorker;
+    }
+    double agingMs = 0;
+    if (napi_get_named_property(env, options, "normalAgingMs", &value) == napi_ok &&
+        napi_get_value_double(env, value, &agingMs) == napi_ok && agingMs > 0) {
+        result.normalAgingUs = static_cast<uint64_t>(agingMs * 1000);
+    }
+    if (napi_get_named_property(env, options, "backgroundAgingMs", &value) == napi_ok &&
+        napi_get_value_double(env, value, &agingMs) == napi_ok && agingMs > 0) {
+        result.backgroundAgingUs = static_cast<uint64_t>(agingMs * 1000);
+    }
+    double limitMs = 0;
+    if (napi_get_named_property(env, options, "longTaskMs", &value) == napi_ok &&
+        napi_get_value_double(env, value, &limitMs) == napi_ok && limitMs > 0) {
+        result.longTaskUs = static_cast<uint64_t>(limitMs * 1000);
+    }
+    if (napi_get_named_property(env, options, "taskHardLimitMs", &value) == napi_ok &&
+        napi_get_value_double(env, value, &limitMs) == napi_ok && limitMs >= 0) {
+        result.taskHardLimitUs = static_cast<uint64_t>(limitMs * 1000);
+    }
+    uint32_t maxMicrotasks = 0;
+    if (napi_get_named_property(env, options, "microtaskMaxJobs", &value) == napi_ok &&
+        napi_get_value_uint32(env, value, &maxMicrotasks) == napi_ok && maxMicrotasks > 0) {
+        result.maxMicrotasks = maxMicrotasks;
+    }
+    if (napi_get_named_property(env, options, "microtaskTimeBudgetMs", &value) == napi_ok &&
+        napi_get_value_double(env, value, &limitMs) == napi_ok && limitMs > 0) {
+        result.microtaskTimeUs = static_cast<uint64_t>(limitMs * 1000);
+    }
+    bool publishBatching = false;
+    if (napi_get_named_property(env, options, "publishBatching", &value) == napi_ok &&
+        napi_get_value_bool(env, value, &publishBatching) == napi_ok) {
+        result.publishBatching = publishBatching;
+    }
+    uint32_t maxBytes = 0;
+    if (napi_get_named_property(env, options, "publishBatchMaxBytes", &value) == napi_ok &&
+        napi_get_value_uint32(env, value, &maxBytes) == napi_ok) {
+        result.publishBatchMaxBytes = maxBytes;
+    }
+    if (napi_get_named_property(env, options, "publishBatchDeadlineMs", &value) == napi_ok &&
+        napi_get_value_double(env, value, &limitMs) == napi_ok && limitMs >= 0) {
+        result.publishBatchDeadlineUs = static_cast<uint64_t>(limitMs * 1000);
+    }
+    bool frameAlignedPublish = false;
+    if (napi_get_named_property(env, options, "frameAlignedPublish", &value) == napi_ok &&
+        napi_get_value_bool(env, value, &frameAlignedPublish) == napi_ok) {
+        result.frameAlignedPublish = frameAlignedPublish;
+    }
+    char wireFormat[16] = {0};
+    size_t wireFormatLength = 0;
+    if (napi_get_named_property(env, options, "wireFormat", &value) == napi_ok &&
+        napi_get_value_string_utf8(env, value, wireFormat, sizeof(wireFormat), &wireFormatLength) == napi_ok) {
+        result.binaryWire = strcmp(wireFormat, "binary") == 0;
+    }
+    uint32_t queueLimit = 0;
+    if (napi_get_named_property(env, options, "invokeQueueLimit", &value) == napi_ok &&
+        napi_get_value_uint32(env, value, &queueLimit) == napi_ok) {
+        result.invokeQueueLimit = queueLimit;
+    }
+    if (napi_get_named_property(env, options, "publishQueueLimit", &value) == napi_ok &&
+        napi_get_value_uint32(env, value, &queueLimit) == napi_ok) {
+        result.publishQueueLimit = queueLimit;
+    }
+    if (napi_get_named_property(env, options, "logQueueLimit", &value) == napi_ok &&
+        napi_get_value_uint32(env, value, &queueLimit) == napi_ok) {
+        result.logQueueLimit = queueLimit;
+    }
+    return result;
 }
 
 // StartJsEngine 对应JS代码中的接口实现
 napi_value StartJsEngine(napi_env env, napi_callback_info info) {
     OHLog("StartJsEngine begin");
 
-    size_t argc = 3;
-    napi_value args[3];
+    size_t argc = 4;
+    napi_value args[4] = {nullptr};
     napi_get_cb_info(env, info, &argc, args, NULL, NULL);
 
     int appIndex;
@@ -595,14 +1240,27 @@ napi_value StartJsEngine(napi_env env, napi_callback_info info) {
     napi_threadsafe_function tsfn;
     napi_create_threadsafe_function(env, args[1], nullptr, workBName, 0, 1, nullptr, nullptr, nullptr, onMessageCb,
                                     &tsfn);
-    tsfnMap[appIndex] = tsfn;
 
     auto now = std::chrono::system_clock::now();
     auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
     PFLog("[launch-container][%{public}lld]JS引擎启动 appIndex: %{public}d", timestamp, appIndex);
 
-    JSEngine *newEngine = new JSEngine(appIndex, registerFunc);
-    engineMap[appIndex] = newEngine;
+    JSSchedulerOptions options = parseSchedulerOptions(env, argc > 3 ? args[3] : nullptr);
+    JSEngine *newEngine = claimPooledEngine(options);
+    if (newEngine) {
+        newEngine->bindAppIndex(appIndex);
+        PFLog("[launch-container][%{public}lld]JS引擎启动-使用预热引擎 ready: %{public}d", timestamp,
+              newEngine->isReady() ? 1 : 0);
+    } else {
+        newEngine = new JSEngine(appIndex, registerFunc, options);
+    }
+    if (!registerEngine(appIndex, newEngine, tsfn)) {
+        // 表满了：引擎已经起来，只能销毁掉，由引擎线程自己释放
+        newEngine->destroyEngine();
+        napi_release_threadsafe_function(tsfn, napi_tsfn_release);
+        napi_throw_error(env, "-1002", "Too many engines");
+        return nullptr;
+    }
     OHLog("engine 地址: %{public}p for appIndex: %{public}d", (void *)newEngine, appIndex);
 
     OHLog("StartJsEngine end");
@@ -627,18 +1285,16 @@ napi_value destroyJsEngine(napi_env env, napi_callback_info info) {
     }
 
     OHWarn("thread destroyJsEngine for appIndex: %{public}d", appIndex);
+    // 先注销再销毁：engine 的释放由引擎线程自己完成（回收进预热池，或者退出后由回收线程 delete），
+    // 回收进池的引擎可能马上被领走绑定新的 appIndex，之后这里不能再碰它
+    napi_threadsafe_function tsfn = unregisterEngine(appIndex);
     engine->destroyEngine();
     OHWarn("thread delete engine for appIndex: %{public}d", appIndex);
-
-    // 从 map 中移除并删除实例
-    engineMap.erase(appIndex);
-    //    delete engine;
+    rejectPendingPaths(env, appIndex);
 
     // 释放对应的线程安全函数
-    napi_threadsafe_function tsfn = getTsfn(appIndex);
     if (tsfn != nullptr) {
         napi_release_threadsafe_function(tsfn, napi_tsfn_release);
-        tsfnMap.erase(appIndex);
     }
 
     napi_value result;
@@ -646,6 +1302,63 @@ napi_value destroyJsEngine(napi_env env, napi_callback_info info) {
     return result;
 }
 
+// suspendEngine(appIndex) / resumeEngine(appIndex)：小程序切到后台 / 回到前台。
+// 只是排进任务队列，立即返回；引擎不存在或正在销毁返回 false
+static napi_value setEngineSuspended(napi_env env, napi_callback_info info, bool suspend) {
+    size_t argc = 1;
+    napi_value args[1] = {nullptr};
+    int appIndex = 0;
+    if (napi_ok != napi_get_cb_info(env, info, &argc, args, nullptr, nullptr) || argc < 1 ||
+        napi_ok != napi_get_value_int32(env, args[0], &appIndex)) {
+        napi_throw_error(env, "-1000", "arguments invalid");
+        return nullptr;
+    }
+
+    JSEngine *engine = getEngine(appIndex);
+    bool queued = false;
+    if (engine && !engine->closing) {
+        queued = suspend ? engine->suspend() : engine->resume();
+    } else {
+        OHLog("%{public}s engine_closing or not found for appIndex: %{public}d",
+              suspend ? "suspendEngine" : "resumeEngine", appIndex);
+    }
+    napi_value result;
+    napi_get_boolean(env, queued, &result);
+    return result;
+}
+
+napi_value SuspendEngine(napi_env env, napi_callback_info info) {
+    return setEngineSuspended(env, info, true);
+}
+
+napi_value ResumeEngine(napi_env env, napi_callback_info info) {
+    return setEngineSuspended(env, info, false);
+}
+
+// onVsync(appIndex, frameTimeNs)：宿主每个 vsync 调一次，驱动 requestAnimationFrame 和按帧 flush 的 publish。
+// frameTimeNs 是单调时钟的纳秒数（和 OH_NativeVSync / displaySync 给的时间戳同一个时钟），不传或为 0 时取当前时间。
+// 只唤醒 JS 线程，不排任务；宿主不推的话引擎按 60Hz 自己出帧
+napi_value OnVsync(napi_env env, napi_callback_info info) {
+    size_t argc = 2;
+    napi_value args[2] = {nullptr};
+    int appIndex = 0;
+    if (napi_ok != napi_get_cb_info(env, info, &argc, args, nullptr, nullptr) || argc < 1 ||
+        napi_ok != napi_get_value_int32(env, args[0], &appIndex)) {
+        napi_throw_error(env, "-1000", "arguments invalid");
+        return nullptr;
+    }
+    int64_t frameTimeNs = 0;
+    if (argc > 1 && napi_get_value_int64(env, args[1], &frameTimeNs) != napi_ok) {
+        frameTimeNs = 0;
+    }
+
+    JSEngine *engine = getEngine(appIndex);
+    if (engine && !engine->closing) {
+        engine->onVsync(frameTimeNs > 0 ? static_cast<uint64_t>(frameTimeNs) : 0);
+    }
+    return nullptr;
+}
+
 
 void initBridges(JSContext *ctx) {
     JSValue diminaServiceBridge = JS_NewObject(ctx);
@@ -660,6 +1373,7 @@ void registerInvoke(JSContext *ctx) {
     JSValue global = JS_GetGlobalObject(ctx);
     JSValue bridge = JS_GetPropertyStr(ctx, global, "DiminaServiceBridge");
     JS_SetPropertyStr(ctx, bridge, "invoke", pm_func);
+    JS_SetPropertyStr(ctx, bridge, "invokeAsync", JS_NewCFunction(ctx, invokeAsync, "invokeAsync", 1));
 
     JS_FreeValue(ctx, global);
     JS_FreeValue(ctx, bridge);
@@ -677,4 +1391,37 @@ void registerPublish(JSContext *ctx) {
     JS_FreeValue(ctx, bridge);
 
     OHLog("registerPublish done");
-}
\ No newline at end of file
+}
+
+static JSValue getOnMessage(JSContext *ctx, JSValueConst this_val) {
+    JSCore *core = static_cast<JSCore *>(JS_GetContextOpaque(ctx));
+    return core ? core->getMessageHandler() : JS_UNDEFINED;
+}
+
+static JSValue setOnMessage(JSContext *ctx, JSValueConst this_val, JSValueConst val) {
+    JSCore *core = static_cast<JSCore *>(JS_GetContextOpaque(ctx));
+    if (core) {
+        core->setMessageHandler(this_val, val);
+    }
+    return JS_UNDEFINED;
+}
+
+// onMessage 做成访问器：service 层照旧 `DiminaServiceBridge.onMessage = fn`，
+// 赋值直接落到 JSCore 里，dispatchJsMessage 拿来就能 JS_Call。
+void registerOnMessage(JSContext *ctx) {
+    JSValue global = JS_GetGlobalObject(ctx);
+    JSValue bridge = JS_GetPropertyStr(ctx, global, "DiminaServiceBridge");
+    JSAtom atom = JS_NewAtom(ctx, "onMessage");
+    JS_DefinePropertyGetSet(ctx, bridge, atom,
+                            JS_NewCFunction2(ctx, (JSCFunction *)getOnMessage, "get onMessage", 0,
+                                             JS_CFUNC_getter, 0),
+                            JS_NewCFunction2(ctx, (JSCFunction *)setOnMessage, "set onMessage", 1,
+                                             JS_CFUNC_setter, 0),
+                            JS_PROP_CONFIGURABLE | JS_PROP_ENUMERABLE);
+    JS_FreeAtom(ctx, atom);
+
+    JS_FreeValue(ctx, global);
+    JS_FreeValue(ctx, bridge);
+
+    OHLog("registerOnMessage done");
+}
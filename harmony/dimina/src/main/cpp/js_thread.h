@@ -9,8 +9,10 @@
 
 #include "napi/native_api.h"
 #include "quickjs.h"
+#include <cstdint>
 #include <cstdlib>
 #include <memory>
+#include <string>
 
 // JSValueToString 返回的是 strdup 出来的缓冲区，得由调用方 free。中途抛异常也要还，
 // 所以统一用带 free 删除器的 unique_ptr 接住，不自己写作用域类。
@@ -24,11 +26,33 @@ extern napi_value StartJsEngine(napi_env env, napi_callback_info info);
 extern napi_value dispatchJsTask(napi_env env, napi_callback_info info);
 extern napi_value dispatchJsTaskAb(napi_env env, napi_callback_info info);
 extern napi_value dispatchJsTaskPath(napi_env env, napi_callback_info info);
+extern napi_value dispatchJsMessage(napi_env env, napi_callback_info info);
 extern napi_value destroyJsEngine(napi_env env, napi_callback_info info);
+extern napi_value SetCodeCacheDir(napi_env env, napi_callback_info info);
+extern napi_value ConfigureJsEnginePool(napi_env env, napi_callback_info info);
+extern napi_value ConfigureJsWorkerPool(napi_env env, napi_callback_info info);
+extern napi_value GetEngineStats(napi_env env, napi_callback_info info);
+extern napi_value SuspendEngine(napi_env env, napi_callback_info info);
+extern napi_value ResumeEngine(napi_env env, napi_callback_info info);
+extern napi_value OnVsync(napi_env env, napi_callback_info info);
 
 extern JSValue sendLogToContainer(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
+// PublishBatcher flush 出来的一批交给 ArkTS。count 为 1 时 payload 就是那一条，按普通 publish 投递；
+// 否则是 "[m1,m2,...]"。只在 JS 线程调用，投递失败只记日志。
+extern void postPublishBatch(JSContext *ctx, int webViewId, OwnedCStr payload, size_t length, uint32_t count);
 extern bool isDebugMode;
 
+// dispatchJsTaskPath 在 JS 线程读完、执行完的结果，时间都是微秒。error 为空表示执行成功
+struct PathLoadResult {
+    uint64_t queueUs = 0; // 入队到开始读文件
+    uint64_t loadUs = 0;  // 读文件
+    uint64_t evalUs = 0;  // 编译（或读字节码缓存）加执行
+    uint64_t bytes = 0;
+    std::string error;
+};
+// 交给 ArkTS 线程兑现 dispatchJsTaskPath 返回的 Promise。只在 JS 线程调用，投递失败只记日志
+extern void postPathLoaded(JSContext *ctx, napi_deferred deferred, PathLoadResult result);
+
 // JS_EXCEPTION 只是个哨兵值，本身不带异常对象。底层已经挂了异常就原样保留，没挂的
 // （比如内存分配失败只返回空指针）自己补一个，否则 JS 侧拿到的是未初始化的内部值。
 extern JSValue throwNativeError(JSContext *ctx, const char *what);
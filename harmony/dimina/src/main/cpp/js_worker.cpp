@@ -0,0 +1,143 @@
+//
+// Created on 2026/10/16.
+//
+
+#include "js_worker.h"
+#include "log.h"
+#include <algorithm>
+
+namespace {
+
+// 默认线程数：一般手机是 2 个大核
+constexpr size_t kDefaultWorkerThreads = 2;
+
+std::mutex gWorkersMutex;
+std::vector<JSWorker *> gWorkers;
+
+void growLocked(size_t threads) {
+    while (gWorkers.size() < threads) {
+        gWorkers.push_back(new JSWorker(static_cast<int>(gWorkers.size())));
+    }
+}
+
+} // namespace
+
+JSWorker::JSWorker(int id) : id(id) {
+    // 循环和命令句柄在起线程之前初始化，post 从构造完成起就可以用
+    loop = uv_loop_new();
+    uv_async_init(loop, &commandHandle, command_cb);
+    commandHandle.data = this;
+
+    // 和独立线程模式一样的栈大小，Runtime 的 JS_SetMaxStackSize 按这个设的
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 1024 * 1024 * 128);
+    pthread_create(&tid, &attr, threadMain, this);
+    pthread_detach(tid);
+    pthread_attr_destroy(&attr);
+}
+
+void *JSWorker::threadMain(void *arg) {
+    auto *worker = static_cast<JSWorker *>(arg);
+    OHWarn("js worker %{public}d start", worker->id);
+    // commandHandle 一直活跃，循环不会退出
+    uv_run(worker->loop, UV_RUN_DEFAULT);
+    return nullptr;
+}
+
+void JSWorker::post(std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lock(commandMutex);
+        commands.push_back(std::move(fn));
+    }
+    uv_async_send(&commandHandle);
+}
+
+void JSWorker::command_cb(uv_async_t *handle) {
+    auto *worker = static_cast<JSWorker *>(handle->data);
+    std::deque<std::function<void()>> pending;
+    {
+        std::lock_guard<std::mutex> lock(worker->commandMutex);
+        pending.swap(worker->commands);
+    }
+    for (auto &fn : pending) {
+        fn();
+    }
+}
+
+void JSWorker::host(JSCore *core, std::function<void(JSContext *ctx)> registerFunc,
+                    std::function<void()> onDetached) {
+    engineCount++;
+    post([this, core, registerFunc, onDetached]() {
+        bind({core, onDetached});
+        core->attach(loop, registerFunc);
+        OHLog("js worker %{public}d host core %{public}p, load: %{public}zu", id, (void *)core, load());
+    });
+}
+
+void JSWorker::bind(HostedCore hosted) {
+    hosted.core->onHostDetached = [this](JSCore *core) {
+        auto it = std::find_if(cores.begin(), cores.end(), [core](const HostedCore &h) { return h.core == core; });
+        if (it == cores.end()) {
+            return;
+        }
+        std::function<void()> onDetached = std::move(it->onDetached);
+        cores.erase(it);
+        engineCount--;
+        // 还在 core 自己的回调里，onDetached 会把 core 交出去释放，放到下一轮命令里再调
+        post(std::move(onDetached));
+        rebalanceWorkers();
+    };
+    cores.push_back(std::move(hosted));
+}
+
+bool JSWorker::migrateIdleCoreTo(JSWorker *target) {
+    auto it = std::find_if(cores.begin(), cores.end(), [](const HostedCore &h) { return h.core->isIdle(); });
+    if (it == cores.end()) {
+        return false;
+    }
+    HostedCore hosted = std::move(*it);
+    cores.erase(it);
+    // 计数先挪过去，迁移途中的 rebalance 不会重复挑中同一对 worker
+    engineCount--;
+    target->engineCount++;
+    JSCore *core = hosted.core;
+    OHLog("js worker %{public}d migrate core %{public}p to %{public}d", id, (void *)core, target->id);
+    // 句柄全部关闭后旧循环不再引用 core，才能在目标线程上重新挂
+    core->detachForMigration([target, hosted]() {
+        target->post([target, hosted]() {
+            target->bind(hosted);
+            hosted.core->reattach(target->loop);
+        });
+    });
+    return true;
+}
+
+void configureWorkerPool(size_t threads) {
+    std::lock_guard<std::mutex> lock(gWorkersMutex);
+    growLocked(threads);
+}
+
+JSWorker *acquireWorker() {
+    std::lock_guard<std::mutex> lock(gWorkersMutex);
+    if (gWorkers.empty()) {
+        growLocked(kDefaultWorkerThreads);
+    }
+    return *std::min_element(gWorkers.begin(), gWorkers.end(),
+                             [](JSWorker *a, JSWorker *b) { return a->load() < b->load(); });
+}
+
+void rebalanceWorkers() {
+    std::lock_guard<std::mutex> lock(gWorkersMutex);
+    if (gWorkers.size() < 2) {
+        return;
+    }
+    auto bounds = std::minmax_element(gWorkers.begin(), gWorkers.end(),
+                                      [](JSWorker *a, JSWorker *b) { return a->load() < b->load(); });
+    JSWorker *idlest = *bounds.first;
+    JSWorker *busiest = *bounds.second;
+    if (busiest->load() < idlest->load() + 2) {
+        return;
+    }
+    busiest->post([busiest, idlest]() { busiest->migrateIdleCoreTo(idlest); });
+}
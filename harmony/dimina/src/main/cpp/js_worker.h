@@ -0,0 +1,73 @@
+//
+// Created on 2026/10/16.
+//
+// Node APIs are not fully supported. To solve the compilation error of the interface cannot be found,
+// please include "napi/native_api.h".
+
+#ifndef DIMINA_HARMONYOS_JS_WORKER_H
+#define DIMINA_HARMONYOS_JS_WORKER_H
+
+#include "js_core.h"
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <pthread.h>
+#include <uv.h>
+#include <vector>
+
+// 共享 JS 线程（M:N 调度）。一个 worker 一个线程、一个事件循环，上面挂多个 JSCore。
+// QuickJS Runtime 只能单线程使用，所以每个 JSCore 任意时刻只属于一个 worker；
+// 空闲的 JSCore 可以在 worker 之间迁移，让各线程上的引擎数保持均衡。
+// worker 跟进程同生命周期，不会退出。
+class JSWorker {
+public:
+    explicit JSWorker(int id);
+
+    // 任意线程调用，fn 在 worker 线程上执行
+    void post(std::function<void()> fn);
+
+    // 把 core 挂到这个 worker 上并创建 Runtime。onDetached 在 core 销毁完成后于 worker 线程上调用。
+    void host(JSCore *core, std::function<void(JSContext *ctx)> registerFunc, std::function<void()> onDetached);
+
+    // 挂在上面的引擎数，包括正在迁入的
+    size_t load() const {
+        return engineCount.load();
+    };
+
+    // worker 线程上调用：挑一个空闲的 core 迁到 target，没有空闲的返回 false
+    bool migrateIdleCoreTo(JSWorker *target);
+
+private:
+    static void *threadMain(void *arg);
+    static void command_cb(uv_async_t *handle);
+
+    struct HostedCore {
+        JSCore *core;
+        std::function<void()> onDetached;
+    };
+    // worker 线程上调用：登记 core 并把销毁回调绑到本 worker
+    void bind(HostedCore hosted);
+
+    int id;
+    pthread_t tid;
+    uv_loop_t *loop;
+    uv_async_t commandHandle;
+    std::mutex commandMutex;
+    std::deque<std::function<void()>> commands;
+
+    // 只在 worker 线程上访问
+    std::vector<HostedCore> cores;
+    std::atomic<size_t> engineCount{0};
+};
+
+// 设置共享 worker 的线程数，只增不减
+void configureWorkerPool(size_t threads);
+
+// 取当前负载最低的 worker，池没配置时按默认线程数初始化
+JSWorker *acquireWorker();
+
+// 负载差到 2 个以上时，从最忙的 worker 迁一个空闲引擎到最闲的
+void rebalanceWorkers();
+
+#endif // DIMINA_HARMONYOS_JS_WORKER_H
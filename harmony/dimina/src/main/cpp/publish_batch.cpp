@@ -0,0 +1,110 @@
+//
+// Created on 2026/10/16.
+//
+
+#include "publish_batch.h"
+#include "log.h"
+#include <cstdlib>
+#include <cstring>
+#include <uv.h>
+
+void PublishBatcher::configure(bool enabled, uint32_t bytes, uint64_t deadline) {
+    maxBytes.store(bytes, std::memory_order_relaxed);
+    deadlineUs.store(deadline, std::memory_order_relaxed);
+    isEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool PublishBatcher::add(JSContext *ctx, int webViewId, OwnedCStr &payload, size_t length) {
+    if (!enabled()) {
+        return false;
+    }
+    Batch *batch = nullptr;
+    for (Batch &b : batches) {
+        if (b.webViewId == webViewId) {
+            batch = &b;
+            break;
+        }
+    }
+    if (!batch) {
+        // 第一条直接接管原缓冲区，这一轮只有它的话原样投递
+        batches.push_back(Batch{webViewId, std::move(payload), length, length, 1, uv_hrtime()});
+        batch = &batches.back();
+    } else if (!append(*batch, payload.get(), length)) {
+        // 扩容失败：先把攒着的交出去，这一条单独开一批，顺序不变
+        OHError("publish batch grow failed, flush webViewId: %{public}d", webViewId);
+        flushBatch(ctx, *batch);
+        batch->data = std::move(payload);
+        batch->length = length;
+        batch->capacity = length;
+        batch->count = 1;
+        batch->firstNs = uv_hrtime();
+    } else {
+        payload.reset();
+    }
+
+    uint32_t bytes = maxBytes.load(std::memory_order_relaxed);
+    if (bytes > 0 && batch->length >= bytes) {
+        flushBatch(ctx, *batch);
+        batches.erase(batches.begin() + (batch - batches.data()));
+    }
+    uint64_t deadline = deadlineUs.load(std::memory_order_relaxed);
+    // batches 按第一次 publish 排序，队头最老
+    if (deadline > 0 && !batches.empty() && (uv_hrtime() - batches.front().firstNs) / 1000 >= deadline) {
+        flush(ctx);
+    }
+    return true;
+}
+
+bool PublishBatcher::append(Batch &batch, const char *payload, size_t length) {
+    // 第二条进来时才改写成数组：'[' + 第一条 + ',' + 第二条 + ']'，之后每条多一个 ','
+    // ',' + 新的一条 + ']' + '\0'，末尾原有的 ']' 被 ',' 覆盖
+    size_t needed = batch.length + 1 + length + 1 + (batch.count == 1 ? 2 : 0);
+    char *data = batch.data.get();
+    if (needed > batch.capacity) {
+        size_t capacity = batch.capacity * 2 > needed ? batch.capacity * 2 : needed;
+        data = static_cast<char *>(std::realloc(batch.data.get(), capacity));
+        if (!data) {
+            return false;
+        }
+        batch.data.release();
+        batch.data.reset(data);
+        batch.capacity = capacity;
+    }
+    if (batch.count == 1) {
+        std::memmove(data + 1, data, batch.length);
+        data[0] = '[';
+        data[batch.length + 1] = ']';
+        batch.length += 2;
+    }
+    char *tail = data + batch.length - 1;
+    *tail++ = ',';
+    std::memcpy(tail, payload, length);
+    tail += length;
+    *tail++ = ']';
+    *tail = '\0';
+    batch.length += 1 + length;
+    batch.count++;
+    return true;
+}
+
+void PublishBatcher::flushBatch(JSContext *ctx, Batch &batch) {
+    if (!batch.data) {
+        return;
+    }
+    postPublishBatch(ctx, batch.webViewId, std::move(batch.data), batch.length, batch.count);
+}
+
+void PublishBatcher::flush(JSContext *ctx) {
+    if (batches.empty()) {
+        return;
+    }
+    // postPublishBatch 不会回到 JS，这期间 batches 不会被改
+    for (Batch &batch : batches) {
+        flushBatch(ctx, batch);
+    }
+    batches.clear();
+}
+
+void PublishBatcher::clear() {
+    batches.clear();
+}
@@ -0,0 +1,61 @@
+//
+// Created on 2026/10/16.
+//
+// Node APIs are not fully supported. To solve the compilation error of the interface cannot be found,
+// please include "napi/native_api.h".
+
+#ifndef DIMINA_HARMONYOS_PUBLISH_BATCH_H
+#define DIMINA_HARMONYOS_PUBLISH_BATCH_H
+
+#include "js_thread.h"
+#include "quickjs.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 同一轮事件循环里的 publish 按 webViewId 攒起来，一次 threadsafe 调用交给 ArkTS，
+// 页面一帧里多次 setData 不再把主线程淹掉。攒出来的是 "[m1,m2,...]"，各条原样拼接，
+// 渲染层可以直接当成一个表达式执行。只攒到一条的照旧按单条投递，不多拷贝。
+// 触发 flush 的时机：每轮循环结束（prepare 阶段，JS 线程睡下去之前；frameAlignedPublish 时改成下一帧的
+// rAF 回调之后）、某个 webViewId 攒够 maxBytes、最早那条等了超过 deadlineUs；以及 invoke / 日志之前，
+// 保证宿主看到的消息顺序不变。
+class PublishBatcher {
+public:
+    // 任意线程配置，JS 线程读。maxBytes / deadlineUs 为 0 表示不按这个条件触发。
+    void configure(bool enabled, uint32_t maxBytes, uint64_t deadlineUs);
+    bool enabled() const {
+        return isEnabled.load(std::memory_order_relaxed);
+    };
+
+    // 以下只在 JS 线程调用。
+    // 没开启时返回 false，payload 原封不动，由调用方直接投递；开启时接管 payload。
+    bool add(JSContext *ctx, int webViewId, OwnedCStr &payload, size_t length);
+    void flush(JSContext *ctx);
+    void clear();
+    bool empty() const {
+        return batches.empty();
+    };
+
+private:
+    struct Batch {
+        int webViewId;
+        OwnedCStr data;
+        size_t length;
+        size_t capacity;
+        uint32_t count;
+        uint64_t firstNs;
+    };
+
+    bool append(Batch &batch, const char *payload, size_t length);
+    void flushBatch(JSContext *ctx, Batch &batch);
+
+    std::atomic<bool> isEnabled{false};
+    std::atomic<uint32_t> maxBytes{0};
+    std::atomic<uint64_t> deadlineUs{0};
+
+    // 按第一次 publish 的顺序 flush。同时打开的页面不多，线性查找就够了
+    std::vector<Batch> batches;
+};
+
+#endif // DIMINA_HARMONYOS_PUBLISH_BATCH_H
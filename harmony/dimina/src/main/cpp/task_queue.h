@@ -0,0 +1,111 @@
+//
+// Created on 2026/10/16.
+//
+// Node APIs are not fully supported. To solve the compilation error of the interface cannot be found,
+// please include "napi/native_api.h".
+
+#ifndef DIMINA_HARMONYOS_TASK_QUEUE_H
+#define DIMINA_HARMONYOS_TASK_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// 有界无锁多生产者单消费者环形队列（Vyukov 有界队列的 MPSC 版本）。
+// 每个槽位带一个序号：序号等于写位置说明可写，等于读位置 + 1 说明可读。
+// 元素只移动不拷贝，入队成功后原对象被移空，出队时再移给调用方。
+// tryPush 可以在任意线程调用；tryPop / front / empty 只能在唯一的消费者线程调用。
+template <typename T>
+class MpscRingQueue {
+public:
+    // capacity 会向上取整到 2 的幂
+    explicit MpscRingQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        mask = size - 1;
+        cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRingQueue(const MpscRingQueue &) = delete;
+    MpscRingQueue &operator=(const MpscRingQueue &) = delete;
+
+    // 队列满时返回 false，value 保持不变
+    bool tryPush(T &value) {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T &value) {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell *cell = &cells[pos & mask];
+        if (cell->sequence.load(std::memory_order_acquire) != pos + 1) {
+            return false;
+        }
+        value = std::move(cell->value);
+        // 移走后留下的空对象也重置一下，大块内存跟着任务一起释放，不会滞留在槽位里
+        cell->value = T();
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        dequeuePos.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // 看一眼队头但不取出，队列空时返回 nullptr。指针在下一次 tryPop 之前有效。
+    T *front() {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        Cell *cell = &cells[pos & mask];
+        if (cell->sequence.load(std::memory_order_acquire) != pos + 1) {
+            return nullptr;
+        }
+        return &cell->value;
+    }
+
+    bool empty() const {
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        return cells[pos & mask].sequence.load(std::memory_order_acquire) != pos + 1;
+    }
+
+    // 近似值，只用于日志
+    size_t size() const {
+        size_t head = dequeuePos.load(std::memory_order_relaxed);
+        size_t tail = enqueuePos.load(std::memory_order_relaxed);
+        return tail > head ? tail - head : 0;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    // 读写位置各占一条缓存行，生产者和消费者互不干扰
+    alignas(64) std::atomic<size_t> enqueuePos{0};
+    alignas(64) std::atomic<size_t> dequeuePos{0};
+};
+
+#endif // DIMINA_HARMONYOS_TASK_QUEUE_H
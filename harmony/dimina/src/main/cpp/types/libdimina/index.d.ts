@@ -1,14 +1,171 @@
 // Dimina Native
+export interface JsEngineOptions {
+  // 每轮事件循环最多连续执行的任务数，默认 64
+  drainMaxTasks?: number;
+  // 每轮事件循环连续执行任务的时间预算（毫秒），默认 8
+  drainTimeBudgetMs?: number;
+  // 有任务时才唤醒 JS 线程，空闲时阻塞在 epoll 上，默认 true；false 回到 idle 空转的老调度
+  eventDriven?: boolean;
+  // 挂到共享 JS 线程上（见 configureJsWorkerPool），不单独起线程，默认 false。
+  // 共享线程上不能阻塞：同步的 DiminaServiceBridge.invoke 会抛 TypeError，只能用 invokeAsync；invoke 积压满了也不等。
+  // 逻辑层（service bundle）的 *Sync API 都依赖同步 invoke，不要给跑 service 的引擎开这个选项
+  sharedWorker?: boolean;
+  // 普通 / 后台任务排队超过这么久就先于高优先级任务执行，默认 50 / 200 毫秒
+  normalAgingMs?: number;
+  backgroundAgingMs?: number;
+  // 单个任务执行超过 longTaskMs 记一条长任务（默认 50）；超过 taskHardLimitMs 中断任务（默认 0，不中断）
+  longTaskMs?: number;
+  taskHardLimitMs?: number;
+  // 一次连续执行微任务的预算，默认 1000 个 / 8 毫秒，剩下的留到下一轮循环
+  microtaskMaxJobs?: number;
+  microtaskTimeBudgetMs?: number;
+  // 同一轮事件循环里的 publish 按 webViewId 合并成一次回调（t 为 4，内容是 JSON 数组），默认 false。
+  // 单个页面攒够 publishBatchMaxBytes（默认 256K）或最早一条等了 publishBatchDeadlineMs（默认 16）就提前交出，0 表示不限
+  publishBatching?: boolean;
+  publishBatchMaxBytes?: number;
+  publishBatchDeadlineMs?: number;
+  // 开启 publishBatching 时，攒着的 publish 等到下一帧、requestAnimationFrame 回调跑完之后再一起交出，
+  // 每帧最多一次（帧来自 onVsync，宿主不推时按 60Hz）。默认 false，每轮事件循环结束时交出
+  frameAlignedPublish?: boolean;
+  // invoke 消息的编码，默认 'json'。'binary' 时回调的 o 参数是 native 解好的消息对象，d 为空串
+  wireFormat?: 'json' | 'binary';
+  // 发给 ArkTS、还没处理完的消息按种类限条数，0 表示不限。满了 invoke 阻塞 JS 线程（默认 64），
+  // publish 同一页面合并成一次 t 为 4 的回调（默认 64），日志丢掉最老的（默认 128）
+  invokeQueueLimit?: number;
+  publishQueueLimit?: number;
+  logQueueLimit?: number;
+}
+
+// 任务优先级：0 用户交互（点击、输入），1 普通（默认），2 后台批量
+export type JsTaskPriority = 0 | 1 | 2;
+
 export const StartJsEngine: (appIndex: number,
-  f: (t: number, w: number, d: string, a: ArrayBuffer) => number | string | boolean | object,
-  isDebugMode: boolean) => number;
+  f: (t: number, w: number, d: string, a: ArrayBuffer, o?: object) => number | string | boolean | object,
+  isDebugMode: boolean, options?: JsEngineOptions) => number;
+
+export const dispatchJsTask: (appIndex: number, script: string, priority?: JsTaskPriority) => void;
+
+export const dispatchJsTaskAb: (appIndex: number, ab: ArrayBuffer, priority?: JsTaskPriority) => void;
 
-export const dispatchJsTask: (appIndex: number, script: string) => void;
+// 文件在 JS 线程读取并执行，执行完 Promise 兑现；读失败或脚本抛异常时 reject，Error 上同样带 loadUs / evalUs。
+// 引擎在执行前销毁的话，destroyJsEngine 时 reject
+export const dispatchJsTaskPath: (appIndex: number, path: string, priority?: JsTaskPriority) => Promise<PathLoadResult>;
 
-export const dispatchJsTaskAb: (appIndex: number, ab: ArrayBuffer) => void;
+// 时间单位都是微秒。preloaded 为 true 时预热引擎已经执行过这个脚本，其余字段都没有
+export interface PathLoadResult {
+  preloaded: boolean;
+  // 入队到开始读文件
+  queueUs?: number;
+  loadUs?: number;
+  // 编译（或读字节码缓存）加执行
+  evalUs?: number;
+  bytes?: number;
+}
 
-export const dispatchJsTaskPath: (appIndex: number, script: string) => void;
+// payload 是 JSON 文本或二进制编码（string / ArrayBuffer），也可以直接传对象，由 native 编码后交给 JS 线程
+export const dispatchJsMessage: (appIndex: number, payload: string | ArrayBuffer | object, priority?: JsTaskPriority) => void;
 
 export const destroyJsEngine: (appIndex: number) => number;
 
+export const setCodeCacheDir: (dir: string) => void;
+
+// 预热引擎池大小；preloadPath 为预先执行的脚本，之后同一路径的 dispatchJsTaskPath 会跳过；
+// recycle 为 true 时销毁的引擎释放 Runtime 后复用线程和事件循环，放回池里
+export const configureJsEnginePool: (size: number, preloadPath?: string, recycle?: boolean) => void;
+
+// 共享 JS 线程数，只增不减，默认 2
+export const configureJsWorkerPool: (threads: number) => void;
+
+// 直方图摘要，百分位是所在桶的上界，误差不超过 12.5%
+export interface HistogramSummary {
+  count: number;
+  mean: number;
+  p50: number;
+  p90: number;
+  p99: number;
+  max: number;
+}
+
+export interface LongTaskEvent {
+  // script / file / message / timer / immediate / frame / microtask
+  kind: string;
+  // 开始时间，毫秒时间戳
+  startTime: number;
+  durationUs: number;
+  // 超时那一刻的调用栈，卡在 native 调用里的任务为空串
+  stack: string;
+  // 超过 taskHardLimitMs 被中断
+  aborted: boolean;
+}
+
+export interface BridgeQueueStats {
+  limit: number;
+  // 已投递、ArkTS 还没处理完的条数
+  inFlight: number;
+  maxInFlight: number;
+  // invoke 等名额的次数和总时长
+  stalls: number;
+  stallUs: number;
+  // sharedWorker 引擎的 invoke 不等名额，超出上限照样投递的次数
+  overLimit: number;
+  // 被挤掉的日志条数
+  dropped: number;
+  // 合并进同一页面前一批的 publish 条数
+  coalesced: number;
+}
+
+// 时间单位都是微秒
+export interface EngineStats {
+  tasksExecuted: number;
+  // 最近一个完整的一秒窗口
+  tasksPerSec: number;
+  loopIterations: number;
+  wakeups: number;
+  queueDepth: number;
+  maxQueueDepth: number;
+  // 按优先级的排队数，下标同 JsTaskPriority
+  laneDepth: number[];
+  // 因为老化提前执行的任务数
+  agedTasks: number;
+  queueWaitUs: HistogramSummary;
+  evalUs: HistogramSummary;
+  microtaskUs: HistogramSummary;
+  queueDepthSamples: HistogramSummary;
+  longTaskCount: number;
+  abortedTasks: number;
+  // 微任务预算用完、剩下的留到下一轮的次数
+  microtaskOverruns: number;
+  // 跑过的帧数，以及其中宿主没推 vsync、由 60Hz 兜底定时器驱动的
+  frames: number;
+  fallbackFrames: number;
+  // 最近 32 条长任务
+  longTasks: LongTaskEvent[];
+  bridgeQueues: {
+    invoke: BridgeQueueStats;
+    publish: BridgeQueueStats;
+    log: BridgeQueueStats;
+  };
+  // suspendEngine 已经在 JS 线程上生效
+  suspended: boolean;
+}
+
+// 不经过 JS 线程，可以随意轮询；引擎不存在返回 undefined
+export const getEngineStats: (appIndex: number) => EngineStats | undefined;
+
+// 小程序切到后台：所有定时器（包括 setInterval）冻结、immediate 暂停，做一次完整 GC，
+// 之后没有任务时引擎线程不再被唤醒。任务照常执行，期间新建的定时器等恢复后才开始计时。
+// 和 dispatchJsTask 一样按 Normal 排队，排在之前发出的 onHide 之后；立即返回，引擎不存在返回 false
+export const suspendEngine: (appIndex: number) => boolean;
+
+// 回到前台：定时器的到期时间按挂起时长顺延，剩余时间和挂起前一样，错过的周期不补
+export const resumeEngine: (appIndex: number) => boolean;
+
+// 宿主的 vsync，驱动 requestAnimationFrame 和 frameAlignedPublish。frameTimeNs 是单调时钟的纳秒时间戳
+// （displaySync 的 IntervalInfo.timestamp），rAF 回调收到的是它的毫秒数；不传时取当前时间。
+// 只唤醒 JS 线程，JS 线程来不及处理的几帧合并成最新的一帧；超过 100 毫秒不推就改由引擎按 60Hz 自己出帧
+export const onVsync: (appIndex: number, frameTimeNs?: number) => void;
+
 export const brotliDecompress: (data: ArrayBuffer) => ArrayBuffer;
+
+// 仅供测试：在临时的 QuickJS 上下文里执行脚本，返回转换成 ArkTS 的结果；脚本或转换出错时抛 Error
+export const evalJsValueForTest: (script: string) => number | string | boolean | object | null | undefined;
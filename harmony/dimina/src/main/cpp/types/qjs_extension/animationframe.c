@@ -0,0 +1,165 @@
+#ifndef QJS_ANIMATION_FRAME_C
+#define QJS_ANIMATION_FRAME_C
+
+#include "types/qjs_extension/animationframe.h"
+#include "quickjs.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 微任务预算、长任务监控和异常日志，见 js_core.h
+extern void js_core_process_pending_jobs(JSContext* ctx);
+extern int js_core_begin_task(JSContext* ctx, const char* kind);
+extern void js_core_end_task(JSContext* ctx);
+extern void js_core_report_exception(JSContext* ctx);
+// 帧由 JSCore 驱动（宿主推的 vsync，或者兜底的定时器），状态也存在 JSCore 上，见 js_core.h
+extern void js_core_request_frame(JSContext* ctx);
+extern void* js_core_get_frames(JSContext* ctx);
+extern void js_core_set_frames(JSContext* ctx, void* frames);
+
+typedef struct {
+    uint32_t id;
+    JSValue func; // 执行过或者取消了就是 undefined
+} FrameCallback;
+
+// 按登记顺序排，id 递增。一帧里的回调不多，取消时线性查找就够了
+typedef struct {
+    JSContext *ctx;
+    FrameCallback *entries;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t live;   // 没取消的条数
+    uint32_t nextId;
+} FrameQueue;
+
+static FrameQueue *getQueue(JSContext *ctx) {
+    return (FrameQueue *)js_core_get_frames(ctx);
+}
+
+void runAnimationFrames(JSContext *ctx, double frameTimeMs) {
+    FrameQueue *q = getQueue(ctx);
+    if (!q || q->count == 0) {
+        return;
+    }
+    // 只跑到这一帧开始时的最后一条；回调里登记的追加在后面，扩容也不影响下标
+    uint32_t n = q->count;
+    JSValue timestamp = JS_NewFloat64(ctx, frameTimeMs);
+    for (uint32_t i = 0; i < n; i++) {
+        JSValue func = q->entries[i].func;
+        if (JS_IsUndefined(func)) {
+            continue;
+        }
+        q->entries[i].func = JS_UNDEFINED;
+        q->live--;
+        int watching = js_core_begin_task(ctx, "frame");
+        JSValue ret = JS_Call(ctx, func, JS_UNDEFINED, 1, &timestamp);
+        if (watching) {
+            js_core_end_task(ctx);
+        }
+        if (JS_IsException(ret)) {
+            js_core_report_exception(ctx);
+        }
+        JS_FreeValue(ctx, ret);
+        JS_FreeValue(ctx, func);
+        // 和浏览器一样，每个回调之后都跑一次微任务
+        js_core_process_pending_jobs(ctx);
+    }
+    JS_FreeValue(ctx, timestamp);
+    q->count -= n;
+    memmove(q->entries, q->entries + n, q->count * sizeof(FrameCallback));
+    if (q->live == 0) {
+        // 剩下的都取消了
+        q->count = 0;
+    }
+}
+
+int hasPendingAnimationFrames(JSContext *ctx) {
+    FrameQueue *q = getQueue(ctx);
+    return q && q->live > 0;
+}
+
+static JSValue js_requestAnimationFrame(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    if (argc < 1 || !JS_IsFunction(ctx, argv[0]))
+        return JS_ThrowTypeError(ctx, "Argument must be a function");
+
+    FrameQueue *q = getQueue(ctx);
+    if (!q) {
+        return JS_ThrowInternalError(ctx, "requestAnimationFrame is not available");
+    }
+    if (q->count == q->capacity) {
+        uint32_t capacity = q->capacity ? q->capacity * 2 : 16;
+        FrameCallback *entries = realloc(q->entries, capacity * sizeof(FrameCallback));
+        if (!entries) {
+            return JS_ThrowOutOfMemory(ctx);
+        }
+        q->entries = entries;
+        q->capacity = capacity;
+    }
+    // 0 留给“无效 id”，回绕时跳过
+    if (++q->nextId == 0) {
+        q->nextId = 1;
+    }
+    FrameCallback *entry = &q->entries[q->count++];
+    entry->id = q->nextId;
+    entry->func = JS_DupValue(ctx, argv[0]);
+    if (q->live++ == 0) {
+        js_core_request_frame(ctx);
+    }
+    return JS_NewUint32(ctx, entry->id);
+}
+
+static JSValue js_cancelAnimationFrame(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    if (argc < 1 || !JS_IsNumber(argv[0]))
+        return JS_UNDEFINED;
+    uint32_t id;
+    if (JS_ToUint32(ctx, &id, argv[0]))
+        return JS_EXCEPTION;
+
+    FrameQueue *q = getQueue(ctx);
+    if (!q || id == 0) {
+        return JS_UNDEFINED;
+    }
+    for (uint32_t i = 0; i < q->count; i++) {
+        if (q->entries[i].id == id) {
+            if (!JS_IsUndefined(q->entries[i].func)) {
+                JS_FreeValue(ctx, q->entries[i].func);
+                q->entries[i].func = JS_UNDEFINED;
+                q->live--;
+            }
+            break;
+        }
+    }
+    return JS_UNDEFINED;
+}
+
+void animationFrameInit(JSContext *ctx) {
+    FrameQueue *q = calloc(1, sizeof(FrameQueue));
+    if (q) {
+        q->ctx = ctx;
+    }
+    js_core_set_frames(ctx, q);
+
+    JSValue global = JS_GetGlobalObject(ctx);
+
+    JSValue request_func = JS_NewCFunction(ctx, js_requestAnimationFrame, "requestAnimationFrame", 1);
+    JS_SetPropertyStr(ctx, global, "requestAnimationFrame", request_func);
+
+    JSValue cancel_func = JS_NewCFunction(ctx, js_cancelAnimationFrame, "cancelAnimationFrame", 1);
+    JS_SetPropertyStr(ctx, global, "cancelAnimationFrame", cancel_func);
+
+    JS_FreeValue(ctx, global);
+}
+
+void animationFrameFree(JSContext *ctx) {
+    FrameQueue *q = getQueue(ctx);
+    if (!q) {
+        return;
+    }
+    for (uint32_t i = 0; i < q->count; i++) {
+        JS_FreeValue(ctx, q->entries[i].func);
+    }
+    free(q->entries);
+    free(q);
+    js_core_set_frames(ctx, NULL);
+}
+#endif // QJS_ANIMATION_FRAME_C
@@ -0,0 +1,25 @@
+#ifndef QJS_ANIMATION_FRAME_h
+#define QJS_ANIMATION_FRAME_h
+
+#include "quickjs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// requestAnimationFrame / cancelAnimationFrame。
+// 状态放在 JSCore 上（js_core_set_frames），和 timeoutInit 一样在 JS_SetContextOpaque 之后调用
+void animationFrameInit(JSContext *ctx);
+// 丢掉没执行的回调并释放状态，Runtime 释放前调用
+void animationFrameFree(JSContext *ctx);
+// JSCore 收到一帧时调用：执行这一帧开始前登记的回调，参数是帧时间（毫秒，单调时钟）。
+// 回调里再登记的留到下一帧
+void runAnimationFrames(JSContext *ctx, double frameTimeMs);
+// 是否还有等下一帧的回调
+int hasPendingAnimationFrames(JSContext *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,427 @@
+#ifndef QJS_SCHEDULER_C
+#define QJS_SCHEDULER_C
+
+#include "types/qjs_extension/scheduler.h"
+#include "quickjs.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// 微任务预算、长任务监控和异常日志，见 js_core.h
+extern void js_core_process_pending_jobs(JSContext* ctx);
+extern int js_core_begin_task(JSContext* ctx, const char* kind);
+extern void js_core_end_task(JSContext* ctx);
+extern void js_core_report_exception(JSContext* ctx);
+// immediate 共用 JSCore 的一个 uv_check_t，状态也存在 JSCore 上，见 js_core.h
+extern void js_core_arm_immediates(JSContext* ctx, int pending);
+extern void* js_core_get_immediates(JSContext* ctx);
+extern void js_core_set_immediates(JSContext* ctx, void* immediates);
+
+// 一条 setImmediate 回调，或者一条发往 MessagePort 的消息
+typedef struct {
+    JSValue func;    // setImmediate 的回调；端口消息是接收方的端口
+    JSValue *argv;   // 端口消息只有一个参数 data
+    int argc;
+    int isMessage;
+    int cleared;
+} ImmediateEntry;
+
+// 先进先出的环形队列。id 按入队顺序递增，第 k 条的 id 是 headId + k，clearImmediate 不用查找。
+// 清掉的只做标记，出队时跳过；全部清掉时整个队列直接清空。
+typedef struct {
+    JSContext *ctx;
+    ImmediateEntry *entries;
+    uint32_t capacity; // 2 的幂
+    uint32_t head;
+    uint32_t count;
+    uint32_t live;     // 没清掉的条数
+    uint64_t headId;
+} ImmediateQueue;
+
+// 同一个引擎里的端口对，peer 互相持有，靠 gc_mark 让循环引用能被回收。
+// 消息不做结构化克隆，对端拿到的是同一个对象。
+typedef struct {
+    JSValue peer;
+    int closed;
+} MessagePort;
+
+static JSClassID portClassId;
+// JS_NewClassID 检查、分配全局 id 时不加锁，各引擎线程同时建 Runtime 会各分到一个、互相覆盖
+static pthread_once_t portClassOnce = PTHREAD_ONCE_INIT;
+
+static void allocPortClassId(void) {
+    JS_NewClassID(&portClassId);
+}
+
+static ImmediateQueue *getQueue(JSContext *ctx) {
+    return (ImmediateQueue *)js_core_get_immediates(ctx);
+}
+
+static void freeEntry(JSContext *ctx, ImmediateEntry *entry) {
+    JS_FreeValue(ctx, entry->func);
+    entry->func = JS_UNDEFINED;
+    for (int i = 0; i < entry->argc; i++) {
+        JS_FreeValue(ctx, entry->argv[i]);
+    }
+    free(entry->argv);
+    entry->argv = NULL;
+    entry->argc = 0;
+}
+
+// 剩下的都是清掉的，整个队列清空，句柄停掉
+static void resetIfEmpty(ImmediateQueue *q) {
+    if (q->live > 0) {
+        return;
+    }
+    q->headId += q->count;
+    q->head = 0;
+    q->count = 0;
+    js_core_arm_immediates(q->ctx, 0);
+}
+
+// argv 的所有权交给队列，失败时还在调用方
+static int pushEntry(ImmediateQueue *q, JSValue func, JSValue *argv, int argc, int isMessage, uint64_t *id) {
+    if (q->count == q->capacity) {
+        uint32_t capacity = q->capacity ? q->capacity * 2 : 64;
+        ImmediateEntry *entries = malloc(capacity * sizeof(ImmediateEntry));
+        if (!entries) {
+            return -1;
+        }
+        // 按出队顺序展开到新数组的开头
+        for (uint32_t i = 0; i < q->count; i++) {
+            entries[i] = q->entries[(q->head + i) & (q->capacity - 1)];
+        }
+        free(q->entries);
+        q->entries = entries;
+        q->capacity = capacity;
+        q->head = 0;
+    }
+    ImmediateEntry *entry = &q->entries[(q->head + q->count) & (q->capacity - 1)];
+    entry->func = JS_DupValue(q->ctx, func);
+    entry->argv = argv;
+    entry->argc = argc;
+    entry->isMessage = isMessage;
+    entry->cleared = 0;
+    if (id) {
+        *id = q->headId + q->count;
+    }
+    q->count++;
+    if (q->live++ == 0) {
+        js_core_arm_immediates(q->ctx, 1);
+    }
+    return 0;
+}
+
+static void callImmediate(JSContext *ctx, ImmediateEntry *entry) {
+    int watching = js_core_begin_task(ctx, "immediate");
+    JSValue ret = JS_Call(ctx, entry->func, JS_UNDEFINED, entry->argc, (JSValueConst *)entry->argv);
+    if (watching) {
+        js_core_end_task(ctx);
+    }
+    if (JS_IsException(ret)) {
+        js_core_report_exception(ctx);
+    }
+    JS_FreeValue(ctx, ret);
+}
+
+// 端口已经关掉或者没设 onmessage 的，消息直接丢掉
+static void deliverMessage(JSContext *ctx, JSValueConst target, JSValueConst data) {
+    MessagePort *port = JS_GetOpaque(target, portClassId);
+    if (!port || port->closed) {
+        return;
+    }
+    JSValue handler = JS_GetPropertyStr(ctx, target, "onmessage");
+    if (!JS_IsFunction(ctx, handler)) {
+        if (JS_IsException(handler)) {
+            js_core_report_exception(ctx);
+        }
+        JS_FreeValue(ctx, handler);
+        return;
+    }
+    JSValue event = JS_NewObject(ctx);
+    JS_SetPropertyStr(ctx, event, "data", JS_DupValue(ctx, data));
+    JS_SetPropertyStr(ctx, event, "target", JS_DupValue(ctx, target));
+    int watching = js_core_begin_task(ctx, "immediate");
+    JSValue ret = JS_Call(ctx, handler, target, 1, (JSValueConst *)&event);
+    if (watching) {
+        js_core_end_task(ctx);
+    }
+    if (JS_IsException(ret)) {
+        js_core_report_exception(ctx);
+    }
+    JS_FreeValue(ctx, ret);
+    JS_FreeValue(ctx, event);
+    JS_FreeValue(ctx, handler);
+}
+
+void runImmediates(JSContext *ctx) {
+    ImmediateQueue *q = getQueue(ctx);
+    if (!q) {
+        return;
+    }
+    // 回调里新排的留到下一轮，和 Node 一致；句柄还开着，poll 不会阻塞
+    uint64_t limitId = q->headId + q->count;
+    while (q->count > 0 && q->headId < limitId) {
+        // 先出队再执行，回调里入队导致扩容也不影响这一条
+        ImmediateEntry entry = q->entries[q->head];
+        q->head = (q->head + 1) & (q->capacity - 1);
+        q->count--;
+        q->headId++;
+        if (entry.cleared) {
+            continue;
+        }
+        q->live--;
+        if (entry.isMessage) {
+            deliverMessage(ctx, entry.func, entry.argv[0]);
+        } else {
+            callImmediate(ctx, &entry);
+        }
+        freeEntry(ctx, &entry);
+        // 每条都是一个宏任务，之间把微任务跑掉
+        js_core_process_pending_jobs(ctx);
+    }
+    resetIfEmpty(q);
+}
+
+int hasPendingImmediates(JSContext *ctx) {
+    ImmediateQueue *q = getQueue(ctx);
+    return q && q->live > 0;
+}
+
+static JSValue microtaskJob(JSContext *ctx, int argc, JSValueConst *argv) {
+    // 异常留给 JS_ExecutePendingJob 的调用方记日志
+    return JS_Call(ctx, argv[0], JS_UNDEFINED, 0, NULL);
+}
+
+static JSValue js_queueMicrotask(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    if (argc < 1 || !JS_IsFunction(ctx, argv[0]))
+        return JS_ThrowTypeError(ctx, "Argument must be a function");
+    if (JS_EnqueueJob(ctx, microtaskJob, 1, argv) < 0)
+        return JS_EXCEPTION;
+    return JS_UNDEFINED;
+}
+
+static JSValue js_setImmediate(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    if (argc < 1 || !JS_IsFunction(ctx, argv[0]))
+        return JS_ThrowTypeError(ctx, "Argument must be a function");
+
+    ImmediateQueue *q = getQueue(ctx);
+    if (!q) {
+        return JS_ThrowInternalError(ctx, "setImmediate is not available");
+    }
+    int nargs = argc - 1;
+    JSValue *args = NULL;
+    if (nargs > 0) {
+        args = malloc(nargs * sizeof(JSValue));
+        if (!args) {
+            return JS_ThrowOutOfMemory(ctx);
+        }
+        for (int i = 0; i < nargs; i++) {
+            args[i] = JS_DupValue(ctx, argv[i + 1]);
+        }
+    }
+    uint64_t id;
+    if (pushEntry(q, argv[0], args, nargs, 0, &id) != 0) {
+        for (int i = 0; i < nargs; i++) {
+            JS_FreeValue(ctx, args[i]);
+        }
+        free(args);
+        return JS_ThrowOutOfMemory(ctx);
+    }
+    return JS_NewInt64(ctx, (int64_t)id);
+}
+
+static JSValue js_clearImmediate(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    if (argc < 1 || !JS_IsNumber(argv[0]))
+        return JS_UNDEFINED;
+    int64_t id;
+    if (JS_ToInt64(ctx, &id, argv[0]))
+        return JS_EXCEPTION;
+
+    ImmediateQueue *q = getQueue(ctx);
+    if (!q || id < 0 || (uint64_t)id < q->headId || (uint64_t)id - q->headId >= q->count) {
+        return JS_UNDEFINED;
+    }
+    ImmediateEntry *entry = &q->entries[(q->head + (uint32_t)((uint64_t)id - q->headId)) & (q->capacity - 1)];
+    if (entry->cleared || entry->isMessage) {
+        return JS_UNDEFINED;
+    }
+    entry->cleared = 1;
+    freeEntry(ctx, entry);
+    q->live--;
+    resetIfEmpty(q);
+    return JS_UNDEFINED;
+}
+
+static void js_port_finalizer(JSRuntime *rt, JSValue val) {
+    MessagePort *port = JS_GetOpaque(val, portClassId);
+    if (port) {
+        JS_FreeValueRT(rt, port->peer);
+        free(port);
+    }
+}
+
+static void js_port_mark(JSRuntime *rt, JSValueConst val, JS_MarkFunc *mark_func) {
+    MessagePort *port = JS_GetOpaque(val, portClassId);
+    if (port) {
+        JS_MarkValue(rt, port->peer, mark_func);
+    }
+}
+
+static JSClassDef portClass = {
+    .class_name = "MessagePort",
+    .finalizer = js_port_finalizer,
+    .gc_mark = js_port_mark,
+};
+
+static JSValue newPort(JSContext *ctx) {
+    JSValue obj = JS_NewObjectClass(ctx, portClassId);
+    if (JS_IsException(obj)) {
+        return obj;
+    }
+    MessagePort *port = calloc(1, sizeof(MessagePort));
+    if (!port) {
+        JS_FreeValue(ctx, obj);
+        return JS_ThrowOutOfMemory(ctx);
+    }
+    port->peer = JS_UNDEFINED;
+    JS_SetOpaque(obj, port);
+    return obj;
+}
+
+// 和 setImmediate 共用一个队列，消息按发送顺序在 check 阶段送到对端的 onmessage
+static JSValue js_port_postMessage(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    MessagePort *port = JS_GetOpaque(this_val, portClassId);
+    if (!port)
+        return JS_ThrowTypeError(ctx, "not a MessagePort");
+    if (port->closed) {
+        return JS_UNDEFINED;
+    }
+    ImmediateQueue *q = getQueue(ctx);
+    if (!q) {
+        return JS_ThrowInternalError(ctx, "MessagePort is not available");
+    }
+    JSValue *args = malloc(sizeof(JSValue));
+    if (!args) {
+        return JS_ThrowOutOfMemory(ctx);
+    }
+    args[0] = argc > 0 ? JS_DupValue(ctx, argv[0]) : JS_UNDEFINED;
+    if (pushEntry(q, port->peer, args, 1, 1, NULL) != 0) {
+        JS_FreeValue(ctx, args[0]);
+        free(args);
+        return JS_ThrowOutOfMemory(ctx);
+    }
+    return JS_UNDEFINED;
+}
+
+// 两端一起关，已经排队的消息送达时丢掉
+static JSValue js_port_close(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    MessagePort *port = JS_GetOpaque(this_val, portClassId);
+    if (!port)
+        return JS_ThrowTypeError(ctx, "not a MessagePort");
+    port->closed = 1;
+    MessagePort *peer = JS_GetOpaque(port->peer, portClassId);
+    if (peer) {
+        peer->closed = 1;
+    }
+    return JS_UNDEFINED;
+}
+
+// 设置 onmessage 就开始接收，start 只是兼容写法
+static JSValue js_port_start(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    return JS_UNDEFINED;
+}
+
+static JSValue js_MessageChannel(JSContext *ctx, JSValueConst new_target, int argc, JSValueConst *argv) {
+    JSValue proto = JS_GetPropertyStr(ctx, new_target, "prototype");
+    if (JS_IsException(proto)) {
+        return proto;
+    }
+    JSValue channel = JS_NewObjectProto(ctx, proto);
+    JS_FreeValue(ctx, proto);
+    if (JS_IsException(channel)) {
+        return channel;
+    }
+    JSValue port1 = newPort(ctx);
+    JSValue port2 = JS_IsException(port1) ? JS_EXCEPTION : newPort(ctx);
+    if (JS_IsException(port2)) {
+        JS_FreeValue(ctx, port1);
+        JS_FreeValue(ctx, channel);
+        return JS_EXCEPTION;
+    }
+    ((MessagePort *)JS_GetOpaque(port1, portClassId))->peer = JS_DupValue(ctx, port2);
+    ((MessagePort *)JS_GetOpaque(port2, portClassId))->peer = JS_DupValue(ctx, port1);
+    JS_DefinePropertyValueStr(ctx, channel, "port1", port1, JS_PROP_ENUMERABLE | JS_PROP_CONFIGURABLE);
+    JS_DefinePropertyValueStr(ctx, channel, "port2", port2, JS_PROP_ENUMERABLE | JS_PROP_CONFIGURABLE);
+    return channel;
+}
+
+void schedulerInit(JSContext *ctx) {
+    ImmediateQueue *q = calloc(1, sizeof(ImmediateQueue));
+    if (q) {
+        q->ctx = ctx;
+        q->headId = 1;
+    }
+    js_core_set_immediates(ctx, q);
+
+    // class id 进程内只分配一次，类按 Runtime 注册
+    JSRuntime *rt = JS_GetRuntime(ctx);
+    pthread_once(&portClassOnce, allocPortClassId);
+    if (!JS_IsRegisteredClass(rt, portClassId)) {
+        JS_NewClass(rt, portClassId, &portClass);
+    }
+    JSValue portProto = JS_NewObject(ctx);
+    JS_SetPropertyStr(ctx, portProto, "postMessage", JS_NewCFunction(ctx, js_port_postMessage, "postMessage", 1));
+    JS_SetPropertyStr(ctx, portProto, "close", JS_NewCFunction(ctx, js_port_close, "close", 0));
+    JS_SetPropertyStr(ctx, portProto, "start", JS_NewCFunction(ctx, js_port_start, "start", 0));
+    JS_SetClassProto(ctx, portClassId, portProto);
+
+    JSValue global = JS_GetGlobalObject(ctx);
+
+    JSValue queueMicrotask_func = JS_NewCFunction(ctx, js_queueMicrotask, "queueMicrotask", 1);
+    JS_SetPropertyStr(ctx, global, "queueMicrotask", queueMicrotask_func);
+
+    JSValue setImmediate_func = JS_NewCFunction(ctx, js_setImmediate, "setImmediate", 1);
+    JS_SetPropertyStr(ctx, global, "setImmediate", setImmediate_func);
+
+    JSValue clearImmediate_func = JS_NewCFunction(ctx, js_clearImmediate, "clearImmediate", 1);
+    JS_SetPropertyStr(ctx, global, "clearImmediate", clearImmediate_func);
+
+    JSValue channel_ctor = JS_NewCFunction2(ctx, js_MessageChannel, "MessageChannel", 0, JS_CFUNC_constructor, 0);
+    JSValue channel_proto = JS_NewObject(ctx);
+    JS_SetConstructor(ctx, channel_ctor, channel_proto);
+    JS_FreeValue(ctx, channel_proto);
+    JS_SetPropertyStr(ctx, global, "MessageChannel", channel_ctor);
+
+    JS_FreeValue(ctx, global);
+}
+
+void schedulerTrim(JSContext *ctx) {
+    ImmediateQueue *q = getQueue(ctx);
+    if (!q || q->count > 0) {
+        return;
+    }
+    free(q->entries);
+    q->entries = NULL;
+    q->capacity = 0;
+    q->head = 0;
+}
+
+void schedulerFree(JSContext *ctx) {
+    ImmediateQueue *q = getQueue(ctx);
+    if (!q) {
+        return;
+    }
+    for (uint32_t i = 0; i < q->count; i++) {
+        ImmediateEntry *entry = &q->entries[(q->head + i) & (q->capacity - 1)];
+        if (!entry->cleared) {
+            freeEntry(ctx, entry);
+        }
+    }
+    q->live = 0;
+    resetIfEmpty(q);
+    free(q->entries);
+    free(q);
+    js_core_set_immediates(ctx, NULL);
+}
+#endif // QJS_SCHEDULER_C
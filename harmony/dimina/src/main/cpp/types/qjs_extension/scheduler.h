@@ -0,0 +1,26 @@
+#ifndef QJS_SCHEDULER_h
+#define QJS_SCHEDULER_h
+
+#include "quickjs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// queueMicrotask / setImmediate / clearImmediate / MessageChannel。
+// 状态放在 JSCore 上（js_core_set_immediates），和 timeoutInit 一样在 JS_SetContextOpaque 之后调用
+void schedulerInit(JSContext *ctx);
+// 清掉排队的 immediate 和端口消息并释放状态，Runtime 释放前调用
+void schedulerFree(JSContext *ctx);
+// 队列空着时把缓冲区还掉，引擎切到后台时调用
+void schedulerTrim(JSContext *ctx);
+// JSCore 的 check 句柄回调：执行这一轮开始前排进来的 immediate 和端口消息
+void runImmediates(JSContext *ctx);
+// 是否还有没执行的 immediate 或端口消息
+int hasPendingImmediates(JSContext *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
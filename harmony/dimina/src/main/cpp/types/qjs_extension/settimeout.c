@@ -5,10 +5,19 @@
 #include "quickjs.h"
 #include <assert.h>
 #include <uv.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 // 声明从 JSContext 获取 uv_loop_t 的外部函数
 extern uv_loop_t* js_core_get_loop_from_ctx(JSContext* ctx);
+// 微任务预算和长任务监控，见 js_core.h
+extern void js_core_process_pending_jobs(JSContext* ctx);
+extern int js_core_begin_task(JSContext* ctx, const char* kind);
+extern void js_core_end_task(JSContext* ctx);
+// 所有定时器共用 JSCore 的一个 uv_timer_t，状态也存在 JSCore 上，见 js_core.h
+extern void js_core_arm_timer(JSContext* ctx, uint64_t timeoutMs);
+extern void* js_core_get_timers(JSContext* ctx);
+extern void js_core_set_timers(JSContext* ctx, void* timers);
 
 #define countof(x) (sizeof(x) / sizeof((x)[0]))
 
@@ -17,184 +26,353 @@ void setLogger(DebugLog newDebugLog, ExceptionLog newExceptionLog) {
     exceptionLog = newExceptionLog;
 }
 
+// 定时器 id 的低 24 位是 records 的下标 + 1，高位是这个槽位的代数。槽位回收时代数加一，
+// 过期的 id（已经触发或者清掉的）就对不上，clearTimeout 不会误删复用了槽位的新定时器。
+// 合起来 53 位，JS 的 number 能精确表示。
+#define TIMER_INDEX_BITS 24
+#define TIMER_INDEX_MASK ((1u << TIMER_INDEX_BITS) - 1)
+#define TIMER_GENERATION_MASK ((1u << 29) - 1)
+#define TIMER_NONE UINT32_MAX
+
+// 一个定时器。回调和参数的引用由这里持有，不挂在 JS 对象上，GC 不用标记它们
 typedef struct {
-    JSContext *ctx;
-    uv_timer_t handle;
-    int interval;
-    int isInterval;  // 1 表示 setInterval, 0 表示 setTimeout
     JSValue func;
+    JSValue *argv;
     int argc;
-    JSValue argv[];
-} UVTimer;
+    int active;    // 还没触发或者周期执行中
+    int running;   // 回调正在执行，期间被清掉的等回调返回再释放
+    uint32_t generation;
+    uint32_t nextFree;
+    int64_t interval; // 小于 0 表示 setTimeout
+} TimerRecord;
+
+// 堆里的一项。cancel 只改 records，堆里留着的旧项出堆时按代数识别出来跳过
+typedef struct {
+    uint64_t due;
+    uint64_t seq;  // 同一时刻到期的按创建顺序执行
+    uint32_t index;
+    uint32_t generation;
+} TimerEntry;
 
-static JSClassID uv_timer_class_id;
-void clearTimer(UVTimer *th) {
-    // debugLog("---lehem clearTimer");
-    JSContext *ctx = th->ctx;
-    JS_FreeValue(ctx, th->func);
-    th->func = JS_UNDEFINED;
+typedef struct {
+    JSContext *ctx;
+    TimerRecord *records;
+    uint32_t capacity;
+    uint32_t freeList;
+    uint32_t live;
+    TimerEntry *heap;
+    uint32_t heapSize;
+    uint32_t heapCapacity;
+    uint32_t stale;  // 堆里已经失效的项
+    uint64_t nextSeq;
+    uint64_t armedDue; // 句柄当前设定的到期时间，UINT64_MAX 表示没有
+    // 挂起期间时钟停在 suspendedAt：句柄不设，新定时器从这个时刻算到期时间
+    int suspended;
+    uint64_t suspendedAt;
+} TimerQueue;
+
+static TimerQueue *getQueue(JSContext *ctx) {
+    return (TimerQueue *)js_core_get_timers(ctx);
+}
 
-    for (int i = 0; i < th->argc; i++) {
-        JS_FreeValue(ctx, th->argv[i]);
-        th->argv[i] = JS_UNDEFINED;
+// 定时器用的当前时间，挂起期间停住不走
+static uint64_t timerNow(TimerQueue *q) {
+    return q->suspended ? q->suspendedAt : uv_now(js_core_get_loop_from_ctx(q->ctx));
+}
+
+static int entryLess(const TimerEntry *a, const TimerEntry *b) {
+    return a->due < b->due || (a->due == b->due && a->seq < b->seq);
+}
+
+static void siftUp(TimerQueue *q, uint32_t i) {
+    TimerEntry entry = q->heap[i];
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (!entryLess(&entry, &q->heap[parent])) {
+            break;
+        }
+        q->heap[i] = q->heap[parent];
+        i = parent;
     }
+    q->heap[i] = entry;
+}
 
-    th->argc = 0;
+static void siftDown(TimerQueue *q, uint32_t i) {
+    TimerEntry entry = q->heap[i];
+    for (;;) {
+        uint32_t child = 2 * i + 1;
+        if (child >= q->heapSize) {
+            break;
+        }
+        if (child + 1 < q->heapSize && entryLess(&q->heap[child + 1], &q->heap[child])) {
+            child++;
+        }
+        if (!entryLess(&q->heap[child], &entry)) {
+            break;
+        }
+        q->heap[i] = q->heap[child];
+        i = child;
+    }
+    q->heap[i] = entry;
 }
 
-static void on_uv_close(uv_handle_t *handle) {
-    // debugLog("---lehem on_uv_close");
-    if (handle && handle->data) {
-        UVTimer *th = handle->data;
-        handle->data = NULL;  // 清除指针
-        free(th);             // 释放 UVTimer 对象
+static int entryLive(TimerQueue *q, const TimerEntry *entry) {
+    const TimerRecord *record = &q->records[entry->index];
+    return record->active && record->generation == entry->generation;
+}
+
+static void popEntry(TimerQueue *q) {
+    q->heap[0] = q->heap[--q->heapSize];
+    if (q->heapSize > 0) {
+        siftDown(q, 0);
     }
 }
 
-static void uv_timer_finalizer(JSRuntime *rt, JSValue val) {
-    UVTimer *th = JS_GetOpaque(val, uv_timer_class_id);
-    if (th) {
-        clearTimer(th);
-        // 关闭 handle（如果还未关闭
-        if (!uv_is_closing((uv_handle_t *)&th->handle) && th->handle.type != UV_UNKNOWN_HANDLE) {
-            uv_close((uv_handle_t *)&th->handle, on_uv_close);
-        } else {
-            free(th);
+// 反复 setTimeout / clearTimeout（防抖）会在堆里留下大量失效项，超过一半时整体重建
+static void compactHeap(TimerQueue *q) {
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < q->heapSize; i++) {
+        if (entryLive(q, &q->heap[i])) {
+            q->heap[n++] = q->heap[i];
         }
     }
+    q->heapSize = n;
+    q->stale = 0;
+    for (uint32_t i = n / 2; i-- > 0;) {
+        siftDown(q, i);
+    }
 }
 
-static void uv_timer_mark(JSRuntime *rt, JSValueConst val, JS_MarkFunc *mark_func) {
-    // debugLog("---lehem uv_timer_mark");
-    UVTimer *th = JS_GetOpaque(val, uv_timer_class_id);
-    if (th) {
-        JS_MarkValue(rt, th->func, mark_func);
-        for (int i = 0; i < th->argc; i++)
-            JS_MarkValue(rt, th->argv[i], mark_func);
+// 堆顶的失效项丢掉，返回最早的有效项，没有返回 NULL
+static TimerEntry *peekEntry(TimerQueue *q) {
+    while (q->heapSize > 0 && !entryLive(q, &q->heap[0])) {
+        popEntry(q);
+        q->stale--;
     }
+    return q->heapSize > 0 ? &q->heap[0] : NULL;
 }
 
-static JSClassDef uv_timer_class = {
-    "UVTimer",
-    .finalizer = uv_timer_finalizer,
-    .gc_mark = uv_timer_mark,
-};
-
-static void callJs(UVTimer *th) {
-    // debugLog("---lehem begin call js");
-    JSContext *ctx = th->ctx;
-    if (ctx == NULL) {
-        debugLog("JavaScript context is NULL");
-        return;
+static int pushEntry(TimerQueue *q, uint32_t index, uint64_t due) {
+    if (q->stale > 64 && q->stale > q->heapSize / 2) {
+        compactHeap(q);
+    }
+    if (q->heapSize == q->heapCapacity) {
+        uint32_t capacity = q->heapCapacity ? q->heapCapacity * 2 : 64;
+        TimerEntry *heap = realloc(q->heap, capacity * sizeof(TimerEntry));
+        if (!heap) {
+            return -1;
+        }
+        q->heap = heap;
+        q->heapCapacity = capacity;
     }
+    TimerEntry *entry = &q->heap[q->heapSize];
+    entry->due = due;
+    entry->seq = q->nextSeq++;
+    entry->index = index;
+    entry->generation = q->records[index].generation;
+    siftUp(q, q->heapSize++);
+    return 0;
+}
 
-    JSValue ret, func1;
-    if (JS_IsUndefined(th->func) || JS_IsNull(th->func)) {
-        debugLog("Function is undefined or null");
+// 让 JSCore 的句柄在最早的定时器到期时回调，已经是这个时间就不重设
+static void rearm(TimerQueue *q) {
+    if (q->suspended) {
+        return;
+    }
+    TimerEntry *top = peekEntry(q);
+    uint64_t due = top ? top->due : UINT64_MAX;
+    if (due == q->armedDue) {
         return;
     }
+    q->armedDue = due;
+    if (due == UINT64_MAX) {
+        js_core_arm_timer(q->ctx, UINT64_MAX);
+        return;
+    }
+    uint64_t now = uv_now(js_core_get_loop_from_ctx(q->ctx));
+    js_core_arm_timer(q->ctx, due > now ? due - now : 0);
+}
 
-    /* 'func' might be destroyed when calling itself (if it frees the handler), so must take extra care */
-    func1 = JS_DupValue(ctx, th->func);
-    ret = JS_Call(ctx, func1, JS_UNDEFINED, th->argc, (JSValueConst *)th->argv);
-    JS_FreeValue(ctx, func1);
+static int allocRecord(TimerQueue *q, uint32_t *index) {
+    if (q->freeList == TIMER_NONE) {
+        if (q->capacity > TIMER_INDEX_MASK - 1) {
+            return -1;
+        }
+        uint32_t capacity = q->capacity ? q->capacity * 2 : 64;
+        if (capacity > TIMER_INDEX_MASK) {
+            capacity = TIMER_INDEX_MASK;
+        }
+        TimerRecord *records = realloc(q->records, capacity * sizeof(TimerRecord));
+        if (!records) {
+            return -1;
+        }
+        for (uint32_t i = capacity; i-- > q->capacity;) {
+            records[i].active = 0;
+            records[i].running = 0;
+            records[i].generation = 0;
+            records[i].nextFree = q->freeList;
+            q->freeList = i;
+        }
+        q->records = records;
+        q->capacity = capacity;
+    }
+    *index = q->freeList;
+    q->freeList = q->records[*index].nextFree;
+    return 0;
+}
+
+// 放掉回调和参数，槽位回到空闲链表
+static void releaseRecord(TimerQueue *q, uint32_t index) {
+    TimerRecord *record = &q->records[index];
+    JS_FreeValue(q->ctx, record->func);
+    record->func = JS_UNDEFINED;
+    for (int i = 0; i < record->argc; i++) {
+        JS_FreeValue(q->ctx, record->argv[i]);
+    }
+    free(record->argv);
+    record->argv = NULL;
+    record->argc = 0;
+    record->generation = (record->generation + 1) & TIMER_GENERATION_MASK;
+    record->nextFree = q->freeList;
+    q->freeList = index;
+}
+
+// 定时器不再有效：堆里的项变成失效项。回调执行中的等它返回再释放
+static void deactivate(TimerQueue *q, uint32_t index) {
+    TimerRecord *record = &q->records[index];
+    record->active = 0;
+    q->live--;
+    q->stale++;
+    if (!record->running) {
+        releaseRecord(q, index);
+    }
+}
+
+static void callJs(TimerQueue *q, uint32_t index) {
+    JSContext *ctx = q->ctx;
+    TimerRecord *record = &q->records[index];
+    record->running = 1;
+    // 回调里新建定时器可能让 records 搬家，参数从这里取出来；清掉自己的话要等 running 复位才释放
+    JSValue func = record->func;
+    JSValue *argv = record->argv;
+    int argc = record->argc;
+    int watching = js_core_begin_task(ctx, "timer");
+    JSValue ret = JS_Call(ctx, func, JS_UNDEFINED, argc, (JSValueConst *)argv);
+    if (watching) {
+        js_core_end_task(ctx);
+    }
+    q->records[index].running = 0;
 
     if (JS_IsException(ret)) {
         debugLog("---djch [TIMER] JS exception in timer callback!");
         exceptionLog(ctx);
     }
-
     JS_FreeValue(ctx, ret);
-    // debugLog("---lehem end call js");
 }
 
+// 和 JSCore 共用一套微任务预算，不在这里无限循环
 void processPendingJobs(JSContext *ctx) {
-    JSContext *ctx1;
-    int err;
-
-    // 循环处理所有挂起的任务
-    while ((err = JS_ExecutePendingJob(JS_GetRuntime(ctx), &ctx1)) > 0) {
-        if (err < 0) {
-            debugLog("JS_ExecutePendingJob error");
-            break;
-        }
-    }
+    js_core_process_pending_jobs(ctx);
 }
 
-static void timerCallback(uv_timer_t *handle) {
-    UVTimer *th = handle->data;
-    
-    // 🔥 防御性检查：如果 data 为 NULL，直接返回
-    if (th == NULL) {
-        // debugLog("---djch [TIMER] callback on NULL handle, ignoring");
+void runTimers(JSContext *ctx) {
+    TimerQueue *q = getQueue(ctx);
+    if (!q) {
         return;
     }
-    
-    // 🔥 检查 func 是否有效（防止被 clearTimer 释放后仍被调用）
-    if (th->ctx == NULL || JS_IsUndefined(th->func) || JS_IsNull(th->func)) {
-        // debugLog("---djch [TIMER] callback on invalid timer, stopping");
-        uv_timer_stop(handle);
-        return;
-    }
-    
-    processPendingJobs(th->ctx);
-    callJs(th);
-    
-    if (th->isInterval == 0) {
-        uv_timer_stop(&th->handle);
+    q->armedDue = UINT64_MAX;
+    uint64_t now = uv_now(js_core_get_loop_from_ctx(ctx));
+    // 这一轮里新建的（包括 setTimeout(fn, 0) 和重新排队的 setInterval）留到下一轮，不会在这里无限循环
+    uint64_t limitSeq = q->nextSeq;
+    TimerEntry *top;
+    while ((top = peekEntry(q)) != NULL && top->due <= now && top->seq < limitSeq) {
+        TimerEntry entry = *top;
+        uint32_t index = entry.index;
+        popEntry(q);
+        processPendingJobs(ctx);
+        // 微任务里可能把它清掉了，槽位还可能已经给了新建的定时器（代数对不上）；
+        // 微任务里新建定时器也可能让 records 搬家，所以在这之后才取 record
+        if (!entryLive(q, &entry)) {
+            q->stale--;
+            continue;
+        }
+        callJs(q, index);
+        TimerRecord *record = &q->records[index];
+        if (!record->active) {
+            // 回调里清掉了自己
+            q->stale--;
+            releaseRecord(q, index);
+        } else if (record->interval < 0) {
+            record->active = 0;
+            q->live--;
+            releaseRecord(q, index);
+        } else if (pushEntry(q, index, now + (uint64_t)record->interval) != 0) {
+            debugLog("---djch [TIMER] out of memory, interval stopped");
+            record->active = 0;
+            q->live--;
+            releaseRecord(q, index);
+        }
     }
+    rearm(q);
 }
 
 static JSValue js_uv_setTimer(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv, int type) {
-    // debugLog("---lehem js_uv_setTimer");
-
     int32_t delay = 0;
     if (argc >= 2) {
         if (JS_ToInt32(ctx, &delay, argv[1]))
             return JS_EXCEPTION;
     }
+    if (delay < 0) {
+        delay = 0;
+    }
 
     JSValue func = argv[0];
     if (!JS_IsFunction(ctx, func))
         return JS_ThrowTypeError(ctx, "Argument must be a function");
 
-    int nargs = argc > 2 ? argc - 2 : 0;
-    size_t size = offsetof(UVTimer, argv) + nargs * sizeof(JSValue);
-    UVTimer *th = (UVTimer *)calloc(1, size);
-    if (!th)
-        return JS_EXCEPTION;
+    TimerQueue *q = getQueue(ctx);
+    if (!q) {
+        return JS_ThrowInternalError(ctx, "timers are not available");
+    }
 
-    th->ctx = ctx;
-    th->func = JS_DupValue(ctx, func);
-    th->argc = nargs;
+    int nargs = argc > 2 ? argc - 2 : 0;
+    JSValue *args = NULL;
+    if (nargs > 0) {
+        args = malloc(nargs * sizeof(JSValue));
+        if (!args) {
+            return JS_ThrowOutOfMemory(ctx);
+        }
+    }
+    uint32_t index;
+    if (allocRecord(q, &index) != 0) {
+        free(args);
+        return JS_ThrowOutOfMemory(ctx);
+    }
+    TimerRecord *record = &q->records[index];
+    record->func = JS_DupValue(ctx, func);
+    record->argv = args;
+    record->argc = nargs;
     for (int i = 0; i < nargs; i++) {
-        th->argv[i] = JS_DupValue(ctx, argv[i + 2]);
+        args[i] = JS_DupValue(ctx, argv[i + 2]);
     }
-    th->isInterval = type;  // 1 表示 setInterval, 0 表示 setTimeout
-
-    // 获取 uv_loop_t
-    uv_loop_t *loop = js_core_get_loop_from_ctx(ctx);
-    uv_timer_init(loop, &th->handle);
-    th->handle.data = th;
-    th->interval = type ? delay : 0;
-    uv_timer_start(&th->handle, timerCallback, type ? 0 : delay, th->interval);
-
-
-    // 创建定时器 JS 对象
-    JSValue timerValue = JS_NewObjectClass(ctx, uv_timer_class_id);
-    JS_SetOpaque(timerValue, th);
-
-    JSValue global = JS_GetGlobalObject(ctx);
-    JSValue globalTimerMap = JS_GetPropertyStr(ctx, global, "globalTimerMap");
-
-    // 生成唯一的 timerId
-    uint64_t timerId = (uint64_t)th;
-    char timerIdStr[21]; // 足够长以容纳64位整数的字符串表示
-    snprintf(timerIdStr, sizeof(timerIdStr), "%lld", (long long)timerId);
-    JSAtom propAtom = JS_NewAtom(ctx, timerIdStr);
-    JS_SetProperty(ctx, globalTimerMap, propAtom, timerValue);
-    JS_FreeAtom(ctx, propAtom);
-    return JS_NewInt64(ctx, timerId);
+    // setInterval(fn, 0) 按 1ms 周期执行，和 Android 一致
+    record->interval = type ? (delay == 0 ? 1 : delay) : -1;
+    record->active = 1;
+    q->live++;
+
+    uint64_t now = timerNow(q);
+    if (pushEntry(q, index, now + (uint64_t)delay) != 0) {
+        record->active = 0;
+        q->live--;
+        releaseRecord(q, index);
+        return JS_ThrowOutOfMemory(ctx);
+    }
+    // 大多数新定时器不比已有的最早一个更早，这时句柄不用动
+    if (now + (uint64_t)delay < q->armedDue) {
+        rearm(q);
+    }
+    uint64_t timerId = ((uint64_t)record->generation << TIMER_INDEX_BITS) | (index + 1);
+    return JS_NewInt64(ctx, (int64_t)timerId);
 }
 
 // 函数用于 setTimeout
@@ -209,62 +387,37 @@ static JSValue js_uv_setInterval(JSContext *ctx, JSValueConst this_val, int argc
 
 
 static JSValue js_uv_clearTimer(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+    // clearTimeout() / clearTimeout(undefined) 之类的什么也不做
+    if (argc < 1 || !JS_IsNumber(argv[0]))
+        return JS_UNDEFINED;
     int64_t timerId;
     if (JS_ToInt64(ctx, &timerId, argv[0]))
         return JS_EXCEPTION;
 
-    char timerIdStr[21];
-    snprintf(timerIdStr, sizeof(timerIdStr), "%lld", (long long)timerId);
-
-    JSValue global = JS_GetGlobalObject(ctx);
-    JSValue globalTimerMap = JS_GetPropertyStr(ctx, global, "globalTimerMap");
-    JSAtom propAtom = JS_NewAtom(ctx, timerIdStr);
-    
-    JSValue timerValue = JS_GetProperty(ctx, globalTimerMap, propAtom);
-    if (!JS_IsUndefined(timerValue)) {
-        UVTimer *th = JS_GetOpaque(timerValue, uv_timer_class_id);
-        if (th) {
-            // 1. 停止定时器
-            uv_timer_stop(&th->handle);
-            
-            // 2. 释放 JS 资源
-            clearTimer(th);
-            
-            // 3. 🔥关键：将 handle->data 置为 NULL，防止 timerCallback 访问
-            th->handle.data = NULL;
-            
-            // 4. 从 globalTimerMap 中删除
-            JS_DeleteProperty(ctx, globalTimerMap, propAtom, 0);
-            
-            // 5. 🔥立即关闭 handle（异步，但会触发 on_uv_close）
-            if (!uv_is_closing((uv_handle_t*)&th->handle)) {
-                uv_close((uv_handle_t*)&th->handle, on_uv_close);
-            }
-            
-            // 6. 将 opaque 置为 NULL，防止 finalizer 二次处理
-            JS_SetOpaque(timerValue, NULL);
-        }
-        JS_FreeValue(ctx, timerValue);
+    TimerQueue *q = getQueue(ctx);
+    if (!q || timerId <= 0) {
+        return JS_UNDEFINED;
+    }
+    uint32_t index = (uint32_t)(timerId & TIMER_INDEX_MASK) - 1;
+    uint32_t generation = (uint32_t)((uint64_t)timerId >> TIMER_INDEX_BITS);
+    if (index < q->capacity && q->records[index].active && q->records[index].generation == generation) {
+        // 堆里的项留着，出堆时跳过；句柄到期空跑一次再按下一个重设，不在这里改
+        deactivate(q, index);
     }
-
-    JS_FreeAtom(ctx, propAtom);
-    JS_FreeValue(ctx, globalTimerMap);
-    JS_FreeValue(ctx, global);
-
     return JS_UNDEFINED;
 }
 
 void timeoutInit(JSContext *ctx) {
-    JS_NewClassID(&uv_timer_class_id);
-    JS_NewClass(JS_GetRuntime(ctx), uv_timer_class_id, &uv_timer_class);
+    TimerQueue *q = calloc(1, sizeof(TimerQueue));
+    if (q) {
+        q->ctx = ctx;
+        q->freeList = TIMER_NONE;
+        q->armedDue = UINT64_MAX;
+    }
+    js_core_set_timers(ctx, q);
 
     JSValue global = JS_GetGlobalObject(ctx);
 
-    // 创建 globalTimerMap 作为全局对象的属性
-    // 不需要 JS_DupValue，因为 JS_SetPropertyStr 会管理引用
-    JSValue globalTimerMap = JS_NewObject(ctx);
-    JS_SetPropertyStr(ctx, global, "globalTimerMap", globalTimerMap);
-
     JSValue setTimeout_func = JS_NewCFunction(ctx, js_uv_setTimeout, "setTimeout", 2);
     JS_SetPropertyStr(ctx, global, "setTimeout", setTimeout_func);
 
@@ -280,44 +433,74 @@ void timeoutInit(JSContext *ctx) {
     JS_FreeValue(ctx, global);
 }
 
-void clearAllTimers(JSContext *ctx) {
-    JSValue global = JS_GetGlobalObject(ctx);
-    JSValue timerMap = JS_GetPropertyStr(ctx, global, "globalTimerMap");
-
-    JSPropertyEnum *props;
-    uint32_t len, i;
-    JS_GetOwnPropertyNames(ctx, &props, &len, timerMap, JS_GPN_STRING_MASK | JS_GPN_ENUM_ONLY);
-
-    for (i = 0; i < len; i++) {
-        JSAtom propAtom = props[i].atom;
-        JSValue timerValue = JS_GetProperty(ctx, timerMap, propAtom);
-
-        UVTimer *th = JS_GetOpaque(timerValue, uv_timer_class_id);
-        if (th) {
-            // 🔥完整清理
-            uv_timer_stop(&th->handle);
-            clearTimer(th);
-            th->handle.data = NULL;
-            
-            if (!uv_is_closing((uv_handle_t*)&th->handle)) {
-                uv_close((uv_handle_t*)&th->handle, on_uv_close);
-            }
-            
-            JS_SetOpaque(timerValue, NULL);
+void suspendTimers(JSContext *ctx) {
+    TimerQueue *q = getQueue(ctx);
+    if (!q || q->suspended) {
+        return;
+    }
+    q->suspendedAt = uv_now(js_core_get_loop_from_ctx(ctx));
+    q->suspended = 1;
+    q->armedDue = UINT64_MAX;
+    js_core_arm_timer(ctx, UINT64_MAX);
+    // 顺带把失效项清掉，堆缩回实际大小
+    compactHeap(q);
+    uint32_t capacity = q->heapSize > 64 ? q->heapSize : 64;
+    if (q->heapCapacity > capacity) {
+        TimerEntry *heap = realloc(q->heap, capacity * sizeof(TimerEntry));
+        if (heap) {
+            q->heap = heap;
+            q->heapCapacity = capacity;
         }
+    }
+}
 
-        JS_FreeValue(ctx, timerValue);
-        JS_FreeAtom(ctx, propAtom);
+void resumeTimers(JSContext *ctx) {
+    TimerQueue *q = getQueue(ctx);
+    if (!q || !q->suspended) {
+        return;
+    }
+    // 所有到期时间整体后移挂起的时长：堆的顺序不变，每个定时器剩下的时间和挂起前一样
+    uint64_t now = uv_now(js_core_get_loop_from_ctx(ctx));
+    uint64_t shift = now > q->suspendedAt ? now - q->suspendedAt : 0;
+    for (uint32_t i = 0; i < q->heapSize; i++) {
+        q->heap[i].due += shift;
     }
+    q->suspended = 0;
+    rearm(q);
+}
 
-    js_free(ctx, props);
-    
-    // 🔥清空 timerMap
-    JSValue emptyObj = JS_NewObject(ctx);
-    JS_SetPropertyStr(ctx, global, "globalTimerMap", emptyObj);
-    JS_FreeValue(ctx, emptyObj);
-    
-    JS_FreeValue(ctx, timerMap);
-    JS_FreeValue(ctx, global);
+int hasActiveTimers(JSContext *ctx) {
+    TimerQueue *q = getQueue(ctx);
+    return q && q->live > 0;
+}
+
+void clearAllTimers(JSContext *ctx) {
+    TimerQueue *q = getQueue(ctx);
+    if (!q) {
+        return;
+    }
+    for (uint32_t i = 0; i < q->capacity; i++) {
+        if (q->records[i].active) {
+            q->records[i].active = 0;
+            q->records[i].running = 0;
+            releaseRecord(q, i);
+        }
+    }
+    q->live = 0;
+    q->heapSize = 0;
+    q->stale = 0;
+    rearm(q);
+}
+
+void timeoutFree(JSContext *ctx) {
+    TimerQueue *q = getQueue(ctx);
+    if (!q) {
+        return;
+    }
+    clearAllTimers(ctx);
+    free(q->records);
+    free(q->heap);
+    free(q);
+    js_core_set_timers(ctx, NULL);
 }
 #endif // QJS_TIMEOUT_C
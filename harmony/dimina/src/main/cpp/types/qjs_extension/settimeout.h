@@ -17,8 +17,19 @@ typedef void (*ExceptionLog)(JSContext *ctx);
 static DebugLog debugLog = NULL;
 static ExceptionLog exceptionLog = NULL;
 
+// 定时器状态放在 JSCore 上（js_core_set_timers），必须在 JS_SetContextOpaque 之后调用
 void timeoutInit(JSContext *ctx);
 void clearAllTimers(JSContext *ctx);
+// 清掉所有定时器并释放状态，Runtime 释放前调用
+void timeoutFree(JSContext *ctx);
+// JSCore 的定时器句柄到期时调用：执行到期的定时器，再把句柄设到下一个
+void runTimers(JSContext *ctx);
+// 切到后台：所有定时器（包括 setInterval）冻结，句柄停掉，挂起期间新建的也不会触发。
+// 恢复时到期时间整体后移挂起的时长，剩余时间和挂起前一样，周期定时器不会把错过的次数一次补上
+void suspendTimers(JSContext *ctx);
+void resumeTimers(JSContext *ctx);
+// 是否还有没触发或者周期执行中的定时器
+int hasActiveTimers(JSContext *ctx);
 
 void setLogger(DebugLog debugLog, ExceptionLog exceptionLog);
 
@@ -6,337 +6,15 @@
 #include <thread>
 #include <sys/syscall.h>
 #include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 using namespace std;
 
 
-#pragma 类型转换 Jsvalue 转 Napi
-// 将 QuickJS 对象转换为 N-API 对象
-napi_value ConvertJSObjectToNapiObject(napi_env env, JSContext *ctx, JSValueConst jsValue) {
-    napi_value result;
-    napi_create_object(env, &result);
-
-    JSPropertyEnum *props;
-    uint32_t propCount;
-    JS_GetOwnPropertyNames(ctx, &props, &propCount, jsValue, JS_GPN_STRING_MASK | JS_GPN_SYMBOL_MASK);
-
-    for (uint32_t i = 0; i < propCount; ++i) {
-        const char *propName = JS_AtomToCString(ctx, props[i].atom);
-
-        OH_LOG_Print(LOG_APP, LOG_ERROR, 0x8989, "dimina/", "ConvertJSObjectToNapiObject propName: %{public}s",
-                     propName);
-
-
-        JSValueConst propValue;
-        propValue = JS_GetProperty(ctx, jsValue, props[i].atom);
-
-        napi_value napiPropValue = ConvertJSValueToNapiValue(env, ctx, propValue);
-
-        napi_set_named_property(env, result, propName, napiPropValue);
-
-        JS_FreeCString(ctx, propName);
-    }
-
-    js_free(ctx, props);
-
-    return result;
-}
-
-napi_value ConvertJSValueToNapiValue(napi_env env, JSContext *ctx, JSValueConst jsValue) {
-    if (JS_IsUndefined(jsValue)) {
-        napi_value result;
-        napi_get_undefined(env, &result);
-        return result;
-    } else if (JS_IsNull(jsValue)) {
-        napi_value result;
-        napi_get_null(env, &result);
-        return result;
-    } else if (JS_IsBool(jsValue)) {
-        bool value = JS_ToBool(ctx, jsValue);
-        napi_value result;
-        napi_get_boolean(env, value, &result);
-        return result;
-    } else if (JS_IsNumber(jsValue)) {
-        // 这里特殊处理下，js 有 number 类型，Native 有 int 和 float
-        int tag = JS_VALUE_GET_TAG(jsValue);
-        if (tag == JS_TAG_INT) {
-            int value = JS_VALUE_GET_INT(jsValue);
-            napi_value result;
-            napi_create_int64(env, value, &result);
-            return result;
-        } else if (tag == JS_TAG_FLOAT64) {
-            double value = JS_VALUE_GET_FLOAT64(jsValue);
-            napi_value result;
-            napi_create_double(env, value, &result);
-            return result;
-        }
-        double value = JS_VALUE_GET_FLOAT64(jsValue);
-        napi_value result;
-        napi_create_double(env, value, &result);
-        return result;
-    } else if (JS_IsString(jsValue)) {
-        const char *str = JS_ToCString(ctx, jsValue);
-        if (str == NULL) {
-            // Handle error (e.g., throw a JavaScript error or return an error value)
-            OH_LOG_Print(LOG_APP, LOG_ERROR, 0x8989, "dimina/", "ConvertJSValueToNapiValue JS_ToCString error");
-            return NULL; // Adjust based on your error handling strategy
-        }
-
-        napi_value result;
-        napi_status status = napi_create_string_utf8(env, str, NAPI_AUTO_LENGTH, &result);
-        JS_FreeCString(ctx, str);
-
-        if (status != napi_ok) {
-            // Handle error for N-API function
-            OH_LOG_Print(LOG_APP, LOG_ERROR, 0x8989, "dimina/",
-                         "ConvertJSValueToNapiValue napi_create_string_utf8 error");
-            return NULL; // Adjust based on your error handling strategy
-        }
-
-        return result;
-    } else if (JS_IsObject(jsValue)) {
-        if (JS_IsArray(ctx, jsValue) == 1) {
-            napi_value result;
-            napi_create_array(env, &result);
-
-            uint32_t array_length;
-            JSValue array_length_value = JS_GetPropertyStr(ctx, jsValue, "length");
-            JS_ToUint32(ctx, &array_length, array_length_value);
-            JS_FreeValue(ctx, array_length_value);
-
-            for (uint32_t i = 0; i < array_length; ++i) {
-                JSValue js_element = JS_GetPropertyUint32(ctx, jsValue, i);
-                napi_value napi_element = ConvertJSValueToNapiValue(env, ctx, js_element);
-                napi_set_element(env, result, i, napi_element);
-                JS_FreeValue(ctx, js_element);
-            }
-            return result;
-        } else {
-            napi_value result;
-            napi_create_object(env, &result);
-
-            JSPropertyEnum *props;
-            uint32_t len;
-            if (JS_GetOwnPropertyNames(ctx, &props, &len, jsValue, JS_GPN_STRING_MASK | JS_GPN_ENUM_ONLY) == 0) {
-                for (uint32_t i = 0; i < len; ++i) {
-                    const char *key = JS_AtomToCString(ctx, props[i].atom);
-                    JSValue value = JS_GetProperty(ctx, jsValue, props[i].atom);
-                    napi_value napiValue = ConvertJSValueToNapiValue(env, ctx, value);
-                    napi_set_named_property(env, result, key, napiValue);
-
-                    JS_FreeCString(ctx, key);
-                    JS_FreeValue(ctx, value);
-                }
-                js_free(ctx, props);
-            }
-            return result;
-        }
-    } else {
-        return NULL;
-    }
-}
-
-#pragma 类型转换 Napi 转 Jsvalue
-JSValue ConvertNapiObjectToJSObject(napi_env env, JSContext *ctx, napi_value napiObject) {
-    JSValue jsObject = JS_NewObject(ctx);
-
-    napi_status status;
-    // 获取对象的属性名数组
-    napi_value propNames;
-
-
-    checkType(env, napiObject, "ConvertNapiObjectToJSObject napiObject");
-
-    //     napi_get_all_property_names(env, napiObject, napi_key_own_only, napi_key_all_properties,
-    //     napi_key_keep_numbers,
-    //                                 &propNames);
-    status = napi_get_property_names(env, napiObject, &propNames);
-    if (status != napi_ok) {
-        OH_LOG_Print(LOG_APP, LOG_ERROR, 0x8989, "dimina/",
-                     "ConvertNapiObjectToJSObject napi_get_property_names error");
-    }
-
-    checkType(env, propNames, "ConvertNapiObjectToJSObject propNames");
-
-
-    uint32_t propCount;
-    status = napi_get_array_length(env, propNames, &propCount);
-    if (status != napi_ok) {
-        OH_LOG_Print(LOG_APP, LOG_ERROR, 0x8989, "dimina/", "ConvertNapiObjectToJSObject napi_get_array_length error");
-    }
-
-
-    for (uint32_t i = 0; i < propCount; i++) {
-        // 获取属性名
-        napi_value propName;
-        status = napi_get_element(env, propNames, i, &propName);
-        if (status != napi_ok) {
-            OH_LOG_Print(LOG_APP, LOG_ERROR, 0x8989, "dimina/", "napi_get_element napi_get_element error");
-        }
-
-        // 定义一个指针来存储字符串结果
-        char *propChar = NULL;
-        // 调用转换函数
-        propChar = getStringFromNapi(env, propName);
-
-        OH_LOG_Print(LOG_APP, LOG_ERROR, 0x8989, "dimina/", "ConvertNapiObjectToJSObject propChar: %{public}s",
-                     propChar);
-
-        // 获取属性值
-        napi_value propValue;
-        napi_get_property(env, napiObject, propName, &propValue);
-
-
-        // 递归处理属性值
-        JSValue jsPropValue = ConvertNapiValueToJsValue(env, ctx, propValue);
-
-        // 将属性名和属性值添加到 QuickJS 对象中
-        JSAtom atom = JS_NewAtom(ctx, propChar);
-        JS_SetProperty(ctx, jsObject, atom, jsPropValue);
-
-        // 释放引用
-        JS_FreeAtom(ctx, atom);
-
-        //         napi_delete_reference(env, propName);
-        //         napi_delete_reference(env, propValue);
-    }
-
-    // 释放属性名数组
-    //     napi_delete_reference(env, propNames);
-
-    return jsObject;
-}
-
-JSValue ConvertNapiValueToJsValue(napi_env env, JSContext *ctx, napi_value napiValue) {
-    JSValue jsValue = JS_UNDEFINED;
-
-    // 获取 NAPI 对象类型
-    napi_valuetype valueType;
-    napi_status status = napi_typeof(env, napiValue, &valueType);
-    if (status != napi_ok) {
-        return JS_EXCEPTION; // 统一错误处理
-    }
-
-    switch (valueType) {
-    case napi_undefined:
-        jsValue = JS_UNDEFINED;
-        break;
-    case napi_null:
-        jsValue = JS_NULL;
-        break;
-    case napi_boolean: {
-        bool boolValue;
-        status = napi_get_value_bool(env, napiValue, &boolValue);
-        if (status != napi_ok) {
-            return JS_EXCEPTION;
-        }
-        jsValue = JS_NewBool(ctx, boolValue);
-        break;
-    }
-    case napi_number: {
-        double numberValue;
-        status = napi_get_value_double(env, napiValue, &numberValue);
-        if (status != napi_ok) {
-            return JS_EXCEPTION;
-        }
-        jsValue = JS_NewFloat64(ctx, numberValue);
-        break;
-    }
-    case napi_string: {
-        size_t strLen;
-        status = napi_get_value_string_utf8(env, napiValue, NULL, 0, &strLen);
-        if (status != napi_ok) {
-            return JS_EXCEPTION;
-        }
-
-        char *strBuf = (char *)malloc(strLen + 1);
-        if (!strBuf) {
-            return JS_EXCEPTION; // 处理内存分配失败
-        }
-
-        status = napi_get_value_string_utf8(env, napiValue, strBuf, strLen + 1, &strLen);
-        if (status != napi_ok) {
-            free(strBuf);
-            return JS_EXCEPTION;
-        }
-        jsValue = JS_NewStringLen(ctx, strBuf, strLen);
-        free(strBuf);
-        break;
-    }
-    case napi_object: {
-        bool isArray;
-        status = napi_is_array(env, napiValue, &isArray);
-        if (status != napi_ok) {
-            return JS_EXCEPTION;
-        }
-
-        if (isArray) {
-            uint32_t length;
-            napi_get_array_length(env, napiValue, &length);
-            JSValue jsArray = JS_NewArray(ctx);
-
-            for (uint32_t i = 0; i < length; i++) {
-                napi_value element;
-                napi_get_element(env, napiValue, i, &element);
-                JSValue jsElement = ConvertNapiValueToJsValue(env, ctx, element);
-                if (JS_IsException(jsElement)) { // 检查子元素是否转换失败
-                    JS_FreeValue(ctx, jsArray);
-                    return JS_EXCEPTION;
-                }
-                JS_SetPropertyUint32(ctx, jsArray, i, jsElement);
-            }
-            jsValue = jsArray;
-        } else {
-            jsValue = JS_NewObject(ctx);
-
-            napi_status status;
-            napi_value propNames;
-
-            status = napi_get_property_names(env, napiValue, &propNames);
-            if (status != napi_ok) {
-                OH_LOG_Print(LOG_APP, LOG_ERROR, 0x8989, "dimina/",
-                             "ConvertNapiValueToJsValue napi_get_property_names error");
-            }
-
-            uint32_t propCount;
-            status = napi_get_array_length(env, propNames, &propCount);
-
-
-            for (uint32_t i = 0; i < propCount; i++) {
-                napi_value value;
-                // 获取属性名
-                napi_value propName;
-                status = napi_get_element(env, propNames, i, &propName);
-                if (status != napi_ok) {
-                    OH_LOG_Print(LOG_APP, LOG_ERROR, 0x8989, "dimina/",
-                                 "ConvertNapiValueToJsValue napi_get_element error");
-                }
-
-                // 定义一个指针来存储字符串结果
-                char *propChar = NULL;
-                // 调用转换函数
-                propChar = getStringFromNapi(env, propName);
-
-                // 获取属性值
-                napi_value propValue;
-                napi_get_property(env, napiValue, propName, &propValue);
-
-                JSValue jsPropValue = ConvertNapiValueToJsValue(env, ctx, propValue);
-                // 假设 properties[i] 已正确转换为字符串
-                JS_SetPropertyStr(ctx, jsValue, propChar, jsPropValue);
-            }
-        }
-        break;
-    }
-
-    default:
-        jsValue = JS_NULL; // 未支持的类型处理
-        break;
-    }
-
-    return jsValue;
-}
-
 napi_value createNapiString(napi_env env, string str) {
     napi_value result;
     char *strChar = (char *)str.c_str();
@@ -382,6 +60,34 @@ char *getStringFromNapi(napi_env env, napi_value value) {
 }
 
 
+bool readFile(const std::string &path, std::string &content) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat sb;
+    if (fstat(fd, &sb) == -1 || sb.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    content.resize(sb.st_size);
+    size_t offset = 0;
+    while (offset < content.size()) {
+        ssize_t n = read(fd, &content[offset], content.size() - offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            close(fd);
+            return false;
+        }
+        offset += n;
+    }
+    close(fd);
+    return true;
+}
+
+
 bool endsWithSync(const char *str) {
     // 计算字符串长度
     size_t strLen = std::strlen(str);
@@ -689,29 +395,28 @@ void printJsValue(JSContext *ctx, JSValueConst jsValue, int indentLevel) {
 }
 
 char *JSValueToString(JSContext *ctx, JSValueConst val) {
-    const char *cstr;
-    char *result;
-    if (JS_IsString(val)) {
-        cstr = JS_ToCString(ctx, val);
-        if (!cstr)
-            return NULL;
-        result = strdup(cstr);
-        JS_FreeCString(ctx, cstr);
-        return result;
-    } else {
-        JSValue strVal = JS_JSONStringify(ctx, val, JS_UNDEFINED, JS_UNDEFINED);
-        if (JS_IsException(strVal)) {
-            JS_FreeValue(ctx, strVal);
-            return NULL;
-        }
-        cstr = JS_ToCString(ctx, strVal);
-        JS_FreeValue(ctx, strVal); // 现在可以安全地释放 strVal
-        if (!cstr)
-            return NULL;
-        result = strdup(cstr);
-        JS_FreeCString(ctx, cstr);
-        return result;
+    size_t length;
+    return JSValueToStringLen(ctx, val, &length);
+}
+
+// QuickJS 的字符串归 runtime 管，跨线程交出去必须拷一份；这里只拷这一次，长度顺带给出去。
+char *JSValueToStringLen(JSContext *ctx, JSValueConst val, size_t *length) {
+    JSValue strVal = JS_IsString(val) ? JS_DupValue(ctx, val) : JS_JSONStringify(ctx, val, JS_UNDEFINED, JS_UNDEFINED);
+    if (JS_IsException(strVal)) {
+        return NULL;
     }
+    size_t len = 0;
+    const char *cstr = JS_ToCStringLen(ctx, &len, strVal);
+    JS_FreeValue(ctx, strVal);
+    if (!cstr)
+        return NULL;
+    char *result = static_cast<char *>(malloc(len + 1));
+    if (result) {
+        memcpy(result, cstr, len + 1);
+        *length = len;
+    }
+    JS_FreeCString(ctx, cstr);
+    return result;
 }
 
 void printFuncName(JSContext *ctx, JSValueConst funcObj) {
@@ -9,6 +9,7 @@
 
 using namespace std;
 
+// 实现在 value_convert.cpp。napi -> QuickJS 失败返回 JS_EXCEPTION，QuickJS -> napi 失败返回 nullptr，异常都挂在 ctx 上
 napi_value ConvertJSObjectToNapiObject(napi_env env, JSContext *ctx, JSValueConst jsValue);
 napi_value ConvertJSValueToNapiValue(napi_env env, JSContext *ctx, JSValueConst jsValue);
 
@@ -30,6 +31,8 @@ void printNapiValue(napi_env env, napi_value value, int indentLevel = 0);
 void printJsValue(JSContext *ctx, JSValueConst jsValue, int indentLevel = 0);
 
 char* JSValueToString(JSContext *ctx, JSValueConst val);
+// 同上，length 带回字节数（不含结尾的 '\0'），调用方不用再 strlen
+char* JSValueToStringLen(JSContext *ctx, JSValueConst val, size_t *length);
 
 void printFuncName(JSContext *ctx, JSValueConst funcObj);
 
@@ -37,4 +40,7 @@ napi_status CopyObject(napi_env env, napi_value source, napi_value *destination)
 
 bool isMainThread();
 
+// 整个文件读进 content。打不开、读失败或者是空文件返回 false，errno 留着给调用方打日志
+bool readFile(const std::string &path, std::string &content);
+
 #endif // DIMINA_HARMONYOS_UTIL_H
@@ -0,0 +1,560 @@
+//
+// Created on 2026/10/16.
+//
+
+#include "utils.h"
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// napi 和 QuickJS 之间的值转换。sync API 的返回值每次都要过一遍，所以：
+// - 用显式栈代替递归，嵌套再深也不会把线程栈用完；
+// - 同一次转换里重复出现的键只转换一次（napi 键 -> JSAtom，JSAtom -> napi 字符串）；
+// - 正常路径不打日志。
+// 语义和原来的递归版本一致：函数 / Symbol 之类 napi 侧转成 null，QuickJS 侧跳过。
+
+namespace {
+
+// 嵌套超过这个深度才开始检查循环引用，常见的浅对象不用付这份开销。
+// 深度优先遍历下环会先沿着一条路径走到这个深度，马上就能发现
+constexpr size_t kCycleCheckDepth = 64;
+
+int napiToJSTypedArray(napi_typedarray_type type) {
+    switch (type) {
+        case napi_int8_array: return JS_TYPED_ARRAY_INT8;
+        case napi_uint8_array: return JS_TYPED_ARRAY_UINT8;
+        case napi_uint8_clamped_array: return JS_TYPED_ARRAY_UINT8C;
+        case napi_int16_array: return JS_TYPED_ARRAY_INT16;
+        case napi_uint16_array: return JS_TYPED_ARRAY_UINT16;
+        case napi_int32_array: return JS_TYPED_ARRAY_INT32;
+        case napi_uint32_array: return JS_TYPED_ARRAY_UINT32;
+        case napi_float32_array: return JS_TYPED_ARRAY_FLOAT32;
+        case napi_float64_array: return JS_TYPED_ARRAY_FLOAT64;
+        case napi_bigint64_array: return JS_TYPED_ARRAY_BIG_INT64;
+        case napi_biguint64_array: return JS_TYPED_ARRAY_BIG_UINT64;
+        default: return -1;
+    }
+}
+
+int jsToNapiTypedArray(int type) {
+    switch (type) {
+        case JS_TYPED_ARRAY_INT8: return napi_int8_array;
+        case JS_TYPED_ARRAY_UINT8: return napi_uint8_array;
+        case JS_TYPED_ARRAY_UINT8C: return napi_uint8_clamped_array;
+        case JS_TYPED_ARRAY_INT16: return napi_int16_array;
+        case JS_TYPED_ARRAY_UINT16: return napi_uint16_array;
+        case JS_TYPED_ARRAY_INT32: return napi_int32_array;
+        case JS_TYPED_ARRAY_UINT32: return napi_uint32_array;
+        case JS_TYPED_ARRAY_FLOAT32: return napi_float32_array;
+        case JS_TYPED_ARRAY_FLOAT64: return napi_float64_array;
+        case JS_TYPED_ARRAY_BIG_INT64: return napi_bigint64_array;
+        case JS_TYPED_ARRAY_BIG_UINT64: return napi_biguint64_array;
+        default: return -1; // Float16 之类 napi 没有，按普通对象转
+    }
+}
+
+size_t typedArrayElementSize(napi_typedarray_type type) {
+    switch (type) {
+        case napi_int16_array:
+        case napi_uint16_array: return 2;
+        case napi_int32_array:
+        case napi_uint32_array:
+        case napi_float32_array: return 4;
+        case napi_float64_array:
+        case napi_bigint64_array:
+        case napi_biguint64_array: return 8;
+        default: return 1;
+    }
+}
+
+// 整数用 int32 表示，QuickJS 里走 JS_TAG_INT 的快路径；-0 保持浮点
+bool isInt32(double d) {
+    return d >= INT32_MIN && d <= INT32_MAX && std::floor(d) == d && !(d == 0 && std::signbit(d));
+}
+
+class NapiToJS {
+public:
+    NapiToJS(napi_env env, JSContext *ctx) : env(env), ctx(ctx) {}
+
+    ~NapiToJS() {
+        for (Frame &frame : stack) {
+            JS_FreeValue(ctx, frame.dst);
+        }
+        for (auto &entry : atoms) {
+            JS_FreeAtom(ctx, entry.second);
+        }
+    }
+
+    // 失败返回 JS_EXCEPTION，异常挂在 ctx 上
+    JSValue convert(napi_value root) {
+        JSValue result;
+        if (!convertValue(root, &result)) {
+            return JS_EXCEPTION;
+        }
+        while (!stack.empty()) {
+            Frame &frame = stack.back();
+            if (frame.index >= frame.count) {
+                JS_FreeValue(ctx, frame.dst);
+                stack.pop_back();
+                continue;
+            }
+            // convertValue 可能压栈，frame 引用随之失效，先把要用的取出来
+            uint32_t index = frame.index++;
+            JSValue parent = frame.dst;
+            bool isArray = frame.isArray;
+            napi_value child;
+            JSAtom atom = JS_ATOM_NULL;
+            if (isArray) {
+                if (napi_get_element(env, frame.src, index, &child) != napi_ok) {
+                    return fail(result, "napi_get_element failed");
+                }
+            } else {
+                napi_value name;
+                if (napi_get_element(env, frame.names, index, &name) != napi_ok ||
+                    napi_get_property(env, frame.src, name, &child) != napi_ok) {
+                    return fail(result, "napi_get_property failed");
+                }
+                atom = atomFor(name);
+                if (atom == JS_ATOM_NULL) {
+                    return fail(result, nullptr);
+                }
+            }
+            JSValue value;
+            if (!convertValue(child, &value)) {
+                return fail(result, nullptr);
+            }
+            int ret = isArray ? JS_DefinePropertyValueUint32(ctx, parent, index, value, JS_PROP_C_W_E)
+                              : JS_DefinePropertyValue(ctx, parent, atom, value, JS_PROP_C_W_E);
+            if (ret < 0) {
+                return fail(result, nullptr);
+            }
+        }
+        return result;
+    }
+
+private:
+    struct Frame {
+        napi_value src;
+        JSValue dst; // 持有一份引用，出栈时释放
+        napi_value names;
+        uint32_t index;
+        uint32_t count;
+        bool isArray;
+    };
+
+    // 叶子直接转换；数组 / 对象先建一个空容器交给调用方挂到父节点上，成员由 convert 的循环填
+    bool convertValue(napi_value value, JSValue *out) {
+        napi_valuetype type = napi_undefined;
+        if (napi_typeof(env, value, &type) != napi_ok) {
+            return throwError("napi_typeof failed");
+        }
+        switch (type) {
+            case napi_undefined:
+                *out = JS_UNDEFINED;
+                return true;
+            case napi_null:
+                *out = JS_NULL;
+                return true;
+            case napi_boolean: {
+                bool b = false;
+                napi_get_value_bool(env, value, &b);
+                *out = JS_NewBool(ctx, b);
+                return true;
+            }
+            case napi_number: {
+                double d = 0;
+                napi_get_value_double(env, value, &d);
+                *out = isInt32(d) ? JS_NewInt32(ctx, static_cast<int32_t>(d)) : JS_NewFloat64(ctx, d);
+                return true;
+            }
+            case napi_string: {
+                if (!readString(value)) {
+                    return throwError("napi_get_value_string_utf8 failed");
+                }
+                *out = JS_NewStringLen(ctx, scratch.data(), scratch.size());
+                return !JS_IsException(*out);
+            }
+            case napi_object:
+                return convertObject(value, out);
+            default:
+                *out = JS_NULL;
+                return true;
+        }
+    }
+
+    bool convertObject(napi_value value, JSValue *out) {
+        if (stack.size() >= kCycleCheckDepth) {
+            for (const Frame &frame : stack) {
+                bool same = false;
+                if (napi_strict_equals(env, frame.src, value, &same) == napi_ok && same) {
+                    JS_ThrowTypeError(ctx, "converting circular structure");
+                    return false;
+                }
+            }
+        }
+        bool is = false;
+        if (napi_is_array(env, value, &is) == napi_ok && is) {
+            uint32_t length = 0;
+            napi_get_array_length(env, value, &length);
+            *out = JS_NewArray(ctx);
+            return push(Frame{value, *out, nullptr, 0, length, true});
+        }
+        if (napi_is_typedarray(env, value, &is) == napi_ok && is) {
+            napi_typedarray_type arrayType;
+            size_t length = 0;
+            void *data = nullptr;
+            napi_value arraybuffer;
+            size_t offset = 0;
+            if (napi_get_typedarray_info(env, value, &arrayType, &length, &data, &arraybuffer, &offset) != napi_ok) {
+                return throwError("napi_get_typedarray_info failed");
+            }
+            int jsType = napiToJSTypedArray(arrayType);
+            if (jsType < 0) {
+                *out = JS_NULL;
+                return true;
+            }
+            // data 已经加上了 byte offset，只拷这个视图覆盖的那一段
+            size_t size = length * typedArrayElementSize(arrayType);
+            JSValue buffer = JS_NewArrayBufferCopy(ctx, static_cast<const uint8_t *>(data), size);
+            if (JS_IsException(buffer)) {
+                return false;
+            }
+            *out = JS_NewTypedArray(ctx, 1, &buffer, static_cast<JSTypedArrayEnum>(jsType));
+            JS_FreeValue(ctx, buffer);
+            return !JS_IsException(*out);
+        }
+        if (napi_is_arraybuffer(env, value, &is) == napi_ok && is) {
+            void *data = nullptr;
+            size_t size = 0;
+            if (napi_get_arraybuffer_info(env, value, &data, &size) != napi_ok) {
+                return throwError("napi_get_arraybuffer_info failed");
+            }
+            *out = JS_NewArrayBufferCopy(ctx, static_cast<const uint8_t *>(data), size);
+            return !JS_IsException(*out);
+        }
+        napi_value names;
+        uint32_t count = 0;
+        if (napi_get_property_names(env, value, &names) != napi_ok ||
+            napi_get_array_length(env, names, &count) != napi_ok) {
+            return throwError("napi_get_property_names failed");
+        }
+        *out = JS_NewObject(ctx);
+        return push(Frame{value, *out, names, 0, count, false});
+    }
+
+    bool push(Frame frame) {
+        if (JS_IsException(frame.dst)) {
+            return false;
+        }
+        frame.dst = JS_DupValue(ctx, frame.dst);
+        stack.push_back(frame);
+        return true;
+    }
+
+    JSAtom atomFor(napi_value name) {
+        napi_value str = name;
+        napi_valuetype type = napi_undefined;
+        napi_typeof(env, name, &type);
+        if (type != napi_string && napi_coerce_to_string(env, name, &str) != napi_ok) {
+            throwError("property name is not a string");
+            return JS_ATOM_NULL;
+        }
+        if (!readString(str)) {
+            throwError("napi_get_value_string_utf8 failed");
+            return JS_ATOM_NULL;
+        }
+        auto it = atoms.find(scratch);
+        if (it != atoms.end()) {
+            return it->second;
+        }
+        JSAtom atom = JS_NewAtomLen(ctx, scratch.data(), scratch.size());
+        if (atom != JS_ATOM_NULL) {
+            atoms.emplace(scratch, atom);
+        }
+        return atom;
+    }
+
+    // 读到 scratch 里，复用同一块缓冲区，不再每个字符串 malloc 一次
+    bool readString(napi_value value) {
+        size_t length = 0;
+        if (napi_get_value_string_utf8(env, value, nullptr, 0, &length) != napi_ok) {
+            return false;
+        }
+        scratch.resize(length);
+        return napi_get_value_string_utf8(env, value, &scratch[0], length + 1, &length) == napi_ok;
+    }
+
+    bool throwError(const char *message) {
+        JS_ThrowInternalError(ctx, "napi to JS: %s", message);
+        return false;
+    }
+
+    JSValue fail(JSValue result, const char *message) {
+        if (message) {
+            throwError(message);
+        }
+        JS_FreeValue(ctx, result);
+        return JS_EXCEPTION;
+    }
+
+    napi_env env;
+    JSContext *ctx;
+    std::vector<Frame> stack;
+    std::unordered_map<std::string, JSAtom> atoms;
+    std::string scratch;
+};
+
+class JSToNapi {
+public:
+    JSToNapi(napi_env env, JSContext *ctx) : env(env), ctx(ctx) {}
+
+    ~JSToNapi() {
+        for (Frame &frame : stack) {
+            release(frame);
+        }
+        for (auto &entry : keys) {
+            JS_FreeAtom(ctx, entry.first);
+        }
+        if (arrayBufferCtorLoaded) {
+            JS_FreeValue(ctx, arrayBufferCtor);
+        }
+    }
+
+    // 失败返回 nullptr，JS 异常（比如 getter 抛出的）留在 ctx 上
+    napi_value convert(JSValueConst root) {
+        napi_value result = nullptr;
+        if (!convertValue(root, &result)) {
+            return nullptr;
+        }
+        while (!stack.empty()) {
+            Frame &frame = stack.back();
+            if (frame.index >= frame.count) {
+                release(frame);
+                stack.pop_back();
+                continue;
+            }
+            uint32_t index = frame.index++;
+            napi_value parent = frame.dst;
+            bool isArray = frame.isArray;
+            JSValue child;
+            napi_value key = nullptr;
+            if (isArray) {
+                child = JS_GetPropertyUint32(ctx, frame.src, index);
+            } else {
+                JSAtom atom = frame.props[index].atom;
+                child = JS_GetProperty(ctx, frame.src, atom);
+                key = keyFor(atom);
+                if (!key) {
+                    JS_FreeValue(ctx, child);
+                    return nullptr;
+                }
+            }
+            if (JS_IsException(child)) {
+                return nullptr;
+            }
+            napi_value value = nullptr;
+            bool ok = convertValue(child, &value);
+            JS_FreeValue(ctx, child);
+            if (!ok) {
+                return nullptr;
+            }
+            // 转不了的值（函数、Symbol）跳过，和原来一样
+            if (value) {
+                if (isArray) {
+                    napi_set_element(env, parent, index, value);
+                } else {
+                    napi_set_property(env, parent, key, value);
+                }
+            }
+        }
+        return result;
+    }
+
+private:
+    struct Frame {
+        JSValue src; // 持有一份引用，出栈时释放
+        napi_value dst;
+        JSPropertyEnum *props;
+        uint32_t index;
+        uint32_t count;
+        bool isArray;
+    };
+
+    bool convertValue(JSValueConst value, napi_value *out) {
+        switch (JS_VALUE_GET_TAG(value)) {
+            case JS_TAG_UNDEFINED:
+                return napi_get_undefined(env, out) == napi_ok;
+            case JS_TAG_NULL:
+                return napi_get_null(env, out) == napi_ok;
+            case JS_TAG_BOOL:
+                return napi_get_boolean(env, JS_VALUE_GET_BOOL(value), out) == napi_ok;
+            case JS_TAG_INT:
+                return napi_create_int32(env, JS_VALUE_GET_INT(value), out) == napi_ok;
+            case JS_TAG_FLOAT64:
+                return napi_create_double(env, JS_VALUE_GET_FLOAT64(value), out) == napi_ok;
+            case JS_TAG_STRING: {
+                size_t length = 0;
+                const char *s = JS_ToCStringLen(ctx, &length, value);
+                if (!s) {
+                    return false;
+                }
+                napi_status status = napi_create_string_utf8(env, s, length, out);
+                JS_FreeCString(ctx, s);
+                return status == napi_ok;
+            }
+            case JS_TAG_OBJECT:
+                return convertObject(value, out);
+            default:
+                *out = nullptr;
+                return true;
+        }
+    }
+
+    bool convertObject(JSValueConst value, napi_value *out) {
+        if (JS_IsFunction(ctx, value)) {
+            *out = nullptr;
+            return true;
+        }
+        if (stack.size() >= kCycleCheckDepth) {
+            for (const Frame &frame : stack) {
+                if (JS_VALUE_GET_PTR(frame.src) == JS_VALUE_GET_PTR(value)) {
+                    JS_ThrowTypeError(ctx, "converting circular structure");
+                    return false;
+                }
+            }
+        }
+        if (JS_IsArray(ctx, value) == 1) {
+            uint32_t length = 0;
+            JSValue lengthValue = JS_GetPropertyStr(ctx, value, "length");
+            int failed = JS_ToUint32(ctx, &length, lengthValue);
+            JS_FreeValue(ctx, lengthValue);
+            if (failed || napi_create_array_with_length(env, length, out) != napi_ok) {
+                return false;
+            }
+            stack.push_back(Frame{JS_DupValue(ctx, value), *out, nullptr, 0, length, true});
+            return true;
+        }
+        int napiType = jsToNapiTypedArray(JS_GetTypedArrayType(value));
+        if (napiType >= 0) {
+            size_t offset = 0, byteLength = 0, bytesPerElement = 0;
+            JSValue buffer = JS_GetTypedArrayBuffer(ctx, value, &offset, &byteLength, &bytesPerElement);
+            if (JS_IsException(buffer)) {
+                return false;
+            }
+            size_t size = 0;
+            uint8_t *data = JS_GetArrayBuffer(ctx, &size, buffer);
+            JS_FreeValue(ctx, buffer);
+            napi_value arraybuffer;
+            if (!copyArrayBuffer(data ? data + offset : nullptr, byteLength, &arraybuffer)) {
+                return false;
+            }
+            size_t length = bytesPerElement > 0 ? byteLength / bytesPerElement : 0;
+            return napi_create_typedarray(env, static_cast<napi_typedarray_type>(napiType), length, arraybuffer, 0,
+                                          out) == napi_ok;
+        }
+        if (isArrayBuffer(value)) {
+            size_t size = 0;
+            uint8_t *data = JS_GetArrayBuffer(ctx, &size, value);
+            return copyArrayBuffer(data, size, out);
+        }
+
+        JSPropertyEnum *props = nullptr;
+        uint32_t count = 0;
+        if (JS_GetOwnPropertyNames(ctx, &props, &count, value, JS_GPN_STRING_MASK | JS_GPN_ENUM_ONLY) != 0) {
+            return false;
+        }
+        if (napi_create_object(env, out) != napi_ok) {
+            freeProps(props, count);
+            return false;
+        }
+        stack.push_back(Frame{JS_DupValue(ctx, value), *out, props, 0, count, false});
+        return true;
+    }
+
+    bool copyArrayBuffer(const uint8_t *data, size_t size, napi_value *out) {
+        void *dst = nullptr;
+        if (napi_create_arraybuffer(env, size, &dst, out) != napi_ok) {
+            return false;
+        }
+        if (size > 0 && data) {
+            std::memcpy(dst, data, size);
+        }
+        return true;
+    }
+
+    bool isArrayBuffer(JSValueConst value) {
+        if (!arrayBufferCtorLoaded) {
+            JSValue global = JS_GetGlobalObject(ctx);
+            arrayBufferCtor = JS_GetPropertyStr(ctx, global, "ArrayBuffer");
+            JS_FreeValue(ctx, global);
+            arrayBufferCtorLoaded = true;
+        }
+        return JS_IsInstanceOf(ctx, value, arrayBufferCtor) == 1;
+    }
+
+    napi_value keyFor(JSAtom atom) {
+        auto it = keys.find(atom);
+        if (it != keys.end()) {
+            return it->second;
+        }
+        size_t length = 0;
+        JSValue name = JS_AtomToString(ctx, atom);
+        const char *s = JS_ToCStringLen(ctx, &length, name);
+        JS_FreeValue(ctx, name);
+        if (!s) {
+            return nullptr;
+        }
+        napi_value key = nullptr;
+        napi_status status = napi_create_string_utf8(env, s, length, &key);
+        JS_FreeCString(ctx, s);
+        if (status != napi_ok) {
+            return nullptr;
+        }
+        keys.emplace(JS_DupAtom(ctx, atom), key);
+        return key;
+    }
+
+    void release(Frame &frame) {
+        JS_FreeValue(ctx, frame.src);
+        freeProps(frame.props, frame.count);
+    }
+
+    void freeProps(JSPropertyEnum *props, uint32_t count) {
+        if (!props) {
+            return;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            JS_FreeAtom(ctx, props[i].atom);
+        }
+        js_free(ctx, props);
+    }
+
+    napi_env env;
+    JSContext *ctx;
+    std::vector<Frame> stack;
+    std::unordered_map<JSAtom, napi_value> keys;
+    JSValue arrayBufferCtor = JS_UNDEFINED;
+    bool arrayBufferCtorLoaded = false;
+};
+
+} // namespace
+
+#pragma 类型转换 Jsvalue 转 Napi
+napi_value ConvertJSValueToNapiValue(napi_env env, JSContext *ctx, JSValueConst jsValue) {
+    return JSToNapi(env, ctx).convert(jsValue);
+}
+
+napi_value ConvertJSObjectToNapiObject(napi_env env, JSContext *ctx, JSValueConst jsValue) {
+    return ConvertJSValueToNapiValue(env, ctx, jsValue);
+}
+
+#pragma 类型转换 Napi 转 Jsvalue
+JSValue ConvertNapiValueToJsValue(napi_env env, JSContext *ctx, napi_value napiValue) {
+    return NapiToJS(env, ctx).convert(napiValue);
+}
+
+JSValue ConvertNapiObjectToJSObject(napi_env env, JSContext *ctx, napi_value napiObject) {
+    return ConvertNapiValueToJsValue(env, ctx, napiObject);
+}
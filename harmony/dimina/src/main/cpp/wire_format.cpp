@@ -0,0 +1,988 @@
+//
+// Created on 2026/10/16.
+//
+
+#include "wire_format.h"
+#include "log.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+enum : uint8_t {
+    kTagUndefined = 0x00,
+    kTagNull = 0x01,
+    kTagFalse = 0x02,
+    kTagTrue = 0x03,
+    kTagInt = 0x04,
+    kTagDouble = 0x05,
+    kTagString = 0x06,
+    kTagArray = 0x07,
+    kTagObject = 0x08,
+    kTagArrayBuffer = 0x09,
+    kTagTypedArray = 0x0A,
+};
+
+// 嵌套超过这个深度按循环引用处理，也防止递归把线程栈用完
+constexpr int kMaxDepth = 128;
+// 对象的键个数先占 5 个字节，写完再回填：带续位的 varint 可以补齐到固定长度，解码方不用区分
+constexpr size_t kCountSlot = 5;
+
+class Writer {
+public:
+    ~Writer() {
+        std::free(data);
+    }
+
+    bool failed = false;
+
+    void byte(uint8_t value) {
+        if (reserve(1)) {
+            data[length++] = static_cast<char>(value);
+        }
+    }
+
+    void varint(uint64_t value) {
+        while (value >= 0x80) {
+            byte(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+        byte(static_cast<uint8_t>(value));
+    }
+
+    void bytes(const void *src, size_t n) {
+        if (n > 0 && reserve(n)) {
+            std::memcpy(data + length, src, n);
+            length += n;
+        }
+    }
+
+    void f64(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        for (int i = 0; i < 8; i++) {
+            byte(static_cast<uint8_t>(bits >> (i * 8)));
+        }
+    }
+
+    void str(const char *s, size_t n) {
+        varint(n);
+        bytes(s, n);
+    }
+
+    size_t beginCount() {
+        size_t at = length;
+        if (reserve(kCountSlot)) {
+            length += kCountSlot;
+        }
+        return at;
+    }
+
+    void endCount(size_t at, uint32_t count) {
+        if (failed) {
+            return;
+        }
+        for (size_t i = 0; i < kCountSlot; i++) {
+            uint8_t b = static_cast<uint8_t>(count & 0x7F);
+            count >>= 7;
+            data[at + i] = static_cast<char>(i + 1 < kCountSlot ? (b | 0x80) : b);
+        }
+    }
+
+    char *release(size_t *outLength) {
+        if (failed) {
+            return nullptr;
+        }
+        char *result = data;
+        *outLength = length;
+        data = nullptr;
+        length = capacity = 0;
+        return result;
+    }
+
+private:
+    bool reserve(size_t n) {
+        if (failed) {
+            return false;
+        }
+        if (length + n > capacity) {
+            size_t next = capacity ? capacity * 2 : 256;
+            while (next < length + n) {
+                next *= 2;
+            }
+            char *grown = static_cast<char *>(std::realloc(data, next));
+            if (!grown) {
+                failed = true;
+                return false;
+            }
+            data = grown;
+            capacity = next;
+        }
+        return true;
+    }
+
+    char *data = nullptr;
+    size_t length = 0;
+    size_t capacity = 0;
+};
+
+class Reader {
+public:
+    Reader(const uint8_t *data, size_t length) : p(data), end(data + length) {}
+
+    bool failed = false;
+
+    uint8_t byte() {
+        if (p >= end) {
+            failed = true;
+            return 0;
+        }
+        return *p++;
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t b = byte();
+            value |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) {
+                return value;
+            }
+        }
+        failed = true;
+        return 0;
+    }
+
+    const uint8_t *bytes(uint64_t n) {
+        if (n > static_cast<uint64_t>(end - p)) {
+            failed = true;
+            return nullptr;
+        }
+        const uint8_t *at = p;
+        p += n;
+        return at;
+    }
+
+    double f64() {
+        const uint8_t *b = bytes(8);
+        uint64_t bits = 0;
+        for (int i = 0; b && i < 8; i++) {
+            bits |= static_cast<uint64_t>(b[i]) << (i * 8);
+        }
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // 元素个数至少占 1 个字节，超过剩余字节数的一定是坏数据，提前拦住免得按它分配
+    uint64_t count() {
+        uint64_t n = varint();
+        if (n > static_cast<uint64_t>(end - p)) {
+            failed = true;
+            return 0;
+        }
+        return n;
+    }
+
+    bool atEnd() const {
+        return p == end;
+    }
+
+private:
+    const uint8_t *p;
+    const uint8_t *end;
+};
+
+int64_t zigzagDecode(uint64_t n) {
+    return static_cast<int64_t>(n >> 1) ^ -static_cast<int64_t>(n & 1);
+}
+
+uint64_t zigzagEncode(int32_t n) {
+    return (static_cast<uint32_t>(n) << 1) ^ static_cast<uint32_t>(n >> 31);
+}
+
+void writeNumber(Writer &w, double d) {
+    if (d >= INT32_MIN && d <= INT32_MAX && std::floor(d) == d && !(d == 0 && std::signbit(d))) {
+        w.byte(kTagInt);
+        w.varint(zigzagEncode(static_cast<int32_t>(d)));
+    } else {
+        w.byte(kTagDouble);
+        w.f64(d);
+    }
+}
+
+// ========== QuickJS ==========
+
+int typedArrayKind(int jsType) {
+    switch (jsType) {
+        case JS_TYPED_ARRAY_INT8: return napi_int8_array;
+        case JS_TYPED_ARRAY_UINT8: return napi_uint8_array;
+        case JS_TYPED_ARRAY_UINT8C: return napi_uint8_clamped_array;
+        case JS_TYPED_ARRAY_INT16: return napi_int16_array;
+        case JS_TYPED_ARRAY_UINT16: return napi_uint16_array;
+        case JS_TYPED_ARRAY_INT32: return napi_int32_array;
+        case JS_TYPED_ARRAY_UINT32: return napi_uint32_array;
+        case JS_TYPED_ARRAY_FLOAT32: return napi_float32_array;
+        case JS_TYPED_ARRAY_FLOAT64: return napi_float64_array;
+        case JS_TYPED_ARRAY_BIG_INT64: return napi_bigint64_array;
+        case JS_TYPED_ARRAY_BIG_UINT64: return napi_biguint64_array;
+        default: return -1; // Float16 之类没有对应的，按普通对象编码
+    }
+}
+
+int jsTypedArrayType(uint8_t kind) {
+    switch (kind) {
+        case napi_int8_array: return JS_TYPED_ARRAY_INT8;
+        case napi_uint8_array: return JS_TYPED_ARRAY_UINT8;
+        case napi_uint8_clamped_array: return JS_TYPED_ARRAY_UINT8C;
+        case napi_int16_array: return JS_TYPED_ARRAY_INT16;
+        case napi_uint16_array: return JS_TYPED_ARRAY_UINT16;
+        case napi_int32_array: return JS_TYPED_ARRAY_INT32;
+        case napi_uint32_array: return JS_TYPED_ARRAY_UINT32;
+        case napi_float32_array: return JS_TYPED_ARRAY_FLOAT32;
+        case napi_float64_array: return JS_TYPED_ARRAY_FLOAT64;
+        case napi_bigint64_array: return JS_TYPED_ARRAY_BIG_INT64;
+        case napi_biguint64_array: return JS_TYPED_ARRAY_BIG_UINT64;
+        default: return -1;
+    }
+}
+
+int elementSize(uint8_t kind) {
+    static const int sizes[] = {1, 1, 1, 2, 2, 4, 4, 4, 8, 8, 8};
+    return kind < sizeof(sizes) / sizeof(sizes[0]) ? sizes[kind] : 0;
+}
+
+class JSEncoder {
+public:
+    JSEncoder(JSContext *ctx) : ctx(ctx) {
+        JSValue global = JS_GetGlobalObject(ctx);
+        arrayBufferCtor = JS_GetPropertyStr(ctx, global, "ArrayBuffer");
+        JS_FreeValue(ctx, global);
+    }
+
+    ~JSEncoder() {
+        JS_FreeValue(ctx, arrayBufferCtor);
+        for (auto &entry : keys) {
+            JS_FreeAtom(ctx, entry.first);
+        }
+    }
+
+    // 返回 false 时异常已经挂在 ctx 上
+    bool encode(JSValueConst value, int depth) {
+        switch (JS_VALUE_GET_TAG(value)) {
+            case JS_TAG_UNDEFINED:
+                w.byte(kTagUndefined);
+                return true;
+            case JS_TAG_NULL:
+                w.byte(kTagNull);
+                return true;
+            case JS_TAG_BOOL:
+                w.byte(JS_VALUE_GET_BOOL(value) ? kTagTrue : kTagFalse);
+                return true;
+            case JS_TAG_INT:
+                w.byte(kTagInt);
+                w.varint(zigzagEncode(JS_VALUE_GET_INT(value)));
+                return true;
+            case JS_TAG_FLOAT64: {
+                double d = JS_VALUE_GET_FLOAT64(value);
+                // 和 JSON 一致，NaN / Infinity 编成 null
+                if (std::isfinite(d)) {
+                    writeNumber(w, d);
+                } else {
+                    w.byte(kTagNull);
+                }
+                return true;
+            }
+            case JS_TAG_STRING: {
+                size_t len = 0;
+                const char *s = JS_ToCStringLen(ctx, &len, value);
+                if (!s) {
+                    return false;
+                }
+                w.byte(kTagString);
+                w.str(s, len);
+                JS_FreeCString(ctx, s);
+                return true;
+            }
+            case JS_TAG_OBJECT:
+                return encodeObject(value, depth);
+            default:
+                // Symbol、BigInt 之类，JSON 也表示不了
+                w.byte(kTagUndefined);
+                return true;
+        }
+    }
+
+    char *release(size_t *length) {
+        if (w.failed) {
+            JS_ThrowOutOfMemory(ctx);
+        }
+        return w.release(length);
+    }
+
+    Writer w;
+
+private:
+    bool encodeObject(JSValueConst value, int depth) {
+        if (depth >= kMaxDepth) {
+            JS_ThrowRangeError(ctx, "wire format: object nested too deeply or circular");
+            return false;
+        }
+        if (JS_IsFunction(ctx, value)) {
+            w.byte(kTagUndefined);
+            return true;
+        }
+        if (JS_IsArray(ctx, value) == 1) {
+            uint32_t count = 0;
+            JSValue lengthValue = JS_GetPropertyStr(ctx, value, "length");
+            int failed = JS_ToUint32(ctx, &count, lengthValue);
+            JS_FreeValue(ctx, lengthValue);
+            if (failed) {
+                return false;
+            }
+            w.byte(kTagArray);
+            w.varint(count);
+            for (uint32_t i = 0; i < count; i++) {
+                JSValue element = JS_GetPropertyUint32(ctx, value, i);
+                if (JS_IsException(element)) {
+                    return false;
+                }
+                // 数组里的 undefined / 函数和 JSON 一样变成 null
+                bool ok;
+                if (JS_IsUndefined(element) || JS_IsFunction(ctx, element)) {
+                    w.byte(kTagNull);
+                    ok = true;
+                } else {
+                    ok = encode(element, depth + 1);
+                }
+                JS_FreeValue(ctx, element);
+                if (!ok) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        int kind = typedArrayKind(JS_GetTypedArrayType(value));
+        if (kind >= 0) {
+            size_t offset = 0, byteLength = 0, bytesPerElement = 0;
+            JSValue buffer = JS_GetTypedArrayBuffer(ctx, value, &offset, &byteLength, &bytesPerElement);
+            if (JS_IsException(buffer)) {
+                return false;
+            }
+            size_t size = 0;
+            uint8_t *data = JS_GetArrayBuffer(ctx, &size, buffer);
+            JS_FreeValue(ctx, buffer);
+            if (!data) {
+                return false;
+            }
+            w.byte(kTagTypedArray);
+            w.byte(static_cast<uint8_t>(kind));
+            w.varint(byteLength);
+            w.bytes(data + offset, byteLength);
+            return true;
+        }
+        if (JS_IsInstanceOf(ctx, value, arrayBufferCtor) == 1) {
+            size_t size = 0;
+            uint8_t *data = JS_GetArrayBuffer(ctx, &size, value);
+            if (!data && size > 0) {
+                return false;
+            }
+            discardPendingError();
+            w.byte(kTagArrayBuffer);
+            w.varint(size);
+            w.bytes(data, size);
+            return true;
+        }
+
+        // 和 JSON.stringify 一样认 toJSON，Date 之类的对象靠它给出真正的内容，不然只剩 {}
+        JSValue toJSON = JS_GetPropertyStr(ctx, value, "toJSON");
+        if (JS_IsException(toJSON)) {
+            return false;
+        }
+        if (JS_IsFunction(ctx, toJSON)) {
+            JSValue key = JS_NewString(ctx, "");
+            JSValue replaced = JS_Call(ctx, toJSON, value, 1, &key);
+            JS_FreeValue(ctx, key);
+            JS_FreeValue(ctx, toJSON);
+            if (JS_IsException(replaced)) {
+                return false;
+            }
+            bool ok = encode(replaced, depth + 1);
+            JS_FreeValue(ctx, replaced);
+            return ok;
+        }
+        JS_FreeValue(ctx, toJSON);
+
+        JSPropertyEnum *props = nullptr;
+        uint32_t len = 0;
+        if (JS_GetOwnPropertyNames(ctx, &props, &len, value, JS_GPN_STRING_MASK | JS_GPN_ENUM_ONLY) != 0) {
+            return false;
+        }
+        w.byte(kTagObject);
+        size_t countAt = w.beginCount();
+        uint32_t written = 0;
+        bool ok = true;
+        uint32_t i = 0;
+        for (; i < len && ok; i++) {
+            JSValue prop = JS_GetProperty(ctx, value, props[i].atom);
+            if (JS_IsException(prop)) {
+                ok = false;
+            } else if (!JS_IsUndefined(prop) && !JS_IsFunction(ctx, prop) &&
+                       JS_VALUE_GET_TAG(prop) != JS_TAG_SYMBOL) {
+                // 和 JSON 一样，值为 undefined / 函数 / Symbol 的键直接跳过
+                ok = writeKey(props[i].atom) && encode(prop, depth + 1);
+                written++;
+            }
+            JS_FreeValue(ctx, prop);
+            JS_FreeAtom(ctx, props[i].atom);
+        }
+        for (; i < len; i++) {
+            JS_FreeAtom(ctx, props[i].atom);
+        }
+        js_free(ctx, props);
+        w.endCount(countAt, written);
+        return ok;
+    }
+
+    bool writeKey(JSAtom atom) {
+        auto it = keys.find(atom);
+        if (it != keys.end()) {
+            w.varint(it->second);
+            return true;
+        }
+        size_t len = 0;
+        JSValue name = JS_AtomToString(ctx, atom);
+        const char *s = JS_ToCStringLen(ctx, &len, name);
+        JS_FreeValue(ctx, name);
+        if (!s) {
+            return false;
+        }
+        w.varint(0);
+        w.str(s, len);
+        JS_FreeCString(ctx, s);
+        keys.emplace(JS_DupAtom(ctx, atom), static_cast<uint32_t>(keys.size() + 1));
+        return true;
+    }
+
+    // 长度为 0 的 ArrayBuffer 拿到的指针可能是空，不是错误
+    void discardPendingError() {
+        if (JS_HasException(ctx)) {
+            JS_FreeValue(ctx, JS_GetException(ctx));
+        }
+    }
+
+    JSContext *ctx;
+    JSValue arrayBufferCtor;
+    std::unordered_map<JSAtom, uint32_t> keys;
+};
+
+class JSDecoder {
+public:
+    JSDecoder(JSContext *ctx, const uint8_t *data, size_t length) : r(data, length), ctx(ctx) {}
+
+    ~JSDecoder() {
+        for (JSAtom atom : keys) {
+            JS_FreeAtom(ctx, atom);
+        }
+    }
+
+    JSValue decode(int depth) {
+        if (depth >= kMaxDepth) {
+            return corrupt();
+        }
+        uint8_t tag = r.byte();
+        if (r.failed) {
+            return corrupt();
+        }
+        switch (tag) {
+            case kTagUndefined: return JS_UNDEFINED;
+            case kTagNull: return JS_NULL;
+            case kTagFalse: return JS_FALSE;
+            case kTagTrue: return JS_TRUE;
+            case kTagInt: {
+                int64_t n = zigzagDecode(r.varint());
+                return r.failed ? corrupt() : JS_NewInt32(ctx, static_cast<int32_t>(n));
+            }
+            case kTagDouble: {
+                double d = r.f64();
+                return r.failed ? corrupt() : JS_NewFloat64(ctx, d);
+            }
+            case kTagString: {
+                uint64_t n = r.varint();
+                const uint8_t *s = r.bytes(n);
+                return r.failed ? corrupt() : JS_NewStringLen(ctx, reinterpret_cast<const char *>(s), n);
+            }
+            case kTagArray: {
+                uint64_t count = r.count();
+                if (r.failed) {
+                    return corrupt();
+                }
+                JSValue array = JS_NewArray(ctx);
+                for (uint64_t i = 0; i < count && !JS_IsException(array); i++) {
+                    JSValue element = decode(depth + 1);
+                    if (JS_IsException(element) ||
+                        JS_DefinePropertyValueUint32(ctx, array, static_cast<uint32_t>(i), element, JS_PROP_C_W_E) < 0) {
+                        JS_FreeValue(ctx, array);
+                        array = JS_EXCEPTION;
+                    }
+                }
+                return array;
+            }
+            case kTagObject: {
+                uint64_t count = r.count();
+                if (r.failed) {
+                    return corrupt();
+                }
+                JSValue object = JS_NewObject(ctx);
+                for (uint64_t i = 0; i < count && !JS_IsException(object); i++) {
+                    JSAtom key = readKey();
+                    JSValue prop = key == JS_ATOM_NULL ? JS_EXCEPTION : decode(depth + 1);
+                    if (JS_IsException(prop) || JS_DefinePropertyValue(ctx, object, key, prop, JS_PROP_C_W_E) < 0) {
+                        JS_FreeValue(ctx, object);
+                        object = JS_EXCEPTION;
+                    }
+                }
+                return object;
+            }
+            case kTagArrayBuffer: {
+                uint64_t n = r.varint();
+                const uint8_t *data = r.bytes(n);
+                return r.failed ? corrupt() : JS_NewArrayBufferCopy(ctx, data, n);
+            }
+            case kTagTypedArray: {
+                uint8_t kind = r.byte();
+                uint64_t n = r.varint();
+                const uint8_t *data = r.bytes(n);
+                int type = jsTypedArrayType(kind);
+                if (r.failed || type < 0 || n % elementSize(kind) != 0) {
+                    return corrupt();
+                }
+                JSValue buffer = JS_NewArrayBufferCopy(ctx, data, n);
+                if (JS_IsException(buffer)) {
+                    return buffer;
+                }
+                JSValue array = JS_NewTypedArray(ctx, 1, &buffer, static_cast<JSTypedArrayEnum>(type));
+                JS_FreeValue(ctx, buffer);
+                return array;
+            }
+            default:
+                return corrupt();
+        }
+    }
+
+    Reader r;
+
+private:
+    JSAtom readKey() {
+        uint64_t index = r.varint();
+        if (r.failed) {
+            corrupt();
+            return JS_ATOM_NULL;
+        }
+        if (index > 0) {
+            if (index > keys.size()) {
+                corrupt();
+                return JS_ATOM_NULL;
+            }
+            return keys[index - 1];
+        }
+        uint64_t n = r.varint();
+        const uint8_t *s = r.bytes(n);
+        if (r.failed) {
+            corrupt();
+            return JS_ATOM_NULL;
+        }
+        JSAtom atom = JS_NewAtomLen(ctx, reinterpret_cast<const char *>(s), n);
+        if (atom != JS_ATOM_NULL) {
+            keys.push_back(atom);
+        }
+        return atom;
+    }
+
+    JSValue corrupt() {
+        if (!JS_HasException(ctx)) {
+            JS_ThrowSyntaxError(ctx, "wire format: malformed message");
+        }
+        return JS_EXCEPTION;
+    }
+
+    JSContext *ctx;
+    // JS_DefinePropertyValue 不接管 atom，字典里的 atom 统一在析构时释放
+    std::vector<JSAtom> keys;
+};
+
+// ========== napi ==========
+
+class NapiEncoder {
+public:
+    NapiEncoder(napi_env env) : env(env) {}
+
+    bool encode(napi_value value, int depth) {
+        napi_valuetype type = napi_undefined;
+        if (napi_typeof(env, value, &type) != napi_ok) {
+            return false;
+        }
+        switch (type) {
+            case napi_undefined:
+            case napi_function:
+            case napi_symbol:
+            case napi_external:
+                w.byte(kTagUndefined);
+                return true;
+            case napi_null:
+                w.byte(kTagNull);
+                return true;
+            case napi_boolean: {
+                bool b = false;
+                napi_get_value_bool(env, value, &b);
+                w.byte(b ? kTagTrue : kTagFalse);
+                return true;
+            }
+            case napi_number: {
+                double d = 0;
+                napi_get_value_double(env, value, &d);
+                if (std::isfinite(d)) {
+                    writeNumber(w, d);
+                } else {
+                    w.byte(kTagNull);
+                }
+                return true;
+            }
+            case napi_string: {
+                size_t len = 0;
+                if (napi_get_value_string_utf8(env, value, nullptr, 0, &len) != napi_ok) {
+                    return false;
+                }
+                std::string &s = scratch;
+                s.resize(len);
+                napi_get_value_string_utf8(env, value, &s[0], len + 1, &len);
+                w.byte(kTagString);
+                w.str(s.data(), len);
+                return true;
+            }
+            case napi_object:
+                return encodeObject(value, depth);
+            default:
+                w.byte(kTagUndefined);
+                return true;
+        }
+    }
+
+    Writer w;
+
+private:
+    bool encodeObject(napi_value value, int depth) {
+        if (depth >= kMaxDepth) {
+            OHError("wire format: object nested too deeply or circular");
+            return false;
+        }
+        bool is = false;
+        if (napi_is_array(env, value, &is) == napi_ok && is) {
+            uint32_t count = 0;
+            napi_get_array_length(env, value, &count);
+            w.byte(kTagArray);
+            w.varint(count);
+            for (uint32_t i = 0; i < count; i++) {
+                napi_value element;
+                if (napi_get_element(env, value, i, &element) != napi_ok) {
+                    return false;
+                }
+                napi_valuetype type = napi_undefined;
+                napi_typeof(env, element, &type);
+                if (type == napi_undefined || type == napi_function) {
+                    w.byte(kTagNull);
+                } else if (!encode(element, depth + 1)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        if (napi_is_typedarray(env, value, &is) == napi_ok && is) {
+            napi_typedarray_type arrayType;
+            size_t count = 0;
+            void *data = nullptr;
+            if (napi_get_typedarray_info(env, value, &arrayType, &count, &data, nullptr, nullptr) != napi_ok) {
+                return false;
+            }
+            size_t byteLength = count * elementSize(static_cast<uint8_t>(arrayType));
+            w.byte(kTagTypedArray);
+            w.byte(static_cast<uint8_t>(arrayType));
+            w.varint(byteLength);
+            w.bytes(data, byteLength);
+            return true;
+        }
+        if (napi_is_arraybuffer(env, value, &is) == napi_ok && is) {
+            void *data = nullptr;
+            size_t size = 0;
+            if (napi_get_arraybuffer_info(env, value, &data, &size) != napi_ok) {
+                return false;
+            }
+            w.byte(kTagArrayBuffer);
+            w.varint(size);
+            w.bytes(data, size);
+            return true;
+        }
+
+        // 和 JSON.stringify 一样认 toJSON，DMPMap 之类的包装对象靠它给出真正的内容
+        napi_value toJSON;
+        napi_valuetype toJSONType = napi_undefined;
+        if (napi_get_named_property(env, value, "toJSON", &toJSON) == napi_ok &&
+            napi_typeof(env, toJSON, &toJSONType) == napi_ok && toJSONType == napi_function) {
+            napi_value replaced;
+            if (napi_call_function(env, value, toJSON, 0, nullptr, &replaced) != napi_ok) {
+                return false;
+            }
+            return encode(replaced, depth + 1);
+        }
+
+        napi_value names;
+        uint32_t len = 0;
+        if (napi_get_property_names(env, value, &names) != napi_ok ||
+            napi_get_array_length(env, names, &len) != napi_ok) {
+            return false;
+        }
+        w.byte(kTagObject);
+        size_t countAt = w.beginCount();
+        uint32_t written = 0;
+        for (uint32_t i = 0; i < len; i++) {
+            napi_value name, prop;
+            if (napi_get_element(env, names, i, &name) != napi_ok ||
+                napi_get_property(env, value, name, &prop) != napi_ok) {
+                return false;
+            }
+            napi_valuetype type = napi_undefined;
+            napi_typeof(env, prop, &type);
+            if (type == napi_undefined || type == napi_function || type == napi_symbol) {
+                continue;
+            }
+            if (!writeKey(name) || !encode(prop, depth + 1)) {
+                return false;
+            }
+            written++;
+        }
+        w.endCount(countAt, written);
+        return true;
+    }
+
+    bool writeKey(napi_value name) {
+        // 键可能是数字（数组下标风格的属性名），统一转成字符串
+        napi_value str = name;
+        napi_valuetype type = napi_undefined;
+        napi_typeof(env, name, &type);
+        if (type != napi_string && napi_coerce_to_string(env, name, &str) != napi_ok) {
+            return false;
+        }
+        size_t len = 0;
+        if (napi_get_value_string_utf8(env, str, nullptr, 0, &len) != napi_ok) {
+            return false;
+        }
+        std::string key(len, '\0');
+        napi_get_value_string_utf8(env, str, &key[0], len + 1, &len);
+        auto it = keys.find(key);
+        if (it != keys.end()) {
+            w.varint(it->second);
+            return true;
+        }
+        w.varint(0);
+        w.str(key.data(), len);
+        uint32_t index = static_cast<uint32_t>(keys.size() + 1);
+        keys.emplace(std::move(key), index);
+        return true;
+    }
+
+    napi_env env;
+    std::string scratch;
+    std::unordered_map<std::string, uint32_t> keys;
+};
+
+class NapiDecoder {
+public:
+    NapiDecoder(napi_env env, const uint8_t *data, size_t length) : r(data, length), env(env) {}
+
+    napi_value decode(int depth) {
+        if (depth >= kMaxDepth) {
+            return nullptr;
+        }
+        uint8_t tag = r.byte();
+        if (r.failed) {
+            return nullptr;
+        }
+        napi_value result = nullptr;
+        switch (tag) {
+            case kTagUndefined:
+                napi_get_undefined(env, &result);
+                return result;
+            case kTagNull:
+                napi_get_null(env, &result);
+                return result;
+            case kTagFalse:
+            case kTagTrue:
+                napi_get_boolean(env, tag == kTagTrue, &result);
+                return result;
+            case kTagInt: {
+                int64_t n = zigzagDecode(r.varint());
+                if (!r.failed) {
+                    napi_create_int32(env, static_cast<int32_t>(n), &result);
+                }
+                return result;
+            }
+            case kTagDouble: {
+                double d = r.f64();
+                if (!r.failed) {
+                    napi_create_double(env, d, &result);
+                }
+                return result;
+            }
+            case kTagString: {
+                uint64_t n = r.varint();
+                const uint8_t *s = r.bytes(n);
+                if (!r.failed) {
+                    napi_create_string_utf8(env, reinterpret_cast<const char *>(s), n, &result);
+                }
+                return result;
+            }
+            case kTagArray: {
+                uint64_t count = r.count();
+                if (r.failed || napi_create_array_with_length(env, count, &result) != napi_ok) {
+                    return nullptr;
+                }
+                for (uint64_t i = 0; i < count; i++) {
+                    napi_value element = decode(depth + 1);
+                    if (!element) {
+                        return nullptr;
+                    }
+                    napi_set_element(env, result, static_cast<uint32_t>(i), element);
+                }
+                return result;
+            }
+            case kTagObject: {
+                uint64_t count = r.count();
+                if (r.failed || napi_create_object(env, &result) != napi_ok) {
+                    return nullptr;
+                }
+                for (uint64_t i = 0; i < count; i++) {
+                    napi_value key = readKey();
+                    napi_value prop = key ? decode(depth + 1) : nullptr;
+                    if (!prop) {
+                        return nullptr;
+                    }
+                    napi_set_property(env, result, key, prop);
+                }
+                return result;
+            }
+            case kTagArrayBuffer: {
+                uint64_t n = r.varint();
+                const uint8_t *data = r.bytes(n);
+                void *dst = nullptr;
+                if (r.failed || napi_create_arraybuffer(env, n, &dst, &result) != napi_ok) {
+                    return nullptr;
+                }
+                if (n > 0) {
+                    std::memcpy(dst, data, n);
+                }
+                return result;
+            }
+            case kTagTypedArray: {
+                uint8_t kind = r.byte();
+                uint64_t n = r.varint();
+                const uint8_t *data = r.bytes(n);
+                int size = elementSize(kind);
+                napi_value buffer;
+                void *dst = nullptr;
+                if (r.failed || size == 0 || n % size != 0 ||
+                    napi_create_arraybuffer(env, n, &dst, &buffer) != napi_ok) {
+                    return nullptr;
+                }
+                if (n > 0) {
+                    std::memcpy(dst, data, n);
+                }
+                napi_create_typedarray(env, static_cast<napi_typedarray_type>(kind), n / size, buffer, 0, &result);
+                return result;
+            }
+            default:
+                return nullptr;
+        }
+    }
+
+    Reader r;
+
+private:
+    // 字典里存的是已经建好的 napi 字符串，重复的键不再转换
+    napi_value readKey() {
+        uint64_t index = r.varint();
+        if (r.failed) {
+            return nullptr;
+        }
+        if (index > 0) {
+            return index <= keys.size() ? keys[index - 1] : nullptr;
+        }
+        uint64_t n = r.varint();
+        const uint8_t *s = r.bytes(n);
+        napi_value key = nullptr;
+        if (r.failed || napi_create_string_utf8(env, reinterpret_cast<const char *>(s), n, &key) != napi_ok) {
+            return nullptr;
+        }
+        keys.push_back(key);
+        return key;
+    }
+
+    napi_env env;
+    std::vector<napi_value> keys;
+};
+
+bool readHeader(Reader &r) {
+    return r.byte() == kWireMagic && r.byte() == kWireVersion && !r.failed;
+}
+
+} // namespace
+
+char *WireEncodeJSValue(JSContext *ctx, JSValueConst value, size_t *length) {
+    JSEncoder encoder(ctx);
+    encoder.w.byte(kWireMagic);
+    encoder.w.byte(kWireVersion);
+    if (!encoder.encode(value, 0)) {
+        return nullptr;
+    }
+    return encoder.release(length);
+}
+
+JSValue WireDecodeJSValue(JSContext *ctx, const uint8_t *data, size_t length) {
+    JSDecoder decoder(ctx, data, length);
+    if (!readHeader(decoder.r)) {
+        return JS_ThrowSyntaxError(ctx, "wire format: unsupported header");
+    }
+    JSValue value = decoder.decode(0);
+    if (!JS_IsException(value) && !decoder.r.atEnd()) {
+        JS_FreeValue(ctx, value);
+        return JS_ThrowSyntaxError(ctx, "wire format: trailing bytes");
+    }
+    return value;
+}
+
+char *WireEncodeNapiValue(napi_env env, napi_value value, size_t *length) {
+    NapiEncoder encoder(env);
+    encoder.w.byte(kWireMagic);
+    encoder.w.byte(kWireVersion);
+    if (!encoder.encode(value, 0)) {
+        return nullptr;
+    }
+    return encoder.w.release(length);
+}
+
+napi_value WireDecodeNapiValue(napi_env env, const uint8_t *data, size_t length) {
+    NapiDecoder decoder(env, data, length);
+    if (!readHeader(decoder.r)) {
+        OHError("wire format: unsupported header");
+        return nullptr;
+    }
+    napi_value value = decoder.decode(0);
+    if (!value || !decoder.r.atEnd()) {
+        OHError("wire format: malformed message, length: %{public}zu", length);
+        return nullptr;
+    }
+    return value;
+}
@@ -0,0 +1,50 @@
+//
+// Created on 2026/10/16.
+//
+// Node APIs are not fully supported. To solve the compilation error of the interface cannot be found,
+// please include "napi/native_api.h".
+
+#ifndef DIMINA_HARMONYOS_WIRE_FORMAT_H
+#define DIMINA_HARMONYOS_WIRE_FORMAT_H
+
+#include "napi/native_api.h"
+#include "quickjs.h"
+#include <cstddef>
+#include <cstdint>
+
+// 桥接消息的二进制编码，省掉两端各一次 JSON 序列化 / 解析。Android 侧是同一套格式。
+//
+//   消息   := 0xD1 版本(1) 值
+//   值     := 类型字节 内容
+//   0x00 undefined   0x01 null   0x02 false   0x03 true
+//   0x04 整数        zigzag varint，只用于 int32 范围内的整数
+//   0x05 浮点        8 字节 little-endian double
+//   0x06 字符串      varint 字节数 + UTF-8
+//   0x07 数组        varint 个数 + 值...
+//   0x08 对象        varint 个数 + (键 值)...
+//        键 := varint n，n 为 0 时后面跟 varint 字节数 + UTF-8，是新键，按出现顺序编号；
+//              n > 0 表示第 n 个已出现的键。同一条消息里重复的键只写一次
+//   0x09 ArrayBuffer varint 字节数 + 原始字节
+//   0x0A TypedArray  1 字节元素类型 + varint 字节数 + 原始字节。元素类型和 napi_typedarray_type 编号一致：
+//                    0 Int8 1 Uint8 2 Uint8Clamped 3 Int16 4 Uint16 5 Int32 6 Uint32 7 Float32 8 Float64
+//                    9 BigInt64 10 BigUint64
+//
+// JSON 文本不会以 0xD1 开头，接收方按首字节判断，两种格式可以混着用。
+// 和 JSON.stringify 一样：函数、Symbol 跳过（数组里编成 null），不支持循环引用（按嵌套深度报错）。
+// 对象带 toJSON 时按它的返回值编码（napi 一侧，宿主的 DMPMap 靠它）；Map 之类按普通对象的可枚举属性编码。
+
+constexpr uint8_t kWireMagic = 0xD1;
+constexpr uint8_t kWireVersion = 1;
+
+inline bool WireIsBinary(const void *data, size_t length) {
+    return length >= 2 && static_cast<const uint8_t *>(data)[0] == kWireMagic;
+}
+
+// 编码结果是 malloc 出来的缓冲区，和 JSValueToStringLen 一样交给 OwnedCStr。
+// QuickJS 两个函数只在 JS 线程调用，失败时异常挂在 ctx 上；napi 两个函数只在 ArkTS 线程调用，失败返回空。
+char *WireEncodeJSValue(JSContext *ctx, JSValueConst value, size_t *length);
+JSValue WireDecodeJSValue(JSContext *ctx, const uint8_t *data, size_t length);
+char *WireEncodeNapiValue(napi_env env, napi_value value, size_t *length);
+napi_value WireDecodeNapiValue(napi_env env, const uint8_t *data, size_t length);
+
+#endif // DIMINA_HARMONYOS_WIRE_FORMAT_H